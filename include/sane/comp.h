@@ -2,17 +2,37 @@
 #define __sane_comp_h__
 
 #include <cmath>
+#include <cfenv>
+#include <cstring>
 #include <string>
 #include <cstdlib>
 #include <cstdint>
 
 #include "sane.h"
+#include "environment.h"
 
 	// comp is an int64_t but 0x8000_0000_0000_0000 is NaN
 	//typedef int64_t comp;
 
 namespace SANE {
 
+	namespace detail {
+
+		// t rounded to an integral value in direction rd, without the host's fenv.
+		template<class T>
+		T round_integral(T t, rounding_direction rd) {
+			switch (rd) {
+				case UPWARD: return std::ceil(t);
+				case DOWNWARD: return std::floor(t);
+				case TOWARDZERO: return std::trunc(t);
+				default:
+					// std::round breaks ties away from 0.
+					if (std::fabs(t - std::trunc(t)) == T(0.5)) return 2 * std::round(t / 2);
+					return std::round(t);
+			}
+		}
+	}
+
 	struct comp {
 
 	public:
@@ -25,9 +45,10 @@ namespace SANE {
 		explicit constexpr comp(uint64_t rhs) : _data(rhs) {}
 
 
-		explicit comp(float rhs) { read_from(rhs); }
-		explicit comp(double rhs) { read_from(rhs); }
-		explicit comp(long double rhs) { read_from(rhs); }
+		// rounded in the environment's direction unless given one.
+		explicit comp(float rhs, rounding_direction rd = getround()) { read_from(rhs, rd); }
+		explicit comp(double rhs, rounding_direction rd = getround()) { read_from(rhs, rd); }
+		explicit comp(long double rhs, rounding_direction rd = getround()) { read_from(rhs, rd); }
 
 
 
@@ -40,16 +61,16 @@ namespace SANE {
 
 
 		comp &operator=(float rhs) {
-			read_from(rhs);
+			read_from(rhs, getround());
 			return *this;
 		}
 
 		comp &operator=(double rhs) {
-			read_from(rhs);
+			read_from(rhs, getround());
 			return *this;
 		}
 		comp &operator=(long double rhs) {
-			read_from(rhs);
+			read_from(rhs, getround());
 			return *this;
 		}
 
@@ -84,20 +105,26 @@ namespace SANE {
 		int64_t _data = 0;
 
 		template <class T>
-		void read_from(T t) {
+		void read_from(T t, rounding_direction rd) {
 
 			switch (std::fpclassify(t)) {
 				case FP_NAN:
 				case FP_INFINITE:
 					_data = NaN;
+					signal_exceptions(INVALID);
 					break;
-				default:
-					if (t > INT64_MAX || t < -INT64_MAX) {
+				default: {
+					// 2^63 is exact in every T.
+					T r = detail::round_integral(t, rd);
+					if (std::fabs(r) >= static_cast<T>(NaN)) {
 						_data = NaN;
+						signal_exceptions(INVALID);
 					} else {
-						_data = static_cast<int64_t>(t);
+						_data = static_cast<int64_t>(r);
+						if (r != t) signal_exceptions(INEXACT);
 					}
 					break;
+				}
 			}
 		}
 
@@ -110,6 +137,13 @@ namespace SANE {
 		friend int isnormal(const comp &);
 		friend comp abs(const comp &);
 
+		friend comp operator+(const comp &lhs, const comp &rhs);
+		friend comp operator-(const comp &lhs, const comp &rhs);
+		friend comp operator*(const comp &lhs, const comp &rhs);
+		friend comp operator/(const comp &lhs, const comp &rhs);
+		friend comp operator-(const comp &c);
+		friend comp rem(const comp &lhs, const comp &rhs);
+
 
 		friend bool operator==(const comp &lhs, const comp &rhs);
 		friend bool operator!=(const comp &lhs, const comp &rhs);
@@ -158,6 +192,112 @@ namespace SANE {
 
 	std::string to_string(const comp &c);
 
+	namespace detail {
+
+		// 10^n, n <= 19.
+		inline uint64_t pow10(unsigned n) {
+			static const uint64_t table[20] = {
+				UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000),
+				UINT64_C(100000), UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000),
+				UINT64_C(1000000000), UINT64_C(10000000000), UINT64_C(100000000000),
+				UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+				UINT64_C(1000000000000000), UINT64_C(10000000000000000), UINT64_C(100000000000000000),
+				UINT64_C(1000000000000000000), UINT64_C(10000000000000000000),
+			};
+			return table[n];
+		}
+
+		// decimal digits in x (1 for 0).
+		inline int count_digits(uint64_t x) {
+			// log10(2) ~ 1233 / 4096, from the bit length.
+			int t = (64 - floating_point::clz64(x | 1)) * 1233 >> 12;
+			return t - ((x | 1) < pow10(t)) + 1;
+		}
+
+		/*
+		 * the digits of x, two at a time, ending at end.  Eight digit
+		 * chunks come off with one 64-bit divide so the rest is 32-bit
+		 * arithmetic.
+		 */
+		inline void write_digits(char *end, uint64_t x) {
+			static const char digit_pairs[201] =
+				"00010203040506070809101112131415161718192021222324"
+				"25262728293031323334353637383940414243444546474849"
+				"50515253545556575859606162636465666768697071727374"
+				"75767778798081828384858687888990919293949596979899";
+
+			while (x >> 32) {
+				uint64_t q = x / 100000000;
+				uint32_t r = (uint32_t)(x - q * 100000000);
+				x = q;
+				for (int i = 0; i < 4; ++i) {
+					end -= 2;
+					std::memcpy(end, digit_pairs + 2 * (r % 100), 2);
+					r /= 100;
+				}
+			}
+			uint32_t y = (uint32_t)x;
+			while (y >= 100) {
+				end -= 2;
+				std::memcpy(end, digit_pairs + 2 * (y % 100), 2);
+				y /= 100;
+			}
+			if (y >= 10) std::memcpy(end - 2, digit_pairs + 2 * y, 2);
+			else end[-1] = (char)('0' + y);
+		}
+
+		// [-]digits into [first, last); the end, or nullptr if it doesn't fit.
+		inline char *format_integer(char *first, char *last, int64_t v) {
+			uint64_t m = v < 0 ? -(uint64_t)v : v;
+			int n = count_digits(m) + (v < 0);
+			if (last - first < n) return nullptr;
+			if (v < 0) *first = '-';
+			write_digits(first + n, m);
+			return first + n;
+		}
+	}
+
+	// exact, without going through long double.  Both round in the environment's direction unless given one.  In decimal.cpp.
+	decimal comp2dec(const comp &c, const decform &df, rounding_direction rd = getround());
+	comp dec2comp(const decimal &d, rounding_direction rd = getround());
+
+	/*
+	 * to_string(c) into [first, last) without allocating, like
+	 * std::to_chars.  Returns the end of the text, or nullptr if it
+	 * doesn't fit (21 bytes always does).
+	 */
+	inline char *to_chars(char *first, char *last, const comp &c) {
+		if (isnan(c)) {
+			if (last - first < 3) return nullptr;
+			std::memcpy(first, "nan", 3);
+			return first + 3;
+		}
+		return detail::format_integer(first, last, (int64_t)c);
+	}
+
+	/*
+	 * scaled comps: c counts units of 10^-scale (cents for 2, mills for
+	 * 3); scale and digits are 0 to 18.  Text is [-]mmm[.fff] with digits
+	 * fraction digits, rounded in the environment's direction (unless
+	 * given one) when digits < scale, exactly as dec2str(FIXEDDECIMAL)
+	 * prints it (-0.00 keeps its sign); dropping non-zero digits is
+	 * INEXACT.  The NaN is NAN(020).  40 bytes is always enough.  In
+	 * sane.cpp.
+	 */
+	char *to_chars(char *first, char *last, const comp &c, int scale, int digits, rounding_direction rd = getround());
+
+	inline char *to_chars(char *first, char *last, const comp &c, int scale) {
+		return to_chars(first, last, c, scale, scale);
+	}
+
+	/*
+	 * and back: [+|-]mmm[.fff], rounded the same way at scale fraction
+	 * digits, or NAN[(ddd)].  Returns the end of the number, or nullptr
+	 * (and the NaN) if there isn't one.  Rounding is INEXACT; out of
+	 * range values are the NaN, and INVALID.
+	 */
+	const char *from_chars(const char *first, const char *last, comp &c, int scale, rounding_direction rd = getround());
+
 	inline int fpclassify(const comp &c) {
 		if (isnan(c)) return FP_NAN;
 		if ((uint64_t)c == (uint64_t)0) return FP_ZERO;
@@ -196,6 +336,625 @@ namespace SANE {
 	template<> comp make_nan<comp>(unsigned);
 
 
+	/*
+	 * arithmetic.  SANE evaluates comp operations in extended and
+	 * converts back, but sums, differences and products of two comps are
+	 * exact in extended whenever they fit in a comp, so those are done as
+	 * integers; anything that overflows is the comp NaN, as the conversion
+	 * back would be.  Inexact quotients round in the environment's
+	 * rounding direction.  NaN operands give NaN.  Exceptions are
+	 * signaled as that conversion would: a NaN result is INVALID.
+	 */
+
+	namespace detail {
+
+		// false on overflow.  -2^63 (the NaN) also fails.
+		inline bool comp_add(int64_t a, int64_t b, int64_t &r) {
+		#if defined(__GNUC__)
+			return !__builtin_add_overflow(a, b, &r) && r != INT64_MIN;
+		#else
+			r = (int64_t)((uint64_t)a + (uint64_t)b);
+			return !((a ^ r) & (b ^ r) & INT64_MIN) && r != INT64_MIN;
+		#endif
+		}
+
+		inline bool comp_sub(int64_t a, int64_t b, int64_t &r) {
+		#if defined(__GNUC__)
+			return !__builtin_sub_overflow(a, b, &r) && r != INT64_MIN;
+		#else
+			r = (int64_t)((uint64_t)a - (uint64_t)b);
+			return !((a ^ b) & (a ^ r) & INT64_MIN) && r != INT64_MIN;
+		#endif
+		}
+
+		inline bool comp_mul(int64_t a, int64_t b, int64_t &r) {
+		#if defined(__GNUC__)
+			return !__builtin_mul_overflow(a, b, &r) && r != INT64_MIN;
+		#else
+			// operands are never -2^63, so the magnitudes fit.
+			uint64_t ua = a < 0 ? -(uint64_t)a : a;
+			uint64_t ub = b < 0 ? -(uint64_t)b : b;
+			if (ua && ub > (uint64_t)INT64_MAX / ua) return false;
+			uint64_t p = ua * ub;
+			r = (a < 0) != (b < 0) ? -(int64_t)p : (int64_t)p;
+			return true;
+		#endif
+		}
+
+		// |a| / |b|, with a 32-bit divide when both fit (most amounts).
+		inline void comp_divide(uint64_t ua, uint64_t ub, uint64_t &q, uint64_t &r) {
+			if (!((ua | ub) >> 32)) {
+				q = (uint32_t)ua / (uint32_t)ub;
+				r = (uint32_t)ua % (uint32_t)ub;
+			} else {
+				q = ua / ub;
+				r = ua % ub;
+			}
+		}
+
+		// |r| > |b| / 2, or exactly half with q odd.  Branch free; it's
+		// a coin toss for most data.
+		inline uint64_t comp_round_nearest(uint64_t q, uint64_t r, uint64_t b) {
+			return (r > b - r) | ((r == b - r) & q & 1);
+		}
+	}
+
+	namespace detail {
+		inline comp comp_invalid() {
+			signal_exceptions(INVALID);
+			return comp(comp::NaN);
+		}
+	}
+
+	inline comp operator+(const comp &lhs, const comp &rhs) {
+		int64_t r;
+		if (isnan(lhs) || isnan(rhs) || !detail::comp_add(lhs._data, rhs._data, r)) return detail::comp_invalid();
+		return comp(r);
+	}
+
+	inline comp operator-(const comp &lhs, const comp &rhs) {
+		int64_t r;
+		if (isnan(lhs) || isnan(rhs) || !detail::comp_sub(lhs._data, rhs._data, r)) return detail::comp_invalid();
+		return comp(r);
+	}
+
+	inline comp operator*(const comp &lhs, const comp &rhs) {
+		int64_t r;
+		if (isnan(lhs) || isnan(rhs) || !detail::comp_mul(lhs._data, rhs._data, r)) return detail::comp_invalid();
+		return comp(r);
+	}
+
+	/*
+	 * the extended quotient has at least one fraction bit unless |rhs| is
+	 * 1, which is never inexact, so rounding the exact quotient to an
+	 * integer matches rounding the extended one.
+	 */
+	inline comp operator/(const comp &lhs, const comp &rhs) {
+		// x/0 is infinite (or 0/0 a NaN), which converts to the comp NaN.
+		if (isnan(lhs) || isnan(rhs)) return detail::comp_invalid();
+		if (!rhs._data) {
+			if (lhs._data) signal_exceptions(DIVBYZERO);
+			return detail::comp_invalid();
+		}
+		bool negative = (lhs._data < 0) != (rhs._data < 0);
+		uint64_t ua = lhs._data < 0 ? -(uint64_t)lhs._data : lhs._data;
+		uint64_t ub = rhs._data < 0 ? -(uint64_t)rhs._data : rhs._data;
+		uint64_t q, r;
+		detail::comp_divide(ua, ub, q, r);
+		if (r) {
+			switch (getround()) {
+				case UPWARD: q += !negative; break;
+				case DOWNWARD: q += negative; break;
+				case TOWARDZERO: break;
+				default: q += detail::comp_round_nearest(q, r, ub); break;
+			}
+			signal_exceptions(INEXACT);
+		}
+		return comp(negative ? -q : q);
+	}
+
+	inline comp operator-(const comp &c) {
+		// -NaN is the NaN.
+		return comp(-(uint64_t)c._data);
+	}
+
+	inline comp operator+(const comp &c) {
+		return c;
+	}
+
+	/*
+	 * IEEE remainder: lhs - n * rhs, n the integer nearest lhs / rhs (ties
+	 * to even).  Always exact; x REM 0 is invalid.
+	 */
+	inline comp rem(const comp &lhs, const comp &rhs) {
+		if (isnan(lhs) || isnan(rhs) || !rhs._data) return detail::comp_invalid();
+		bool negative = lhs._data < 0;
+		uint64_t ua = lhs._data < 0 ? -(uint64_t)lhs._data : lhs._data;
+		uint64_t ub = rhs._data < 0 ? -(uint64_t)rhs._data : rhs._data;
+		uint64_t q, r;
+		detail::comp_divide(ua, ub, q, r);
+		uint64_t away = detail::comp_round_nearest(q, r, ub);
+		r = away ? ub - r : r;
+		negative ^= away;
+		return comp(negative ? -r : r);
+	}
+
+	inline comp &operator+=(comp &lhs, const comp &rhs) { return lhs = lhs + rhs; }
+	inline comp &operator-=(comp &lhs, const comp &rhs) { return lhs = lhs - rhs; }
+	inline comp &operator*=(comp &lhs, const comp &rhs) { return lhs = lhs * rhs; }
+	inline comp &operator/=(comp &lhs, const comp &rhs) { return lhs = lhs / rhs; }
+
+
+namespace floating_point {
+
+	/*
+	 * comp arrays <-> float, double and extended arrays, either byte order.
+	 * The results are the scalar conversions': comp(x) rounds in the
+	 * direction (the environment's unless one is given), and NaNs,
+	 * infinities and anything out of range give the comp NaN, which
+	 * converts back as NaN(NANCOMP).  With AVX2 there are explicit
+	 * kernels (below); otherwise the loops are branch free, the NaN cases
+	 * being selects.  Conversions to comp signal INVALID and INEXACT once
+	 * for the batch.
+	 */
+
+	namespace detail {
+
+		// the rounding direction as bits, so the loops have no switch.
+		struct integer_rounding {
+			uint64_t nearest, up, down;
+			explicit integer_rounding(rounding_direction rd) :
+				nearest(rd == TONEAREST), up(rd == UPWARD), down(rd == DOWNWARD)
+			{}
+		};
+
+		/*
+		 * |(-1)^sign * sig * 2^(e - 63)| rounded to an integer, for e <=
+		 * 62 (the callers mask larger e).  fraction is non-zero if it
+		 * wasn't one.  Branch free.
+		 */
+		inline uint64_t round_magnitude(bool sign, int e, uint64_t sig, integer_rounding r, uint64_t &fraction) {
+
+			constexpr uint64_t half = UINT64_C(1) << 63;
+
+			// integer part q and the fraction f (half is 2^63) for -1 <= k <= 62.
+			int k = e < -1 ? -1 : e > 62 ? 62 : e;
+			uint64_t q = (sig >> 1) >> (62 - k);
+			uint64_t f = sig << ((k + 1) & 63);
+			// below 1/2 it only matters whether it's 0; halve it, keeping the sticky bit.
+			uint64_t tiny = e < -1;
+			f = (f >> tiny) | (f & tiny);
+
+			uint64_t up = (uint64_t)sign ? r.down : r.up;
+			uint64_t inc = (r.nearest & ((f > half) | ((f == half) & q))) | (~r.nearest & (f != 0) & up);
+			fraction = f;
+			return q + (inc & 1);
+		}
+
+		// float and double images as (sign, e, sig) for round_magnitude.
+		template<class W, int exp_bits, int bias>
+		void unpack_binary(W w, bool &sign, int &e, uint64_t &sig) {
+			constexpr int bits = sizeof(W) * 8;
+			constexpr int mant = bits - 1 - exp_bits;
+			constexpr unsigned emax = (1u << exp_bits) - 1;
+			unsigned biased = (unsigned)(w >> mant) & emax;
+			sign = w >> (bits - 1);
+			// subnormals are far below 1/2, so only the bits matter.
+			e = biased == emax ? 16384 : (int)biased - bias;
+			sig = ((uint64_t)w << (64 - mant - 1) << 1 >> 1) | ((uint64_t)(biased != 0) << 63);
+		}
+
+		template<size_t size> struct comp_binary;
+		template<> struct comp_binary<4> { typedef float type; typedef uint32_t word; };
+		template<> struct comp_binary<8> { typedef double type; typedef uint64_t word; };
+
+		template<class W, endian byte_order>
+		W load_word(const uint8_t *cp) {
+			W w;
+			std::memcpy(&w, cp, sizeof(W));
+			reverse_bytes_if<sizeof(W)>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+			return w;
+		}
+
+		template<endian byte_order, class W>
+		void store_word(uint8_t *cp, W w) {
+			reverse_bytes_if<sizeof(W)>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+			std::memcpy(cp, &w, sizeof(W));
+		}
+
+	#ifdef SANE_HAVE_AVX2
+		/*
+		 * AVX2 kernels, 4 values a step; they return how many they did
+		 * and the scalar loops finish.  There's no int64 <-> double
+		 * conversion before AVX-512: int64 -> double adds the high and
+		 * low halves as exact doubles (biased by magic constants), so the
+		 * only rounding is the final add, as with cvtsi2sd; double ->
+		 * int64 rounds with vroundpd and shifts the significand into
+		 * place.  The comp NaN is a compare and blend.
+		 */
+		inline __m256d int64_lanes_to_double(__m256i x) {
+			// 3 * 2^67 and 3 * 2^67 + 2^52.
+			__m256i hi = _mm256_blend_epi16(_mm256_srai_epi32(x, 16), _mm256_setzero_si256(), 0x33);
+			hi = _mm256_add_epi64(hi, _mm256_castpd_si256(_mm256_set1_pd(442721857769029238784.0)));
+			__m256i lo = _mm256_blend_epi16(x, _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0)), 0x88);
+			__m256d f = _mm256_sub_pd(_mm256_castsi256_pd(hi), _mm256_set1_pd(442726361368656609280.0));
+			return _mm256_add_pd(f, _mm256_castsi256_pd(lo));
+		}
+
+		// t is integral and |t| < 2^63.
+		inline __m256i integral_lanes_to_int64(__m256d t) {
+			__m256i b = _mm256_castpd_si256(t);
+			__m256i e = _mm256_sub_epi64(_mm256_srli_epi64(_mm256_slli_epi64(b, 1), 53), _mm256_set1_epi64x(1075));
+			__m256i m = _mm256_or_si256(_mm256_and_si256(b, _mm256_set1_epi64x(UINT64_C(0x000fffffffffffff))), _mm256_set1_epi64x(UINT64_C(0x0010000000000000)));
+			__m256i v = _mm256_or_si256(_mm256_sllv_epi64(m, e), _mm256_srlv_epi64(m, _mm256_sub_epi64(_mm256_setzero_si256(), e)));
+			__m256i s = _mm256_cmpgt_epi64(_mm256_setzero_si256(), b);
+			return _mm256_sub_epi64(_mm256_xor_si256(v, s), s);
+		}
+
+		// rounded by mode; |x| >= 2^63 (after rounding) and NaNs are the comp NaN.
+		template<int mode>
+		inline __m256i double_lanes_to_comp(__m256d x, __m256i &valid, __m256i &inexact) {
+			__m256d t = _mm256_round_pd(x, mode | _MM_FROUND_NO_EXC);
+			__m256d ok = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), t), _mm256_set1_pd(9223372036854775808.0), _CMP_LT_OQ);
+			valid = _mm256_and_si256(valid, _mm256_castpd_si256(ok));
+			inexact = _mm256_or_si256(inexact, _mm256_castpd_si256(_mm256_and_pd(ok, _mm256_cmp_pd(t, x, _CMP_NEQ_UQ))));
+			return _mm256_blendv_epi8(_mm256_set1_epi64x(comp::NaN), integral_lanes_to_int64(t), _mm256_castpd_si256(ok));
+		}
+
+		template<endian byte_order>
+		inline __m256d load_double_lanes(format<8, byte_order>, const uint8_t *sp) {
+			return _mm256_castsi256_pd(load_lanes256<8, byte_order>(sp));
+		}
+
+		template<endian byte_order>
+		inline __m256d load_double_lanes(format<4, byte_order>, const uint8_t *sp) {
+			return _mm256_cvtps_pd(_mm_castsi128_ps(load_float_lanes<byte_order>(sp)));
+		}
+
+		template<int mode, class F, endian comp_order>
+		size_t binary_to_comp_avx2(const uint8_t *sp, uint8_t *dp, size_t count, unsigned &flags) {
+			__m256i valid = _mm256_set1_epi64x(-1), inexact = _mm256_setzero_si256();
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256d x = load_double_lanes(F{}, sp + i * F::size);
+				store_lanes256<8, comp_order>(dp + i * 8, double_lanes_to_comp<mode>(x, valid, inexact));
+			}
+			flags |= (_mm256_movemask_epi8(valid) != -1 ? INVALID : 0) | (_mm256_movemask_epi8(inexact) ? INEXACT : 0);
+			return i;
+		}
+
+		// vroundpd takes its mode as an immediate.
+		template<size_t size, endian byte_order, endian comp_order>
+		size_t transcode_avx2(format<size, byte_order>, const uint8_t *sp, format_comp<comp_order>, uint8_t *dp, size_t count, rounding_direction rd, unsigned &flags) {
+			typedef format<size, byte_order> F;
+			switch (rd) {
+				case UPWARD: return binary_to_comp_avx2<_MM_FROUND_TO_POS_INF, F, comp_order>(sp, dp, count, flags);
+				case DOWNWARD: return binary_to_comp_avx2<_MM_FROUND_TO_NEG_INF, F, comp_order>(sp, dp, count, flags);
+				case TOWARDZERO: return binary_to_comp_avx2<_MM_FROUND_TO_ZERO, F, comp_order>(sp, dp, count, flags);
+				default: return binary_to_comp_avx2<_MM_FROUND_TO_NEAREST_INT, F, comp_order>(sp, dp, count, flags);
+			}
+		}
+
+		template<endian comp_order, endian byte_order>
+		size_t transcode_avx2(format_comp<comp_order>, const uint8_t *sp, format<8, byte_order>, uint8_t *dp, size_t count) {
+			const __m256i comp_nan = _mm256_set1_epi64x(comp::NaN);
+			const __m256d nan = _mm256_set1_pd(make_nan<double>(NANCOMP));
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256i w = load_lanes256<8, comp_order>(sp + i * 8);
+				__m256d x = _mm256_blendv_pd(int64_lanes_to_double(w), nan, _mm256_castsi256_pd(_mm256_cmpeq_epi64(w, comp_nan)));
+				store_lanes256<8, byte_order>(dp + i * 8, _mm256_castpd_si256(x));
+			}
+			return i;
+		}
+
+		// |w| >= 2^53 would round twice, so those blocks are done one at a time.
+		template<endian comp_order, endian byte_order>
+		size_t transcode_avx2(format_comp<comp_order>, const uint8_t *sp, format<4, byte_order>, uint8_t *dp, size_t count) {
+			const __m256i comp_nan = _mm256_set1_epi64x(comp::NaN);
+			const __m256i limit = _mm256_set1_epi64x(INT64_C(0x001fffffffffffff));
+			const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+			const __m128 nan = _mm_set1_ps(make_nan<float>(NANCOMP));
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256i w = load_lanes256<8, comp_order>(sp + i * 8);
+				__m256i is_nan = _mm256_cmpeq_epi64(w, comp_nan);
+				__m256i big = _mm256_or_si256(_mm256_cmpgt_epi64(w, limit), _mm256_cmpgt_epi64(_mm256_sub_epi64(_mm256_setzero_si256(), limit), w));
+				if (_mm256_movemask_epi8(_mm256_andnot_si256(is_nan, big))) {
+					for (size_t j = i; j < i + 4; ++j) {
+						uint64_t v = load_word<uint64_t, comp_order>(sp + j * 8);
+						float x = v == comp::NaN ? make_nan<float>(NANCOMP) : static_cast<float>((int64_t)v);
+						store_word<byte_order>(dp + j * 4, bit_cast<uint32_t>(x));
+					}
+					continue;
+				}
+				__m128 x = _mm256_cvtpd_ps(int64_lanes_to_double(w));
+				__m128i mask = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(is_nan, even));
+				x = _mm_blendv_ps(x, nan, _mm_castsi128_ps(mask));
+				store_float_lanes<byte_order>(dp + i * 4, _mm_castps_si128(x));
+			}
+			return i;
+		}
+
+		// the extended images are loaded and stored a lane at a time; the arithmetic is the vector part.
+		template<endian comp_order, class To>
+		size_t transcode_avx2(format_comp<comp_order>, const uint8_t *sp, To t, uint8_t *dp, size_t count, uint16_t nan_sexp, uint64_t nan_sig) {
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i two52 = _mm256_set1_epi64x(UINT64_C(0x4330000000000000));
+			const __m256i low32 = _mm256_set1_epi64x(UINT64_C(0xffffffff));
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256i w = load_lanes256<8, comp_order>(sp + i * 8);
+				__m256i s = _mm256_cmpgt_epi64(zero, w);
+				__m256i m = _mm256_sub_epi64(_mm256_xor_si256(w, s), s);
+				// the top bit from the exponents of the halves as exact doubles (2^52 + h).
+				__m256i hi = _mm256_srli_epi64(m, 32);
+				__m256i eh = _mm256_srli_epi64(_mm256_castpd_si256(_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(hi, two52)), _mm256_castsi256_pd(two52))), 52);
+				__m256i el = _mm256_srli_epi64(_mm256_castpd_si256(_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(m, low32), two52)), _mm256_castsi256_pd(two52))), 52);
+				__m256i top = _mm256_blendv_epi8(_mm256_add_epi64(eh, _mm256_set1_epi64x(32)), el, _mm256_cmpeq_epi64(hi, zero));
+				// top is now 1023 + the bit number (0 for m == 0).
+				__m256i sig = _mm256_sllv_epi64(m, _mm256_sub_epi64(_mm256_set1_epi64x(1023 + 63), top));
+				__m256i sexp = _mm256_or_si256(_mm256_and_si256(s, _mm256_set1_epi64x(0x8000)), _mm256_add_epi64(top, _mm256_set1_epi64x((int64_t)extended_traits::bias - 1023)));
+				sexp = _mm256_andnot_si256(_mm256_cmpeq_epi64(m, zero), sexp);
+				__m256i is_nan = _mm256_cmpeq_epi64(w, _mm256_set1_epi64x(comp::NaN));
+				sig = _mm256_blendv_epi8(sig, _mm256_set1_epi64x(nan_sig), is_nan);
+				sexp = _mm256_blendv_epi8(sexp, _mm256_set1_epi64x(nan_sexp), is_nan);
+				alignas(32) uint64_t sigs[4], sexps[4];
+				_mm256_store_si256((__m256i *)sigs, sig);
+				_mm256_store_si256((__m256i *)sexps, sexp);
+				for (size_t j = 0; j < 4; ++j)
+					store_extended(t, dp + (i + j) * To::size, (uint16_t)sexps[j], sigs[j]);
+			}
+			return i;
+		}
+
+		/*
+		 * round_magnitude, 4 lanes at a time, for extended (sexp, sig):
+		 * the rounded magnitude, with e the unbiased exponent, s the sign
+		 * mask and frac the fraction.  Valid for e <= 62, like the scalar.
+		 */
+		inline __m256i round_magnitude_lanes(__m256i sexp, __m256i sig, integer_rounding r, __m256i &e, __m256i &s, __m256i &frac) {
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i one = _mm256_set1_epi64x(1);
+			const __m256i half = _mm256_set1_epi64x(INT64_MIN);
+			e = _mm256_sub_epi64(_mm256_and_si256(sexp, _mm256_set1_epi64x(extended_traits::nan_exp)), _mm256_set1_epi64x(extended_traits::bias));
+			s = _mm256_cmpgt_epi64(sexp, _mm256_set1_epi64x(0x7fff));
+			// out of range shift counts give 0, which is what e < 0 wants for q.
+			__m256i q = _mm256_srlv_epi64(sig, _mm256_sub_epi64(_mm256_set1_epi64x(63), e));
+			__m256i tiny = _mm256_cmpgt_epi64(_mm256_set1_epi64x(-1), e);
+			frac = _mm256_blendv_epi8(_mm256_sllv_epi64(sig, _mm256_add_epi64(e, one)),
+				_mm256_or_si256(_mm256_srli_epi64(sig, 1), _mm256_and_si256(sig, one)), tiny);
+			// f > half unsigned is f ^ 2^63 > 0 signed.
+			__m256i odd = _mm256_cmpeq_epi64(_mm256_and_si256(q, one), one);
+			__m256i to_nearest = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_xor_si256(frac, half), zero), _mm256_and_si256(_mm256_cmpeq_epi64(frac, half), odd));
+			__m256i away = _mm256_andnot_si256(_mm256_cmpeq_epi64(frac, zero), _mm256_blendv_epi8(_mm256_set1_epi64x(-(int64_t)r.up), _mm256_set1_epi64x(-(int64_t)r.down), s));
+			return _mm256_sub_epi64(q, _mm256_blendv_epi8(away, to_nearest, _mm256_set1_epi64x(-(int64_t)r.nearest)));
+		}
+
+		template<class From, endian comp_order>
+		size_t transcode_avx2(From, const uint8_t *sp, format_comp<comp_order>, uint8_t *dp, size_t count, integer_rounding r, unsigned &flags) {
+			constexpr size_t ahead = From::size < 16;
+			const __m256i fields = extended_fields<From>();
+			const __m256i zero = _mm256_setzero_si256();
+			__m256i invalid = zero, fraction = zero;
+			size_t i = 0;
+			for (; count - i >= 4 + ahead; i += 4) {
+				__m256i sexp, sig, e, s, frac;
+				load_extended_quad<From>(sp + i * From::size, fields, sexp, sig);
+				__m256i m = round_magnitude_lanes(sexp, sig, r, e, s, frac);
+				// m is 2^63 when it rounds up out of range.
+				__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(e, _mm256_set1_epi64x(62)), _mm256_cmpgt_epi64(zero, m));
+				__m256i w = _mm256_sub_epi64(_mm256_xor_si256(m, s), s);
+				invalid = _mm256_or_si256(invalid, bad);
+				fraction = _mm256_or_si256(fraction, _mm256_andnot_si256(bad, frac));
+				store_lanes256<8, comp_order>(dp + i * 8, _mm256_blendv_epi8(w, _mm256_set1_epi64x(comp::NaN), bad));
+			}
+			flags |= (_mm256_movemask_epi8(invalid) ? INVALID : 0) | (_mm256_testz_si256(fraction, fraction) ? 0 : INEXACT);
+			return i;
+		}
+	#endif
+	}
+
+	/*
+	 * count comps as text, back to back in arena (20 * count bytes is
+	 * always enough).  Value i is [offsets[i], offsets[i + 1]); returns
+	 * the bytes used.
+	 */
+	template<endian byte_order>
+	size_t to_chars(format_comp<byte_order>, const void *src, size_t count, char *arena, size_t *offsets) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		char *cp = arena;
+
+		for (size_t i = 0; i < count; ++i, sp += 8) {
+			offsets[i] = cp - arena;
+			uint64_t w = detail::load_word<uint64_t, byte_order>(sp);
+			// 20 characters is the longest.
+			cp = SANE::to_chars(cp, cp + 20, comp(w));
+		}
+		offsets[count] = cp - arena;
+		return cp - arena;
+	}
+
+	// the same for scaled comps (40 * count bytes is always enough).
+	template<endian byte_order>
+	size_t to_chars(format_comp<byte_order>, const void *src, size_t count, int scale, int digits, char *arena, size_t *offsets, rounding_direction rd = getround()) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		char *cp = arena;
+
+		for (size_t i = 0; i < count; ++i, sp += 8) {
+			offsets[i] = cp - arena;
+			uint64_t w = detail::load_word<uint64_t, byte_order>(sp);
+			cp = SANE::to_chars(cp, cp + 40, comp(w), scale, digits, rd);
+		}
+		offsets[count] = cp - arena;
+		return cp - arena;
+	}
+
+	/*
+	 * count scaled comps from text fields [offsets[i], offsets[i + 1]) of
+	 * arena.  A field that isn't entirely a number (or NaN) is the NaN.
+	 * Returns how many weren't.
+	 */
+	template<endian byte_order>
+	size_t from_chars(format_comp<byte_order>, const char *arena, const size_t *offsets, size_t count, int scale, void *dst, rounding_direction rd = getround()) {
+
+		uint8_t *dp = (uint8_t *)dst;
+		size_t bad = 0;
+
+		for (size_t i = 0; i < count; ++i, dp += 8) {
+			comp c(0);
+			const char *first = arena + offsets[i];
+			const char *last = arena + offsets[i + 1];
+			if (SANE::from_chars(first, last, c, scale, rd) != last) {
+				c = comp(comp::NaN);
+				++bad;
+			}
+			detail::store_word<byte_order>(dp, (uint64_t)c);
+		}
+		return bad;
+	}
+
+	template<endian comp_order, size_t size, endian byte_order>
+	typename std::enable_if<size == 4 || size == 8>::type
+	transcode(format_comp<comp_order>, const void *src, format<size, byte_order>, void *dst, size_t count) {
+
+		typedef typename detail::comp_binary<size>::type T;
+		typedef typename detail::comp_binary<size>::word W;
+
+		const W nan = bit_cast<W>(make_nan<T>(NANCOMP));
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(format_comp<comp_order>{}, sp, format<size, byte_order>{}, dp, count);
+		sp += i * 8;
+		dp += i * size;
+	#endif
+		for (; i < count; ++i, sp += 8, dp += size) {
+			uint64_t w = detail::load_word<uint64_t, comp_order>(sp);
+			W x = bit_cast<W>(static_cast<T>((int64_t)w));
+			detail::store_word<byte_order>(dp, w == comp::NaN ? nan : x);
+		}
+	}
+
+	template<size_t size, endian byte_order, endian comp_order>
+	typename std::enable_if<size == 4 || size == 8>::type
+	transcode(format<size, byte_order>, const void *src, format_comp<comp_order>, void *dst, size_t count, rounding_direction rd = getround()) {
+
+		typedef typename detail::comp_binary<size>::word W;
+
+		const detail::integer_rounding r(rd);
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		unsigned invalid = 0, flags = 0;
+		uint64_t fraction = 0;
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(format<size, byte_order>{}, sp, format_comp<comp_order>{}, dp, count, rd, flags);
+		sp += i * size;
+		dp += i * 8;
+	#endif
+		for (; i < count; ++i, sp += size, dp += 8) {
+			bool sign;
+			int e;
+			uint64_t sig, f;
+			detail::unpack_binary<W, size == 4 ? 8 : 11, size == 4 ? 127 : 1023>(detail::load_word<W, byte_order>(sp), sign, e, sig);
+			// |x| >= 2^63 after rounding, infinities and NaNs are NaN.
+			uint64_t m = detail::round_magnitude(sign, e, sig, r, f);
+			bool ok = (e <= 62) & (m < comp::NaN);
+			invalid |= !ok;
+			fraction |= ok ? f : 0;
+			detail::store_word<comp_order>(dp, ok ? (sign ? -m : m) : comp::NaN);
+		}
+		signal_exceptions(flags | (invalid ? INVALID : 0) | (fraction ? INEXACT : 0));
+	}
+
+	// byte order only.
+	template<endian from_order, endian to_order>
+	void transcode(format_comp<from_order>, const void *src, format_comp<to_order>, void *dst, size_t count) {
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+		for (size_t i = 0; i < count; ++i, sp += 8, dp += 8)
+			detail::store_word<to_order>(dp, detail::load_word<uint64_t, from_order>(sp));
+	}
+
+	// int64 -> extended is exact, so it's all integer arithmetic.
+	template<endian comp_order, class To>
+	typename std::enable_if<extended_layout<To>::value>::type
+	transcode(format_comp<comp_order>, const void *src, To t, void *dst, size_t count) {
+
+		uint8_t image[10];
+		info fpi;
+		fpi.nan = true;
+		fpi.sig = NANCOMP;
+		fpi.write(format<10, endian::native>{}, image);
+
+		uint16_t nan_sexp;
+		uint64_t nan_sig;
+		load_extended(format<10, endian::native>{}, image, nan_sexp, nan_sig);
+
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(format_comp<comp_order>{}, sp, t, dp, count, nan_sexp, nan_sig);
+		sp += i * 8;
+		dp += i * To::size;
+	#endif
+		for (; i < count; ++i, sp += 8, dp += To::size) {
+			uint64_t w = detail::load_word<uint64_t, comp_order>(sp);
+			// branch free; the signs are a coin toss.
+			uint64_t s = -(w >> 63);
+			uint64_t m = (w ^ s) - s;
+			int shift = clz64(m | 1);
+			uint64_t sig = m << shift;
+			uint16_t sexp = ((s & 0x8000) | (extended_traits::bias + 63 - shift)) & -(uint16_t)(m != 0);
+			bool nan = w == comp::NaN;
+			store_extended(t, dp, nan ? nan_sexp : sexp, nan ? nan_sig : sig);
+		}
+	}
+
+	template<class From, endian comp_order>
+	typename std::enable_if<extended_layout<From>::value>::type
+	transcode(From f, const void *src, format_comp<comp_order>, void *dst, size_t count, rounding_direction rd = getround()) {
+
+		const detail::integer_rounding r(rd);
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		unsigned invalid = 0, flags = 0;
+		uint64_t fraction = 0;
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(f, sp, format_comp<comp_order>{}, dp, count, r, flags);
+		sp += i * From::size;
+		dp += i * 8;
+	#endif
+		for (; i < count; ++i, sp += From::size, dp += 8) {
+			uint16_t sexp;
+			uint64_t sig;
+			load_extended(f, sp, sexp, sig);
+
+			// |x| >= 2^63 after rounding, infinities and NaNs are NaN.
+			int e = (int)(sexp & extended_traits::nan_exp) - (int)extended_traits::bias;
+			uint64_t f;
+			uint64_t m = detail::round_magnitude(sexp >> 15, e, sig, r, f);
+			bool ok = (e <= 62) & (m < comp::NaN);
+			invalid |= !ok;
+			fraction |= ok ? f : 0;
+			detail::store_word<comp_order>(dp, ok ? (sexp >> 15 ? -m : m) : comp::NaN);
+		}
+		signal_exceptions(flags | (invalid ? INVALID : 0) | (fraction ? INEXACT : 0));
+	}
+
+} // floating_point
+
+
 }
 
 #endif
@@ -0,0 +1,92 @@
+
+#ifndef __sane_compare_h__
+#define __sane_compare_h__
+
+#include <cstdint>
+#include <cstddef>
+
+#include "hash.h"
+
+namespace SANE {
+
+	/* relations, as returned by FCMPX / the relation function. */
+	enum relop {
+		GREATERTHAN = 0,
+		LESSTHAN = 1,
+		EQUALTO = 2,
+		UNORDERED = 3,
+	};
+
+namespace floating_point {
+
+	namespace detail {
+
+		// |a| vs |b| (-1, 0, 1) when either is nonbinary.  In decimal.cpp.
+		int compare_magnitude(const canonical &a, const canonical &b);
+
+		// -1, 0, 1 for negative, zero, positive.
+		inline int signum(const canonical &c) {
+			return c.kind == canonical::zero ? 0 : c.sign ? -1 : 1;
+		}
+	}
+
+	/*
+	 * ordering from the canonical forms.  Signs and classes decide most
+	 * pairs; finite binary values of the same sign compare exponent then
+	 * significand.  Only a nonbinary decimal close in magnitude to the
+	 * other value needs big integers.
+	 */
+	inline relop compare(const canonical &a, const canonical &b) {
+
+		if (a.kind == canonical::nan || b.kind == canonical::nan) return UNORDERED;
+
+		int sa = detail::signum(a);
+		int sb = detail::signum(b);
+		if (sa != sb) return sa < sb ? LESSTHAN : GREATERTHAN;
+		if (!sa) return EQUALTO;
+
+		int m;
+		bool ia = a.kind == canonical::infinite;
+		bool ib = b.kind == canonical::infinite;
+		if (ia | ib) m = ia - ib;
+		else if (a.kind == canonical::nonbinary || b.kind == canonical::nonbinary) m = detail::compare_magnitude(a, b);
+		else if (a.exp != b.exp) m = a.exp < b.exp ? -1 : 1;
+		else if (a.hi != b.hi) m = a.hi < b.hi ? -1 : 1;
+		else m = (a.lo > b.lo) - (a.lo < b.lo);
+
+		if (!m) return EQUALTO;
+		return (m < 0) != (sa < 0) ? LESSTHAN : GREATERTHAN;
+	}
+
+	template<class A, class B>
+	relop compare(A a, const void *ap, B b, const void *bp) {
+		return compare(canonicalize(a, ap), canonicalize(b, bp));
+	}
+
+	template<class A>
+	relop compare(A a, const void *ap, const decimal &d) {
+		return compare(canonicalize(a, ap), canonicalize(d));
+	}
+
+	template<class B>
+	relop compare(const decimal &d, B b, const void *bp) {
+		return compare(canonicalize(d), canonicalize(b, bp));
+	}
+
+	// each element of src against value, for filters.
+	template<class F>
+	void compare(F f, const void *src, const canonical &value, relop *out, size_t count) {
+		const uint8_t *sp = (const uint8_t *)src;
+		for (size_t i = 0; i < count; ++i, sp += F::size)
+			out[i] = compare(canonicalize(f, sp), value);
+	}
+
+} // floating_point
+
+	inline relop compare(const decimal &a, const decimal &b) {
+		return floating_point::compare(canonicalize(a), canonicalize(b));
+	}
+
+}
+
+#endif
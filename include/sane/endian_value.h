@@ -0,0 +1,156 @@
+
+#ifndef __sane_endian_value_h__
+#define __sane_endian_value_h__
+
+#include <cstdint>
+#include <cstring>
+
+#include "floating_point.h"
+#include "soft_extended.h"
+#include "comp.h"
+
+namespace SANE {
+
+namespace floating_point {
+
+	// the usual guest encoding of T.  long double is SANE extended.
+	template<class T, endian byte_order> struct value_format;
+	template<endian byte_order> struct value_format<float, byte_order> { typedef format<4, byte_order> type; };
+	template<endian byte_order> struct value_format<double, byte_order> { typedef format<8, byte_order> type; };
+	template<endian byte_order> struct value_format<long double, byte_order> { typedef format<10, byte_order> type; };
+	template<endian byte_order> struct value_format<soft_extended, byte_order> { typedef format<10, byte_order> type; };
+	template<endian byte_order> struct value_format<comp, byte_order> { typedef format_comp<byte_order> type; };
+
+	namespace detail {
+
+		// load / store a T in format F.
+		template<class T, class W, endian byte_order>
+		T load_bits(const void *vp) {
+			W w;
+			std::memcpy(&w, vp, sizeof(W));
+			reverse_bytes_if<sizeof(W)>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+			return bit_cast<T>(w);
+		}
+
+		template<class W, endian byte_order, class T>
+		void store_bits(T x, void *vp) {
+			W w = bit_cast<W>(x);
+			reverse_bytes_if<sizeof(W)>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+			std::memcpy(vp, &w, sizeof(W));
+		}
+
+		template<endian byte_order>
+		float load_value(float *, format<4, byte_order>, const void *vp) { return load_bits<float, uint32_t, byte_order>(vp); }
+
+		template<endian byte_order>
+		void store_value(float x, format<4, byte_order>, void *vp) { store_bits<uint32_t, byte_order>(x, vp); }
+
+		template<endian byte_order>
+		double load_value(double *, format<8, byte_order>, const void *vp) { return load_bits<double, uint64_t, byte_order>(vp); }
+
+		template<endian byte_order>
+		void store_value(double x, format<8, byte_order>, void *vp) { store_bits<uint64_t, byte_order>(x, vp); }
+
+		// the fields go straight to and from an x87 image where possible.
+		template<class F>
+		long double load_value(long double *, F f, const void *vp) {
+		#ifdef SANE_X87_BIT_CAST
+			x87_image tmp{};
+			load_extended(f, vp, tmp.sexp, tmp.sig);
+			// 68881 infinities/NaNs don't require the explicit 1 bit; x87 does.
+			if (std::is_same<F, format_68881<F::byte_order>>::value)
+				tmp.sig |= (uint64_t)((tmp.sexp & extended_traits::nan_exp) == extended_traits::nan_exp) << 63;
+			return bit_cast<long double>(tmp);
+		#else
+			return read_extended(f, vp);
+		#endif
+		}
+
+		template<class F>
+		void store_value(long double x, F f, void *vp) {
+		#ifdef SANE_X87_BIT_CAST
+			x87_image tmp = bit_cast<x87_image>(x);
+			store_extended(f, vp, tmp.sexp, tmp.sig);
+		#else
+			write_extended(x, f, vp);
+		#endif
+		}
+
+		template<class F>
+		soft_extended load_value(soft_extended *, F f, const void *vp) {
+			uint16_t sexp;
+			uint64_t sig;
+			load_extended(f, vp, sexp, sig);
+			return soft_extended(sexp, sig);
+		}
+
+		template<class F>
+		void store_value(const soft_extended &x, F f, void *vp) { store_extended(f, vp, x.sexp, x.sig); }
+
+		template<endian byte_order>
+		comp load_value(comp *, format_comp<byte_order>, const void *vp) { return comp(load_bits<uint64_t, uint64_t, byte_order>(vp)); }
+
+		template<endian byte_order>
+		void store_value(const comp &x, format_comp<byte_order>, void *vp) { store_bits<uint64_t, byte_order>((uint64_t)x, vp); }
+	}
+
+} // floating_point
+
+
+	/*
+	 * a T stored in guest memory as F.  The object is just the encoded
+	 * bytes (alignment 1), so it can overlay unaligned guest RAM:
+	 *
+	 *	auto &x = big_endian<double>::at(ram + address);
+	 *	x += 1.0;
+	 *
+	 * Each access is one load or store plus a byte swap (bswap, or movbe
+	 * where the target has it) for float, double and comp.
+	 */
+	template<class T, endian byte_order, class F = typename floating_point::value_format<T, byte_order>::type>
+	class endian_value {
+	public:
+
+		typedef T value_type;
+		typedef F format_type;
+
+		endian_value() = default;
+		endian_value(const endian_value &) = default;
+		endian_value &operator=(const endian_value &) = default;
+
+		endian_value(const T &x) { store(x); }
+
+		static endian_value &at(void *vp) { return *static_cast<endian_value *>(vp); }
+		static const endian_value &at(const void *vp) { return *static_cast<const endian_value *>(vp); }
+
+		T load() const { return floating_point::detail::load_value((T *)nullptr, F{}, _data); }
+		void store(const T &x) { floating_point::detail::store_value(x, F{}, _data); }
+
+		operator T() const { return load(); }
+
+		endian_value &operator=(const T &x) {
+			store(x);
+			return *this;
+		}
+
+		template<class U> endian_value &operator+=(const U &u) { store(load() + u); return *this; }
+		template<class U> endian_value &operator-=(const U &u) { store(load() - u); return *this; }
+		template<class U> endian_value &operator*=(const U &u) { store(load() * u); return *this; }
+		template<class U> endian_value &operator/=(const U &u) { store(load() / u); return *this; }
+
+		const void *data() const { return _data; }
+		void *data() { return _data; }
+
+	private:
+		uint8_t _data[F::size];
+	};
+
+	template<class T>
+	using big_endian = endian_value<T, endian::big>;
+
+	template<class T>
+	using little_endian = endian_value<T, endian::little>;
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+
+#ifndef __sane_environment_h__
+#define __sane_environment_h__
+
+#include <cstdint>
+
+#include "floating_point.h"
+
+namespace SANE {
+
+	/*
+	 * the SANE environment word:
+	 *
+	 * [unused : 1] [rounding direction : 2] [flags : 5] [unused : 1]
+	 * [rounding precision : 2] [halt enables : 5]
+	 *
+	 * One per thread; the host fenv is never touched.  These set the
+	 * sticky flags themselves:
+	 * - comp arithmetic, the integer conversions, convert(), conversions
+	 *   to comp and the decimal conversions (dec2x, x2dec, comp2dec,
+	 *   dec2comp, truncate and comp's to_chars/from_chars), which also
+	 *   take their rounding direction from it unless given one.
+	 * info::write and the soft_extended operations are the primitives
+	 * underneath: they round as told and leave the environment alone.
+	 * The rounding precision is only stored.
+	 */
+	typedef uint16_t environment;
+
+	enum rounding_precision {
+		EXTPRECISION = 0,
+		DBLPRECISION = 1,
+		REALPRECISION = 2,
+	};
+
+	// called with the exceptions that have halts enabled, and the environment at the time.
+	typedef void (*haltvector)(unsigned exceptions, environment e);
+
+	namespace detail {
+
+		constexpr environment flag_shift = 8;
+		constexpr environment exception_mask = 0x1f;
+
+		struct environment_state {
+			environment word = 0;
+			haltvector halt = nullptr;
+		};
+
+		inline environment_state &current_environment() {
+			static thread_local environment_state state;
+			return state;
+		}
+	}
+
+	/*
+	 * set the exceptions' flags, then halt if any of them are enabled
+	 * (and there's a halt vector).  Library routines call this once per
+	 * operation or batch.
+	 */
+	inline void signal_exceptions(unsigned exceptions) {
+		exceptions &= detail::exception_mask;
+		if (!exceptions) return;
+		auto &env = detail::current_environment();
+		env.word |= exceptions << detail::flag_shift;
+		unsigned halts = exceptions & env.word;
+		if (halts && env.halt) env.halt(halts, env.word);
+	}
+
+	inline environment getenvironment() {
+		return detail::current_environment().word;
+	}
+
+	inline void setenvironment(environment e) {
+		detail::current_environment().word = e;
+	}
+
+	// save the environment and set the default one (all clear, TONEAREST).
+	inline void procentry(environment &e) {
+		e = getenvironment();
+		setenvironment(0);
+	}
+
+	// restore e, then signal the exceptions raised since procentry.
+	inline void procexit(environment e) {
+		unsigned raised = getenvironment() >> detail::flag_shift;
+		setenvironment(e);
+		signal_exceptions(raised);
+	}
+
+	// any of the exceptions' flags set.
+	inline bool testexception(unsigned exceptions) {
+		return getenvironment() & (exceptions & detail::exception_mask) << detail::flag_shift;
+	}
+
+	// setting a flag signals it (and may halt); clearing doesn't.
+	inline void setexception(unsigned exceptions, bool on) {
+		if (on) signal_exceptions(exceptions);
+		else detail::current_environment().word &= ~((exceptions & detail::exception_mask) << detail::flag_shift);
+	}
+
+	inline bool testhalt(unsigned exceptions) {
+		return getenvironment() & exceptions & detail::exception_mask;
+	}
+
+	inline void sethalt(unsigned exceptions, bool on) {
+		auto &env = detail::current_environment();
+		exceptions &= detail::exception_mask;
+		env.word = on ? env.word | exceptions : env.word & ~exceptions;
+	}
+
+	inline rounding_direction getround() {
+		return (rounding_direction)(getenvironment() >> 13 & 0x03);
+	}
+
+	inline void setround(rounding_direction rd) {
+		auto &env = detail::current_environment();
+		env.word = (env.word & ~0x6000) | (rd & 0x03) << 13;
+	}
+
+	// stored for programs that read it back; the library always rounds to the format.
+	inline rounding_precision getprecision() {
+		return (rounding_precision)(getenvironment() >> 5 & 0x03);
+	}
+
+	inline void setprecision(rounding_precision p) {
+		auto &env = detail::current_environment();
+		env.word = (env.word & ~0x0060) | (p & 0x03) << 5;
+	}
+
+	inline haltvector gethaltvector() {
+		return detail::current_environment().halt;
+	}
+
+	inline void sethaltvector(haltvector v) {
+		detail::current_environment().halt = v;
+	}
+
+	/*
+	 * fpi encoded as F, rounded in the current direction, signaling
+	 * what the rounding raised.  A signaling NaN is INVALID and
+	 * delivered quiet.
+	 */
+	template<class F>
+	void convert(const floating_point::info &fpi, F f, void *vp) {
+		rounding_direction rd = getround();
+		floating_point::info q = fpi;
+		q.signaling = false;
+		q.write(f, vp, rd);
+		signal_exceptions(fpi.write_exceptions(f, rd));
+	}
+
+}
+
+#endif
@@ -2,19 +2,156 @@
 #ifndef __sane_floating_point_h__
 #define __sane_floating_point_h__
 
+#include <algorithm>
 #include <type_traits>
 #include <cstdint>
 #include <cmath>
 #include <cstring>
 #include <utility>
 #include <string>
+#include <cfloat>
 
 #include "endian.h"
 
+/*
+ * constexpr support depends on the language level.  C++14 is needed for
+ * multi-statement constexpr functions and __builtin_bit_cast (gcc 11+,
+ * clang 9+) to reinterpret floating point bits at compile time.
+ */
+#if __cpp_constexpr >= 201304L
+#define SANE_CONSTEXPR constexpr
+#else
+#define SANE_CONSTEXPR inline
+#endif
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_bit_cast) && __cpp_constexpr >= 201304L
+#define SANE_HAVE_BIT_CAST 1
+#endif
+#endif
+
+#ifdef SANE_HAVE_BIT_CAST
+#define SANE_BIT_CAST_CONSTEXPR constexpr
+#else
+#define SANE_BIT_CAST_CONSTEXPR inline
+#endif
+
+// long double is x87 extended (+ padding) and can be bit cast.
+#if defined(SANE_HAVE_BIT_CAST) && LDBL_MANT_DIG == 64 && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SANE_X87_BIT_CAST 1
+#define SANE_LD_CONSTEXPR constexpr
+#else
+#define SANE_LD_CONSTEXPR inline
+#endif
+
+// __float128 (gcc/clang, x86-64 and others) for binary128 on any host.
+#if defined(__SIZEOF_FLOAT128__)
+#define SANE_HAVE_FLOAT128 1
+#endif
+
+/*
+ * vector kernels for the batch loops: SSE2 (every x86-64) and AVX2 when
+ * the compiler targets it.  -DSANE_NO_SIMD keeps the portable loops.
+ */
+#if !defined(SANE_NO_SIMD) && defined(__SSE2__)
+#define SANE_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if !defined(SANE_NO_SIMD) && defined(__AVX2__)
+#define SANE_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
 namespace SANE {
 
+	/* rounding directions, in environment word order. */
+	enum rounding_direction {
+		TONEAREST = 0,
+		UPWARD = 1,
+		DOWNWARD = 2,
+		TOWARDZERO = 3,
+	};
+
+	/* exceptions, as halt enable bits (flags are the same << 8). */
+	enum exception_bits {
+		INVALID = 0x01,
+		UNDERFLOW = 0x02,
+		OVERFLOW = 0x04,
+		DIVBYZERO = 0x08,
+		INEXACT = 0x10,
+	};
+
+	/* NaN codes.  See pp41, table 5-1 */
+	enum {
+		NANSQRT = 1,       /* Invalid square root, such as sqrt(-1)   */
+		NANADD = 2,        /* Invalid addition, such as +INF - +INF   */
+		NANDIV = 4,        /* Invalid division, such as 0/0           */
+		NANMUL = 8,        /* Invalid multiply, such as 0 * INF       */
+		NANREM = 9,        /* Invalid rem or mod, such as x REM 0     */
+		NANASCBIN = 17,    /* Conversion of invalid ASCII string     */
+		NANCOMP = 20,      /* Comp NaN converted to floating         */
+		NANZERO = 21,      /* Attempt to create a NaN with zero code */
+		NANTRIG = 33,      /* Invalid argument to trig routine       */
+		NANINVTRIG = 34,   /* Invalid arg to inverse trig routine    */
+		NANLOG = 36,       /* Invalid argument to log routine        */
+		NANPOWER = 37,     /* Invalid argument to x^i or x^y routine */
+		NANFINAN = 38,     /* Invalid argument to financial function */	
+	};
+
 namespace floating_point {
 
+	template<class To, class From>
+	SANE_BIT_CAST_CONSTEXPR To bit_cast(const From &from) {
+		static_assert(sizeof(To) == sizeof(From), "bit_cast size");
+	#ifdef SANE_HAVE_BIT_CAST
+		return __builtin_bit_cast(To, from);
+	#else
+		To to;
+		std::memcpy(&to, &from, sizeof(To));
+		return to;
+	#endif
+	}
+
+	SANE_CONSTEXPR int clz64(uint64_t x) {
+	#if defined(__GNUC__)
+		return x ? __builtin_clzll(x) : 64;
+	#else
+		int n = 0;
+		if (!x) return 64;
+		while (!(x >> 63)) { x <<= 1; ++n; }
+		return n;
+	#endif
+	}
+
+	// 64 x 64 -> 128, with __int128 where the compiler has it.
+	SANE_CONSTEXPR void mul64(uint64_t a, uint64_t b, uint64_t &hi, uint64_t &lo) {
+	#ifdef __SIZEOF_INT128__
+		unsigned __int128 p = (unsigned __int128)a * b;
+		hi = p >> 64;
+		lo = p;
+	#else
+		uint64_t a0 = a & 0xffffffff, a1 = a >> 32;
+		uint64_t b0 = b & 0xffffffff, b1 = b >> 32;
+
+		uint64_t p00 = a0 * b0;
+		uint64_t p01 = a0 * b1;
+		uint64_t p10 = a1 * b0;
+		uint64_t p11 = a1 * b1;
+
+		uint64_t mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+		lo = (mid << 32) | (p00 & 0xffffffff);
+		hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+	#endif
+	}
+
+	// in-memory image of an x87 long double.
+	struct x87_image {
+		uint64_t sig;
+		uint16_t sexp;
+		uint8_t padding[sizeof(long double) > 10 ? sizeof(long double) - 10 : 1];
+	};
+
 	template<size_t size>
 	void reverse_bytes(void *vp) {
 		char *cp = (char *)vp;
@@ -22,6 +159,67 @@ namespace floating_point {
 			std::swap(cp[i], cp[size - i - 1]);
 	}
 
+#if defined(__GNUC__)
+	// the compiler doesn't always see the loop as a byte swap.
+	template<>
+	inline void reverse_bytes<2>(void *vp) {
+		uint16_t x;
+		std::memcpy(&x, vp, 2);
+		x = __builtin_bswap16(x);
+		std::memcpy(vp, &x, 2);
+	}
+
+	template<>
+	inline void reverse_bytes<4>(void *vp) {
+		uint32_t x;
+		std::memcpy(&x, vp, 4);
+		x = __builtin_bswap32(x);
+		std::memcpy(vp, &x, 4);
+	}
+
+	template<>
+	inline void reverse_bytes<8>(void *vp) {
+		uint64_t x;
+		std::memcpy(&x, vp, 8);
+		x = __builtin_bswap64(x);
+		std::memcpy(vp, &x, 8);
+	}
+
+	template<>
+	inline void reverse_bytes<10>(void *vp) {
+		uint64_t a;
+		uint16_t b;
+		std::memcpy(&a, vp, 8);
+		std::memcpy(&b, (uint8_t *)vp + 8, 2);
+		a = __builtin_bswap64(a);
+		b = __builtin_bswap16(b);
+		std::memcpy(vp, &b, 2);
+		std::memcpy((uint8_t *)vp + 2, &a, 8);
+	}
+
+	template<>
+	inline void reverse_bytes<12>(void *vp) {
+		uint64_t a;
+		uint32_t b;
+		std::memcpy(&a, vp, 8);
+		std::memcpy(&b, (uint8_t *)vp + 8, 4);
+		a = __builtin_bswap64(a);
+		b = __builtin_bswap32(b);
+		std::memcpy(vp, &b, 4);
+		std::memcpy((uint8_t *)vp + 4, &a, 8);
+	}
+
+	template<>
+	inline void reverse_bytes<16>(void *vp) {
+		uint64_t a[2];
+		std::memcpy(a, vp, 16);
+		uint64_t tmp = __builtin_bswap64(a[0]);
+		a[0] = __builtin_bswap64(a[1]);
+		a[1] = tmp;
+		std::memcpy(vp, a, 16);
+	}
+#endif
+
 	template<size_t size>
 	void reverse_bytes_if(void *vp, std::true_type) {
 		reverse_bytes<size>(vp);
@@ -108,23 +306,164 @@ namespace floating_point {
 
 	}
 
+	namespace quad_traits {
+
+		constexpr size_t bias = 16383;
+		constexpr size_t exponent_bits = 15;
+		constexpr size_t significand_bits = 112;
+		constexpr int max_exp = 16383;
+		constexpr int min_exp = -16382;
+
+		// the significand is split.  these apply to the high 64 bits.
+		constexpr uint64_t significand_mask = ((UINT64_C(1) << (significand_bits - 64)) - 1);
+		constexpr uint64_t sign_bit = UINT64_C(1) << 63;
+		constexpr uint64_t nan_exp = UINT64_C(0x7fff) << (significand_bits - 64);
+
+		constexpr uint64_t quiet_nan = UINT64_C(0x02) << (significand_bits - 64 - 2);
+		constexpr uint64_t signaling_nan = UINT64_C(0x01) << (significand_bits - 64 - 2);
+	}
+
+	// the host long double is x87 extended (possibly with padding).
+	constexpr bool long_double_is_x87 = LDBL_MANT_DIG == 64;
+
 	template<size_t _size, endian _byte_order>
 	struct format {
 		static constexpr size_t size = _size;
 		static constexpr endian byte_order = _byte_order;
 	};
 
+	/*
+	 * 68881/68882 96-bit extended.  Unlike format<12, ...> (x87 + 2 bytes
+	 * of padding at the end), the padding sits between the sign/exponent
+	 * and the significand:
+	 *
+	 * big endian: [sign + exp : 16] [padding : 16] [significand : 64]
+	 */
+	template<endian _byte_order>
+	struct format_68881 {
+		static constexpr size_t size = 12;
+		static constexpr endian byte_order = _byte_order;
+	};
+
+
+	/*
+	 * IEEE binary128.  format<16, ...> is x87 extended + padding; this is
+	 * the real thing (aarch64 long double, __float128).
+	 */
+	template<endian _byte_order>
+	struct format_quad {
+		static constexpr size_t size = 16;
+		static constexpr endian byte_order = _byte_order;
+	};
+
+
+	/*
+	 * double-double (PowerPC long double): a pair of doubles, hi first,
+	 * with value hi + lo and |lo| <= ulp(hi) / 2.
+	 */
+	template<endian _byte_order>
+	struct format_double_double {
+		static constexpr size_t size = 16;
+		static constexpr endian byte_order = _byte_order;
+	};
+
+
+	/*
+	 * comp: 64-bit two's complement integer; 0x8000000000000000 is NaN.
+	 */
+	template<endian _byte_order>
+	struct format_comp {
+		static constexpr size_t size = 8;
+		static constexpr endian byte_order = _byte_order;
+	};
+
+
+	/*
+	 * INTEGER (2) and LONGINT (4): two's complement.  The most negative
+	 * value is also the result of an invalid conversion.
+	 */
+	template<size_t _size, endian _byte_order>
+	struct format_integer {
+		static_assert(_size == 2 || _size == 4, "format_integer size");
+		static constexpr size_t size = _size;
+		static constexpr endian byte_order = _byte_order;
+	};
+
+
+	/*
+	 * extended <-> binary128 on the bit images.  The exponent fields are
+	 * the same width and bias.  Extended -> binary128 is exact;
+	 * binary128 -> extended rounds to nearest even.  NaN payloads (SANE
+	 * NaN codes) live in the low bits of both.
+	 */
+	SANE_CONSTEXPR void extended_to_quad(uint16_t sexp, uint64_t sig, uint64_t &hi, uint64_t &lo) {
+
+		hi = (uint64_t)sexp << 48;
+		lo = 0;
+
+		if ((sexp & extended_traits::nan_exp) == extended_traits::nan_exp) {
+			if (sig << 1) {
+				if (sig & extended_traits::quiet_nan) hi |= quad_traits::quiet_nan;
+				lo = sig & (extended_traits::quiet_nan - 1);
+				if (!(hi & quad_traits::significand_mask) && !lo) lo = 1;
+			}
+			return;
+		}
+
+		// pseudo-denormal.
+		if (!(sexp & extended_traits::nan_exp) && (sig >> 63)) hi |= UINT64_C(1) << 48;
+
+		hi |= (sig << 1) >> 16;
+		lo = sig << 49;
+	}
+
+	SANE_CONSTEXPR void quad_to_extended(uint64_t hi, uint64_t lo, uint16_t &sexp, uint64_t &sig) {
+
+		using namespace quad_traits;
+
+		uint64_t frac = hi & significand_mask;
+		sexp = hi >> 48;
+
+		if ((hi & nan_exp) == nan_exp) {
+			sig = extended_traits::one_bit;
+			if (frac | lo) {
+				if (frac & quiet_nan) sig |= extended_traits::quiet_nan;
+				sig |= lo & (extended_traits::quiet_nan - 1);
+				if (!(sig << 1)) sig |= 1;
+			}
+			return;
+		}
+
+		bool normal = hi & nan_exp;
+		sig = ((uint64_t)normal << 63) | (frac << 15) | (lo >> 49);
+
+		// 113 -> 64 bits.
+		constexpr uint64_t half = UINT64_C(1) << 48;
+		uint64_t rest = lo & ((half << 1) - 1);
+		sig += rest > half || (rest == half && (sig & 0x01));
+
+		if (normal && sig == 0) {
+			// carry out.
+			sig = extended_traits::one_bit;
+			++sexp;
+		}
+		if (!normal && (sig >> 63)) sexp |= 1; // denormal rounded up to normal.
+	}
+
 
 	class info {
 	private:
+		// out of line versions, kept for binary compatibility.
 		void read_single(const void *);
 		void read_double(const void *);
 		void read_extended(const void *);
+		void read_68881(const void *);
 
 
 		void write_single(void *) const;
 		void write_double(void *) const;
 		void write_extended(void *) const;
+		void write_68881(void *) const;
 	public:
 
 		bool sign = false;
@@ -135,11 +474,458 @@ namespace floating_point {
 		bool nan = false;
 		bool inf = false;
 
+		/*
+		 * NaNs: sig is the payload, right justified, without the quiet
+		 * bit.  The SANE NaN code is the low byte.  Narrower formats keep
+		 * the low bits (22 for single, 51 for double, 62 for extended), so
+		 * the code and the quiet bit survive any conversion.
+		 */
+		bool signaling = false;
+
 		//classification type = zero;
 
-		template<class T, typename = std::enable_if<std::is_floating_point<T>::value> >
-		void read(T x)
-		{ read(format<sizeof(x), endian::native>{}, &x); }
+
+		/* bit level decoding. */
+
+		SANE_CONSTEXPR void unpack_single(uint32_t i) {
+
+			using namespace single_traits;
+
+			sign = i >> 31;
+			one = 0;
+			exp = (i >> 23) & ((1 << 8) - 1);
+			sig = i & ((1 << 23) - 1);
+			nan = false;
+			inf = false;
+			signaling = false;
+
+			if (exp == 255) {
+				exp = 0;
+				if (sig == 0) inf = true;
+				else {
+					nan = true;
+					signaling = !(sig & quiet_nan);
+					sig &= quiet_nan - 1;
+				}
+				return;
+			}
+
+			if (exp == 0 && sig != 0) {
+				// denormalized.
+				one = 0;
+				sig <<= 40; //?
+				exp = -126;
+				return;
+			}
+
+			if (exp) { one = 1; exp -= bias; }
+
+			// adjust to 64 bit significand.
+			sig <<= 40;
+			if (one) sig |= (UINT64_C(1) << 63);
+		}
+
+		SANE_CONSTEXPR void unpack_double(uint64_t i) {
+
+			using namespace double_traits;
+
+			sign = i >> 63;
+			one = 0;
+			exp = (i >> 52) & ((1 << 11) - 1);
+			sig = i & ((UINT64_C(1) << 52) - 1);
+			nan = false;
+			inf = false;
+			signaling = false;
+
+			if (exp == 2047) {
+				exp = 0;
+				if (sig == 0) inf = true;
+				else {
+					nan = true;
+					signaling = !(sig & quiet_nan);
+					sig &= quiet_nan - 1;
+				}
+				return;
+			}
+			if (exp == 0 && sig != 0) {
+				// denormalized.
+				one = 0;
+				sig <<= 11;
+				exp = -1022;
+				return;
+			}
+
+
+			if (exp) { one = 1; exp -= bias; }
+			sig <<= 11;
+			if (one) sig |= (UINT64_C(1) << 63);
+		}
+
+		SANE_CONSTEXPR void unpack_extended(uint16_t sexp, uint64_t i) {
+
+			using namespace extended_traits;
+
+			sign = (sexp >> 15) & 0x01;
+			exp = sexp & ((1 << 15) - 1);
+			nan = false;
+			inf = false;
+			signaling = false;
+
+			one = i >> 63;
+			sig = i; // includes 1. i & ((UINT64_C(1) << 63) - 1);
+
+			if (exp == 32767) {
+				exp = 0;
+				sig &= ((UINT64_C(1) << 63) - 1);
+				if (sig == 0) inf = true;
+				else {
+					nan = true;
+					signaling = !(sig & quiet_nan);
+					sig &= quiet_nan - 1;
+				}
+				return;
+			}
+
+			if (exp) exp -= bias;
+			else if (sig) exp = min_exp; // denormalized.
+		}
+
+
+		/* bit level encoding. */
+
+		/*
+		 * bit level encoding.  Values are rounded in direction rd;
+		 * results below the normal range are de-normalized (gradual
+		 * underflow).
+		 */
+
+		SANE_CONSTEXPR uint32_t pack_single(rounding_direction rd = TONEAREST) const {
+
+			using namespace single_traits;
+
+			uint32_t i = 0;
+
+			if (sign) i |= sign_bit;
+
+			if (nan) {
+				i |= nan_exp;
+				i |= nan_payload(quiet_nan);
+			}
+			else if (inf) {
+				i |= nan_exp; // also infinite.
+			}
+			else {
+				i |= round_pack_ieee<significand_bits, bias, min_exp, max_exp>(sign, rd);
+			}
+			return i;
+		}
+
+		SANE_CONSTEXPR uint64_t pack_double(rounding_direction rd = TONEAREST) const {
+
+			using namespace double_traits;
+
+			uint64_t i = 0;
+
+			if (sign) i |= sign_bit;
+
+			if (nan) {
+				i |= nan_exp;
+				i |= nan_payload(quiet_nan);
+			}
+			else if (inf) {
+				i |= nan_exp;
+			}
+			else {
+				i |= round_pack_ieee<significand_bits, bias, min_exp, max_exp>(sign, rd);
+			}
+			return i;
+		}
+
+		SANE_CONSTEXPR void pack_extended(uint16_t &sexp, uint64_t &i, rounding_direction rd = TONEAREST) const {
+
+			using namespace extended_traits;
+
+			i = 0;
+			sexp = 0;
+
+			if (sign) sexp |= sign_bit;
+
+			if (nan) {
+				sexp |= nan_exp;
+				i |= one_bit;
+				i |= nan_payload(quiet_nan);
+			}
+			else if (inf) {
+				sexp |= nan_exp;
+				i |= one_bit;
+			}
+			else if (sig) {
+				// normalize (single/double denormals).
+				int shift = clz64(sig);
+				uint64_t s = sig << shift;
+				int e = exp - shift;
+
+				if (e > max_exp) {
+					if (overflow_to_inf(sign, rd)) {
+						sexp |= nan_exp;
+						i = one_bit;
+					} else {
+						sexp |= nan_exp - 1;
+						i = ~UINT64_C(0);
+					}
+				}
+				else if (e < min_exp) {
+					// de-normalize.  rounding up may produce the smallest normal.
+					unsigned n = min_exp - e;
+					uint64_t m = n < 64 ? s >> n : 0;
+					uint64_t rem = n < 64 ? s << (64 - n) : n == 64 ? s : 1;
+					i = m + round_increment(sign, m & 0x01, rem, rd);
+					sexp |= i >> 63;
+				}
+				else {
+					sexp |= e + bias;
+					i = s; // 1-bit already set.
+				}
+			}
+		}
+
+		SANE_CONSTEXPR void unpack_quad(uint64_t hi, uint64_t lo) {
+			uint16_t sexp = 0;
+			uint64_t i = 0;
+			quad_to_extended(hi, lo, sexp, i);
+			unpack_extended(sexp, i);
+		}
+
+		SANE_CONSTEXPR void pack_quad(uint64_t &hi, uint64_t &lo, rounding_direction rd = TONEAREST) const {
+
+			using namespace quad_traits;
+
+			hi = 0;
+			lo = 0;
+
+			if (sign) hi |= sign_bit;
+
+			if (nan) {
+				hi |= nan_exp;
+				if (!signaling) hi |= quiet_nan;
+				lo = nan_payload(extended_traits::quiet_nan) & (extended_traits::quiet_nan - 1);
+			}
+			else if (inf) {
+				hi |= nan_exp;
+			}
+			else if (sig) {
+				int shift = clz64(sig);
+				uint64_t s = sig << shift;
+				int e = exp - shift;
+
+				if (e > max_exp) {
+					if (overflow_to_inf(sign, rd)) hi |= nan_exp;
+					else {
+						hi |= nan_exp - (UINT64_C(1) << 48) + significand_mask;
+						lo = ~UINT64_C(0);
+					}
+					return;
+				}
+
+				uint64_t h = s >> 15;
+				uint64_t l = s << 49;
+
+				if (e < min_exp) {
+					// de-normalize.  rounding up may produce the smallest normal.
+					unsigned n = min_exp - e;
+					uint64_t rem = 0;
+					if (n < 64) {
+						rem = l << (64 - n);
+						l = (l >> n) | (h << (64 - n));
+						h >>= n;
+					} else if (n == 64) {
+						rem = l;
+						l = h;
+						h = 0;
+					} else if (n < 128) {
+						rem = (h << (128 - n)) | (l != 0);
+						l = h >> (n - 64);
+						h = 0;
+					} else {
+						rem = 1;
+						l = h = 0;
+					}
+					uint64_t inc = round_increment(sign, l & 0x01, rem, rd);
+					l += inc;
+					h += l < inc;
+				}
+				else {
+					hi |= (uint64_t)(e + bias) << 48;
+					h &= significand_mask;
+				}
+				hi |= h;
+				lo = l;
+			}
+		}
+
+
+		/*
+		 * double-double.  The 64-bit significand always splits exactly
+		 * (53 + 11 bits) when both halves are in double range.  The sum
+		 * of an arbitrary pair is rounded to nearest even.
+		 */
+		SANE_CONSTEXPR void unpack_double_double(uint64_t hi, uint64_t lo) {
+
+			info b;
+			unpack_double(hi);
+			b.unpack_double(lo);
+
+			if (nan || inf) return;
+			if (b.nan || b.inf || sig == 0) {
+				if (b.sig || b.nan || b.inf) *this = b;
+				return;
+			}
+			if (b.sig == 0) return;
+
+			// normalize (denormals) and order by magnitude.
+			int shift = clz64(sig);
+			sig <<= shift;
+			exp -= shift;
+			shift = clz64(b.sig);
+			b.sig <<= shift;
+			b.exp -= shift;
+			one = b.one = true;
+
+			if (b.exp > exp || (b.exp == exp && b.sig > sig)) {
+				info tmp = b;
+				b = *this;
+				*this = tmp;
+			}
+
+			// 128-bit sum.
+			uint64_t h = sig;
+			uint64_t l = 0;
+			uint64_t bh = b.sig;
+			uint64_t bl = 0;
+			unsigned d = exp - b.exp;
+			if (d >= 128) {
+				bh = 0;
+				bl = 1;
+			}
+			else if (d >= 64) {
+				bl = (bh >> (d - 64)) | (d > 64 && (bh << (128 - d)) != 0);
+				bh = 0;
+			}
+			else if (d) {
+				bl = bh << (64 - d);
+				bh >>= d;
+			}
+
+			if (sign == b.sign) {
+				l = bl;
+				h += bh;
+				if (h < bh) {
+					// carry out.
+					l = (l >> 1) | (h << 63) | (l & 0x01);
+					h = (h >> 1) | extended_traits::one_bit;
+					++exp;
+				}
+			}
+			else {
+				l = 0 - bl;
+				h -= bh + (bl != 0);
+				if (h == 0 && l == 0) {
+					*this = info();
+					return;
+				}
+				if (h == 0) {
+					h = l;
+					l = 0;
+					exp -= 64;
+				}
+				shift = clz64(h);
+				if (shift) {
+					h = (h << shift) | (l >> (64 - shift));
+					l <<= shift;
+					exp -= shift;
+				}
+			}
+
+			constexpr uint64_t half = extended_traits::one_bit;
+			h += l > half || (l == half && (h & 0x01));
+			if (h == 0) {
+				h = extended_traits::one_bit;
+				++exp;
+			}
+			sig = h;
+		}
+
+		SANE_CONSTEXPR void pack_double_double(uint64_t &hi, uint64_t &lo) const {
+
+			lo = 0;
+			if (nan || inf || sig == 0) {
+				hi = pack_double();
+				return;
+			}
+
+			uint64_t s = sig;
+			int e = exp;
+			int shift = clz64(s);
+			s <<= shift;
+			e -= shift;
+
+			// hi = s rounded to 53 bits.
+			uint64_t h = s >> 11;
+			uint64_t r = s & 0x7ff;
+			bool up = r > 0x400 || (r == 0x400 && (h & 0x01));
+
+			info a;
+			a.sign = sign;
+			a.one = true;
+			a.exp = e;
+			a.sig = (h + up) << 11;
+			if ((h + up) >> 53) {
+				a.sig = extended_traits::one_bit;
+				a.exp = e + 1;
+			}
+			hi = a.pack_double();
+			if ((hi & ~double_traits::sign_bit) == double_traits::nan_exp) return; // overflow.
+
+			// lo = the (exact) difference.
+			int64_t diff = (int64_t)r - (up ? 0x800 : 0);
+			if (diff) {
+				info b;
+				uint64_t m = diff < 0 ? -diff : diff;
+				shift = clz64(m);
+				b.sign = sign ^ (diff < 0);
+				b.one = true;
+				b.exp = e - shift;
+				b.sig = m << shift;
+				lo = b.pack_double();
+			}
+		}
+
+
+
+		SANE_BIT_CAST_CONSTEXPR void read(float x) {
+			unpack_single(bit_cast<uint32_t>(x));
+		}
+
+		SANE_BIT_CAST_CONSTEXPR void read(double x) {
+			unpack_double(bit_cast<uint64_t>(x));
+		}
+
+		SANE_LD_CONSTEXPR void read(long double x) {
+		#if defined(SANE_X87_BIT_CAST)
+			x87_image tmp = bit_cast<x87_image>(x);
+			unpack_extended(tmp.sexp, tmp.sig);
+		#elif LDBL_MANT_DIG == 113
+			read(format_quad<endian::native>{}, &x);
+		#else
+			read(format<sizeof(x), endian::native>{}, &x);
+		#endif
+		}
+
+		#ifdef SANE_HAVE_FLOAT128
+		void read(__float128 x) {
+			read(format_quad<endian::native>{}, &x);
+		}
+		#endif
 
 		template<size_t size, endian byte_order>
 		void read(format<size, byte_order>, const void *vp) {
@@ -153,24 +939,60 @@ namespace floating_point {
 		}
 
 		void read(format<4, endian::native>, const void *vp) {
-			read_single(vp);
+			uint32_t i;
+			std::memcpy(&i, vp, 4);
+			unpack_single(i);
 		}
 
 
 		void read(format<8, endian::native>, const void *vp) {
-			read_double(vp);
+			uint64_t i;
+			std::memcpy(&i, vp, 8);
+			unpack_double(i);
 		}
 
 		void read(format<10, endian::native>, const void *vp) {
-			read_extended(vp);
+			read_extended_image(vp);
 		}
 
 		void read(format<12, endian::native>, const void *vp) {
-			read_extended(vp);
+			read_extended_image(vp);
 		}
 
 		void read(format<16, endian::native>, const void *vp) {
-			read_extended(vp);
+			read_extended_image(vp);
+		}
+
+		template<endian byte_order>
+		void read(format_quad<byte_order>, const void *vp) {
+
+			uint64_t i[2];
+
+			std::memcpy(i, vp, 16);
+			reverse_bytes_if<16>(i, std::integral_constant<bool, byte_order != endian::native>{});
+			if (endian::native == endian::little) unpack_quad(i[1], i[0]);
+			else unpack_quad(i[0], i[1]);
+		}
+
+		template<endian byte_order>
+		void read(format_double_double<byte_order>, const void *vp) {
+
+			uint64_t i[2];
+
+			std::memcpy(i, vp, 16);
+			reverse_bytes_if<8>(i + 0, std::integral_constant<bool, byte_order != endian::native>{});
+			reverse_bytes_if<8>(i + 1, std::integral_constant<bool, byte_order != endian::native>{});
+			unpack_double_double(i[0], i[1]);
+		}
+
+		template<endian byte_order>
+		void read(format_68881<byte_order>, const void *vp) {
+
+			uint8_t buffer[12];
+
+			std::memcpy(buffer, vp, 12);
+			reverse_bytes_if<12>(buffer, std::integral_constant<bool, byte_order != endian::native>{});
+			read_68881(buffer);
 		}
 
 
@@ -179,68 +1001,289 @@ namespace floating_point {
 		void write(T &x) const
 		{ write(format<sizeof(x), endian::native>{}, &x); }
 
+		void write(long double &x) const
+		{ x = (long double)*this; }
+
 		template<size_t size, endian byte_order>
-		void write(format<size, byte_order>, void *vp) const {
+		void write(format<size, byte_order>, void *vp, rounding_direction rd = TONEAREST) const {
 
 			uint8_t buffer[size];
 			static_assert(byte_order != endian::native, "byte order");
 
 
-			write(format<size, endian::native>{}, buffer);
+			write(format<size, endian::native>{}, buffer, rd);
 
 			reverse_bytes<size>(buffer);
 			std::memcpy(vp, buffer, size);
 		}
 
 
-		void write(format<4, endian::native>, void *vp) const {
-			write_single(vp);
+		void write(format<4, endian::native>, void *vp, rounding_direction rd = TONEAREST) const {
+			uint32_t i = pack_single(rd);
+			std::memcpy(vp, &i, 4);
 		}
 
 
-		void write(format<8, endian::native>, void *vp) const {
-			write_double(vp);
+		void write(format<8, endian::native>, void *vp, rounding_direction rd = TONEAREST) const {
+			uint64_t i = pack_double(rd);
+			std::memcpy(vp, &i, 8);
 		}
 
-		void write(format<10, endian::native>, void *vp) const {
-			write_extended(vp);
+		void write(format<10, endian::native>, void *vp, rounding_direction rd = TONEAREST) const {
+			write_extended_image(vp, rd);
 		}
 
-		void write(format<12, endian::native>, void *vp) const {
-			write_extended(vp);
+		void write(format<12, endian::native>, void *vp, rounding_direction rd = TONEAREST) const {
+			write_extended_image(vp, rd);
 			std::memset((uint8_t *)vp + 10, 0, 12-10);
 		}
 
-		void write(format<16, endian::native>, void *vp) const {
-			write_extended(vp);
+		void write(format<16, endian::native>, void *vp, rounding_direction rd = TONEAREST) const {
+			write_extended_image(vp, rd);
 			std::memset((uint8_t *)vp + 10, 0, 16-10);
 		}
 
+		template<endian byte_order>
+		void write(format_quad<byte_order>, void *vp, rounding_direction rd = TONEAREST) const {
 
-		explicit operator long double() const {
+			uint64_t i[2];
+
+			if (endian::native == endian::little) pack_quad(i[1], i[0], rd);
+			else pack_quad(i[0], i[1], rd);
+			reverse_bytes_if<16>(i, std::integral_constant<bool, byte_order != endian::native>{});
+			std::memcpy(vp, i, 16);
+		}
+
+		template<endian byte_order>
+		void write(format_double_double<byte_order>, void *vp) const {
+
+			uint64_t i[2];
+
+			pack_double_double(i[0], i[1]);
+			reverse_bytes_if<8>(i + 0, std::integral_constant<bool, byte_order != endian::native>{});
+			reverse_bytes_if<8>(i + 1, std::integral_constant<bool, byte_order != endian::native>{});
+			std::memcpy(vp, i, 16);
+		}
+
+		template<endian byte_order>
+		void write(format_68881<byte_order>, void *vp, rounding_direction rd = TONEAREST) const {
+
+			uint8_t buffer[10];
+
+			write_extended_image(buffer, rd);
+			transcode(format<10, endian::native>{}, buffer, format_68881<byte_order>{}, vp, 1);
+		}
+
+
+		/*
+		 * the exceptions write(f, vp, rd) raises: INEXACT when it rounds,
+		 * UNDERFLOW when it rounds a value below the normal range,
+		 * OVERFLOW when it's too big, INVALID for signaling NaNs.  write
+		 * itself leaves the environment alone; convert() (environment.h)
+		 * signals these.
+		 */
+		template<size_t size, endian byte_order>
+		SANE_CONSTEXPR unsigned write_exceptions(format<size, byte_order>, rounding_direction rd = TONEAREST) const {
+			return size == 4 ? round_exceptions<single_traits::significand_bits, single_traits::min_exp, single_traits::max_exp>(rd)
+				: size == 8 ? round_exceptions<double_traits::significand_bits, double_traits::min_exp, double_traits::max_exp>(rd)
+				: round_exceptions<63, extended_traits::min_exp, extended_traits::max_exp>(rd);
+		}
+
+		template<endian byte_order>
+		SANE_CONSTEXPR unsigned write_exceptions(format_68881<byte_order>, rounding_direction rd = TONEAREST) const {
+			return round_exceptions<63, extended_traits::min_exp, extended_traits::max_exp>(rd);
+		}
+
+		// binary128 holds any info exactly.
+		template<endian byte_order>
+		SANE_CONSTEXPR unsigned write_exceptions(format_quad<byte_order>, rounding_direction = TONEAREST) const {
+			return nan && signaling ? INVALID : 0;
+		}
+
+
+		explicit SANE_LD_CONSTEXPR operator long double() const {
+		#ifdef SANE_X87_BIT_CAST
+			x87_image tmp{};
+			pack_extended(tmp.sexp, tmp.sig);
+			return bit_cast<long double>(tmp);
+		#elif LDBL_MANT_DIG == 113
 			long double tmp;
-			write(tmp);
+			write(format_quad<endian::native>{}, &tmp);
 			return tmp;
-		}
-		explicit operator double() const {
-			double tmp;
-			write(tmp);
+		#else
+			long double tmp;
+			write(format<sizeof(tmp), endian::native>{}, &tmp);
 			return tmp;
+		#endif
 		}
-		explicit operator float() const {
-			float tmp;
-			write(tmp);
+
+		#ifdef SANE_HAVE_FLOAT128
+		explicit operator __float128() const {
+			__float128 tmp;
+			write(format_quad<endian::native>{}, &tmp);
 			return tmp;
 		}
 
+		explicit info(__float128 x) { read(x); }
+		#endif
+		explicit SANE_BIT_CAST_CONSTEXPR operator double() const {
+			return bit_cast<double>(pack_double());
+		}
+		explicit SANE_BIT_CAST_CONSTEXPR operator float() const {
+			return bit_cast<float>(pack_single());
+		}
 
-		template<class T, typename = std::enable_if<std::is_floating_point<T>::value> >
-		explicit info(T x) { read(x); }
+
+		template<class T, typename = typename std::enable_if<std::is_floating_point<T>::value>::type >
+		explicit SANE_CONSTEXPR info(T x) { read(x); }
 		info() = default;
 
 
+	private:
+
+		/*
+		 * payload bits below quiet (the format's quiet bit) plus the quiet
+		 * bit itself.  A signaling NaN needs a non-zero payload so one
+		 * that doesn't fit becomes NANZERO.
+		 */
+		SANE_CONSTEXPR uint64_t nan_payload(uint64_t quiet) const {
+			uint64_t p = sig & (quiet - 1);
+			if (!signaling) return p | quiet;
+			return p ? p : (uint64_t)NANZERO;
+		}
+
+		static SANE_CONSTEXPR bool overflow_to_inf(bool sign, rounding_direction rd) {
+			return rd == TONEAREST || (rd == UPWARD && !sign) || (rd == DOWNWARD && sign);
+		}
+
+		/*
+		 * 1 if the truncated value should be incremented.  rem holds the
+		 * discarded bits, most significant bit first.
+		 */
+		static SANE_CONSTEXPR uint64_t round_increment(bool sign, bool lsb, uint64_t rem, rounding_direction rd) {
+			constexpr uint64_t half = UINT64_C(1) << 63;
+			uint64_t nearest = (rem > half) | ((rem == half) & lsb);
+			uint64_t away = rem != 0;
+			switch (rd) {
+				case TONEAREST: return nearest;
+				case UPWARD: return away & !sign;
+				case DOWNWARD: return away & sign;
+				default: return 0;
+			}
+		}
+
+		/*
+		 * single/double magnitude bits (no sign).  The biased exponent is
+		 * added to the significand (hidden bit included) so a carry out
+		 * of the significand bumps the exponent, and a de-normal that
+		 * rounds up becomes the smallest normal.
+		 */
+		template<int significand_bits, int bias, int min_exp, int max_exp>
+		SANE_CONSTEXPR uint64_t round_pack_ieee(bool sign, rounding_direction rd) const {
+
+			constexpr uint64_t max_finite = ((uint64_t)(2 * bias) << significand_bits) | ((UINT64_C(1) << significand_bits) - 1);
+			constexpr uint64_t infinity = (uint64_t)(2 * bias + 1) << significand_bits;
+			constexpr unsigned low = 63 - significand_bits;
+
+			// common case: normalized and in the normal range.  One test,
+			// then straight-line shift, round and pack.
+			if (((uint64_t)(exp - min_exp) <= (uint64_t)(max_exp - min_exp)) & (sig >> 63)) {
+				uint64_t m = sig >> low;
+				uint64_t i = ((uint64_t)(exp + bias - 1) << significand_bits) + m;
+				i += round_increment(sign, m & 0x01, sig << (64 - low), rd);
+				if (i >= infinity) return overflow_to_inf(sign, rd) ? infinity : max_finite;
+				return i;
+			}
+
+			if (!sig) return 0;
+
+			int shift = clz64(sig);
+			uint64_t s = sig << shift;
+			int e = exp - shift;
+
+			if (e > max_exp) return overflow_to_inf(sign, rd) ? infinity : max_finite;
+
+			int d = min_exp - e;
+			d = d > 0 ? d : 0;
+			unsigned n = 63 - significand_bits + d;
+
+			uint64_t m = 0;
+			uint64_t rem = 0;
+			if (n < 64) {
+				m = s >> n;
+				rem = s << (64 - n);
+			} else {
+				// < 1/2 the smallest de-normal.
+				m = 0;
+				rem = n == 64 ? s : 1;
+			}
+
+			uint64_t i = ((uint64_t)(e + d + bias - 1) << significand_bits) + m;
+			i += round_increment(sign, m & 0x01, rem, rd);
+
+			if (i >= infinity) return overflow_to_inf(sign, rd) ? infinity : max_finite;
+			return i;
+		}
+
+		// round_pack_ieee's (and pack_extended's) rounding, for the exceptions.
+		template<int significand_bits, int min_exp, int max_exp>
+		SANE_CONSTEXPR unsigned round_exceptions(rounding_direction rd) const {
+
+			if (nan) return signaling ? INVALID : 0;
+			if (inf || !sig) return 0;
+
+			int shift = clz64(sig);
+			uint64_t s = sig << shift;
+			int e = exp - shift;
+
+			if (e > max_exp) return OVERFLOW | INEXACT;
 
+			int d = min_exp - e;
+			d = d > 0 ? d : 0;
+			unsigned n = 63 - significand_bits + d;
 
+			uint64_t m = n < 64 ? s >> n : 0;
+			uint64_t rem = n == 0 ? 0 : n < 64 ? s << (64 - n) : 1;
+			if (!rem) return 0;
+
+			unsigned x = INEXACT;
+			if (d) x |= UNDERFLOW;
+			// all ones at the top exponent, rounding up.
+			constexpr uint64_t ones = ~UINT64_C(0) >> (63 - significand_bits);
+			if (e == max_exp && m == ones && round_increment(sign, 1, rem, rd)) x |= OVERFLOW;
+			return x;
+		}
+
+		// 10-byte native image, shared by all extended sizes.
+		void read_extended_image(const void *vp) {
+			uint64_t i;
+			uint16_t sexp;
+
+			if (endian::native == endian::little) {
+				std::memcpy(&i, (const uint8_t *)vp, 8);
+				std::memcpy(&sexp, (const uint8_t *)vp + 8, 2);
+			} else {
+				std::memcpy(&sexp, (const uint8_t *)vp, 2);
+				std::memcpy(&i, (const uint8_t *)vp + 2, 8);
+			}
+			unpack_extended(sexp, i);
+		}
+
+		void write_extended_image(void *vp, rounding_direction rd = TONEAREST) const {
+			uint64_t i = 0;
+			uint16_t sexp = 0;
+
+			pack_extended(sexp, i, rd);
+
+			uint8_t *cp = (uint8_t *)vp;
+			if (endian::native == endian::little) {
+				std::memcpy(cp + 0, &i, 8);
+				std::memcpy(cp + 8, &sexp, 2);
+			} else {
+				std::memcpy(cp + 0, &sexp, 2);
+				std::memcpy(cp + 2, &i, 8);
+			}
+		}
 
 	};
 
@@ -294,8 +1337,8 @@ namespace floating_point {
 
 		static_assert(size == 10 || size == 12 || size == 16, "extended size");
 
-		if (ldsize == 8) {
-			// long double is really a double. manually down-grade it.
+		if (!long_double_is_x87) {
+			// long double is really a double (or binary128). manually convert it.
 			info fpi;
 			fpi.read(f, vp);
 
@@ -354,7 +1397,7 @@ namespace floating_point {
 		constexpr size_t ssize = ldsize > size ? ldsize : size;
 		typename std::aligned_storage<ssize, alignof(return_type)>::type buffer[1];
 
-		if (ldsize == 8) {
+		if (!long_double_is_x87) {
 			// do it manually.
 			info fpi;
 			fpi.read(x);
@@ -369,40 +1412,1328 @@ namespace floating_point {
 	}
 
 
+	/*
+	 * extended <-> extended transcoding.  Only the sign/exponent word and
+	 * the significand are moved; padding is zeroed.
+	 */
+
+	template<class F>
+	struct extended_layout {
+		static constexpr bool value = false;
+	};
+
+	// offsets within a native byte order image.
+	template<size_t _size, endian byte_order>
+	struct extended_layout<format<_size, byte_order>> {
+		static constexpr bool value = _size == 10 || _size == 12 || _size == 16;
+		static constexpr size_t sexp = endian::native == endian::little ? 8 : 0;
+		static constexpr size_t sig = endian::native == endian::little ? 0 : 2;
+	};
+
+	template<endian byte_order>
+	struct extended_layout<format_68881<byte_order>> {
+		static constexpr bool value = true;
+		static constexpr size_t sexp = endian::native == endian::little ? 10 : 0;
+		static constexpr size_t sig = endian::native == endian::little ? 0 : 4;
+	};
+
+
+	/*
+	 * sign/exponent word and significand straight from an encoded image.
+	 * Loading the fields in place (rather than swapping a copy of the
+	 * whole image) avoids a store forwarding stall per value.
+	 */
+	template<class F>
+	void load_extended(F, const void *vp, uint16_t &sexp, uint64_t &sig) {
+
+		typedef extended_layout<F> fl;
+		constexpr bool swap = F::byte_order != endian::native;
+
+		const uint8_t *cp = (const uint8_t *)vp;
+		std::memcpy(&sexp, cp + (swap ? F::size - fl::sexp - 2 : fl::sexp), 2);
+		std::memcpy(&sig, cp + (swap ? F::size - fl::sig - 8 : fl::sig), 8);
+		reverse_bytes_if<2>(&sexp, std::integral_constant<bool, swap>{});
+		reverse_bytes_if<8>(&sig, std::integral_constant<bool, swap>{});
+	}
+
+	// and back.  Padding is zeroed.
+	template<class F>
+	void store_extended(F, void *vp, uint16_t sexp, uint64_t sig) {
+
+		typedef extended_layout<F> fl;
+		constexpr bool swap = F::byte_order != endian::native;
+
+		uint8_t *cp = (uint8_t *)vp;
+		reverse_bytes_if<2>(&sexp, std::integral_constant<bool, swap>{});
+		reverse_bytes_if<8>(&sig, std::integral_constant<bool, swap>{});
+		std::memset(cp, 0, F::size);
+		std::memcpy(cp + (swap ? F::size - fl::sexp - 2 : fl::sexp), &sexp, 2);
+		std::memcpy(cp + (swap ? F::size - fl::sig - 8 : fl::sig), &sig, 8);
+	}
+
+
+	template<class From, class To>
+	typename std::enable_if<extended_layout<From>::value && extended_layout<To>::value>::type
+	transcode(From f, const void *src, To t, void *dst, size_t count) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		for (size_t n = 0; n < count; ++n, sp += From::size, dp += To::size) {
+
+			uint16_t sexp;
+			uint64_t sig;
+			load_extended(f, sp, sexp, sig);
+
+			// 68881 infinities/NaNs don't require the explicit 1 bit; x87 does.
+			sig |= (uint64_t)((sexp & extended_traits::nan_exp) == extended_traits::nan_exp) << 63;
+
+			store_extended(t, dp, sexp, sig);
+		}
+	}
+
+
+	/*
+	 * extended <-> binary128 transcoding.
+	 */
+
+	template<class From, endian byte_order>
+	typename std::enable_if<extended_layout<From>::value>::type
+	transcode(From f, const void *src, format_quad<byte_order>, void *dst, size_t count) {
+
+		constexpr bool little = endian::native == endian::little;
+
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		for (size_t n = 0; n < count; ++n, sp += From::size, dp += 16) {
+
+			uint64_t b[2];
+			uint16_t sexp;
+			uint64_t sig;
+			load_extended(f, sp, sexp, sig);
+
+			extended_to_quad(sexp, sig, b[little], b[!little]);
+
+			reverse_bytes_if<16>(b, std::integral_constant<bool, byte_order != endian::native>{});
+			std::memcpy(dp, b, 16);
+		}
+	}
+
+	template<endian byte_order, class To>
+	typename std::enable_if<extended_layout<To>::value>::type
+	transcode(format_quad<byte_order>, const void *src, To t, void *dst, size_t count) {
+
+		constexpr bool little = endian::native == endian::little;
+
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		for (size_t n = 0; n < count; ++n, sp += 16, dp += To::size) {
+
+			uint64_t a[2];
+			uint16_t sexp;
+			uint64_t sig;
+
+			std::memcpy(a, sp, 16);
+			reverse_bytes_if<16>(a, std::integral_constant<bool, byte_order != endian::native>{});
+
+			quad_to_extended(a[little], a[!little], sexp, sig);
+			store_extended(t, dp, sexp, sig);
+		}
+	}
+
+
+	/*
+	 * extended <-> double-double, batched into separate hi and lo arrays
+	 * (the layout SIMD double arithmetic wants).  Values are unpacked a
+	 * block at a time and run through a branch-free kernel (SSE2/AVX2,
+	 * the scalar loop finishes); anything outside the common range
+	 * (zero, denormal, inf, nan, out of double range, non-canonical
+	 * pairs) is redone through info.
+	 */
+
+	namespace detail {
+
+	#ifdef SANE_HAVE_SSE2
+		/*
+		 * The int64 <-> double conversions are the magic constant ones:
+		 * the values in play (the 11 bits split off, or lo in units of
+		 * the extended lsb) are well inside 2^51, so adding 1.5 * 2^52
+		 * does it in one step.  Lo takes hi's sign by negating the
+		 * integer, which keeps a zero lo +0.  The range compares are on
+		 * exponents, which fit the low 32-bit word; SSE2 has no 64-bit
+		 * compare.
+		 */
+		constexpr double dd_magic = 6755399441055744.0;
+		constexpr int64_t dd_magic_bits = INT64_C(0x4338000000000000);
+
+		inline __m128i low_word_mask(__m128i x) {
+			return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 2, 0, 0));
+		}
+
+		inline size_t split_double_double_sse2(const uint64_t *sexp, const uint64_t *sig, double *hi, double *lo, uint64_t *slow, size_t n) {
+
+			const __m128i one = _mm_set1_epi64x(1);
+
+			size_t i = 0;
+			for (; n - i >= 2; i += 2) {
+				__m128i x = _mm_loadu_si128((const __m128i *)(sexp + i));
+				__m128i s = _mm_loadu_si128((const __m128i *)(sig + i));
+				__m128i e = _mm_and_si128(x, _mm_set1_epi64x(0x7fff));
+				__m128i neg = _mm_sub_epi64(_mm_setzero_si128(), _mm_srli_epi64(x, 15));
+
+				// round to 53 bits, nearest even; a carry out renormalizes.
+				__m128i h = _mm_srli_epi64(s, 11);
+				__m128i r = _mm_and_si128(s, _mm_set1_epi64x(0x7ff));
+				__m128i up = _mm_add_epi64(_mm_add_epi64(r, _mm_set1_epi64x(0x3ff)), _mm_and_si128(h, one));
+				up = _mm_srli_epi64(up, 11);
+				h = _mm_add_epi64(h, up);
+				__m128i c = _mm_srli_epi64(h, 53);
+				__m128i cm = _mm_sub_epi64(_mm_setzero_si128(), c);
+				h = _mm_or_si128(_mm_andnot_si128(cm, h), _mm_and_si128(cm, _mm_srli_epi64(h, 1)));
+
+				__m128i diff = _mm_sub_epi64(r, _mm_slli_epi64(up, 11));
+				diff = _mm_sub_epi64(_mm_xor_si128(diff, neg), neg);
+				__m128d d = _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(diff, _mm_set1_epi64x(dd_magic_bits))), _mm_set1_pd(dd_magic));
+				__m128i scale = _mm_slli_epi64(_mm_and_si128(_mm_sub_epi64(e, _mm_set1_epi64x(16383 + 63 - 1023)), _mm_set1_epi64x(0x7ff)), 52);
+
+				__m128i eh = _mm_add_epi64(_mm_sub_epi64(e, _mm_set1_epi64x(16383 - 1023)), c);
+				__m128i b = _mm_or_si128(_mm_slli_epi64(neg, 63), _mm_slli_epi64(_mm_and_si128(eh, _mm_set1_epi64x(0x7ff)), 52));
+				b = _mm_or_si128(b, _mm_and_si128(h, _mm_set1_epi64x(double_traits::significand_mask)));
+				_mm_storeu_pd(hi + i, _mm_castsi128_pd(b));
+				_mm_storeu_pd(lo + i, _mm_mul_pd(d, _mm_castsi128_pd(scale)));
+
+				// both halves normal.
+				__m128i ok = _mm_and_si128(_mm_cmpgt_epi32(e, _mm_set1_epi64x(16383 + 63 - 1023)), _mm_cmpgt_epi32(_mm_set1_epi64x(16383 + 1023 + 1), _mm_add_epi64(e, c)));
+				ok = _mm_and_si128(low_word_mask(ok), _mm_shuffle_epi32(_mm_srai_epi32(s, 31), _MM_SHUFFLE(3, 3, 1, 1)));
+				_mm_storeu_si128((__m128i *)(slow + i), _mm_andnot_si128(ok, one));
+			}
+			return i;
+		}
+
+		inline size_t join_double_double_sse2(const double *hi, const double *lo, uint64_t *sexp, uint64_t *sig, uint64_t *slow, size_t n) {
+
+			const __m128i one = _mm_set1_epi64x(1);
+
+			size_t i = 0;
+			for (; n - i >= 2; i += 2) {
+				__m128i hb = _mm_castpd_si128(_mm_loadu_pd(hi + i));
+				__m128i eh = _mm_and_si128(_mm_srli_epi64(hb, 52), _mm_set1_epi64x(0x7ff));
+				__m128i sign = _mm_srli_epi64(hb, 63);
+				__m128i neg = _mm_sub_epi64(_mm_setzero_si128(), sign);
+
+				// lo in units of the extended lsb, which must be an integer.
+				__m128i scale = _mm_slli_epi64(_mm_and_si128(_mm_sub_epi64(_mm_set1_epi64x(63 + 1023 + 1023), eh), _mm_set1_epi64x(0x7ff)), 52);
+				__m128d t = _mm_mul_pd(_mm_loadu_pd(lo + i), _mm_castsi128_pd(scale));
+				__m128i ok = _mm_and_si128(_mm_cmpgt_epi32(eh, _mm_set1_epi64x(1023 - 960 - 1)), _mm_cmpgt_epi32(_mm_set1_epi64x(0x7ff), eh));
+				ok = _mm_and_si128(low_word_mask(ok), _mm_castpd_si128(_mm_cmple_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), t), _mm_set1_pd(1024))));
+				t = _mm_and_pd(t, _mm_castsi128_pd(ok));
+				__m128d y = _mm_add_pd(t, _mm_set1_pd(dd_magic));
+				ok = _mm_and_si128(ok, _mm_castpd_si128(_mm_cmpeq_pd(_mm_sub_pd(y, _mm_set1_pd(dd_magic)), t)));
+				__m128i ti = _mm_sub_epi64(_mm_castpd_si128(y), _mm_set1_epi64x(dd_magic_bits));
+				ti = _mm_sub_epi64(_mm_xor_si128(ti, neg), neg);
+
+				__m128i s = _mm_or_si128(_mm_and_si128(hb, _mm_set1_epi64x(double_traits::significand_mask)), _mm_set1_epi64x(INT64_C(1) << 52));
+				s = _mm_add_epi64(_mm_slli_epi64(s, 11), ti);
+				__m128i norm = _mm_xor_si128(_mm_srli_epi64(s, 63), one);
+				s = _mm_add_epi64(s, _mm_and_si128(s, _mm_sub_epi64(_mm_setzero_si128(), norm)));
+				__m128i e = _mm_and_si128(_mm_sub_epi64(_mm_add_epi64(eh, _mm_set1_epi64x(16383 - 1023)), norm), _mm_set1_epi64x(0x7fff));
+
+				_mm_storeu_si128((__m128i *)(sexp + i), _mm_or_si128(_mm_slli_epi64(sign, 15), e));
+				_mm_storeu_si128((__m128i *)(sig + i), s);
+				_mm_storeu_si128((__m128i *)(slow + i), _mm_andnot_si128(ok, one));
+			}
+			return i;
+		}
+	#endif
+
+	#ifdef SANE_HAVE_AVX2
+		// the SSE2 kernels, 4 at a time, with the 64-bit compares and shifts.
+		inline size_t split_double_double_avx2(const uint64_t *sexp, const uint64_t *sig, double *hi, double *lo, uint64_t *slow, size_t n) {
+
+			const __m256i one = _mm256_set1_epi64x(1);
+
+			size_t i = 0;
+			for (; n - i >= 4; i += 4) {
+				__m256i x = _mm256_loadu_si256((const __m256i *)(sexp + i));
+				__m256i s = _mm256_loadu_si256((const __m256i *)(sig + i));
+				__m256i e = _mm256_and_si256(x, _mm256_set1_epi64x(0x7fff));
+				__m256i neg = _mm256_sub_epi64(_mm256_setzero_si256(), _mm256_srli_epi64(x, 15));
+
+				__m256i h = _mm256_srli_epi64(s, 11);
+				__m256i r = _mm256_and_si256(s, _mm256_set1_epi64x(0x7ff));
+				__m256i up = _mm256_add_epi64(_mm256_add_epi64(r, _mm256_set1_epi64x(0x3ff)), _mm256_and_si256(h, one));
+				up = _mm256_srli_epi64(up, 11);
+				h = _mm256_add_epi64(h, up);
+				__m256i c = _mm256_srli_epi64(h, 53);
+				h = _mm256_srlv_epi64(h, c);
+
+				__m256i diff = _mm256_sub_epi64(r, _mm256_slli_epi64(up, 11));
+				diff = _mm256_sub_epi64(_mm256_xor_si256(diff, neg), neg);
+				__m256d d = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(diff, _mm256_set1_epi64x(dd_magic_bits))), _mm256_set1_pd(dd_magic));
+				__m256i scale = _mm256_slli_epi64(_mm256_and_si256(_mm256_sub_epi64(e, _mm256_set1_epi64x(16383 + 63 - 1023)), _mm256_set1_epi64x(0x7ff)), 52);
+
+				__m256i eh = _mm256_add_epi64(_mm256_sub_epi64(e, _mm256_set1_epi64x(16383 - 1023)), c);
+				__m256i b = _mm256_or_si256(_mm256_slli_epi64(neg, 63), _mm256_slli_epi64(_mm256_and_si256(eh, _mm256_set1_epi64x(0x7ff)), 52));
+				b = _mm256_or_si256(b, _mm256_and_si256(h, _mm256_set1_epi64x(double_traits::significand_mask)));
+				_mm256_storeu_pd(hi + i, _mm256_castsi256_pd(b));
+				_mm256_storeu_pd(lo + i, _mm256_mul_pd(d, _mm256_castsi256_pd(scale)));
+
+				__m256i ok = _mm256_and_si256(_mm256_cmpgt_epi64(e, _mm256_set1_epi64x(16383 + 63 - 1023)), _mm256_cmpgt_epi64(_mm256_set1_epi64x(16383 + 1023 + 1), _mm256_add_epi64(e, c)));
+				ok = _mm256_and_si256(ok, _mm256_cmpgt_epi64(_mm256_setzero_si256(), s));
+				_mm256_storeu_si256((__m256i *)(slow + i), _mm256_andnot_si256(ok, one));
+			}
+			return i;
+		}
+
+		inline size_t join_double_double_avx2(const double *hi, const double *lo, uint64_t *sexp, uint64_t *sig, uint64_t *slow, size_t n) {
+
+			const __m256i one = _mm256_set1_epi64x(1);
+
+			size_t i = 0;
+			for (; n - i >= 4; i += 4) {
+				__m256i hb = _mm256_castpd_si256(_mm256_loadu_pd(hi + i));
+				__m256i eh = _mm256_and_si256(_mm256_srli_epi64(hb, 52), _mm256_set1_epi64x(0x7ff));
+				__m256i sign = _mm256_srli_epi64(hb, 63);
+				__m256i neg = _mm256_sub_epi64(_mm256_setzero_si256(), sign);
+
+				__m256i scale = _mm256_slli_epi64(_mm256_and_si256(_mm256_sub_epi64(_mm256_set1_epi64x(63 + 1023 + 1023), eh), _mm256_set1_epi64x(0x7ff)), 52);
+				__m256d t = _mm256_mul_pd(_mm256_loadu_pd(lo + i), _mm256_castsi256_pd(scale));
+				__m256i ok = _mm256_and_si256(_mm256_cmpgt_epi64(eh, _mm256_set1_epi64x(1023 - 960 - 1)), _mm256_cmpgt_epi64(_mm256_set1_epi64x(0x7ff), eh));
+				ok = _mm256_and_si256(ok, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), t), _mm256_set1_pd(1024), _CMP_LE_OQ)));
+				t = _mm256_and_pd(t, _mm256_castsi256_pd(ok));
+				__m256d y = _mm256_add_pd(t, _mm256_set1_pd(dd_magic));
+				ok = _mm256_and_si256(ok, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_sub_pd(y, _mm256_set1_pd(dd_magic)), t, _CMP_EQ_OQ)));
+				__m256i ti = _mm256_sub_epi64(_mm256_castpd_si256(y), _mm256_set1_epi64x(dd_magic_bits));
+				ti = _mm256_sub_epi64(_mm256_xor_si256(ti, neg), neg);
+
+				__m256i s = _mm256_or_si256(_mm256_and_si256(hb, _mm256_set1_epi64x(double_traits::significand_mask)), _mm256_set1_epi64x(INT64_C(1) << 52));
+				s = _mm256_add_epi64(_mm256_slli_epi64(s, 11), ti);
+				__m256i norm = _mm256_xor_si256(_mm256_srli_epi64(s, 63), one);
+				s = _mm256_sllv_epi64(s, norm);
+				__m256i e = _mm256_and_si256(_mm256_sub_epi64(_mm256_add_epi64(eh, _mm256_set1_epi64x(16383 - 1023)), norm), _mm256_set1_epi64x(0x7fff));
+
+				_mm256_storeu_si256((__m256i *)(sexp + i), _mm256_or_si256(_mm256_slli_epi64(sign, 15), e));
+				_mm256_storeu_si256((__m256i *)(sig + i), s);
+				_mm256_storeu_si256((__m256i *)(slow + i), _mm256_andnot_si256(ok, one));
+			}
+			return i;
+		}
+	#endif
+	}
+
+	template<class From>
+	typename std::enable_if<extended_layout<From>::value>::type
+	split_double_double(From f, const void *src, double *hi, double *lo, size_t count) {
+
+		constexpr size_t block = 64;
+
+		const uint8_t *sp = (const uint8_t *)src;
+
+		for (size_t base = 0; base < count; base += block) {
+
+			size_t n = count - base < block ? count - base : block;
+			uint64_t sexp[block];
+			uint64_t sig[block];
+			uint64_t slow[block];
+
+			for (size_t i = 0; i < n; ++i) {
+				uint16_t e;
+				load_extended(f, sp + (base + i) * From::size, e, sig[i]);
+				sexp[i] = e;
+			}
+
+			size_t i = 0;
+		#if defined(SANE_HAVE_AVX2)
+			i = detail::split_double_double_avx2(sexp, sig, hi + base, lo + base, slow, n);
+		#elif defined(SANE_HAVE_SSE2)
+			i = detail::split_double_double_sse2(sexp, sig, hi + base, lo + base, slow, n);
+		#endif
+
+			for (; i < n; ++i) {
+				uint64_t s = sig[i];
+				int64_t e = (int64_t)(sexp[i] & 0x7fff) - 16383;
+				uint64_t sign = (sexp[i] >> 15) << 63;
+
+				uint64_t h = s >> 11;
+				uint64_t r = s & 0x7ff;
+				uint64_t up = (r > 0x400) | ((r == 0x400) & h);
+				h += up;
+				uint64_t c = h >> 53;
+				h >>= c;
+				int64_t eh = e + c;
+
+				int64_t diff = (int64_t)r - (int64_t)(up << 11);
+				double scale = bit_cast<double>((uint64_t)((e - 63 + 1023) & 0x7ff) << 52);
+				uint64_t l = bit_cast<uint64_t>((double)diff * scale);
+
+				hi[base + i] = bit_cast<double>(sign | ((uint64_t)((eh + 1023) & 0x7ff) << 52) | (h & double_traits::significand_mask));
+				lo[base + i] = bit_cast<double>(l ^ (sign & (0 - (uint64_t)(diff != 0))));
+
+				// both halves normal.
+				slow[i] = !((s >> 63) & (e - 63 >= -1022) & (eh <= 1023));
+			}
+
+			for (size_t i = 0; i < n; ++i) {
+				if (!slow[i]) continue;
+				info fpi;
+				uint64_t h, l;
+				fpi.unpack_extended(sexp[i], sig[i]);
+				fpi.pack_double_double(h, l);
+				hi[base + i] = bit_cast<double>(h);
+				lo[base + i] = bit_cast<double>(l);
+			}
+		}
+	}
+
+	template<class To>
+	typename std::enable_if<extended_layout<To>::value>::type
+	join_double_double(const double *hi, const double *lo, To to, void *dst, size_t count) {
+
+		constexpr size_t block = 64;
+
+		uint8_t *dp = (uint8_t *)dst;
+
+		for (size_t base = 0; base < count; base += block) {
+
+			size_t n = count - base < block ? count - base : block;
+			uint64_t sexp[block];
+			uint64_t sig[block];
+			uint64_t slow[block];
+
+			size_t i = 0;
+		#if defined(SANE_HAVE_AVX2)
+			i = detail::join_double_double_avx2(hi + base, lo + base, sexp, sig, slow, n);
+		#elif defined(SANE_HAVE_SSE2)
+			i = detail::join_double_double_sse2(hi + base, lo + base, sexp, sig, slow, n);
+		#endif
+
+			for (; i < n; ++i) {
+				uint64_t hb = bit_cast<uint64_t>(hi[base + i]);
+				int64_t eh = (hb >> 52) & 0x7ff;
+				int64_t e = eh - 1023;
+				uint64_t sign = hb >> 63;
+
+				// lo in units of the extended lsb.
+				double scale = bit_cast<double>((uint64_t)((63 - e + 1023) & 0x7ff) << 52);
+				double t = lo[base + i] * scale;
+				uint64_t ok = (uint64_t)(eh - 1) < 0x7fe;
+				ok &= e >= -960;
+				ok &= std::fabs(t) <= 1024; // also false for nan.
+				t = bit_cast<double>(bit_cast<uint64_t>(t) & (0 - ok));
+				int64_t ti = (int64_t)t;
+				ok &= (double)ti == t;
+
+				ti = (ti ^ (0 - (int64_t)sign)) + sign;
+				uint64_t s = (((hb & double_traits::significand_mask) | (UINT64_C(1) << 52)) << 11) + ti;
+				uint64_t norm = !(s >> 63);
+				s <<= norm;
+				e -= norm;
+
+				sexp[i] = (sign << 15) | ((e + 16383) & 0x7fff);
+				sig[i] = s;
+				slow[i] = !ok;
+			}
+
+			for (size_t i = 0; i < n; ++i) {
+				if (slow[i]) {
+					info fpi;
+					uint16_t e;
+					fpi.unpack_double_double(bit_cast<uint64_t>(hi[base + i]), bit_cast<uint64_t>(lo[base + i]));
+					fpi.pack_extended(e, sig[i]);
+					sexp[i] = e;
+				}
+				store_extended(to, dp + (base + i) * To::size, sexp[i], sig[i]);
+			}
+		}
+	}
+
+
+#ifdef SANE_HAVE_SSE2
+	namespace detail {
+
+		/*
+		 * SSE2 helpers.  x86 is little endian, so only big endian images
+		 * need the swap; SSE2 has no byte shuffle, so it's done as a
+		 * byte swap of each 16-bit word and a word shuffle.
+		 */
+		template<size_t size, endian byte_order>
+		inline __m128i load_lanes(const uint8_t *sp) {
+			__m128i x = _mm_loadu_si128((const __m128i *)sp);
+			if (byte_order == endian::native) return x;
+			x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+			if (size == 4) {
+				x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+				return _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+			}
+			x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+			return _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+		}
+
+		/*
+		 * 4 doubles as their high and low 32-bit words, in order.  The
+		 * low words are left in memory order: they're only tested for
+		 * zero and for the low byte, which low_byte() finds.
+		 */
+		template<endian byte_order>
+		inline void load_words(const uint8_t *sp, __m128i &hi, __m128i &lo) {
+			constexpr bool big = byte_order != endian::native;
+			__m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)sp));
+			__m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(sp + 16)));
+			__m128 h = big ? _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)) : _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			__m128 l = big ? _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)) : _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			hi = _mm_castps_si128(h);
+			if (big) {
+				hi = _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(hi, 8));
+				hi = _mm_shufflelo_epi16(hi, _MM_SHUFFLE(2, 3, 0, 1));
+				hi = _mm_shufflehi_epi16(hi, _MM_SHUFFLE(2, 3, 0, 1));
+			}
+			lo = _mm_castps_si128(l);
+		}
+
+		template<endian byte_order>
+		inline __m128i low_byte(__m128i lo) {
+			if (byte_order != endian::native) return _mm_srli_epi32(lo, 24);
+			return _mm_and_si128(lo, _mm_set1_epi32(0xff));
+		}
+
+		inline size_t lane_sum(__m128i x) {
+			uint32_t v[4];
+			_mm_storeu_si128((__m128i *)v, x);
+			return (size_t)v[0] + v[1] + v[2] + v[3];
+		}
+
+		// low bytes of the 4 lanes.
+		inline void store_bytes(uint8_t *dp, __m128i x) {
+			x = _mm_packs_epi32(x, x);
+			x = _mm_packus_epi16(x, x);
+			uint32_t v = _mm_cvtsi128_si32(x);
+			std::memcpy(dp, &v, 4);
+		}
+
+		// lane counters are 32 bits; fold them into size_t this often.
+		constexpr size_t lane_block = size_t(1) << 24;
+
+		/*
+		 * single and double NaN codes, 4 at a time.  Returns how many
+		 * were done; the caller finishes the tail.  For double only the
+		 * high word decides unless it's exactly the infinity pattern.
+		 */
+		template<endian byte_order>
+		size_t nan_codes_sse2(format<4, byte_order>, const uint8_t *sp, uint8_t *codes, size_t count, size_t &n) {
+
+			const __m128i magnitude = _mm_set1_epi32(0x7fffffff);
+			const __m128i nan_exp = _mm_set1_epi32(single_traits::nan_exp);
+			const __m128i low_byte = _mm_set1_epi32(0xff);
+
+			size_t i = 0;
+			while (count - i >= 4) {
+				size_t end = i + std::min((count - i) & ~size_t(3), lane_block);
+				__m128i nans = _mm_setzero_si128();
+				for (; i < end; i += 4) {
+					__m128i w = load_lanes<4, byte_order>(sp + i * 4);
+					__m128i nan = _mm_cmpgt_epi32(_mm_and_si128(w, magnitude), nan_exp);
+					nans = _mm_sub_epi32(nans, nan);
+					store_bytes(codes + i, _mm_and_si128(_mm_and_si128(w, nan), low_byte));
+				}
+				n += lane_sum(nans);
+			}
+			return i;
+		}
+
+		template<endian byte_order>
+		size_t nan_codes_sse2(format<8, byte_order>, const uint8_t *sp, uint8_t *codes, size_t count, size_t &n) {
+
+			const __m128i magnitude = _mm_set1_epi32(0x7fffffff);
+			const __m128i nan_exp = _mm_set1_epi32(double_traits::nan_exp >> 32);
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t i = 0;
+			while (count - i >= 4) {
+				size_t end = i + std::min((count - i) & ~size_t(3), lane_block);
+				__m128i nans = _mm_setzero_si128();
+				for (; i < end; i += 4) {
+					__m128i hi, lo;
+					load_words<byte_order>(sp + i * 8, hi, lo);
+					hi = _mm_and_si128(hi, magnitude);
+					__m128i nan = _mm_or_si128(_mm_cmpgt_epi32(hi, nan_exp),
+						_mm_andnot_si128(_mm_cmpeq_epi32(lo, zero), _mm_cmpeq_epi32(hi, nan_exp)));
+					nans = _mm_sub_epi32(nans, nan);
+					store_bytes(codes + i, _mm_and_si128(low_byte<byte_order>(lo), nan));
+				}
+				n += lane_sum(nans);
+			}
+			return i;
+		}
+
+		/*
+		 * 4 extended values as 32-bit lanes: the sign/exponent word and
+		 * the significand's top (explicit bit) and bottom words, all left
+		 * in image byte order.  The tests only need zeros, the explicit
+		 * bit and the low byte, so the constants are swapped instead.
+		 * The fields are loaded in place (movq and movd), which keeps
+		 * the shuffles down; the sign/exponent word's 4 bytes stay
+		 * inside the image.
+		 */
+		template<class F>
+		struct extended_lanes {
+			typedef extended_layout<F> fl;
+			static constexpr bool swap = F::byte_order != endian::native;
+			static constexpr int sig_at = swap ? F::size - fl::sig - 8 : fl::sig;
+			static constexpr int sexp_at = swap ? F::size - fl::sexp - 2 : fl::sexp;
+			static constexpr int word_at = sexp_at >= 2 ? sexp_at - 2 : sexp_at;
+			static constexpr int32_t explicit_bit = swap ? 0x80 : INT32_MIN;
+			static constexpr int32_t nan_exp = (swap ? 0xff7f : 0x7fff) << (sexp_at - word_at) * 8;
+		};
+
+		template<class F>
+		inline void load_extended_lanes(const uint8_t *sp, __m128i &sexp, __m128i &top, __m128i &bottom) {
+			typedef extended_lanes<F> el;
+			auto sig = [&](int j) {
+				return _mm_loadl_epi64((const __m128i *)(sp + j * F::size + el::sig_at));
+			};
+			auto word = [&](int j) {
+				int32_t w;
+				std::memcpy(&w, sp + j * F::size + el::word_at, 4);
+				return _mm_cvtsi32_si128(w);
+			};
+			__m128 s0 = _mm_castsi128_ps(_mm_unpacklo_epi64(sig(0), sig(1)));
+			__m128 s1 = _mm_castsi128_ps(_mm_unpacklo_epi64(sig(2), sig(3)));
+			__m128i lo = _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i hi = _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1)));
+			sexp = _mm_unpacklo_epi64(_mm_unpacklo_epi32(word(0), word(1)), _mm_unpacklo_epi32(word(2), word(3)));
+			top = el::swap ? lo : hi;
+			bottom = el::swap ? hi : lo;
+		}
+
+		// SSE2 has no 64-bit compare; pair up the 32-bit ones.
+		inline __m128i cmpeq_epi64_sse2(__m128i a, __m128i b) {
+			__m128i eq = _mm_cmpeq_epi32(a, b);
+			return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		}
+
+		inline size_t lane_sum64(__m128i x) {
+			uint64_t v[2];
+			_mm_storeu_si128((__m128i *)v, x);
+			return v[0] + v[1];
+		}
+
+		// the low byte of the significand.
+		template<class F>
+		inline __m128i extended_code(__m128i bottom) {
+			return extended_lanes<F>::swap ? _mm_srli_epi32(bottom, 24) : _mm_and_si128(bottom, _mm_set1_epi32(0xff));
+		}
+
+		/*
+		 * the classify classes as lane masks: the top exponent is high
+		 * (infinity or NaN), and below it a clear explicit bit is low
+		 * (zero or subnormal).  NaNs ignore the explicit bit.
+		 */
+		template<class F>
+		inline void extended_masks(__m128i sexp, __m128i top, __m128i bottom, __m128i &high, __m128i &low, __m128i &zero, __m128i &nan) {
+			typedef extended_lanes<F> el;
+			const __m128i nan_exp = _mm_set1_epi32(el::nan_exp);
+			const __m128i explicit_bit = _mm_set1_epi32(el::explicit_bit);
+			const __m128i z = _mm_setzero_si128();
+			high = _mm_cmpeq_epi32(_mm_and_si128(sexp, nan_exp), nan_exp);
+			low = _mm_andnot_si128(high, _mm_cmpeq_epi32(_mm_and_si128(top, explicit_bit), z));
+			zero = _mm_andnot_si128(high, _mm_cmpeq_epi32(_mm_or_si128(top, bottom), z));
+			nan = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_or_si128(_mm_andnot_si128(explicit_bit, top), bottom), z), high);
+		}
+
+		template<class F>
+		size_t nan_codes_sse2(F, const uint8_t *sp, uint8_t *codes, size_t count, size_t &n) {
+
+			size_t i = 0;
+			while (count - i >= 4) {
+				size_t end = i + std::min((count - i) & ~size_t(3), lane_block);
+				__m128i nans = _mm_setzero_si128();
+				for (; i < end; i += 4) {
+					__m128i sexp, top, bottom, high, low, zero, nan;
+					load_extended_lanes<F>(sp + i * F::size, sexp, top, bottom);
+					extended_masks<F>(sexp, top, bottom, high, low, zero, nan);
+					nans = _mm_sub_epi32(nans, nan);
+					store_bytes(codes + i, _mm_and_si128(extended_code<F>(bottom), nan));
+				}
+				n += lane_sum(nans);
+			}
+			return i;
+		}
+	}
+#endif
+
+#ifdef SANE_HAVE_AVX2
+	namespace detail {
+
+		// pshufb control to reverse each size-byte lane.
+		template<size_t size>
+		inline __m256i lane_swap() {
+			return size == 4
+				? _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+				: _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+		}
+
+		template<size_t size, endian byte_order>
+		inline __m256i load_lanes256(const uint8_t *sp) {
+			__m256i x = _mm256_loadu_si256((const __m256i *)sp);
+			return byte_order == endian::native ? x : _mm256_shuffle_epi8(x, lane_swap<size>());
+		}
+
+		template<size_t size, endian byte_order>
+		inline void store_lanes256(uint8_t *dp, __m256i x) {
+			if (byte_order != endian::native) x = _mm256_shuffle_epi8(x, lane_swap<size>());
+			_mm256_storeu_si256((__m256i *)dp, x);
+		}
+
+		// 4 floats; the low half of the 8-lane control does.
+		template<endian byte_order>
+		inline __m128i load_float_lanes(const uint8_t *sp) {
+			__m128i x = _mm_loadu_si128((const __m128i *)sp);
+			return byte_order == endian::native ? x : _mm_shuffle_epi8(x, _mm256_castsi256_si128(lane_swap<4>()));
+		}
+
+		template<endian byte_order>
+		inline void store_float_lanes(uint8_t *dp, __m128i x) {
+			if (byte_order != endian::native) x = _mm_shuffle_epi8(x, _mm256_castsi256_si128(lane_swap<4>()));
+			_mm_storeu_si128((__m128i *)dp, x);
+		}
+
+		/*
+		 * load_extended_pair 4 at a time: one pshufb per two images puts
+		 * each significand in the low quadword (swapped) and the
+		 * sign/exponent word in the high one.
+		 */
+		template<class F>
+		inline __m256i extended_fields() {
+			typedef extended_layout<F> fl;
+			constexpr bool swap = F::byte_order != endian::native;
+			int8_t c[16];
+			for (int k = 0; k < 8; ++k) c[k] = swap ? F::size - fl::sig - 1 - k : fl::sig + k;
+			for (int k = 0; k < 2; ++k) c[8 + k] = swap ? F::size - fl::sexp - 1 - k : fl::sexp + k;
+			for (int k = 10; k < 16; ++k) c[k] = -128;
+			return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)c));
+		}
+
+		template<class F>
+		inline void load_extended_quad(const uint8_t *sp, __m256i fields, __m256i &sexp, __m256i &sig) {
+			auto pair = [&](const uint8_t *p) {
+				__m256i x = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p));
+				x = _mm256_inserti128_si256(x, _mm_loadu_si128((const __m128i *)(p + 2 * F::size)), 1);
+				return _mm256_shuffle_epi8(x, fields);
+			};
+			// images 0 and 2, 1 and 3, so the unpacks leave them in order.
+			__m256i a = pair(sp);
+			__m256i b = pair(sp + F::size);
+			sig = _mm256_unpacklo_epi64(a, b);
+			sexp = _mm256_unpackhi_epi64(a, b);
+		}
+
+		inline void extended_masks(__m256i sexp, __m256i sig, __m256i &high, __m256i &low, __m256i &zero, __m256i &nan) {
+			const __m256i nan_exp = _mm256_set1_epi64x(extended_traits::nan_exp);
+			const __m256i z = _mm256_setzero_si256();
+			high = _mm256_cmpeq_epi64(_mm256_and_si256(sexp, nan_exp), nan_exp);
+			low = _mm256_cmpeq_epi64(_mm256_or_si256(high, _mm256_cmpgt_epi64(z, sig)), z);
+			zero = _mm256_andnot_si256(high, _mm256_cmpeq_epi64(sig, z));
+			nan = _mm256_andnot_si256(_mm256_cmpeq_epi64(_mm256_and_si256(sig, _mm256_set1_epi64x(INT64_MAX)), z), high);
+		}
+
+		inline __m128i fold_lanes64(__m256i x) {
+			return _mm_add_epi64(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+		}
+
+		template<class F>
+		size_t nan_codes_avx2(F, const uint8_t *sp, uint8_t *codes, size_t count, size_t &n) {
+
+			constexpr size_t ahead = F::size < 16;
+			const __m256i fields = extended_fields<F>();
+			const __m256i low_bytes = _mm256_setr_epi8(0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+				0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+			__m256i nans = _mm256_setzero_si256();
+
+			size_t i = 0;
+			for (; count - i >= 4 + ahead; i += 4) {
+				__m256i sexp, sig, high, low, zero, nan;
+				load_extended_quad<F>(sp + i * F::size, fields, sexp, sig);
+				extended_masks(sexp, sig, high, low, zero, nan);
+				nans = _mm256_sub_epi64(nans, nan);
+				// each half's two low bytes to its bottom.
+				__m256i b = _mm256_shuffle_epi8(_mm256_and_si256(sig, nan), low_bytes);
+				uint32_t v = (uint16_t)_mm256_cvtsi256_si32(b) | (uint32_t)_mm_cvtsi128_si32(_mm256_extracti128_si256(b, 1)) << 16;
+				std::memcpy(codes + i, &v, 4);
+			}
+			n += lane_sum64(fold_lanes64(nans));
+			return i;
+		}
+	}
+#endif
+
+
+	/*
+	 * SANE NaN codes straight from the bit images, without a decode.
+	 * codes[i] is the low byte of the payload, or 0 if the value isn't
+	 * a NaN.  Returns the number of NaNs.  The loops are branch free.
+	 */
+
+	template<endian byte_order>
+	size_t nan_codes(format<4, byte_order>, const void *src, uint8_t *codes, size_t count) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t n = 0;
+		size_t i = 0;
+
+	#ifdef SANE_HAVE_SSE2
+		i = detail::nan_codes_sse2(format<4, byte_order>{}, sp, codes, count, n);
+		sp += i * 4;
+	#endif
+
+		for (; i < count; ++i, sp += 4) {
+			uint32_t w;
+			std::memcpy(&w, sp, 4);
+			reverse_bytes_if<4>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+			uint32_t nan = (w & ~single_traits::sign_bit) > single_traits::nan_exp;
+			codes[i] = w & -nan & 0xff;
+			n += nan;
+		}
+		return n;
+	}
+
+	template<endian byte_order>
+	size_t nan_codes(format<8, byte_order>, const void *src, uint8_t *codes, size_t count) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t n = 0;
+		size_t i = 0;
+
+	#ifdef SANE_HAVE_SSE2
+		i = detail::nan_codes_sse2(format<8, byte_order>{}, sp, codes, count, n);
+		sp += i * 8;
+	#endif
+
+		for (; i < count; ++i, sp += 8) {
+			uint64_t w;
+			std::memcpy(&w, sp, 8);
+			reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+			uint64_t nan = (w & ~double_traits::sign_bit) > double_traits::nan_exp;
+			codes[i] = w & -nan & 0xff;
+			n += nan;
+		}
+		return n;
+	}
+
+	template<class F>
+	typename std::enable_if<extended_layout<F>::value, size_t>::type
+	nan_codes(F f, const void *src, uint8_t *codes, size_t count) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t n = 0;
+		size_t i = 0;
+
+	#if defined(SANE_HAVE_AVX2)
+		i = detail::nan_codes_avx2(f, sp, codes, count, n);
+		sp += i * F::size;
+	#elif defined(SANE_HAVE_SSE2)
+		i = detail::nan_codes_sse2(f, sp, codes, count, n);
+		sp += i * F::size;
+	#endif
+
+		for (; i < count; ++i, sp += F::size) {
+			uint16_t sexp;
+			uint64_t sig;
+			load_extended(f, sp, sexp, sig);
+
+			// the explicit bit is ignored (68881 doesn't require it).
+			uint64_t nan = ((sexp & extended_traits::nan_exp) == extended_traits::nan_exp) & ((sig << 1) != 0);
+			codes[i] = sig & -nan & 0xff;
+			n += nan;
+		}
+		return n;
+	}
+
+	template<endian byte_order>
+	size_t nan_codes(format_quad<byte_order>, const void *src, uint8_t *codes, size_t count) {
+
+		constexpr bool little = endian::native == endian::little;
+
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t n = 0;
+
+		for (size_t i = 0; i < count; ++i, sp += 16) {
+			uint64_t w[2];
+			std::memcpy(w, sp, 16);
+			reverse_bytes_if<16>(w, std::integral_constant<bool, byte_order != endian::native>{});
+
+			uint64_t hi = w[little] & ~quad_traits::sign_bit;
+			uint64_t lo = w[!little];
+			uint64_t nan = (hi > quad_traits::nan_exp) | ((hi == quad_traits::nan_exp) & (lo != 0));
+			codes[i] = lo & -nan & 0xff;
+			n += nan;
+		}
+		return n;
+	}
+
+	// either half may be the NaN.
+	template<endian byte_order>
+	size_t nan_codes(format_double_double<byte_order>, const void *src, uint8_t *codes, size_t count) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t n = 0;
+
+		for (size_t i = 0; i < count; ++i, sp += 16) {
+			uint64_t w[2];
+			std::memcpy(w, sp, 16);
+			reverse_bytes_if<8>(w + 0, std::integral_constant<bool, byte_order != endian::native>{});
+			reverse_bytes_if<8>(w + 1, std::integral_constant<bool, byte_order != endian::native>{});
+
+			uint64_t hnan = (w[0] & ~double_traits::sign_bit) > double_traits::nan_exp;
+			uint64_t lnan = (w[1] & ~double_traits::sign_bit) > double_traits::nan_exp;
+			uint64_t hinf = (w[0] & ~double_traits::sign_bit) == double_traits::nan_exp;
+			lnan &= !hnan & !hinf;
+			codes[i] = ((w[0] & -hnan) | (w[1] & -lnan)) & 0xff;
+			n += hnan | lnan;
+		}
+		return n;
+	}
+
+
+	/*
+	 * class counts of encoded values, straight from the bit images.  The
+	 * classes are the ones fpclassify(info) returns.  NaNs are also
+	 * counted by SANE NaN code (the low byte of the payload).
+	 */
+	struct class_counts {
+		size_t zero = 0;
+		size_t subnormal = 0;
+		size_t normal = 0;
+		size_t infinite = 0;
+		size_t nan = 0;
+		size_t nan_code[256] = {};
+
+		class_counts &operator+=(const class_counts &rhs) {
+			zero += rhs.zero;
+			subnormal += rhs.subnormal;
+			normal += rhs.normal;
+			infinite += rhs.infinite;
+			nan += rhs.nan;
+			for (unsigned i = 0; i < 256; ++i) nan_code[i] += rhs.nan_code[i];
+			return *this;
+		}
+	};
+
+	namespace detail {
+
+		/*
+		 * single and double.  Normal numbers take one compare and are
+		 * counted by subtraction; the rest are sorted out with compares.
+		 */
+		template<class W, endian byte_order>
+		void classify_ieee(const void *src, size_t count, W nan_exp, W min_normal, class_counts &c) {
+
+			constexpr W mask = ~W(0) >> 1;
+
+			const uint8_t *sp = (const uint8_t *)src;
+			size_t zero = 0, low = 0, high = 0, nan = 0;
+
+			for (size_t i = 0; i < count; ++i, sp += sizeof(W)) {
+				W w;
+				std::memcpy(&w, sp, sizeof(W));
+				reverse_bytes_if<sizeof(W)>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+				W m = w & mask;
+				if (m - min_normal < nan_exp - min_normal) continue;
+				zero += m == 0;
+				low += m < min_normal;
+				high += m >= nan_exp;
+				if (m > nan_exp) {
+					++nan;
+					++c.nan_code[w & 0xff];
+				}
+			}
+
+			c.zero += zero;
+			c.subnormal += low - zero;
+			c.infinite += high - nan;
+			c.nan += nan;
+			c.normal += count - low - high;
+		}
+
+	#ifdef SANE_HAVE_SSE2
+		/*
+		 * the same counts 4 at a time, as lane counters.  NaNs are rare,
+		 * so their codes are picked out of the lanes behind a test.
+		 * Double compares the high words (signed is fine, the sign is
+		 * masked off) and looks at the low word only for zero and NaN.
+		 */
+		inline void add_nan_codes(__m128i codes, __m128i nan, class_counts &c) {
+			uint32_t v[4];
+			_mm_storeu_si128((__m128i *)v, codes);
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(nan));
+			for (int j = 0; j < 4; ++j)
+				if ((mask >> j) & 0x01) ++c.nan_code[v[j] & 0xff];
+		}
+
+		inline void add_lane_counts(size_t count, __m128i zeros, __m128i lows, __m128i highs, __m128i nans, class_counts &c) {
+			size_t zero = lane_sum(zeros);
+			size_t low = lane_sum(lows);
+			size_t high = lane_sum(highs);
+			size_t nan = lane_sum(nans);
+
+			c.zero += zero;
+			c.subnormal += low - zero;
+			c.infinite += high - nan;
+			c.nan += nan;
+			c.normal += count - low - high;
+		}
+
+		template<endian byte_order>
+		size_t classify_sse2(format<4, byte_order>, const uint8_t *sp, size_t count, class_counts &c) {
+
+			const __m128i magnitude = _mm_set1_epi32(0x7fffffff);
+			const __m128i min_normal = _mm_set1_epi32(1 << 23);
+			const __m128i nan_exp = _mm_set1_epi32(single_traits::nan_exp);
+			const __m128i below_inf = _mm_set1_epi32(single_traits::nan_exp - 1);
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t i = 0;
+			while (count - i >= 4) {
+				size_t start = i;
+				size_t end = i + std::min((count - i) & ~size_t(3), lane_block);
+				__m128i zeros = zero, lows = zero, highs = zero, nans = zero;
+				for (; i < end; i += 4) {
+					__m128i w = load_lanes<4, byte_order>(sp + i * 4);
+					__m128i m = _mm_and_si128(w, magnitude);
+					__m128i nan = _mm_cmpgt_epi32(m, nan_exp);
+					zeros = _mm_sub_epi32(zeros, _mm_cmpeq_epi32(m, zero));
+					lows = _mm_sub_epi32(lows, _mm_cmplt_epi32(m, min_normal));
+					highs = _mm_sub_epi32(highs, _mm_cmpgt_epi32(m, below_inf));
+					nans = _mm_sub_epi32(nans, nan);
+					if (_mm_movemask_epi8(nan)) add_nan_codes(w, nan, c);
+				}
+				add_lane_counts(end - start, zeros, lows, highs, nans, c);
+			}
+			return i;
+		}
+
+		template<endian byte_order>
+		size_t classify_sse2(format<8, byte_order>, const uint8_t *sp, size_t count, class_counts &c) {
+
+			const __m128i magnitude = _mm_set1_epi32(0x7fffffff);
+			const __m128i min_normal = _mm_set1_epi32(1 << 20);
+			const __m128i nan_exp = _mm_set1_epi32(double_traits::nan_exp >> 32);
+			const __m128i below_inf = _mm_set1_epi32((double_traits::nan_exp >> 32) - 1);
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t i = 0;
+			while (count - i >= 4) {
+				size_t start = i;
+				size_t end = i + std::min((count - i) & ~size_t(3), lane_block);
+				__m128i zeros = zero, lows = zero, highs = zero, nans = zero;
+				for (; i < end; i += 4) {
+					__m128i hi, lo;
+					load_words<byte_order>(sp + i * 8, hi, lo);
+					__m128i m = _mm_and_si128(hi, magnitude);
+					__m128i lo_zero = _mm_cmpeq_epi32(lo, zero);
+					__m128i nan = _mm_or_si128(_mm_cmpgt_epi32(m, nan_exp),
+						_mm_andnot_si128(lo_zero, _mm_cmpeq_epi32(m, nan_exp)));
+					zeros = _mm_sub_epi32(zeros, _mm_and_si128(lo_zero, _mm_cmpeq_epi32(m, zero)));
+					lows = _mm_sub_epi32(lows, _mm_cmplt_epi32(m, min_normal));
+					highs = _mm_sub_epi32(highs, _mm_cmpgt_epi32(m, below_inf));
+					nans = _mm_sub_epi32(nans, nan);
+					if (_mm_movemask_epi8(nan)) add_nan_codes(low_byte<byte_order>(lo), nan, c);
+				}
+				add_lane_counts(end - start, zeros, lows, highs, nans, c);
+			}
+			return i;
+		}
+
+		// add_lane_counts for 64-bit lanes.
+		inline void add_lane_counts64(size_t count, __m128i zeros, __m128i lows, __m128i highs, __m128i nans, class_counts &c) {
+			size_t zero = lane_sum64(zeros);
+			size_t low = lane_sum64(lows);
+			size_t high = lane_sum64(highs);
+			size_t nan = lane_sum64(nans);
+
+			c.zero += zero;
+			c.subnormal += low - zero;
+			c.infinite += high - nan;
+			c.nan += nan;
+			c.normal += count - low - high;
+		}
+
+		template<class F>
+		size_t classify_sse2(F, const uint8_t *sp, size_t count, class_counts &c) {
+
+			const __m128i z = _mm_setzero_si128();
+
+			size_t i = 0;
+			while (count - i >= 4) {
+				size_t start = i;
+				size_t end = i + std::min((count - i) & ~size_t(3), lane_block);
+				__m128i zeros = z, lows = z, highs = z, nans = z;
+				for (; i < end; i += 4) {
+					__m128i sexp, top, bottom, high, low, zero, nan;
+					load_extended_lanes<F>(sp + i * F::size, sexp, top, bottom);
+					extended_masks<F>(sexp, top, bottom, high, low, zero, nan);
+					zeros = _mm_sub_epi32(zeros, zero);
+					lows = _mm_sub_epi32(lows, low);
+					highs = _mm_sub_epi32(highs, high);
+					nans = _mm_sub_epi32(nans, nan);
+					if (_mm_movemask_epi8(nan)) add_nan_codes(extended_code<F>(bottom), nan, c);
+				}
+				add_lane_counts(end - start, zeros, lows, highs, nans, c);
+			}
+			return i;
+		}
+
+		// comp: 64-bit compares against 0 and the NaN image (in memory order, so there's no swap).
+		template<endian byte_order>
+		size_t classify_sse2(format_comp<byte_order>, const uint8_t *sp, size_t count, class_counts &c) {
+
+			const __m128i nan = _mm_set1_epi64x(byte_order == endian::native ? INT64_MIN : 0x80);
+			const __m128i zero = _mm_setzero_si128();
+			__m128i zeros = zero, nans = zero;
+
+			size_t i = 0;
+			for (; count - i >= 2; i += 2) {
+				__m128i w = _mm_loadu_si128((const __m128i *)(sp + i * 8));
+				zeros = _mm_sub_epi64(zeros, cmpeq_epi64_sse2(w, zero));
+				nans = _mm_sub_epi64(nans, cmpeq_epi64_sse2(w, nan));
+			}
+			size_t z = lane_sum64(zeros), n = lane_sum64(nans);
+			c.zero += z;
+			c.nan += n;
+			c.nan_code[NANCOMP] += n;
+			c.normal += i - z - n;
+			return i;
+		}
+	#endif
+
+	#ifdef SANE_HAVE_AVX2
+		// the SSE2 kernels, 4 at a time.
+		template<class F>
+		size_t classify_avx2(F, const uint8_t *sp, size_t count, class_counts &c) {
+
+			constexpr size_t ahead = F::size < 16;
+			const __m256i fields = extended_fields<F>();
+			const __m256i z = _mm256_setzero_si256();
+			__m256i zeros = z, lows = z, highs = z, nans = z;
+
+			size_t i = 0;
+			for (; count - i >= 4 + ahead; i += 4) {
+				__m256i sexp, sig, high, low, zero, nan;
+				load_extended_quad<F>(sp + i * F::size, fields, sexp, sig);
+				extended_masks(sexp, sig, high, low, zero, nan);
+				zeros = _mm256_sub_epi64(zeros, zero);
+				lows = _mm256_sub_epi64(lows, low);
+				highs = _mm256_sub_epi64(highs, high);
+				nans = _mm256_sub_epi64(nans, nan);
+				if (_mm256_movemask_epi8(nan)) {
+					alignas(32) uint64_t v[4];
+					_mm256_store_si256((__m256i *)v, sig);
+					int mask = _mm256_movemask_pd(_mm256_castsi256_pd(nan));
+					for (int j = 0; j < 4; ++j)
+						if ((mask >> j) & 0x01) ++c.nan_code[v[j] & 0xff];
+				}
+			}
+			add_lane_counts64(i, fold_lanes64(zeros), fold_lanes64(lows), fold_lanes64(highs), fold_lanes64(nans), c);
+			return i;
+		}
+
+		template<endian byte_order>
+		size_t classify_avx2(format_comp<byte_order>, const uint8_t *sp, size_t count, class_counts &c) {
+
+			const __m256i nan = _mm256_set1_epi64x(byte_order == endian::native ? INT64_MIN : 0x80);
+			const __m256i zero = _mm256_setzero_si256();
+			__m256i zeros = zero, nans = zero;
+
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256i w = _mm256_loadu_si256((const __m256i *)(sp + i * 8));
+				zeros = _mm256_sub_epi64(zeros, _mm256_cmpeq_epi64(w, zero));
+				nans = _mm256_sub_epi64(nans, _mm256_cmpeq_epi64(w, nan));
+			}
+			size_t z = lane_sum64(fold_lanes64(zeros)), n = lane_sum64(fold_lanes64(nans));
+			c.zero += z;
+			c.nan += n;
+			c.nan_code[NANCOMP] += n;
+			c.normal += i - z - n;
+			return i;
+		}
+	#endif
+	}
+
+	// adds to c.
+	template<endian byte_order>
+	void classify(format<4, byte_order>, const void *src, size_t count, class_counts &c) {
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t i = 0;
+	#ifdef SANE_HAVE_SSE2
+		i = detail::classify_sse2(format<4, byte_order>{}, sp, count, c);
+	#endif
+		detail::classify_ieee<uint32_t, byte_order>(sp + i * 4, count - i, single_traits::nan_exp, UINT32_C(1) << 23, c);
+	}
+
+	template<endian byte_order>
+	void classify(format<8, byte_order>, const void *src, size_t count, class_counts &c) {
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t i = 0;
+	#ifdef SANE_HAVE_SSE2
+		i = detail::classify_sse2(format<8, byte_order>{}, sp, count, c);
+	#endif
+		detail::classify_ieee<uint64_t, byte_order>(sp + i * 8, count - i, double_traits::nan_exp, UINT64_C(1) << 52, c);
+	}
+
+	// pseudo-denormals are normal, unnormals subnormal, as with info.
+	template<class F>
+	typename std::enable_if<extended_layout<F>::value>::type
+	classify(F f, const void *src, size_t count, class_counts &c) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t zero = 0, sub = 0, inf = 0, nan = 0;
+		size_t i = 0;
+
+	#if defined(SANE_HAVE_AVX2)
+		i = detail::classify_avx2(f, sp, count, c);
+		sp += i * F::size;
+	#elif defined(SANE_HAVE_SSE2)
+		i = detail::classify_sse2(f, sp, count, c);
+		sp += i * F::size;
+	#endif
+		size_t tail = count - i;
+
+		for (; i < count; ++i, sp += F::size) {
+			uint16_t sexp;
+			uint64_t sig;
+			load_extended(f, sp, sexp, sig);
+
+			unsigned e = sexp & extended_traits::nan_exp;
+			if ((sig >> 63) && e - 1 < extended_traits::nan_exp - 1u) continue;
+
+			if (e == extended_traits::nan_exp) {
+				if (sig << 1) {
+					++nan;
+					++c.nan_code[sig & 0xff];
+				}
+				else ++inf;
+			}
+			else if (sig >> 63) continue;
+			else if (sig) ++sub;
+			else ++zero;
+		}
+
+		c.zero += zero;
+		c.subnormal += sub;
+		c.infinite += inf;
+		c.nan += nan;
+		c.normal += tail - zero - sub - inf - nan;
+	}
+
+	// comp is zero, normal, or NaN.
+	template<endian byte_order>
+	void classify(format_comp<byte_order>, const void *src, size_t count, class_counts &c) {
+
+		const uint8_t *sp = (const uint8_t *)src;
+		size_t zero = 0, nan = 0;
+		size_t i = 0;
+
+	#if defined(SANE_HAVE_AVX2)
+		i = detail::classify_avx2(format_comp<byte_order>{}, sp, count, c);
+		sp += i * 8;
+	#elif defined(SANE_HAVE_SSE2)
+		i = detail::classify_sse2(format_comp<byte_order>{}, sp, count, c);
+		sp += i * 8;
+	#endif
+		size_t tail = count - i;
+
+		for (; i < count; ++i, sp += 8) {
+			uint64_t w;
+			std::memcpy(&w, sp, 8);
+			reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+			zero += w == 0;
+			nan += w == (UINT64_C(1) << 63);
+		}
+
+		c.zero += zero;
+		c.nan += nan;
+		c.nan_code[NANCOMP] += nan; // what comp NaNs convert to.
+		c.normal += tail - zero - nan;
+	}
+
+	template<class F>
+	class_counts classify(F f, const void *src, size_t count) {
+		class_counts c;
+		classify(f, src, count, c);
+		return c;
+	}
+
+
+	template<endian byte_order>
+	long double read_extended(format_68881<byte_order> f, const void *vp) {
+
+		constexpr size_t ldsize = sizeof(long double);
+		typedef long double return_type;
+
+		if (!long_double_is_x87) {
+			info fpi;
+			fpi.read(f, vp);
+
+			return (return_type)fpi;
+		} else {
+
+			typename std::aligned_storage<ldsize, alignof(return_type)>::type buffer[1];
+
+			std::memset(buffer, 0, ldsize);
+			transcode(f, vp, format<10, endian::native>{}, buffer, 1);
+			return *(return_type *)buffer;
+		}
+	}
+
+	template<endian byte_order>
+	void write_extended(long double x, format_68881<byte_order> f, void *vp) {
+
+		if (!long_double_is_x87) {
+			info fpi;
+			fpi.read(x);
+			fpi.write(f, vp);
+		} else {
+			transcode(format<10, endian::native>{}, &x, f, vp, 1);
+		}
+	}
 
 } // floating point.
 
 
-	inline int fpclassify(const floating_point::info &fpi) {
+	SANE_CONSTEXPR int fpclassify(const floating_point::info &fpi) {
 		if (fpi.nan) return FP_NAN;
 		if (fpi.inf) return FP_INFINITE;
 		if (fpi.sig == 0) return FP_ZERO;
 		return fpi.sig >> 63 ? FP_NORMAL : FP_SUBNORMAL;
 	}
 
-	inline int signbit(const floating_point::info &fpi) {
+	SANE_CONSTEXPR int signbit(const floating_point::info &fpi) {
 		return fpi.sign;
 	}
 
-	inline int isnan(const floating_point::info &fpi) {
+	SANE_CONSTEXPR int isnan(const floating_point::info &fpi) {
 		return fpi.nan;
 	}
 
-	inline int isinf(const floating_point::info &fpi) {
+	SANE_CONSTEXPR int isinf(const floating_point::info &fpi) {
 		return fpi.inf;
 	}
 
-	inline int isfinite(const floating_point::info &fpi) {
+	SANE_CONSTEXPR int isfinite(const floating_point::info &fpi) {
 		if (fpi.nan || fpi.inf) return false;
 		return true;
 	}
 
-	inline int isnormal(const floating_point::info &fpi) {
+	SANE_CONSTEXPR int isnormal(const floating_point::info &fpi) {
 		if (fpi.nan || fpi.inf) return false;
 		return fpi.sig >> 63;
 	}
 
-	inline floating_point::info abs(const floating_point::info &fpi) {
+	SANE_CONSTEXPR floating_point::info abs(const floating_point::info &fpi) {
 		floating_point::info tmp(fpi);
 		tmp.sign = 0;
 		return tmp;
@@ -0,0 +1,378 @@
+
+#ifndef __sane_hash_h__
+#define __sane_hash_h__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "floating_point.h"
+#include "sane.h"
+
+namespace SANE {
+
+namespace floating_point {
+
+	/*
+	 * canonical form of a value, independent of the format it came from.
+	 * Two values are numerically equal exactly when their canonical forms
+	 * are equal (and neither is a NaN), so the hash of the canonical form
+	 * is consistent with numeric equality across formats.
+	 *
+	 * finite: value = (hi:lo) * 2^(exp - 127), hi normalized.
+	 * nonbinary: a decimal that no binary format can hold exactly.
+	 *   value = (hi:lo) * 10^exp, (hi:lo) not a multiple of 10.
+	 * zero, infinite, nan: only the infinity keeps its sign.
+	 */
+	struct canonical {
+		enum { zero, finite, infinite, nan, nonbinary };
+
+		uint64_t hi = 0;
+		uint64_t lo = 0;
+		int32_t exp = 0;
+		uint8_t kind = zero;
+		bool sign = false;
+	};
+
+	inline bool operator==(const canonical &a, const canonical &b) {
+		return a.hi == b.hi && a.lo == b.lo && a.exp == b.exp && a.kind == b.kind && a.sign == b.sign;
+	}
+
+	inline bool operator!=(const canonical &a, const canonical &b) {
+		return !(a == b);
+	}
+
+
+	namespace detail {
+
+		// value = (hi:lo) * 2^(exp - 127), not necessarily normalized.
+		inline canonical make_finite(bool sign, int exp, uint64_t hi, uint64_t lo) {
+			canonical c;
+			if (!(hi | lo)) return c;
+
+			int shift = hi ? clz64(hi) : 64 + clz64(lo);
+			if (shift >= 64) {
+				hi = lo << (shift - 64);
+				lo = 0;
+			}
+			else if (shift) {
+				hi = (hi << shift) | (lo >> (64 - shift));
+				lo <<= shift;
+			}
+
+			c.hi = hi;
+			c.lo = lo;
+			c.exp = exp - shift;
+			c.kind = canonical::finite;
+			c.sign = sign;
+			return c;
+		}
+
+		inline canonical make_special(uint8_t kind, bool sign = false) {
+			canonical c;
+			c.kind = kind;
+			c.sign = kind == canonical::infinite && sign;
+			return c;
+		}
+
+		// murmur3 finalizer.
+		inline uint64_t fmix64(uint64_t h) {
+			h ^= h >> 33;
+			h *= UINT64_C(0xff51afd7ed558ccd);
+			h ^= h >> 33;
+			h *= UINT64_C(0xc4ceb9fe1a85ec53);
+			h ^= h >> 33;
+			return h;
+		}
+
+		// the hash of a canonical form, from its significand and tag words.
+		inline uint64_t hash_words(uint64_t hi, uint64_t lo, uint64_t tag) {
+			return fmix64(hi ^ (lo * UINT64_C(0x9e3779b97f4a7c15)) ^ (tag * UINT64_C(0xc2b2ae3d27d4eb4f)));
+		}
+
+		inline uint64_t hash_tag(int32_t exp, uint8_t kind, bool sign) {
+			return ((uint64_t)(uint32_t)exp << 8) | ((uint64_t)kind << 1) | sign;
+		}
+	}
+
+
+	// value = sig * 2^(exp - 63), as with info.
+	inline canonical canonicalize(const info &fpi) {
+		if (fpi.nan) return detail::make_special(canonical::nan);
+		if (fpi.inf) return detail::make_special(canonical::infinite, fpi.sign);
+		return detail::make_finite(fpi.sign, fpi.exp, fpi.sig, 0);
+	}
+
+	template<endian byte_order>
+	canonical canonicalize(format<4, byte_order>, const void *vp) {
+		using namespace single_traits;
+
+		uint32_t w;
+		std::memcpy(&w, vp, 4);
+		reverse_bytes_if<4>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+		bool sign = w >> 31;
+		int e = (w >> 23) & 0xff;
+		uint64_t frac = w & significand_mask;
+
+		if (e == 0xff) return detail::make_special(frac ? canonical::nan : canonical::infinite, sign);
+		if (e) frac |= significand_mask + 1;
+		else e = 1;
+		return detail::make_finite(sign, e - (int)bias - 23 + 63, frac, 0);
+	}
+
+	template<endian byte_order>
+	canonical canonicalize(format<8, byte_order>, const void *vp) {
+		using namespace double_traits;
+
+		uint64_t w;
+		std::memcpy(&w, vp, 8);
+		reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+		bool sign = w >> 63;
+		int e = (w >> 52) & 0x7ff;
+		uint64_t frac = w & significand_mask;
+
+		if (e == 0x7ff) return detail::make_special(frac ? canonical::nan : canonical::infinite, sign);
+		if (e) frac |= significand_mask + 1;
+		else e = 1;
+		return detail::make_finite(sign, e - (int)bias - 52 + 63, frac, 0);
+	}
+
+	template<class F>
+	typename std::enable_if<extended_layout<F>::value, canonical>::type
+	canonicalize(F f, const void *vp) {
+
+		uint16_t sexp;
+		uint64_t sig;
+		load_extended(f, vp, sexp, sig);
+
+		bool sign = sexp >> 15;
+		int e = sexp & extended_traits::nan_exp;
+
+		// the explicit bit is ignored for infinities and NaNs (68881 doesn't require it).
+		if (e == extended_traits::nan_exp)
+			return detail::make_special((sig << 1) ? canonical::nan : canonical::infinite, sign);
+		return detail::make_finite(sign, (e ? e : 1) - (int)extended_traits::bias, sig, 0);
+	}
+
+	template<endian byte_order>
+	canonical canonicalize(format_quad<byte_order>, const void *vp) {
+		using namespace quad_traits;
+
+		constexpr bool little = endian::native == endian::little;
+
+		uint64_t w[2];
+		std::memcpy(w, vp, 16);
+		reverse_bytes_if<16>(w, std::integral_constant<bool, byte_order != endian::native>{});
+
+		uint64_t hi = w[little];
+		uint64_t lo = w[!little];
+
+		bool sign = hi >> 63;
+		int e = (hi >> 48) & 0x7fff;
+		hi &= significand_mask;
+
+		if (e == 0x7fff) return detail::make_special((hi | lo) ? canonical::nan : canonical::infinite, sign);
+		if (e) hi |= significand_mask + 1;
+		else e = 1;
+		return detail::make_finite(sign, e - (int)bias - 112 + 127, hi, lo);
+	}
+
+	template<endian byte_order>
+	canonical canonicalize(format_comp<byte_order>, const void *vp) {
+
+		uint64_t w;
+		std::memcpy(&w, vp, 8);
+		reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+		if (w == UINT64_C(0x8000000000000000)) return detail::make_special(canonical::nan);
+		bool sign = w >> 63;
+		return detail::make_finite(sign, 63, sign ? -w : w, 0);
+	}
+
+
+	inline uint64_t hash(const canonical &c) {
+		return detail::hash_words(c.hi, c.lo, detail::hash_tag(c.exp, c.kind, c.sign));
+	}
+
+	// numeric equality: NaNs are unequal to everything, -0 == +0.
+	inline bool equal(const canonical &a, const canonical &b) {
+		return a.kind != canonical::nan && a == b;
+	}
+
+	template<class F>
+	uint64_t hash(F f, const void *vp) {
+		return hash(canonicalize(f, vp));
+	}
+
+	namespace detail {
+
+		/*
+		 * finite values that are already normalized, straight from the
+		 * bits: the canonical significand and tag words, without the
+		 * clz or any branch.  Returns 0 for the rest (zero, denormal,
+		 * inf, nan), which go through canonicalize().
+		 */
+		template<endian byte_order>
+		inline uint64_t normal_words(format<4, byte_order>, const uint8_t *sp, uint64_t &hi, uint64_t &lo, uint64_t &tag) {
+			uint32_t w;
+			std::memcpy(&w, sp, 4);
+			reverse_bytes_if<4>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+			int e = (w >> 23) & 0xff;
+			hi = (uint64_t)((w & single_traits::significand_mask) | (single_traits::significand_mask + 1)) << 40;
+			lo = 0;
+			tag = hash_tag(e - (int)single_traits::bias, canonical::finite, w >> 31);
+			return (unsigned)(e - 1) < 0xfe;
+		}
+
+		template<endian byte_order>
+		inline uint64_t normal_words(format<8, byte_order>, const uint8_t *sp, uint64_t &hi, uint64_t &lo, uint64_t &tag) {
+			uint64_t w;
+			std::memcpy(&w, sp, 8);
+			reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+			int e = (w >> 52) & 0x7ff;
+			hi = ((w & double_traits::significand_mask) | (double_traits::significand_mask + 1)) << 11;
+			lo = 0;
+			tag = hash_tag(e - (int)double_traits::bias, canonical::finite, w >> 63);
+			return (unsigned)(e - 1) < 0x7fe;
+		}
+
+		template<class F>
+		inline typename std::enable_if<extended_layout<F>::value, uint64_t>::type
+		normal_words(F f, const uint8_t *sp, uint64_t &hi, uint64_t &lo, uint64_t &tag) {
+			uint16_t sexp;
+			load_extended(f, sp, sexp, hi);
+
+			int e = sexp & extended_traits::nan_exp;
+			lo = 0;
+			tag = hash_tag(e - (int)extended_traits::bias, canonical::finite, sexp >> 15);
+			return (hi >> 63) & ((unsigned)(e - 1) < extended_traits::nan_exp - 1u);
+		}
+
+		template<endian byte_order>
+		inline uint64_t normal_words(format_quad<byte_order>, const uint8_t *sp, uint64_t &hi, uint64_t &lo, uint64_t &tag) {
+			constexpr bool little = endian::native == endian::little;
+
+			uint64_t w[2];
+			std::memcpy(w, sp, 16);
+			reverse_bytes_if<16>(w, std::integral_constant<bool, byte_order != endian::native>{});
+
+			int e = (w[little] >> 48) & 0x7fff;
+			uint64_t h = (w[little] & quad_traits::significand_mask) | (quad_traits::significand_mask + 1);
+			hi = (h << 15) | (w[!little] >> 49);
+			lo = w[!little] << 15;
+			tag = hash_tag(e - (int)quad_traits::bias, canonical::finite, w[little] >> 63);
+			return (unsigned)(e - 1) < 0x7ffe;
+		}
+
+		template<endian byte_order>
+		inline uint64_t normal_words(format_comp<byte_order>, const uint8_t *sp, uint64_t &hi, uint64_t &lo, uint64_t &tag) {
+			uint64_t w;
+			std::memcpy(&w, sp, 8);
+			reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+			uint64_t sign = w >> 63;
+			uint64_t m = sign ? -w : w;
+			int shift = clz64(m | 1);
+			hi = m << shift;
+			lo = 0;
+			tag = hash_tag(63 - shift, canonical::finite, sign);
+			return (w != 0) & (w != UINT64_C(0x8000000000000000));
+		}
+
+		/*
+		 * hash_words() over arrays.  There's no 64-bit multiply before
+		 * AVX-512, so the vector versions build it from 32 x 32 -> 64
+		 * multiplies; with AVX2's 4 lanes that still beats the scalar
+		 * imul chain.
+		 */
+	#ifdef SANE_HAVE_AVX2
+		inline __m256i mul64_lanes(__m256i a, __m256i k) {
+			__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), k), _mm256_mul_epu32(a, _mm256_srli_epi64(k, 32)));
+			return _mm256_add_epi64(_mm256_mul_epu32(a, k), _mm256_slli_epi64(cross, 32));
+		}
+
+		inline __m256i fmix64_lanes(__m256i h) {
+			h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+			h = mul64_lanes(h, _mm256_set1_epi64x(UINT64_C(0xff51afd7ed558ccd)));
+			h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+			h = mul64_lanes(h, _mm256_set1_epi64x(UINT64_C(0xc4ceb9fe1a85ec53)));
+			return _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+		}
+	#endif
+
+		// lo is only ever non-zero for binary128.
+		template<bool wide>
+		inline void hash_words(const uint64_t *hi, const uint64_t *lo, const uint64_t *tag, uint64_t *out, size_t count) {
+			size_t i = 0;
+		#ifdef SANE_HAVE_AVX2
+			const __m256i lo_mul = _mm256_set1_epi64x(UINT64_C(0x9e3779b97f4a7c15));
+			const __m256i tag_mul = _mm256_set1_epi64x(UINT64_C(0xc2b2ae3d27d4eb4f));
+			for (; count - i >= 4; i += 4) {
+				__m256i h = _mm256_loadu_si256((const __m256i *)(hi + i));
+				if (wide) h = _mm256_xor_si256(h, mul64_lanes(_mm256_loadu_si256((const __m256i *)(lo + i)), lo_mul));
+				h = _mm256_xor_si256(h, mul64_lanes(_mm256_loadu_si256((const __m256i *)(tag + i)), tag_mul));
+				_mm256_storeu_si256((__m256i *)(out + i), fmix64_lanes(h));
+			}
+		#endif
+			for (; i < count; ++i) out[i] = hash_words(hi[i], wide ? lo[i] : 0, tag[i]);
+		}
+	}
+
+	/*
+	 * batch hash.  A block is decoded branch free into significand and
+	 * tag words, hashed by the kernel above, and the few values that
+	 * aren't finite normals are redone through canonicalize().
+	 */
+	template<class F>
+	void hash(F f, const void *src, uint64_t *out, size_t count) {
+
+		constexpr size_t block = 64;
+		const uint8_t *sp = (const uint8_t *)src;
+
+		for (size_t base = 0; base < count; base += block) {
+
+			size_t n = count - base < block ? count - base : block;
+			uint64_t hi[block];
+			uint64_t lo[block];
+			uint64_t tag[block];
+			uint8_t slow[block];
+			uint8_t any = 0;
+
+			for (size_t i = 0; i < n; ++i) {
+				slow[i] = !detail::normal_words(f, sp + (base + i) * F::size, hi[i], lo[i], tag[i]);
+				any |= slow[i];
+			}
+
+			detail::hash_words<std::is_same<F, format_quad<F::byte_order>>::value>(hi, lo, tag, out + base, n);
+
+			if (!any) continue;
+			for (size_t i = 0; i < n; ++i)
+				if (slow[i]) out[base + i] = hash(canonicalize(f, sp + (base + i) * F::size));
+		}
+	}
+
+	template<class A, class B>
+	bool equal(A a, const void *ap, B b, const void *bp) {
+		return equal(canonicalize(a, ap), canonicalize(b, bp));
+	}
+
+} // floating_point
+
+
+	/*
+	 * decimal records, without going through dec2x.  Invalid digit
+	 * strings are NaNs, as with dec2x.
+	 */
+	floating_point::canonical canonicalize(const decimal &d);
+
+	inline uint64_t hash(const decimal &d) {
+		return floating_point::hash(canonicalize(d));
+	}
+
+}
+
+#endif
@@ -0,0 +1,371 @@
+
+#ifndef __sane_info_batch_h__
+#define __sane_info_batch_h__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "floating_point.h"
+
+namespace SANE {
+
+namespace floating_point {
+
+	/*
+	 * structure-of-arrays version of info.
+	 * flags are stored as bitsets (64 per word), exponents and significands
+	 * in separate arrays so they can be processed in bulk.
+	 */
+	class info_batch {
+	public:
+
+		typedef std::vector<uint64_t> bitset;
+
+		bitset sign;
+		bitset one;
+		bitset nan;
+		bitset inf;
+		bitset signaling;
+
+		std::vector<int> exp;
+		std::vector<uint64_t> sig;
+
+
+		info_batch() = default;
+		explicit info_batch(size_t n) { resize(n); }
+
+		size_t size() const { return sig.size(); }
+
+		void resize(size_t n) {
+			size_t words = (n + 63) / 64;
+			sign.resize(words);
+			one.resize(words);
+			nan.resize(words);
+			inf.resize(words);
+			signaling.resize(words);
+			exp.resize(n);
+			sig.resize(n);
+		}
+
+		static bool test(const bitset &bits, size_t i) {
+			return (bits[i >> 6] >> (i & 63)) & 0x01;
+		}
+
+		static void assign(bitset &bits, size_t i, bool value) {
+			uint64_t mask = UINT64_C(1) << (i & 63);
+			uint64_t &w = bits[i >> 6];
+			w = (w & ~mask) | (-(uint64_t)value & mask);
+		}
+
+
+		info get(size_t i) const {
+			info fpi;
+			fpi.sign = test(sign, i);
+			fpi.one = test(one, i);
+			fpi.nan = test(nan, i);
+			fpi.inf = test(inf, i);
+			fpi.signaling = test(signaling, i);
+			fpi.exp = exp[i];
+			fpi.sig = sig[i];
+			return fpi;
+		}
+
+		void set(size_t i, const info &fpi) {
+			assign(sign, i, fpi.sign);
+			assign(one, i, fpi.one);
+			assign(nan, i, fpi.nan);
+			assign(inf, i, fpi.inf);
+			assign(signaling, i, fpi.signaling);
+			exp[i] = fpi.exp;
+			sig[i] = fpi.sig;
+		}
+
+
+		/*
+		 * decode count values of format f.  single, double and the
+		 * extended layouts are decoded field by field straight from the
+		 * words (the same results as info::read), 64 values per bitset
+		 * word.  A block of normal numbers takes one pass with no
+		 * per-value tests; other blocks take a second, general pass.
+		 * Other formats go through info.
+		 */
+		template<endian byte_order>
+		void read(format<4, byte_order>, const void *vp, size_t count) {
+			read_binary<uint32_t, single_traits::significand_bits, single_traits::bias, single_traits::min_exp, byte_order>(vp, count);
+		}
+
+		template<endian byte_order>
+		void read(format<8, byte_order>, const void *vp, size_t count) {
+			read_binary<uint64_t, double_traits::significand_bits, double_traits::bias, double_traits::min_exp, byte_order>(vp, count);
+		}
+
+		template<class F>
+		typename std::enable_if<extended_layout<F>::value>::type
+		read(F f, const void *vp, size_t count) {
+
+			using namespace extended_traits;
+			constexpr uint64_t m68881 = std::is_same<F, format_68881<F::byte_order>>::value;
+
+			const uint8_t *cp = (const uint8_t *)vp;
+
+			resize(count);
+			for (size_t base = 0; base < count; base += 64, cp += 64 * F::size) {
+				size_t n = std::min<size_t>(count - base, 64);
+				int *ep = exp.data() + base;
+				uint64_t *gp = sig.data() + base;
+
+				// the common case, a block of normal numbers.
+				uint64_t s = 0, odd = 0;
+				for (size_t j = 0; j < n; ++j) {
+					uint16_t sexp;
+					uint64_t m;
+					load_extended(f, cp + j * F::size, sexp, m);
+					unsigned e = sexp & nan_exp;
+					odd |= (e - 1 >= nan_exp - 1u) | !(m >> 63);
+					s |= (uint64_t)(sexp >> 15) << j;
+					ep[j] = (int)e - (int)bias;
+					gp[j] = m;
+				}
+				if (!odd) {
+					store_flags(base, s, ~UINT64_C(0) >> (64 - n), 0, 0, 0);
+					continue;
+				}
+
+				uint64_t o = 0, na = 0, in = 0, sn = 0;
+				for (size_t j = 0; j < n; ++j) {
+					uint16_t sexp;
+					uint64_t m;
+					load_extended(f, cp + j * F::size, sexp, m);
+
+					int e = sexp & nan_exp;
+					uint64_t frac = m & significand_mask;
+					uint64_t special = e == nan_exp;
+					uint64_t isnan = special & (frac != 0);
+
+					// 68881 infinities and NaNs don't need the explicit bit (see transcode).
+					o |= ((m >> 63) | (special & m68881)) << j;
+					na |= isnan << j;
+					in |= (special & (frac == 0)) << j;
+					sn |= (isnan & ((frac & quiet_nan) == 0)) << j;
+					int x = e ? e - (int)bias : -(int)(m != 0) & min_exp;
+					ep[j] = x & ((int)special - 1);
+					gp[j] = special ? frac & (quiet_nan - 1) : m;
+				}
+				store_flags(base, s, o, na, in, sn);
+			}
+		}
+
+		template<class F>
+		typename std::enable_if<!extended_layout<F>::value>::type
+		read(F f, const void *vp, size_t count) {
+
+			const uint8_t *cp = (const uint8_t *)vp;
+
+			resize(count);
+			for (size_t i = 0; i < count; ++i, cp += F::size) {
+				info fpi;
+				fpi.read(f, cp);
+				set(i, fpi);
+			}
+		}
+
+		/*
+		 * encode all values as format f.  Values that fit the format
+		 * exactly (everything read from it) are packed straight from the
+		 * fields; the rest are rounded by info.
+		 */
+		template<endian byte_order>
+		void write(format<4, byte_order> f, void *vp) const {
+			write_binary<uint32_t, single_traits::significand_bits, single_traits::bias, single_traits::min_exp, single_traits::max_exp>(f, vp);
+		}
+
+		template<endian byte_order>
+		void write(format<8, byte_order> f, void *vp) const {
+			write_binary<uint64_t, double_traits::significand_bits, double_traits::bias, double_traits::min_exp, double_traits::max_exp>(f, vp);
+		}
+
+		template<class F>
+		typename std::enable_if<extended_layout<F>::value>::type
+		write(F f, void *vp) const {
+
+			using namespace extended_traits;
+
+			uint8_t *cp = (uint8_t *)vp;
+
+			for (size_t i = 0, n = size(); i < n; ++i, cp += F::size) {
+				int e = exp[i];
+				uint64_t m = sig[i];
+				bool special = test(nan, i) | test(inf, i);
+				// normal, or denormal at min_exp.
+				if (!special && (m >> 63 ? e - min_exp <= max_exp - min_exp : e == min_exp || !m)) {
+					uint16_t sexp = (test(sign, i) << 15) | (m >> 63 ? e + (int)bias : 0);
+					store_extended(f, cp, sexp, m);
+				}
+				else get(i).write(f, cp);
+			}
+		}
+
+		template<class F>
+		typename std::enable_if<!extended_layout<F>::value>::type
+		write(F f, void *vp) const {
+
+			uint8_t *cp = (uint8_t *)vp;
+
+			for (size_t i = 0, n = size(); i < n; ++i, cp += F::size) {
+				get(i).write(f, cp);
+			}
+		}
+
+	private:
+
+		void store_flags(size_t base, uint64_t s, uint64_t o, uint64_t na, uint64_t in, uint64_t sn) {
+			size_t w = base >> 6;
+			sign[w] = s;
+			one[w] = o;
+			nan[w] = na;
+			inf[w] = in;
+			signaling[w] = sn;
+		}
+
+		// as info::unpack_single/unpack_double, a block at a time.
+		template<class W, int significand_bits, int bias, int min_exp, endian byte_order>
+		void read_binary(const void *vp, size_t count) {
+
+			constexpr int bits = sizeof(W) * 8;
+			constexpr W significand_mask = (W(1) << significand_bits) - 1;
+			constexpr W quiet_nan = W(1) << (significand_bits - 1);
+			constexpr W emax = (W(1) << (bits - 1 - significand_bits)) - 1;
+
+			const uint8_t *cp = (const uint8_t *)vp;
+			auto load = [](const uint8_t *p) {
+				W w;
+				std::memcpy(&w, p, sizeof(W));
+				reverse_bytes_if<sizeof(W)>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+				return w;
+			};
+
+			resize(count);
+			for (size_t base = 0; base < count; base += 64, cp += 64 * sizeof(W)) {
+				size_t n = std::min<size_t>(count - base, 64);
+				int *ep = exp.data() + base;
+				uint64_t *gp = sig.data() + base;
+
+				// the common case, a block of normal numbers.
+				uint64_t s = 0;
+				W odd = 0;
+				for (size_t j = 0; j < n; ++j) {
+					W w = load(cp + j * sizeof(W));
+					W e = (w >> significand_bits) & emax;
+					odd |= e - 1 >= emax - 1;
+					s |= (uint64_t)(w >> (bits - 1)) << j;
+					ep[j] = (int)e - bias;
+					gp[j] = ((uint64_t)w << (63 - significand_bits)) | (UINT64_C(1) << 63);
+				}
+				if (!odd) {
+					store_flags(base, s, ~UINT64_C(0) >> (64 - n), 0, 0, 0);
+					continue;
+				}
+
+				uint64_t o = 0, na = 0, in = 0, sn = 0;
+				for (size_t j = 0; j < n; ++j) {
+					W w = load(cp + j * sizeof(W));
+					W e = (w >> significand_bits) & emax;
+					W frac = w & significand_mask;
+					uint64_t special = e == emax;
+					uint64_t normal = (e != 0) & !special;
+					uint64_t isnan = special & (frac != 0);
+
+					o |= normal << j;
+					na |= isnan << j;
+					in |= (special & (frac == 0)) << j;
+					sn |= (isnan & ((frac & quiet_nan) == 0)) << j;
+					int x = e ? (int)e - bias : -(int)(frac != 0) & min_exp;
+					ep[j] = x & ((int)special - 1);
+					gp[j] = special ? (uint64_t)(frac & (quiet_nan - 1)) : ((uint64_t)frac << (63 - significand_bits)) | (normal << 63);
+				}
+				store_flags(base, s, o, na, in, sn);
+			}
+		}
+
+		template<class W, int significand_bits, int bias, int min_exp, int max_exp, class F>
+		void write_binary(F f, void *vp) const {
+
+			constexpr int shift = 63 - significand_bits;
+			constexpr uint64_t lost = (UINT64_C(1) << shift) - 1;
+
+			uint8_t *cp = (uint8_t *)vp;
+
+			for (size_t i = 0, n = size(); i < n; ++i, cp += sizeof(W)) {
+				int e = exp[i];
+				uint64_t m = sig[i];
+				bool special = test(nan, i) | test(inf, i);
+				// exact normals (and zeros / denormals at min_exp) pack without rounding.
+				bool exact = !special && !(m & lost) && (m >> 63 ? e - min_exp <= max_exp - min_exp : e == min_exp || !m);
+				if (exact) {
+					W w = ((W)test(sign, i) << (sizeof(W) * 8 - 1))
+						| ((W)(m >> 63 ? e + bias : 0) << significand_bits)
+						| (W)((m << 1) >> (shift + 1));
+					reverse_bytes_if<sizeof(W)>(&w, std::integral_constant<bool, F::byte_order != endian::native>{});
+					std::memcpy(cp, &w, sizeof(W));
+				}
+				else get(i).write(f, cp);
+			}
+		}
+	};
+
+} // floating_point
+
+
+	/*
+	 * batch classification.  out must have room for batch.size() entries.
+	 */
+	inline void fpclassify(const floating_point::info_batch &b, int *out) {
+
+		typedef floating_point::info_batch ib;
+
+		for (size_t i = 0, n = b.size(); i < n; ++i) {
+			uint64_t sig = b.sig[i];
+			int c = sig >> 63 ? FP_NORMAL : FP_SUBNORMAL;
+			c = sig == 0 ? FP_ZERO : c;
+			c = ib::test(b.inf, i) ? FP_INFINITE : c;
+			c = ib::test(b.nan, i) ? FP_NAN : c;
+			out[i] = c;
+		}
+	}
+
+	// bitset results; bits past size() are 0.
+	inline floating_point::info_batch::bitset signbit(const floating_point::info_batch &b) {
+		return b.sign;
+	}
+
+	inline floating_point::info_batch::bitset isnan(const floating_point::info_batch &b) {
+		return b.nan;
+	}
+
+	inline floating_point::info_batch::bitset isinf(const floating_point::info_batch &b) {
+		return b.inf;
+	}
+
+	inline floating_point::info_batch::bitset isfinite(const floating_point::info_batch &b) {
+		floating_point::info_batch::bitset tmp(b.nan.size());
+		size_t n = b.size();
+		for (size_t i = 0; i < tmp.size(); ++i)
+			tmp[i] = ~(b.nan[i] | b.inf[i]);
+		// clear the unused bits.
+		if (n & 63) tmp.back() &= (UINT64_C(1) << (n & 63)) - 1;
+		return tmp;
+	}
+
+	inline floating_point::info_batch abs(const floating_point::info_batch &b) {
+		floating_point::info_batch tmp(b);
+		for (auto &w : tmp.sign) w = 0;
+		return tmp;
+	}
+
+}
+
+#endif
@@ -0,0 +1,380 @@
+
+#ifndef __sane_integer_h__
+#define __sane_integer_h__
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+#include "floating_point.h"
+#include "comp.h" // detail::load_word, store_word, round_magnitude, unpack_binary
+#include "environment.h"
+
+namespace SANE {
+
+namespace floating_point {
+
+	/*
+	 * INTEGER and LONGINT conversions.  As with comp, SANE rounds to
+	 * integer in the rounding direction; NaNs, infinities and anything
+	 * that rounds out of range are invalid and give the most negative
+	 * value (0x8000, 0x80000000).  The direction is the environment's
+	 * unless one is given; INVALID and INEXACT are signaled once per
+	 * call.  Integers to extended and double are exact; LONGINT to float
+	 * rounds in the direction too (INEXACT).  With AVX2 there are
+	 * explicit kernels, as for comp.
+	 */
+
+	namespace detail {
+
+		template<size_t size> struct integer_type;
+		template<> struct integer_type<2> { typedef int16_t type; typedef uint16_t word; };
+		template<> struct integer_type<4> { typedef int32_t type; typedef uint32_t word; };
+
+		/*
+		 * (-1)^sign * sig * 2^(e - 63) rounded to an integer of size
+		 * bytes.  e > 62 is out of range for any size, which covers
+		 * infinities and NaNs.  Branch free; invalid and inexact
+		 * accumulate (non-zero if the exception happened).
+		 */
+		template<size_t size>
+		typename integer_type<size>::word round_integer(bool sign, int e, uint64_t sig, integer_rounding r, uint64_t &invalid, uint64_t &inexact) {
+
+			typedef typename integer_type<size>::word W;
+			constexpr uint64_t limit = UINT64_C(1) << (size * 8 - 1);
+
+			uint64_t f;
+			uint64_t m = round_magnitude(sign, e, sig, r, f);
+			uint64_t s = -(uint64_t)sign;
+			uint64_t ok = -(uint64_t)((e <= 62) & (m < limit + sign));
+			invalid |= ~ok;
+			inexact |= f & ok;
+			return (W)((((m ^ s) - s) & ok) | (limit & ~ok));
+		}
+
+		// exact.
+		template<class T>
+		T integer_to_binary(int32_t v, integer_rounding, uint64_t &, std::false_type) {
+			return static_cast<T>(v);
+		}
+
+		/*
+		 * LONGINT -> float: the magnitude rounded to 24 bits (q, in
+		 * [2^23, 2^24]) by round_magnitude, then scaled back, which is
+		 * exact.
+		 */
+		template<class T>
+		T integer_to_binary(int32_t v, integer_rounding r, uint64_t &inexact, std::true_type) {
+			uint64_t s = -(uint64_t)(v < 0);
+			uint64_t m = ((uint64_t)(int64_t)v ^ s) - s;
+			int shift = clz64(m | 1);
+			uint64_t f;
+			uint64_t q = round_magnitude(v < 0, 23, m << shift, r, f);
+			inexact |= f;
+			T x = (T)(int64_t)q * bit_cast<T>((uint32_t)(127 + 40 - shift) << 23);
+			return v < 0 ? -x : x;
+		}
+
+	#ifdef SANE_HAVE_AVX2
+		// 4 INTEGERs or LONGINTs as 32-bit lanes, and back (INTEGERs saturate, they're in range).
+		template<size_t size, endian byte_order>
+		inline __m128i load_integer_lanes(const uint8_t *sp) {
+			if (size == 4) return load_float_lanes<byte_order>(sp);
+			__m128i x = _mm_loadl_epi64((const __m128i *)sp);
+			if (byte_order != endian::native) x = _mm_shuffle_epi8(x, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+			return _mm_cvtepi16_epi32(x);
+		}
+
+		template<size_t size, endian byte_order>
+		inline void store_integer_lanes(uint8_t *dp, __m128i x) {
+			if (size == 4) return store_float_lanes<byte_order>(dp, x);
+			x = _mm_packs_epi32(x, x);
+			if (byte_order != endian::native) x = _mm_shuffle_epi8(x, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+			_mm_storel_epi64((__m128i *)dp, x);
+		}
+
+		// the low 32 bits of each 64-bit lane.
+		inline __m128i low_words(__m256i x) {
+			return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+		}
+
+		// as binary_to_comp_avx2: rounded by mode, out of range is -limit.
+		template<int mode, class F, size_t size, endian byte_order>
+		size_t binary_to_integer_avx2(const uint8_t *sp, uint8_t *dp, size_t count, unsigned &flags) {
+			const __m256d limit = _mm256_set1_pd((double)(UINT64_C(1) << (size * 8 - 1)));
+			const __m256d low = _mm256_sub_pd(_mm256_setzero_pd(), limit);
+			__m256i valid = _mm256_set1_epi64x(-1), inexact = _mm256_setzero_si256();
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256d x = load_double_lanes(F{}, sp + i * F::size);
+				__m256d t = _mm256_round_pd(x, mode | _MM_FROUND_NO_EXC);
+				__m256d ok = _mm256_and_pd(_mm256_cmp_pd(t, limit, _CMP_LT_OQ), _mm256_cmp_pd(t, low, _CMP_GE_OQ));
+				valid = _mm256_and_si256(valid, _mm256_castpd_si256(ok));
+				inexact = _mm256_or_si256(inexact, _mm256_castpd_si256(_mm256_and_pd(ok, _mm256_cmp_pd(t, x, _CMP_NEQ_UQ))));
+				store_integer_lanes<size, byte_order>(dp + i * size, _mm256_cvtpd_epi32(_mm256_blendv_pd(low, t, ok)));
+			}
+			flags |= (_mm256_movemask_epi8(valid) != -1 ? INVALID : 0) | (_mm256_movemask_epi8(inexact) ? INEXACT : 0);
+			return i;
+		}
+
+		template<size_t fsize, endian fp_order, size_t size, endian byte_order>
+		size_t transcode_avx2(format<fsize, fp_order>, const uint8_t *sp, format_integer<size, byte_order>, uint8_t *dp, size_t count, rounding_direction rd, unsigned &flags) {
+			typedef format<fsize, fp_order> F;
+			switch (rd) {
+				case UPWARD: return binary_to_integer_avx2<_MM_FROUND_TO_POS_INF, F, size, byte_order>(sp, dp, count, flags);
+				case DOWNWARD: return binary_to_integer_avx2<_MM_FROUND_TO_NEG_INF, F, size, byte_order>(sp, dp, count, flags);
+				case TOWARDZERO: return binary_to_integer_avx2<_MM_FROUND_TO_ZERO, F, size, byte_order>(sp, dp, count, flags);
+				default: return binary_to_integer_avx2<_MM_FROUND_TO_NEAREST_INT, F, size, byte_order>(sp, dp, count, flags);
+			}
+		}
+
+		// round_integer, 4 lanes at a time.
+		template<class From, size_t size, endian byte_order>
+		size_t transcode_avx2(From, const uint8_t *sp, format_integer<size, byte_order>, uint8_t *dp, size_t count, integer_rounding r, unsigned &flags) {
+			constexpr size_t ahead = From::size < 16;
+			const __m256i fields = extended_fields<From>();
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i limit = _mm256_set1_epi64x(INT64_C(1) << (size * 8 - 1));
+			__m256i invalid = zero, fraction = zero;
+			size_t i = 0;
+			for (; count - i >= 4 + ahead; i += 4) {
+				__m256i sexp, sig, e, s, frac;
+				load_extended_quad<From>(sp + i * From::size, fields, sexp, sig);
+				__m256i m = round_magnitude_lanes(sexp, sig, r, e, s, frac);
+				// m < limit + sign; it's 2^63 when it rounds up out of range.
+				__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(e, _mm256_set1_epi64x(62)), _mm256_cmpgt_epi64(zero, m));
+				bad = _mm256_or_si256(bad, _mm256_cmpgt_epi64(_mm256_add_epi64(m, s), _mm256_sub_epi64(limit, _mm256_set1_epi64x(1))));
+				__m256i w = _mm256_sub_epi64(_mm256_xor_si256(m, s), s);
+				invalid = _mm256_or_si256(invalid, bad);
+				fraction = _mm256_or_si256(fraction, _mm256_andnot_si256(bad, frac));
+				w = _mm256_blendv_epi8(w, _mm256_sub_epi64(zero, limit), bad);
+				store_integer_lanes<size, byte_order>(dp + i * size, low_words(w));
+			}
+			flags |= (_mm256_movemask_epi8(invalid) ? INVALID : 0) | (_mm256_testz_si256(fraction, fraction) ? 0 : INEXACT);
+			return i;
+		}
+
+		// exact as doubles, whose fields widen to extended; the images are stored a lane at a time.
+		template<size_t size, endian byte_order, class To>
+		size_t transcode_avx2(format_integer<size, byte_order>, const uint8_t *sp, To t, uint8_t *dp, size_t count) {
+			const __m256i zero = _mm256_setzero_si256();
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256i b = _mm256_castpd_si256(_mm256_cvtepi32_pd(load_integer_lanes<size, byte_order>(sp + i * size)));
+				__m256i eb = _mm256_srli_epi64(_mm256_slli_epi64(b, 1), 53);
+				__m256i is_zero = _mm256_cmpeq_epi64(eb, zero);
+				__m256i sig = _mm256_or_si256(_mm256_slli_epi64(b, 11), _mm256_set1_epi64x(INT64_MIN));
+				__m256i sexp = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(b, 48), _mm256_set1_epi64x(0x8000)), _mm256_add_epi64(eb, _mm256_set1_epi64x((int64_t)extended_traits::bias - 1023)));
+				alignas(32) uint64_t sigs[4], sexps[4];
+				_mm256_store_si256((__m256i *)sigs, _mm256_andnot_si256(is_zero, sig));
+				_mm256_store_si256((__m256i *)sexps, _mm256_andnot_si256(is_zero, sexp));
+				for (size_t j = 0; j < 4; ++j)
+					store_extended(t, dp + (i + j) * To::size, (uint16_t)sexps[j], sigs[j]);
+			}
+			return i;
+		}
+
+		template<size_t size, endian byte_order, endian fp_order>
+		size_t transcode_avx2(format_integer<size, byte_order>, const uint8_t *sp, format<8, fp_order>, uint8_t *dp, size_t count, integer_rounding, unsigned &) {
+			size_t i = 0;
+			for (; count - i >= 4; i += 4)
+				store_lanes256<8, fp_order>(dp + i * 8, _mm256_castpd_si256(_mm256_cvtepi32_pd(load_integer_lanes<size, byte_order>(sp + i * size))));
+			return i;
+		}
+
+		template<endian byte_order, endian fp_order>
+		size_t transcode_avx2(format_integer<2, byte_order>, const uint8_t *sp, format<4, fp_order>, uint8_t *dp, size_t count, integer_rounding, unsigned &) {
+			size_t i = 0;
+			for (; count - i >= 4; i += 4)
+				store_float_lanes<fp_order>(dp + i * 4, _mm_castps_si128(_mm_cvtepi32_ps(load_integer_lanes<2, byte_order>(sp + i * 2))));
+			return i;
+		}
+
+		/*
+		 * LONGINT -> float: exact as double, rounded to nearest by
+		 * cvtpd_ps, then a directed rounding that went the wrong way is
+		 * moved one ulp (the float bits +-1, as the magnitudes are normal).
+		 */
+		template<endian byte_order, endian fp_order>
+		size_t transcode_avx2(format_integer<4, byte_order>, const uint8_t *sp, format<4, fp_order>, uint8_t *dp, size_t count, integer_rounding r, unsigned &flags) {
+			const __m256d abs_mask = _mm256_set1_pd(-0.0);
+			const __m256i directed = _mm256_set1_epi64x(-(int64_t)!r.nearest);
+			const __m256i up = _mm256_set1_epi64x(-(int64_t)r.up);
+			const __m256i down = _mm256_set1_epi64x(-(int64_t)r.down);
+			__m256i inexact = _mm256_setzero_si256();
+			size_t i = 0;
+			for (; count - i >= 4; i += 4) {
+				__m256d d = _mm256_cvtepi32_pd(load_integer_lanes<4, byte_order>(sp + i * 4));
+				__m128 x = _mm256_cvtpd_ps(d);
+				__m256d ad = _mm256_andnot_pd(abs_mask, d);
+				__m256d ax = _mm256_andnot_pd(abs_mask, _mm256_cvtps_pd(x));
+				__m256i over = _mm256_castpd_si256(_mm256_cmp_pd(ax, ad, _CMP_GT_OQ));
+				__m256i under = _mm256_castpd_si256(_mm256_cmp_pd(ax, ad, _CMP_LT_OQ));
+				inexact = _mm256_or_si256(inexact, _mm256_or_si256(over, under));
+				// directed rounding wants the larger magnitude for up and positive, or down and negative.
+				__m256i away = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(up), _mm256_castsi256_pd(down), d));
+				__m256i delta = _mm256_sub_epi64(_mm256_and_si256(_mm256_andnot_si256(away, directed), over), _mm256_and_si256(away, under));
+				store_float_lanes<fp_order>(dp + i * 4, _mm_add_epi32(_mm_castps_si128(x), low_words(delta)));
+			}
+			flags |= _mm256_movemask_epi8(inexact) ? INEXACT : 0;
+			return i;
+		}
+	#endif
+	}
+
+
+	template<class From, size_t size, endian byte_order>
+	typename std::enable_if<extended_layout<From>::value>::type
+	transcode(From f, const void *src, format_integer<size, byte_order>, void *dst, size_t count, rounding_direction rd = getround()) {
+
+		const detail::integer_rounding r(rd);
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+		uint64_t invalid = 0, inexact = 0;
+		unsigned flags = 0;
+
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(f, sp, format_integer<size, byte_order>{}, dp, count, r, flags);
+		sp += i * From::size;
+		dp += i * size;
+	#endif
+		for (; i < count; ++i, sp += From::size, dp += size) {
+			uint16_t sexp;
+			uint64_t sig;
+			load_extended(f, sp, sexp, sig);
+			int e = (int)(sexp & extended_traits::nan_exp) - (int)extended_traits::bias;
+			detail::store_word<byte_order>(dp, detail::round_integer<size>(sexp >> 15, e, sig, r, invalid, inexact));
+		}
+		signal_exceptions(flags | (invalid ? INVALID : 0) | (inexact ? INEXACT : 0));
+	}
+
+	template<size_t fsize, endian fp_order, size_t size, endian byte_order>
+	typename std::enable_if<fsize == 4 || fsize == 8>::type
+	transcode(format<fsize, fp_order>, const void *src, format_integer<size, byte_order>, void *dst, size_t count, rounding_direction rd = getround()) {
+
+		typedef typename detail::comp_binary<fsize>::word W;
+		constexpr int exp_bits = fsize == 4 ? 8 : 11;
+		constexpr int bias = fsize == 4 ? 127 : 1023;
+
+		const detail::integer_rounding r(rd);
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+		uint64_t invalid = 0, inexact = 0;
+		unsigned flags = 0;
+
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(format<fsize, fp_order>{}, sp, format_integer<size, byte_order>{}, dp, count, rd, flags);
+		sp += i * fsize;
+		dp += i * size;
+	#endif
+		for (; i < count; ++i, sp += fsize, dp += size) {
+			bool sign;
+			int e;
+			uint64_t sig;
+			detail::unpack_binary<W, exp_bits, bias>(detail::load_word<W, fp_order>(sp), sign, e, sig);
+			detail::store_word<byte_order>(dp, detail::round_integer<size>(sign, e, sig, r, invalid, inexact));
+		}
+		signal_exceptions(flags | (invalid ? INVALID : 0) | (inexact ? INEXACT : 0));
+	}
+
+	// exact, all integer arithmetic.
+	template<size_t size, endian byte_order, class To>
+	typename std::enable_if<extended_layout<To>::value>::type
+	transcode(format_integer<size, byte_order>, const void *src, To t, void *dst, size_t count) {
+
+		typedef typename detail::integer_type<size>::type I;
+		typedef typename detail::integer_type<size>::word W;
+
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(format_integer<size, byte_order>{}, sp, t, dp, count);
+		sp += i * size;
+		dp += i * To::size;
+	#endif
+		for (; i < count; ++i, sp += size, dp += To::size) {
+			int64_t v = (I)detail::load_word<W, byte_order>(sp);
+			uint64_t s = -(uint64_t)(v < 0);
+			uint64_t m = ((uint64_t)v ^ s) - s;
+			int shift = clz64(m | 1);
+			uint64_t sig = m << shift;
+			uint16_t sexp = ((s & 0x8000) | (extended_traits::bias + 63 - shift)) & -(uint16_t)(m != 0);
+			store_extended(t, dp, sexp, sig);
+		}
+	}
+
+	// only LONGINT -> float can be inexact.
+	template<size_t size, endian byte_order, size_t fsize, endian fp_order>
+	typename std::enable_if<fsize == 4 || fsize == 8>::type
+	transcode(format_integer<size, byte_order>, const void *src, format<fsize, fp_order>, void *dst, size_t count, rounding_direction rd = getround()) {
+
+		typedef typename detail::integer_type<size>::type I;
+		typedef typename detail::integer_type<size>::word W;
+		typedef typename detail::comp_binary<fsize>::type T;
+		typedef typename detail::comp_binary<fsize>::word FW;
+
+		const detail::integer_rounding r(rd);
+		const uint8_t *sp = (const uint8_t *)src;
+		uint8_t *dp = (uint8_t *)dst;
+		uint64_t inexact = 0;
+		unsigned flags = 0;
+
+		size_t i = 0;
+	#ifdef SANE_HAVE_AVX2
+		i = detail::transcode_avx2(format_integer<size, byte_order>{}, sp, format<fsize, fp_order>{}, dp, count, r, flags);
+		sp += i * size;
+		dp += i * fsize;
+	#endif
+		for (; i < count; ++i, sp += size, dp += fsize) {
+			I v = (I)detail::load_word<W, byte_order>(sp);
+			T x = detail::integer_to_binary<T>(v, r, inexact, std::integral_constant<bool, size == 4 && fsize == 4>{});
+			detail::store_word<fp_order>(dp, bit_cast<FW>(x));
+		}
+		signal_exceptions(flags | (inexact ? INEXACT : 0));
+	}
+
+} // floating_point
+
+
+	namespace detail {
+
+		template<size_t size>
+		typename floating_point::detail::integer_type<size>::type x2integer(const floating_point::info &fpi, rounding_direction rd) {
+			uint16_t sexp;
+			uint64_t sig;
+			uint64_t invalid = 0, inexact = 0;
+			fpi.pack_extended(sexp, sig);
+			int e = (int)(sexp & floating_point::extended_traits::nan_exp) - (int)floating_point::extended_traits::bias;
+			auto w = floating_point::detail::round_integer<size>(sexp >> 15, e, sig, floating_point::detail::integer_rounding(rd), invalid, inexact);
+			signal_exceptions((invalid ? INVALID : 0) | (inexact ? INEXACT : 0));
+			return w;
+		}
+	}
+
+	/*
+	 * extended -> INTEGER (x2i) and LONGINT (x2l), rounded in rd.  Invalid
+	 * conversions are INT16_MIN / INT32_MIN.
+	 */
+	inline int16_t x2i(const floating_point::info &fpi, rounding_direction rd = getround()) {
+		return detail::x2integer<2>(fpi, rd);
+	}
+
+	inline int32_t x2l(const floating_point::info &fpi, rounding_direction rd = getround()) {
+		return detail::x2integer<4>(fpi, rd);
+	}
+
+	inline int16_t x2i(long double x, rounding_direction rd = getround()) {
+		return x2i(floating_point::info(x), rd);
+	}
+
+	inline int32_t x2l(long double x, rounding_direction rd = getround()) {
+		return x2l(floating_point::info(x), rd);
+	}
+
+}
+
+#endif
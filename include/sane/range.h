@@ -0,0 +1,232 @@
+
+#ifndef __sane_range_h__
+#define __sane_range_h__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "floating_point.h"
+#include "endian_value.h"
+#include "hash.h"
+
+namespace SANE {
+
+namespace floating_point {
+
+	// the host type for the values in F.
+	template<class F> struct format_value;
+	template<endian byte_order> struct format_value<format<4, byte_order>> { typedef float type; };
+	template<endian byte_order> struct format_value<format<8, byte_order>> { typedef double type; };
+	template<endian byte_order> struct format_value<format<10, byte_order>> { typedef long double type; };
+	template<endian byte_order> struct format_value<format<12, byte_order>> { typedef long double type; };
+	template<endian byte_order> struct format_value<format<16, byte_order>> { typedef long double type; };
+	template<endian byte_order> struct format_value<format_68881<byte_order>> { typedef long double type; };
+	template<endian byte_order> struct format_value<format_comp<byte_order>> { typedef comp type; };
+
+
+	/*
+	 * count values encoded as F, stride bytes apart (F::size or more, for
+	 * records or padding).  Random access; elements are endian_value
+	 * references into the buffer, so nothing is decoded until it's read.
+	 */
+	template<class F, size_t stride, class T, class Byte>
+	class basic_format_range {
+	public:
+
+		static_assert(stride >= F::size, "stride");
+
+		typedef F format_type;
+		typedef endian_value<T, F::byte_order, F> element;
+		typedef typename std::conditional<std::is_const<Byte>::value, const element, element>::type reference_type;
+
+		static constexpr bool contiguous = stride == F::size;
+
+		class iterator {
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef element value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef reference_type *pointer;
+			typedef reference_type &reference;
+
+			iterator() = default;
+			explicit iterator(Byte *cp) : _cp(cp) {}
+
+			reference operator*() const { return element::at(_cp); }
+			pointer operator->() const { return &element::at(_cp); }
+			reference operator[](difference_type n) const { return element::at(_cp + n * (difference_type)stride); }
+
+			iterator &operator++() { _cp += stride; return *this; }
+			iterator &operator--() { _cp -= stride; return *this; }
+			iterator operator++(int) { iterator tmp(*this); _cp += stride; return tmp; }
+			iterator operator--(int) { iterator tmp(*this); _cp -= stride; return tmp; }
+
+			iterator &operator+=(difference_type n) { _cp += n * (difference_type)stride; return *this; }
+			iterator &operator-=(difference_type n) { _cp -= n * (difference_type)stride; return *this; }
+
+			friend iterator operator+(iterator a, difference_type n) { return a += n; }
+			friend iterator operator+(difference_type n, iterator a) { return a += n; }
+			friend iterator operator-(iterator a, difference_type n) { return a -= n; }
+			friend difference_type operator-(const iterator &a, const iterator &b) { return (a._cp - b._cp) / (difference_type)stride; }
+
+			friend bool operator==(const iterator &a, const iterator &b) { return a._cp == b._cp; }
+			friend bool operator!=(const iterator &a, const iterator &b) { return a._cp != b._cp; }
+			friend bool operator<(const iterator &a, const iterator &b) { return a._cp < b._cp; }
+			friend bool operator<=(const iterator &a, const iterator &b) { return a._cp <= b._cp; }
+			friend bool operator>(const iterator &a, const iterator &b) { return a._cp > b._cp; }
+			friend bool operator>=(const iterator &a, const iterator &b) { return a._cp >= b._cp; }
+
+			Byte *data() const { return _cp; }
+
+		private:
+			Byte *_cp = nullptr;
+		};
+
+		basic_format_range() = default;
+		basic_format_range(typename std::conditional<std::is_const<Byte>::value, const void, void>::type *data, size_t size) :
+			_data((Byte *)data), _size(size)
+		{}
+
+		// a mutable range converts to a const one.
+		template<class B, class = typename std::enable_if<std::is_const<Byte>::value && !std::is_const<B>::value>::type>
+		basic_format_range(const basic_format_range<F, stride, T, B> &r) : _data(r.data()), _size(r.size())
+		{}
+
+		size_t size() const { return _size; }
+		bool empty() const { return !_size; }
+		Byte *data() const { return _data; }
+
+		iterator begin() const { return iterator(_data); }
+		iterator end() const { return iterator(_data + _size * stride); }
+
+		reference_type &operator[](size_t i) const { return element::at(_data + i * stride); }
+
+		basic_format_range subrange(size_t first, size_t count) const {
+			return basic_format_range(_data + first * stride, count);
+		}
+
+	private:
+		Byte *_data = nullptr;
+		size_t _size = 0;
+	};
+
+	template<class F, size_t stride = F::size, class T = typename format_value<F>::type>
+	using format_range = basic_format_range<F, stride, T, uint8_t>;
+
+	template<class F, size_t stride = F::size, class T = typename format_value<F>::type>
+	using const_format_range = basic_format_range<F, stride, T, const uint8_t>;
+
+
+	namespace detail {
+
+		/*
+		 * fn(block, first, n) over the range with block holding n packed
+		 * values.  Contiguous ranges are one call; strided ones are
+		 * gathered a block at a time so the batch kernels still see
+		 * packed arrays.
+		 */
+		template<class F, size_t stride, class T, class Byte, class Fn>
+		void for_each_block(const basic_format_range<F, stride, T, Byte> &r, Fn fn) {
+
+			if (basic_format_range<F, stride, T, Byte>::contiguous) {
+				fn((const void *)r.data(), (size_t)0, r.size());
+				return;
+			}
+
+			constexpr size_t block = 256;
+			uint8_t buffer[block * F::size];
+			const uint8_t *sp = r.data();
+
+			for (size_t first = 0; first < r.size(); first += block) {
+				size_t n = std::min(block, r.size() - first);
+				for (size_t i = 0; i < n; ++i, sp += stride)
+					std::memcpy(buffer + i * F::size, sp, F::size);
+				fn((const void *)buffer, first, n);
+			}
+		}
+
+		template<class From, class To, class = void>
+		struct transcoder {
+			// through info, which rounds when narrowing.
+			static void run(const void *src, void *dst, size_t count) {
+				const uint8_t *sp = (const uint8_t *)src;
+				uint8_t *dp = (uint8_t *)dst;
+				for (size_t i = 0; i < count; ++i, sp += From::size, dp += To::size) {
+					info fpi;
+					fpi.read(From{}, sp);
+					fpi.write(To{}, dp);
+				}
+			}
+		};
+
+		template<class From, class To>
+		struct transcoder<From, To, decltype(transcode(From{}, (const void *)nullptr, To{}, (void *)nullptr, (size_t)0))> {
+			static void run(const void *src, void *dst, size_t count) {
+				transcode(From{}, src, To{}, dst, count);
+			}
+		};
+	}
+
+
+	/*
+	 * re-encode src into dst (same size).  Pairs with a transcode kernel
+	 * use it; everything else goes through info.  Strided ranges are
+	 * gathered and scattered a block at a time.
+	 */
+	template<class From, size_t s1, class T1, class B1, class To, size_t s2, class T2>
+	void transform(const basic_format_range<From, s1, T1, B1> &src, const basic_format_range<To, s2, T2, uint8_t> &dst) {
+
+		typedef detail::transcoder<From, To> transcoder;
+
+		size_t count = std::min(src.size(), dst.size());
+
+		if (basic_format_range<To, s2, T2, uint8_t>::contiguous) {
+			detail::for_each_block(src.subrange(0, count), [&](const void *block, size_t first, size_t n){
+				transcoder::run(block, dst.data() + first * To::size, n);
+			});
+			return;
+		}
+
+		uint8_t buffer[256 * To::size];
+		detail::for_each_block(src.subrange(0, count), [&](const void *block, size_t first, size_t n){
+			for (size_t base = 0; base < n; base += 256) {
+				size_t m = std::min((size_t)256, n - base);
+				transcoder::run((const uint8_t *)block + base * From::size, buffer, m);
+				for (size_t i = 0; i < m; ++i)
+					std::memcpy(dst.data() + (first + base + i) * s2, buffer + i * To::size, To::size);
+			}
+		});
+	}
+
+
+	// the batch kernels over ranges.
+
+	template<class F, size_t stride, class T, class Byte>
+	class_counts classify(const basic_format_range<F, stride, T, Byte> &r) {
+		class_counts c;
+		detail::for_each_block(r, [&](const void *block, size_t, size_t n){ classify(F{}, block, n, c); });
+		return c;
+	}
+
+	template<class F, size_t stride, class T, class Byte>
+	size_t nan_codes(const basic_format_range<F, stride, T, Byte> &r, uint8_t *codes) {
+		size_t count = 0;
+		detail::for_each_block(r, [&](const void *block, size_t first, size_t n){ count += nan_codes(F{}, block, codes + first, n); });
+		return count;
+	}
+
+	template<class F, size_t stride, class T, class Byte>
+	void hash(const basic_format_range<F, stride, T, Byte> &r, uint64_t *out) {
+		detail::for_each_block(r, [&](const void *block, size_t first, size_t n){ hash(F{}, block, out + first, n); });
+	}
+
+} // floating_point
+
+}
+
+#endif
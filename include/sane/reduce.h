@@ -0,0 +1,198 @@
+
+#ifndef __sane_reduce_h__
+#define __sane_reduce_h__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "floating_point.h"
+#include "comp.h"
+#include "sort.h" // detail::parallel
+
+namespace SANE {
+
+namespace floating_point {
+
+	enum nan_policy {
+		skip_nans,      // NaNs are counted and otherwise ignored.
+		propagate_nans, // any NaN makes sum, min and max NaN.
+	};
+
+	/*
+	 * sum, min, max and count of a comp column.  total (hi:lo) is the
+	 * exact 128-bit two's complement sum; sum is the comp NaN when it
+	 * doesn't fit in a comp.  min and max are NaN when there are no
+	 * values.  mean is NaN whenever sum is.
+	 */
+	struct comp_reduction {
+		comp sum = comp(0);
+		comp min = comp(comp::NaN);
+		comp max = comp(comp::NaN);
+		size_t count = 0;
+		size_t nans = 0;
+
+		int64_t total_hi = 0;
+		uint64_t total_lo = 0;
+
+		long double mean() const {
+			if (!count) return make_nan<long double>(NANDIV);
+			if (isnan(sum)) return make_nan<long double>(NANCOMP);
+			return (std::ldexp((long double)total_hi, 64) + (long double)total_lo) / (long double)count;
+		}
+	};
+
+	namespace detail {
+
+		// (hi:lo) += (xhi:xlo), 128-bit two's complement.
+		inline void add128(int64_t &hi, uint64_t &lo, int64_t xhi, uint64_t xlo) {
+			lo += xlo;
+			hi = (int64_t)((uint64_t)hi + (uint64_t)xhi + (lo < xlo));
+		}
+
+		/*
+		 * one slice.  Each value is split into a signed high and an
+		 * unsigned low 32 bits, summed in separate 64-bit lanes that
+		 * can't overflow for a block of 2^16, then folded into 128 bits.
+		 * The NaN (-2^63) is already below everything for max; min is
+		 * taken over w - 1, which wraps the NaN to the top.  AVX2 does
+		 * a block 4 lanes at a time (SSE2 has no 64-bit compare for min
+		 * and max); the scalar loop is branch free too.
+		 */
+	#ifdef SANE_HAVE_AVX2
+		template<endian byte_order>
+		size_t reduce_comp_avx2(const uint8_t *sp, size_t n, int64_t &hi, uint64_t &lo, int64_t &nans, int64_t &mn, int64_t &mx) {
+
+			const __m256i nan = _mm256_set1_epi64x(INT64_MIN);
+			const __m256i one = _mm256_set1_epi64x(1);
+			const __m256i low32 = _mm256_set1_epi64x(UINT64_C(0xffffffff));
+			__m256i vhi = _mm256_setzero_si256(), vlo = _mm256_setzero_si256(), vnans = _mm256_setzero_si256();
+			__m256i vmn = _mm256_set1_epi64x(mn), vmx = _mm256_set1_epi64x(mx);
+
+			size_t i = 0;
+			for (; n - i >= 4; i += 4) {
+				__m256i w = load_lanes256<8, byte_order>(sp + i * 8);
+				__m256i is_nan = _mm256_cmpeq_epi64(w, nan);
+				__m256i v = _mm256_andnot_si256(is_nan, w);
+				__m256i m = _mm256_sub_epi64(w, one);
+				// v >> 32 (arithmetic): the high half, with its sign in the odd 32-bit lane.
+				vhi = _mm256_add_epi64(vhi, _mm256_blend_epi32(_mm256_srli_epi64(v, 32), _mm256_srai_epi32(v, 31), 0xaa));
+				vlo = _mm256_add_epi64(vlo, _mm256_and_si256(v, low32));
+				vnans = _mm256_sub_epi64(vnans, is_nan);
+				vmn = _mm256_blendv_epi8(vmn, m, _mm256_cmpgt_epi64(vmn, m));
+				vmx = _mm256_blendv_epi8(vmx, w, _mm256_cmpgt_epi64(w, vmx));
+			}
+
+			alignas(32) int64_t h[4], l[4], c[4], a[4], b[4];
+			_mm256_store_si256((__m256i *)h, vhi);
+			_mm256_store_si256((__m256i *)l, vlo);
+			_mm256_store_si256((__m256i *)c, vnans);
+			_mm256_store_si256((__m256i *)a, vmn);
+			_mm256_store_si256((__m256i *)b, vmx);
+			for (int j = 0; j < 4; ++j) {
+				hi += h[j];
+				lo += (uint64_t)l[j];
+				nans += c[j];
+				mn = std::min(mn, a[j]);
+				mx = std::max(mx, b[j]);
+			}
+			return i;
+		}
+	#endif
+
+		template<endian byte_order>
+		void reduce_comp(const uint8_t *sp, size_t count, comp_reduction &r, int64_t &min1, int64_t &max) {
+
+			constexpr size_t block = 65536;
+
+			for (size_t first = 0; first < count; first += block) {
+				size_t n = std::min(block, count - first);
+				int64_t hi = 0;
+				uint64_t lo = 0;
+				int64_t nans = 0;
+				int64_t mn = min1, mx = max;
+
+				size_t i = 0;
+			#ifdef SANE_HAVE_AVX2
+				i = reduce_comp_avx2<byte_order>(sp, n, hi, lo, nans, mn, mx);
+			#endif
+				for (; i < n; ++i) {
+					int64_t w = (int64_t)load_word<uint64_t, byte_order>(sp + i * 8);
+					int64_t nan = w == INT64_MIN;
+					int64_t v = nan ? 0 : w;
+					int64_t m = (int64_t)((uint64_t)w - 1);
+					hi += v >> 32;
+					lo += (uint32_t)v;
+					nans += nan;
+					mn = m < mn ? m : mn;
+					mx = w > mx ? w : mx;
+				}
+				sp += n * 8;
+
+				add128(r.total_hi, r.total_lo, hi >> 32, (uint64_t)hi << 32);
+				add128(r.total_hi, r.total_lo, 0, lo);
+				r.nans += nans;
+				r.count += n - nans;
+				min1 = mn;
+				max = mx;
+			}
+		}
+	}
+
+	/*
+	 * reduce count comps.  threads = 0 uses every hardware thread; small
+	 * arrays use one.  Integer sums are exact, so the result doesn't
+	 * depend on the thread count.
+	 */
+	template<endian byte_order>
+	comp_reduction reduce(format_comp<byte_order>, const void *src, size_t count, nan_policy policy = skip_nans, unsigned threads = 0) {
+
+		if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = (unsigned)std::min<size_t>(threads, 1 + count / 65536);
+
+		const uint8_t *sp = (const uint8_t *)src;
+		std::vector<comp_reduction> part(threads);
+		// mins are min - 1.
+		std::vector<int64_t> mins(threads, INT64_MAX), maxs(threads, INT64_MIN);
+
+		detail::parallel(threads, [&](unsigned t){
+			size_t lo = count * t / threads, hi = count * (t + 1) / threads;
+			detail::reduce_comp<byte_order>(sp + lo * 8, hi - lo, part[t], mins[t], maxs[t]);
+		});
+
+		comp_reduction r;
+		int64_t min = INT64_MAX, max = INT64_MIN;
+		for (unsigned t = 0; t < threads; ++t) {
+			detail::add128(r.total_hi, r.total_lo, part[t].total_hi, part[t].total_lo);
+			r.count += part[t].count;
+			r.nans += part[t].nans;
+			min = std::min(min, mins[t]);
+			max = std::max(max, maxs[t]);
+		}
+
+		if (policy == propagate_nans && r.nans) {
+			r.sum = comp(comp::NaN);
+			return r;
+		}
+
+		// fits in a comp: the high word is the sign extension, and not -2^63.
+		if (r.total_hi == (int64_t)r.total_lo >> 63 && r.total_lo != comp::NaN)
+			r.sum = comp(r.total_lo);
+		else
+			r.sum = comp(comp::NaN);
+
+		if (r.count) {
+			r.min = comp(min + 1);
+			r.max = comp(max);
+		}
+		return r;
+	}
+
+} // floating_point
+
+}
+
+#endif
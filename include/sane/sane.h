@@ -4,26 +4,12 @@
 #include <cstdint>
 #include <string>
 
+#include "floating_point.h"
+#include "environment.h"
+
 namespace SANE
 {
 
-	/* NaN codes.  See pp41, table 5-1 */
-	enum {
-		NANSQRT = 1,       /* Invalid square root, such as sqrt(-1)   */
-		NANADD = 2,        /* Invalid addition, such as +INF - +INF   */
-		NANDIV = 4,        /* Invalid division, such as 0/0           */
-		NANMUL = 8,        /* Invalid multiply, such as 0 * INF       */
-		NANREM = 9,        /* Invalid rem or mod, such as x REM 0     */
-		NANASCBIN = 17,    /* Conversion of invalid ASCII string     */
-		NANCOMP = 20,      /* Comp NaN converted to floating         */
-		NANZERO = 21,      /* Attempt to create a NaN with zero code */
-		NANTRIG = 33,      /* Invalid argument to trig routine       */
-		NANINVTRIG = 34,   /* Invalid arg to inverse trig routine    */
-		NANLOG = 36,       /* Invalid argument to log routine        */
-		NANPOWER = 37,     /* Invalid argument to x^i or x^y routine */
-		NANFINAN = 38,     /* Invalid argument to financial function */	
-	};
-
 	struct decimal {
 		enum {
 			SIGDIGLEN = 32,
@@ -99,18 +85,45 @@ namespace SANE
 	void str2dec(const std::string &s, uint16_t &index, decimal &d, uint16_t &vp);
 	void dec2str(const decform &f, const decimal &d, std::string &s);
 
-	long double dec2x(const decimal &d);
-	decimal x2dec(long double x, const decform &df);
+	long double dec2x(const decimal &d, rounding_direction rd = getround());
+	decimal x2dec(long double x, const decform &df, rounding_direction rd = getround());
+
+	// exact, independent of the host long double (and its rounding mode).
+	void dec2x(const decimal &d, floating_point::info &fpi, rounding_direction rd = getround());
+	decimal x2dec(const floating_point::info &fpi, const decform &df, rounding_direction rd = getround());
+
+	// raw (guest) images; a signaling NaN is INVALID and delivered quiet, as in convert().
+	template<size_t size, endian byte_order>
+	void dec2x(const decimal &d, floating_point::format<size, byte_order> f, void *vp, rounding_direction rd = getround()) {
+		floating_point::info fpi;
+		dec2x(d, fpi, rd);
+		signal_exceptions(fpi.write_exceptions(f, rd));
+		fpi.signaling = false;
+		fpi.write(f, vp, rd);
+	}
+
+	template<size_t size, endian byte_order>
+	decimal x2dec(floating_point::format<size, byte_order> f, const void *vp, const decform &df, rounding_direction rd = getround()) {
+		floating_point::info fpi;
+		fpi.read(f, vp);
+		return x2dec(fpi, df, rd);
+	}
 
-	void truncate(decimal &d, int digits);
+	// round to digits significant digits.
+	void truncate(decimal &d, int digits, rounding_direction rd = getround());
 
+	/*
+	 * float, double, and long double NaNs are header-only so constant
+	 * codes (make_nan<double>(NANSQRT)) fold at compile time.
+	 */
 	template<class T>
-	T make_nan(unsigned code);
-
+	SANE_BIT_CAST_CONSTEXPR T make_nan(unsigned code) {
+		floating_point::info fpi;
+		fpi.nan = true;
+		fpi.sig = code ? code : (unsigned)NANZERO;
+		return static_cast<T>(fpi);
+	}
 
-	template<> float make_nan<float>(unsigned);
-	template<> double make_nan<double>(unsigned);
-	template<> long double make_nan<long double>(unsigned);
 	template<> decimal make_nan<decimal>(unsigned);
 }
 
@@ -0,0 +1,138 @@
+
+#ifndef __sane_soft_extended_h__
+#define __sane_soft_extended_h__
+
+#include <cstdint>
+#include <cmath>
+
+#include "floating_point.h"
+
+namespace SANE {
+
+	/*
+	 * software 80-bit extended arithmetic.
+	 *
+	 * The representation is the SANE/x87 image (sign + 15-bit biased
+	 * exponent, 64-bit significand with explicit 1 bit) so results are
+	 * the same whether the host long double is x87, binary64, or binary128.
+	 * The operations round as told and don't touch the environment: no
+	 * flags, and always to the full 64 bits whatever the precision.
+	 */
+	class soft_extended {
+	public:
+
+		uint64_t sig = 0;
+		uint16_t sexp = 0;
+
+		constexpr soft_extended() = default;
+		constexpr soft_extended(uint16_t e, uint64_t s) : sig(s), sexp(e) {}
+
+		explicit soft_extended(const floating_point::info &);
+		explicit soft_extended(long double x) : soft_extended(floating_point::info(x)) {}
+
+		/*
+		 * round (sig + extra / 2^64) * 2^(exp - 63) to extended.
+		 * extra holds the bits below sig; its low bit may be a sticky bit.
+		 */
+		static soft_extended make(bool sign, int exp, uint64_t sig, uint64_t extra, rounding_direction rd = TONEAREST);
+
+
+		template<class F>
+		void read(F f, const void *vp) {
+			floating_point::info fpi;
+			fpi.read(f, vp);
+			*this = soft_extended(fpi);
+		}
+
+		template<class F>
+		void write(F f, void *vp) const {
+			((floating_point::info)*this).write(f, vp);
+		}
+
+		explicit operator floating_point::info() const {
+			floating_point::info fpi;
+			fpi.unpack_extended(sexp, sig);
+			return fpi;
+		}
+
+		explicit operator long double() const {
+			return (long double)(floating_point::info)*this;
+		}
+
+		explicit operator double() const {
+			return (double)(floating_point::info)*this;
+		}
+
+		explicit operator float() const {
+			return (float)(floating_point::info)*this;
+		}
+	};
+
+
+	soft_extended add(const soft_extended &a, const soft_extended &b, rounding_direction rd = TONEAREST);
+	soft_extended sub(const soft_extended &a, const soft_extended &b, rounding_direction rd = TONEAREST);
+	soft_extended mul(const soft_extended &a, const soft_extended &b, rounding_direction rd = TONEAREST);
+	soft_extended div(const soft_extended &a, const soft_extended &b, rounding_direction rd = TONEAREST);
+
+	// IEEE remainder (always exact).
+	soft_extended rem(const soft_extended &a, const soft_extended &b);
+
+	soft_extended sqrt(const soft_extended &a, rounding_direction rd = TONEAREST);
+
+	// round to integral value.
+	soft_extended rint(const soft_extended &a, rounding_direction rd = TONEAREST);
+
+	// -1, 0, 1, or 2 if unordered.
+	int compare(const soft_extended &a, const soft_extended &b);
+
+
+	inline soft_extended operator+(const soft_extended &a, const soft_extended &b) { return add(a, b); }
+	inline soft_extended operator-(const soft_extended &a, const soft_extended &b) { return sub(a, b); }
+	inline soft_extended operator*(const soft_extended &a, const soft_extended &b) { return mul(a, b); }
+	inline soft_extended operator/(const soft_extended &a, const soft_extended &b) { return div(a, b); }
+
+	inline soft_extended operator-(const soft_extended &a) {
+		return soft_extended(a.sexp ^ 0x8000, a.sig);
+	}
+
+	inline bool operator==(const soft_extended &a, const soft_extended &b) { return compare(a, b) == 0; }
+	inline bool operator!=(const soft_extended &a, const soft_extended &b) { return compare(a, b) != 0; }
+	inline bool operator<(const soft_extended &a, const soft_extended &b) { return compare(a, b) == -1; }
+	inline bool operator<=(const soft_extended &a, const soft_extended &b) { int c = compare(a, b); return c == -1 || c == 0; }
+	inline bool operator>(const soft_extended &a, const soft_extended &b) { return compare(a, b) == 1; }
+	inline bool operator>=(const soft_extended &a, const soft_extended &b) { int c = compare(a, b); return c == 1 || c == 0; }
+
+
+	inline int fpclassify(const soft_extended &x) {
+		if ((x.sexp & 0x7fff) == 0x7fff) return (x.sig << 1) ? FP_NAN : FP_INFINITE;
+		if (x.sig == 0) return FP_ZERO;
+		return x.sig >> 63 ? FP_NORMAL : FP_SUBNORMAL;
+	}
+
+	inline int signbit(const soft_extended &x) {
+		return x.sexp >> 15;
+	}
+
+	inline int isnan(const soft_extended &x) {
+		return fpclassify(x) == FP_NAN;
+	}
+
+	inline int isinf(const soft_extended &x) {
+		return fpclassify(x) == FP_INFINITE;
+	}
+
+	inline int isfinite(const soft_extended &x) {
+		return (x.sexp & 0x7fff) != 0x7fff;
+	}
+
+	inline int isnormal(const soft_extended &x) {
+		return fpclassify(x) == FP_NORMAL;
+	}
+
+	inline soft_extended abs(const soft_extended &x) {
+		return soft_extended(x.sexp & 0x7fff, x.sig);
+	}
+
+}
+
+#endif
@@ -0,0 +1,330 @@
+
+#ifndef __sane_sort_h__
+#define __sane_sort_h__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "floating_point.h"
+
+namespace SANE {
+
+namespace floating_point {
+
+	/*
+	 * order preserving sort keys.  Each encoded value maps to an unsigned
+	 * key whose (unsigned) order is the numeric order of the values:
+	 * -0 sorts just before +0 and all NaNs sort last, with the same key.
+	 * Keys are built from the bit images; nothing is decoded.
+	 */
+
+	// 80-bit key for extended.
+	struct extended_key {
+		uint64_t lo = 0;
+		uint16_t hi = 0;
+	};
+
+	inline bool operator<(const extended_key &a, const extended_key &b) {
+		return (a.hi < b.hi) | ((a.hi == b.hi) & (a.lo < b.lo));
+	}
+
+	inline bool operator==(const extended_key &a, const extended_key &b) {
+		return a.hi == b.hi && a.lo == b.lo;
+	}
+
+	inline unsigned key_byte(uint32_t k, unsigned i) { return (k >> (8 * i)) & 0xff; }
+	inline unsigned key_byte(uint64_t k, unsigned i) { return (k >> (8 * i)) & 0xff; }
+	inline unsigned key_byte(const extended_key &k, unsigned i) {
+		return i < 8 ? key_byte(k.lo, i) : key_byte((uint32_t)k.hi, i - 8);
+	}
+
+
+	template<endian byte_order>
+	uint32_t sort_key(format<4, byte_order>, const void *vp) {
+		using namespace single_traits;
+
+		uint32_t w;
+		std::memcpy(&w, vp, 4);
+		reverse_bytes_if<4>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+		uint32_t neg = -(w >> 31);
+		uint32_t nan = -(uint32_t)((w & ~sign_bit) > nan_exp);
+		return ((w ^ (neg >> 1)) ^ sign_bit) | nan;
+	}
+
+	template<endian byte_order>
+	uint64_t sort_key(format<8, byte_order>, const void *vp) {
+		using namespace double_traits;
+
+		uint64_t w;
+		std::memcpy(&w, vp, 8);
+		reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+
+		uint64_t neg = -(w >> 63);
+		uint64_t nan = -(uint64_t)((w & ~sign_bit) > nan_exp);
+		return ((w ^ (neg >> 1)) ^ sign_bit) | nan;
+	}
+
+	// NaN (0x8000000000000000) wraps around to the top.
+	template<endian byte_order>
+	uint64_t sort_key(format_comp<byte_order>, const void *vp) {
+
+		uint64_t w;
+		std::memcpy(&w, vp, 8);
+		reverse_bytes_if<8>(&w, std::integral_constant<bool, byte_order != endian::native>{});
+		return (w ^ (UINT64_C(1) << 63)) - 1;
+	}
+
+	namespace detail {
+
+		// 79 bits of magnitude, flipped for negative values.
+		inline extended_key signed_key(bool sign, uint16_t e, uint64_t sig) {
+			uint64_t m = -(uint64_t)sign;
+			extended_key k;
+			k.hi = (e ^ (m & 0x7fff)) | (~m & 0x8000);
+			k.lo = sig ^ m;
+			return k;
+		}
+
+		// the uncommon encodings.
+		inline extended_key extended_sort_key(uint16_t sexp, uint64_t sig) {
+
+			int e = sexp & extended_traits::nan_exp;
+
+			if (e == extended_traits::nan_exp) {
+				if (sig << 1) {
+					extended_key k;
+					k.hi = 0xffff;
+					k.lo = ~UINT64_C(0);
+					return k;
+				}
+				sig = extended_traits::one_bit;
+			}
+			else if (sig) {
+				// value is sig * 2^(max(e, 1) - bias - 63).
+				int ee = e ? e : 1;
+				int shift = std::min(clz64(sig), ee - 1);
+				sig <<= shift;
+				e = (sig >> 63) ? ee - shift : 0;
+			}
+			else e = 0;
+
+			return signed_key(sexp >> 15, e, sig);
+		}
+	}
+
+	/*
+	 * extended images aren't unique (denormals, pseudo-denormals, unnormals)
+	 * so those are normalized first.
+	 */
+	template<class F>
+	typename std::enable_if<extended_layout<F>::value, extended_key>::type
+	sort_key(F f, const void *vp) {
+
+		uint16_t sexp;
+		uint64_t sig;
+		load_extended(f, vp, sexp, sig);
+
+		unsigned e = sexp & extended_traits::nan_exp;
+		if ((sig >> 63) && e - 1 < extended_traits::nan_exp - 1)
+			return detail::signed_key(sexp >> 15, e, sig);
+		return detail::extended_sort_key(sexp, sig);
+	}
+
+
+	template<class F>
+	using sort_key_t = decltype(sort_key(F{}, nullptr));
+
+	template<class F>
+	void sort_keys(F f, const void *src, sort_key_t<F> *keys, size_t count) {
+		const uint8_t *sp = (const uint8_t *)src;
+		for (size_t i = 0; i < count; ++i, sp += F::size)
+			keys[i] = sort_key(f, sp);
+	}
+
+	template<class F>
+	constexpr unsigned sort_key_bytes() {
+		return std::is_same<sort_key_t<F>, extended_key>::value ? 10 : sizeof(sort_key_t<F>);
+	}
+
+
+	namespace detail {
+
+		// f(t) for t in [0, threads).
+		template<class Fn>
+		void parallel(unsigned threads, Fn f) {
+			std::vector<std::thread> v;
+			for (unsigned t = 1; t < threads; ++t) v.emplace_back(f, t);
+			f(0);
+			for (auto &t : v) t.join();
+		}
+
+		template<class K>
+		struct keyed {
+			K key;
+			size_t index;
+		};
+
+		/*
+		 * radix sort, 8 bits per pass.  Digits that are the same in every
+		 * key are skipped.  One stable pass on the most significant digit
+		 * splits the keys into 256 buckets, then each bucket is sorted
+		 * least significant digit first; the buckets are usually small
+		 * enough to stay in cache, so only the first pass scatters across
+		 * all of memory.  Threads histogram and scatter their own slice
+		 * of the first pass and then take whole buckets.  The result is
+		 * stable and does not depend on the thread count.
+		 */
+		template<class K>
+		void radix_sort(std::vector<keyed<K>> &v, unsigned bytes, unsigned threads) {
+
+			size_t n = v.size();
+			std::vector<keyed<K>> tmp(n);
+			std::vector<size_t> hist(threads * bytes * 256);
+
+			auto lo = [&](unsigned t){ return n * t / threads; };
+
+			parallel(threads, [&](unsigned t){
+				size_t *h = &hist[t * bytes * 256];
+				for (size_t i = lo(t), e = lo(t + 1); i < e; ++i)
+					for (unsigned b = 0; b < bytes; ++b) ++h[b * 256 + key_byte(v[i].key, b)];
+			});
+
+			std::vector<unsigned> digits;
+			for (unsigned b = 0; b < bytes; ++b) {
+				unsigned d0 = key_byte(v[0].key, b);
+				size_t same = 0;
+				for (unsigned t = 0; t < threads; ++t) same += hist[(t * bytes + b) * 256 + d0];
+				if (same != n) digits.push_back(b);
+			}
+			if (digits.empty()) return;
+
+			unsigned top = digits.back();
+			digits.pop_back();
+
+			size_t bucket[257];
+			size_t sum = 0;
+			for (unsigned d = 0; d < 256; ++d) {
+				bucket[d] = sum;
+				for (unsigned t = 0; t < threads; ++t) {
+					size_t &x = hist[(t * bytes + top) * 256 + d];
+					size_t c = x;
+					x = sum;
+					sum += c;
+				}
+			}
+			bucket[256] = n;
+
+			parallel(threads, [&](unsigned t){
+				size_t *h = &hist[(t * bytes + top) * 256];
+				for (size_t i = lo(t), e = lo(t + 1); i < e; ++i)
+					tmp[h[key_byte(v[i].key, top)]++] = v[i];
+			});
+
+			std::atomic<unsigned> next(0);
+			parallel(threads, [&](unsigned){
+				std::vector<size_t> h(digits.size() * 256);
+
+				for (unsigned d; (d = next++) < 256; ) {
+					size_t b0 = bucket[d];
+					size_t size = bucket[d + 1] - b0;
+					keyed<K> *src = tmp.data() + b0;
+					keyed<K> *dst = v.data() + b0;
+
+					std::fill(h.begin(), h.end(), 0);
+					for (size_t i = 0; i < size; ++i)
+						for (size_t j = 0; j < digits.size(); ++j) ++h[j * 256 + key_byte(src[i].key, digits[j])];
+
+					for (size_t j = 0; j < digits.size() && size > 1; ++j) {
+						size_t *hj = &h[j * 256];
+						unsigned b = digits[j];
+						if (hj[key_byte(src[0].key, b)] == size) continue;
+
+						size_t sum = 0;
+						for (unsigned k = 0; k < 256; ++k) {
+							size_t x = hj[k];
+							hj[k] = sum;
+							sum += x;
+						}
+						for (size_t i = 0; i < size; ++i)
+							dst[hj[key_byte(src[i].key, b)]++] = src[i];
+						std::swap(src, dst);
+					}
+					if (src != v.data() + b0) std::copy(src, src + size, v.data() + b0);
+				}
+			});
+		}
+	}
+
+
+	/*
+	 * stable sort of count encoded values, in place.  threads = 0 uses
+	 * every hardware thread; small arrays use one.
+	 */
+	template<class F>
+	void radix_sort(F f, void *data, size_t count, unsigned threads = 0) {
+
+		if (count < 2) return;
+
+		if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = (unsigned)std::min<size_t>(threads, 1 + count / 65536);
+
+		uint8_t *cp = (uint8_t *)data;
+		std::vector<detail::keyed<sort_key_t<F>>> v(count);
+
+		detail::parallel(threads, [&](unsigned t){
+			for (size_t i = count * t / threads, e = count * (t + 1) / threads; i < e; ++i) {
+				v[i].key = sort_key(f, cp + i * F::size);
+				v[i].index = i;
+			}
+		});
+
+		detail::radix_sort(v, sort_key_bytes<F>(), threads);
+
+		std::vector<uint8_t> tmp(cp, cp + count * F::size);
+		for (size_t i = 0; i < count; ++i)
+			std::memcpy(cp + i * F::size, tmp.data() + v[i].index * F::size, F::size);
+	}
+
+
+	/*
+	 * first position in sorted data whose value is not less than value
+	 * (both encoded as F).  Branch free: the loop runs log2(count) times
+	 * and the compare only feeds the next address.  Both possible next
+	 * probes are prefetched since nothing is speculated.
+	 */
+	template<class F>
+	size_t lower_bound(F f, const void *data, size_t count, const void *value) {
+
+		if (!count) return 0;
+
+		const uint8_t *base = (const uint8_t *)data;
+		const uint8_t *cp = base;
+		auto k = sort_key(f, value);
+
+		while (count > 1) {
+			size_t half = count / 2;
+			count -= half;
+		#if defined(__GNUC__)
+			// two levels ahead.
+			size_t q = count / 2, r = (count - q) / 2;
+			__builtin_prefetch(cp + r * F::size);
+			__builtin_prefetch(cp + (q + r) * F::size);
+			__builtin_prefetch(cp + (half + r) * F::size);
+			__builtin_prefetch(cp + (half + q + r) * F::size);
+		#endif
+			cp += (sort_key(f, cp + half * F::size) < k) * half * F::size;
+		}
+		return (cp - base) / F::size + (sort_key(f, cp) < k);
+	}
+
+} // floating_point
+
+}
+
+#endif
@@ -0,0 +1,383 @@
+
+#ifndef __sane_value_h__
+#define __sane_value_h__
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sane.h"
+#include "floating_point.h"
+#include "comp.h"
+#include "hash.h"
+#include "compare.h"
+#include "range.h" // detail::transcoder
+
+namespace SANE {
+
+	enum value_type : uint8_t {
+		single_type,
+		double_type,
+		extended_type,
+		comp_type,
+		decimal_type,
+	};
+
+	namespace detail {
+
+		/*
+		 * fn(F{}) with the native format a value_type is stored in
+		 * (extended is the 10-byte image, whatever the host long double
+		 * is).  Not for decimal_type.
+		 */
+		template<class Fn>
+		void visit_format(value_type t, Fn &&fn) {
+			using namespace floating_point;
+			switch (t) {
+				case single_type: fn(format<4, endian::native>{}); break;
+				case double_type: fn(format<8, endian::native>{}); break;
+				case extended_type: fn(format<10, endian::native>{}); break;
+				case comp_type: fn(format_comp<endian::native>{}); break;
+				default: break;
+			}
+		}
+
+		// decimals go everywhere through dec2x and the extended image.
+		inline void decimal_image(const decimal &d, void *vp) {
+			floating_point::info fpi;
+			dec2x(d, fpi);
+			fpi.write(floating_point::format<10, endian::native>{}, vp);
+		}
+
+		inline size_t value_size(value_type t) {
+			static const uint8_t sizes[] = { 4, 8, 10, 8, 0 };
+			return sizes[t];
+		}
+	}
+
+
+	/*
+	 * any SANE numeric type, tagged.  Binary values and comps are kept as
+	 * their native images (so there's no long double padding); decimals,
+	 * the rare case, are held out of line.  16 bytes.
+	 */
+	class sane_value {
+	public:
+
+		sane_value() : sane_value(0.0L) {}
+
+		explicit sane_value(float x) : _type(single_type) { std::memcpy(_bits, &x, 4); }
+		explicit sane_value(double x) : _type(double_type) { std::memcpy(_bits, &x, 8); }
+		explicit sane_value(long double x) : _type(extended_type) {
+			floating_point::info(x).write(floating_point::format<10, endian::native>{}, _bits);
+		}
+		explicit sane_value(const comp &c) : _type(comp_type) {
+			uint64_t w = (uint64_t)c;
+			std::memcpy(_bits, &w, 8);
+		}
+		explicit sane_value(const decimal &d) : _type(decimal_type) { set_decimal(new decimal(d)); }
+
+		// from a native image (not decimal_type: there's no image to copy).
+		sane_value(value_type t, const void *vp) : _type(t) {
+			assert(t != decimal_type);
+			std::memcpy(_bits, vp, detail::value_size(t));
+		}
+
+		sane_value(const sane_value &rhs) : _type(rhs._type) {
+			if (_type == decimal_type) set_decimal(new decimal(rhs.dec()));
+			else std::memcpy(_bits, rhs._bits, sizeof(_bits));
+		}
+
+		sane_value(sane_value &&rhs) : _type(rhs._type) {
+			std::memcpy(_bits, rhs._bits, sizeof(_bits));
+			rhs._type = extended_type;
+		}
+
+		sane_value &operator=(sane_value rhs) {
+			std::swap(_type, rhs._type);
+			std::swap(_bits, rhs._bits);
+			return *this;
+		}
+
+		~sane_value() {
+			if (_type == decimal_type) delete &dec();
+		}
+
+		value_type type() const { return _type; }
+
+		// the native image (see detail::visit_format).  Not for decimals.
+		const void *data() const { return _bits; }
+
+		const decimal &dec() const {
+			decimal *d;
+			std::memcpy(&d, _bits, sizeof(d));
+			return *d;
+		}
+
+		// exact for everything but long decimals, which dec2x rounds.
+		floating_point::info info() const {
+			floating_point::info fpi;
+			if (_type == decimal_type) dec2x(dec(), fpi);
+			else {
+				uint8_t x[10] = {};
+				write(floating_point::format<10, endian::native>{}, x);
+				fpi.read(floating_point::format<10, endian::native>{}, x);
+			}
+			return fpi;
+		}
+
+		floating_point::canonical canonical() const {
+			floating_point::canonical c;
+			if (_type == decimal_type) c = canonicalize(dec());
+			else detail::visit_format(_type, [&](auto f){ c = canonicalize(f, _bits); });
+			return c;
+		}
+
+		// encoded as F, rounding as the conversions do.
+		template<class F>
+		void write(F, void *vp) const {
+			if (_type == decimal_type) {
+				uint8_t x[10];
+				detail::decimal_image(dec(), x);
+				floating_point::detail::transcoder<floating_point::format<10, endian::native>, F>::run(x, vp, 1);
+			}
+			else detail::visit_format(_type, [&](auto from){
+				floating_point::detail::transcoder<decltype(from), F>::run(_bits, vp, 1);
+			});
+		}
+
+	private:
+		// the image, or the decimal's address.
+		uint8_t _bits[15];
+		value_type _type;
+
+		void set_decimal(decimal *d) {
+			std::memcpy(_bits, &d, sizeof(d));
+		}
+	};
+
+	inline int fpclassify(const sane_value &v) {
+		if (v.type() == decimal_type) return fpclassify(v.dec());
+		return fpclassify(v.info());
+	}
+
+	inline int isnan(const sane_value &v) {
+		return fpclassify(v) == FP_NAN;
+	}
+
+	inline relop compare(const sane_value &a, const sane_value &b) {
+		return floating_point::compare(a.canonical(), b.canonical());
+	}
+
+	// comps print exactly (comp2dec); decimals as they are.
+	inline std::string to_string(const sane_value &v, const decform &df = decform(decform::FLOATDECIMAL, 19)) {
+		std::string s;
+		switch (v.type()) {
+			case decimal_type: dec2str(df, v.dec(), s); break;
+			case comp_type: {
+				uint64_t w;
+				std::memcpy(&w, v.data(), 8);
+				dec2str(df, comp2dec(comp(w), df), s);
+				break;
+			}
+			default: dec2str(df, x2dec(v.info(), df), s); break;
+		}
+		return s;
+	}
+
+
+	/*
+	 * a column of mixed SANE values, stored as runs of one type: packed
+	 * native images, or decimals.  Operations dispatch on the type once
+	 * per run and hand the whole run to the single-format kernels.
+	 */
+	class sane_column {
+	public:
+
+		struct run {
+			value_type type;
+			size_t first;  // index of the first value
+			size_t count;
+			size_t offset; // into the images (bytes) or the decimals
+		};
+
+		size_t size() const { return _size; }
+		bool empty() const { return !_size; }
+		const std::vector<run> &runs() const { return _runs; }
+
+		// the images for a binary or comp run.
+		const void *data(const run &r) const { return _data.data() + r.offset; }
+		const decimal *decimals(const run &r) const { return _decimals.data() + r.offset; }
+
+		void clear() {
+			_runs.clear();
+			_data.clear();
+			_decimals.clear();
+			_size = 0;
+		}
+
+		void push_back(const sane_value &v) {
+			if (v.type() == decimal_type) append(&v.dec(), 1);
+			else append(v.type(), v.data(), 1);
+		}
+
+		// count native images of type t.
+		void append(value_type t, const void *src, size_t count) {
+			size_t bytes = count * detail::value_size(t);
+			extend(t, count, _data.size());
+			_data.insert(_data.end(), (const uint8_t *)src, (const uint8_t *)src + bytes);
+		}
+
+		void append(const float *src, size_t count) { append(single_type, src, count); }
+		void append(const double *src, size_t count) { append(double_type, src, count); }
+
+		void append(const long double *src, size_t count) {
+			size_t offset = _data.size();
+			extend(extended_type, count, offset);
+			_data.resize(offset + count * 10);
+			for (size_t i = 0; i < count; ++i)
+				floating_point::info(src[i]).write(floating_point::format<10, endian::native>{}, _data.data() + offset + i * 10);
+		}
+
+		void append(const comp *src, size_t count) {
+			size_t offset = _data.size();
+			extend(comp_type, count, offset);
+			_data.resize(offset + count * 8);
+			for (size_t i = 0; i < count; ++i) {
+				uint64_t w = (uint64_t)src[i];
+				std::memcpy(_data.data() + offset + i * 8, &w, 8);
+			}
+		}
+
+		void append(const decimal *src, size_t count) {
+			extend(decimal_type, count, _decimals.size());
+			_decimals.insert(_decimals.end(), src, src + count);
+		}
+
+		const run &run_at(size_t i) const {
+			return *(std::upper_bound(_runs.begin(), _runs.end(), i, [](size_t i, const run &r){ return i < r.first; }) - 1);
+		}
+
+		sane_value operator[](size_t i) const {
+			const run &r = run_at(i);
+			if (r.type == decimal_type) return sane_value(_decimals[r.offset + i - r.first]);
+			return sane_value(r.type, _data.data() + r.offset + (i - r.first) * detail::value_size(r.type));
+		}
+
+		/*
+		 * every value encoded as F into dst (size() * F::size bytes).
+		 * Runs use the transcode kernels where there are any.
+		 */
+		template<class F>
+		void convert(F, void *dst) const {
+			uint8_t *dp = (uint8_t *)dst;
+			for (const run &r : _runs) {
+				if (r.type == decimal_type) {
+					typedef floating_point::detail::transcoder<floating_point::format<10, endian::native>, F> transcoder;
+					decimal_blocks(r, [&](const uint8_t *block, size_t first, size_t n){
+						transcoder::run(block, dp + first * F::size, n);
+					});
+					continue;
+				}
+				detail::visit_format(r.type, [&](auto from){
+					floating_point::detail::transcoder<decltype(from), F>::run(data(r), dp + r.first * F::size, r.count);
+				});
+			}
+		}
+
+		// decimals are classified as their extended values.
+		floating_point::class_counts classify() const {
+			floating_point::class_counts c;
+			for (const run &r : _runs) {
+				if (r.type == decimal_type) {
+					decimal_blocks(r, [&](const uint8_t *block, size_t, size_t n){
+						floating_point::classify(floating_point::format<10, endian::native>{}, block, n, c);
+					});
+					continue;
+				}
+				detail::visit_format(r.type, [&](auto f){ floating_point::classify(f, data(r), r.count, c); });
+			}
+			return c;
+		}
+
+		// each value against value, into out[size()].
+		void compare(const floating_point::canonical &value, relop *out) const {
+			for (const run &r : _runs) {
+				if (r.type == decimal_type) {
+					for (size_t i = 0; i < r.count; ++i)
+						out[r.first + i] = floating_point::compare(canonicalize(_decimals[r.offset + i]), value);
+					continue;
+				}
+				detail::visit_format(r.type, [&](auto f){ floating_point::compare(f, data(r), value, out + r.first, r.count); });
+			}
+		}
+
+		// to_string(operator[](i), df) for each value, into out[size()].
+		void format(const decform &df, std::string *out) const {
+			for (const run &r : _runs) {
+				std::string *sp = out + r.first;
+				if (r.type == decimal_type) {
+					for (size_t i = 0; i < r.count; ++i) dec2str(df, _decimals[r.offset + i], sp[i]);
+					continue;
+				}
+				if (r.type == comp_type) {
+					const uint8_t *cp = _data.data() + r.offset;
+					for (size_t i = 0; i < r.count; ++i) {
+						uint64_t w;
+						std::memcpy(&w, cp + i * 8, 8);
+						dec2str(df, comp2dec(comp(w), df), sp[i]);
+					}
+					continue;
+				}
+				// widened to extended (exactly) a block at a time.
+				detail::visit_format(r.type, [&](auto from){
+					typedef floating_point::format<10, endian::native> X;
+					uint8_t block[256 * 10];
+					const uint8_t *cp = _data.data() + r.offset;
+					for (size_t base = 0; base < r.count; base += 256) {
+						size_t n = std::min((size_t)256, r.count - base);
+						floating_point::detail::transcoder<decltype(from), X>::run(cp + base * decltype(from)::size, block, n);
+						for (size_t i = 0; i < n; ++i) {
+							floating_point::info fpi;
+							fpi.read(X{}, block + i * 10);
+							dec2str(df, x2dec(fpi, df), sp[base + i]);
+						}
+					}
+				});
+			}
+		}
+
+	private:
+		std::vector<run> _runs;
+		std::vector<uint8_t> _data;
+		std::vector<decimal> _decimals;
+		size_t _size = 0;
+
+		// fn(block, first, n) with a decimal run as extended images, 256 at a time.
+		template<class Fn>
+		void decimal_blocks(const run &r, Fn fn) const {
+			uint8_t block[256 * 10];
+			for (size_t base = 0; base < r.count; base += 256) {
+				size_t n = std::min((size_t)256, r.count - base);
+				for (size_t i = 0; i < n; ++i) detail::decimal_image(_decimals[r.offset + base + i], block + i * 10);
+				fn(block, r.first + base, n);
+			}
+		}
+
+		// count more values of type t, stored from offset; extends the last run if it's the same type.
+		void extend(value_type t, size_t count, size_t offset) {
+			if (!count) return;
+			if (_runs.empty() || _runs.back().type != t) _runs.push_back(run{t, _size, 0, offset});
+			_runs.back().count += count;
+			_size += count;
+		}
+	};
+
+}
+
+#endif
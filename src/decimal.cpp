@@ -0,0 +1,805 @@
+
+/*
+ * exact decimal <-> binary conversion.
+ *
+ * Everything is done in integer arithmetic on the 64-bit significand so
+ * the result does not depend on the host long double.
+ */
+
+#include <sane/sane.h>
+#include <sane/floating_point.h>
+#include <sane/soft_extended.h>
+#include <sane/comp.h>
+#include <sane/hash.h>
+#include <sane/compare.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace SANE {
+
+	namespace fp = floating_point;
+
+	namespace {
+
+		/*
+		 * decimal NaNs are N followed by hex digits, in one of two forms:
+		 * up to 4 digits (what str2dec produces) with the quiet bit at
+		 * 0x4000, or 16 digits with it at bit 62, like the extended
+		 * significand.  5 to 15 digits are the short form if the value
+		 * fits in it (leading zeros) and the long one otherwise.  More
+		 * than 16 isn't a NaN code, so it's NANZERO.
+		 */
+		void nan_type(const std::string &s, fp::info &fpi) {
+
+			uint64_t akk = 0;
+			int digits = 0;
+			for (char c : s.substr(1)) {
+				if (std::isdigit(c)) akk = (akk << 4) + c - '0';
+				else if (std::isxdigit(c)) akk = (akk << 4) + (c | 0x20) - 'a' + 10;
+				else continue;
+				++digits;
+			}
+
+			if (digits > 16) akk = 0;
+			int quiet = digits == 16 || akk > 0xffff ? 62 : 14;
+			fpi.nan = true;
+			fpi.signaling = !((akk >> quiet) & 0x01);
+			fpi.sig = akk & ((UINT64_C(1) << quiet) - 1);
+			if (!fpi.sig && fpi.signaling) {
+				fpi.signaling = false;
+				fpi.sig = NANZERO;
+			}
+		}
+
+		std::string nan_string(const fp::info &fpi) {
+
+			uint64_t payload = fpi.sig & (fp::extended_traits::quiet_nan - 1);
+			uint64_t quiet = !fpi.signaling;
+			char buffer[20];
+
+			if (payload < 0x4000)
+				snprintf(buffer, sizeof(buffer), "N%04x", (unsigned)(payload | quiet << 14));
+			else
+				snprintf(buffer, sizeof(buffer), "N%016llx", (unsigned long long)(payload | quiet << 62));
+			return buffer;
+		}
+
+
+		// 5^27 is the largest power that fits in 64 bits.
+		uint64_t pow5(unsigned n) {
+			static const uint64_t table[] = {
+				UINT64_C(1), UINT64_C(5), UINT64_C(25), UINT64_C(125),
+				UINT64_C(625), UINT64_C(3125), UINT64_C(15625), UINT64_C(78125),
+				UINT64_C(390625), UINT64_C(1953125), UINT64_C(9765625), UINT64_C(48828125),
+				UINT64_C(244140625), UINT64_C(1220703125), UINT64_C(6103515625), UINT64_C(30517578125),
+				UINT64_C(152587890625), UINT64_C(762939453125), UINT64_C(3814697265625), UINT64_C(19073486328125),
+				UINT64_C(95367431640625), UINT64_C(476837158203125), UINT64_C(2384185791015625), UINT64_C(11920928955078125),
+				UINT64_C(59604644775390625), UINT64_C(298023223876953125), UINT64_C(1490116119384765625), UINT64_C(7450580596923828125),
+			};
+			return table[n];
+		}
+
+
+		/*
+		 * minimal unsigned big integer.  32-bit words, least significant
+		 * first, no leading 0 words.
+		 */
+		class bigint {
+		public:
+
+			std::vector<uint32_t> w;
+
+			bigint() = default;
+			explicit bigint(uint64_t x) {
+				while (x) {
+					w.push_back(x);
+					x >>= 32;
+				}
+			}
+
+			bool zero() const { return w.empty(); }
+
+			unsigned bits() const {
+				if (w.empty()) return 0;
+				return w.size() * 32 - (fp::clz64(w.back()) - 32);
+			}
+
+			// *this = *this * m + a
+			void mul(uint32_t m, uint32_t a = 0) {
+				uint64_t carry = a;
+				for (auto &x : w) {
+					uint64_t t = (uint64_t)x * m + carry;
+					x = t;
+					carry = t >> 32;
+				}
+				if (carry) w.push_back(carry);
+			}
+
+			void mul_pow5(unsigned n) {
+				// 5^13 is the largest power that fits in 32 bits.
+				for (; n >= 13; n -= 13) mul(pow5(13));
+				if (n) mul(pow5(n));
+			}
+
+			void shl(unsigned n) {
+				if (w.empty() || n == 0) return;
+				unsigned words = n / 32;
+				unsigned bits = n % 32;
+				if (bits) {
+					uint32_t carry = 0;
+					for (auto &x : w) {
+						uint32_t t = x >> (32 - bits);
+						x = (x << bits) | carry;
+						carry = t;
+					}
+					if (carry) w.push_back(carry);
+				}
+				w.insert(w.begin(), words, 0);
+			}
+
+			// decimal digits, no leading 0s.
+			std::string to_string() const {
+				std::vector<uint32_t> chunks;
+				bigint tmp(*this);
+				while (!tmp.zero()) {
+					uint64_t r = 0;
+					for (size_t i = tmp.w.size(); i--; ) {
+						uint64_t t = (r << 32) | tmp.w[i];
+						tmp.w[i] = t / 1000000000;
+						r = t % 1000000000;
+					}
+					if (tmp.w.back() == 0) tmp.w.pop_back();
+					chunks.push_back(r);
+				}
+
+				std::string s;
+				s.reserve(chunks.size() * 9);
+				for (size_t i = chunks.size(); i--; ) {
+					char buffer[9];
+					uint32_t c = chunks[i];
+					int n = 0;
+					do {
+						buffer[n++] = '0' + c % 10;
+						c /= 10;
+					} while (c);
+					if (i + 1 != chunks.size()) s.append(9 - n, '0');
+					while (n) s.push_back(buffer[--n]);
+				}
+				return s;
+			}
+
+		};
+
+
+		/*
+		 * q = a / b (Knuth algorithm D).  returns true if the remainder is
+		 * non-zero.
+		 */
+		bool divide(bigint a, bigint b, bigint &q) {
+
+			q.w.clear();
+			size_t n = b.w.size();
+
+			if (a.w.size() < n) return !a.zero();
+
+			int s = fp::clz64(b.w.back()) - 32;
+			a.shl(s);
+			b.shl(s);
+			a.w.push_back(0);
+
+			size_t m = a.w.size() - n - 1;
+			q.w.assign(m + 1, 0);
+
+			uint64_t top = b.w[n - 1];
+			uint64_t next = n > 1 ? b.w[n - 2] : 0;
+
+			for (size_t j = m + 1; j--; ) {
+				uint64_t num = ((uint64_t)a.w[j + n] << 32) | a.w[j + n - 1];
+				uint64_t qhat = num / top;
+				uint64_t rhat = num % top;
+				uint64_t lower = n > 1 ? a.w[j + n - 2] : 0;
+				while (qhat >> 32 || qhat * next > ((rhat << 32) | lower)) {
+					--qhat;
+					rhat += top;
+					if (rhat >> 32) break;
+				}
+
+				// a[j .. j + n] -= qhat * b
+				uint64_t carry = 0;
+				int64_t borrow = 0;
+				for (size_t i = 0; i < n; ++i) {
+					uint64_t p = qhat * b.w[i] + carry;
+					carry = p >> 32;
+					int64_t t = (int64_t)a.w[i + j] - borrow - (uint32_t)p;
+					a.w[i + j] = t;
+					borrow = t < 0;
+				}
+				int64_t t = (int64_t)a.w[j + n] - borrow - (int64_t)carry;
+				a.w[j + n] = t;
+
+				if (t < 0) {
+					// add back.
+					--qhat;
+					carry = 0;
+					for (size_t i = 0; i < n; ++i) {
+						uint64_t sum = (uint64_t)a.w[i + j] + b.w[i] + carry;
+						a.w[i + j] = sum;
+						carry = sum >> 32;
+					}
+					a.w[j + n] += carry;
+				}
+				q.w[j] = qhat;
+			}
+
+			while (!q.w.empty() && q.w.back() == 0) q.w.pop_back();
+			return std::any_of(a.w.begin(), a.w.end(), [](uint32_t x){ return x != 0; });
+		}
+
+
+		/*
+		 * round the digit string s (value s * 10^exp) to keep digits,
+		 * signaling INEXACT if any dropped digit wasn't 0.  keep may be
+		 * <= 0.  The result may carry out to keep + 1 digits.
+		 */
+		void round_digits(std::string &s, int &exp, int keep, bool sign, rounding_direction rd) {
+
+			if (keep < 0) {
+				s.insert(0, -keep, '0');
+				keep = 0;
+			}
+
+			int drop = s.length() - keep;
+			if (drop <= 0) return;
+
+			int round = s[keep] - '0';
+			bool sticky = std::any_of(s.begin() + keep + 1, s.end(), [](char c){ return c != '0'; });
+
+			s.resize(keep);
+			exp += drop;
+			if (round || sticky) signal_exceptions(INEXACT);
+
+			bool up = false;
+			switch (rd) {
+				case TONEAREST:
+					up = round > 5 || (round == 5 && (sticky || (keep && (s.back() & 0x01))));
+					break;
+				case UPWARD:
+					up = !sign && (round || sticky);
+					break;
+				case DOWNWARD:
+					up = sign && (round || sticky);
+					break;
+				case TOWARDZERO:
+					break;
+			}
+
+			if (!up) return;
+
+			for (auto iter = s.rbegin(); iter != s.rend(); ++iter) {
+				if (*iter != '9') {
+					++*iter;
+					return;
+				}
+				*iter = '0';
+			}
+			s.insert(s.begin(), '1');
+		}
+
+		/*
+		 * value = m * 2^e.  returns the digits of value / 10^t (value ~ s * 10^exp).
+		 * if inexact, a trailing 1 is appended as a sticky digit.
+		 */
+		std::string scaled_digits(uint64_t m, int e, int t, int &exp) {
+
+			// m * 2^e / (2^t * 5^t)
+			bigint a(m);
+			bigint b(1);
+			if (t < 0) a.mul_pow5(-t);
+			if (t > 0) b.mul_pow5(t);
+			if (e - t > 0) a.shl(e - t);
+			if (e - t < 0) b.shl(t - e);
+
+			bigint q;
+			bool sticky = divide(a, b, q);
+
+			std::string s = q.to_string();
+			exp = t;
+			if (sticky) {
+				s.push_back('1');
+				--exp;
+			}
+			return s;
+		}
+
+		/*
+		 * (hi:lo) * 2^shift = the top 128 bits of a.  false if that
+		 * drops any 1 bits.
+		 */
+		bool window128(const bigint &a, uint64_t &hi, uint64_t &lo, int &shift) {
+
+			shift = std::max((int)a.bits() - 128, 0);
+
+			auto bit = [&](int i){ return (uint64_t)(a.w[i / 32] >> (i % 32)) & 0x01; };
+
+			uint64_t x[2] = {};
+			for (int i = shift; i < (int)a.bits(); ++i)
+				x[(i - shift) / 64] |= bit(i) << ((i - shift) % 64);
+			lo = x[0];
+			hi = x[1];
+
+			for (int i = 0; i < shift; ++i)
+				if (bit(i)) return false;
+			return true;
+		}
+
+		soft_extended pow10(unsigned n) {
+			return soft_extended::make(false, 63 + (int)n, pow5(n), 0);
+		}
+
+	}
+
+
+	decimal x2dec(const fp::info &fpi, const decform &df, rounding_direction rd) {
+
+		/*
+		 * SANE pp 27 - 31
+		 *
+		 * Floating style (0):
+		 * [-| ]m[.nnn]e[+|-]dddd
+		 * digits is the number of significant digits
+		 *
+		 * Fixed style (1):
+		 * [-]mmm[.nnn]
+		 * digits is the number of digits to the right of the decimal point
+		 * (left if negative)
+		 */
+
+		decimal d;
+		int digits = df.digits;
+		// SANE requires at least 18 digits.
+		// IIgs sane allows 28 digits
+		// MacOS sane allows 20 digits.
+		if (digits > 32) digits = 32;
+
+		d.sgn = fpi.sign;
+
+		if (fpi.nan) {
+			d.sig = nan_string(fpi);
+			return d;
+		}
+
+		if (fpi.inf) {
+			d.sig = "I";
+			return d;
+		}
+
+		if (fpi.sig == 0) {
+			d.sig = "0";
+			return d;
+		}
+
+		// value = m * 2^e exactly.
+		uint64_t m = fpi.sig;
+		int e = fpi.exp - 63;
+		int bits = 64 - fp::clz64(m);
+
+		// scale by 10^-t so only the digits needed are generated.
+		int t;
+		if (df.style == decform::FIXEDDECIMAL) t = -digits - 1;
+		else {
+			int k = std::floor((e + bits - 1) * 0.30102999566398120);
+			t = k - std::max(digits, 1) - 1;
+		}
+
+		int exp;
+		std::string s = scaled_digits(m, e, t, exp);
+
+		if (df.style == decform::FIXEDDECIMAL) {
+
+			int shift = exp + digits;
+			if (shift >= 0) {
+				s.append(shift, '0');
+				exp -= shift;
+			}
+			else round_digits(s, exp, s.length() + shift, fpi.sign, rd);
+
+			if (s.empty()) s = "0";
+			d.sig = std::move(s);
+			d.exp = exp;
+			return d;
+		}
+
+		// float
+		size_t n = std::max(digits, 1);
+		round_digits(s, exp, n, fpi.sign, rd);
+		if (s.length() > n) {
+			// 999 -> 1000
+			s.pop_back();
+			++exp;
+		}
+		while (s.length() < n) {
+			s.push_back('0');
+			--exp;
+		}
+
+		d.sig = std::move(s);
+		d.exp = exp;
+		return d;
+	}
+
+
+	void dec2x(const decimal &d, fp::info &fpi, rounding_direction rd) {
+
+		fpi = fp::info();
+		fpi.sign = d.sgn;
+
+		// page 38 -- leading 0 is 0.
+		if (d.sig.empty() || d.sig[0] == '0') return;
+
+		if (d.sig[0] == 'I') {
+			fpi.inf = true;
+			return;
+		}
+
+		if (d.sig[0] == 'N') {
+			nan_type(d.sig, fpi);
+			return;
+		}
+
+		if (!std::all_of(d.sig.begin(), d.sig.end(), [](char c){ return std::isdigit(c); })) {
+			fpi.nan = true;
+			fpi.sig = NANASCBIN;
+			return;
+		}
+
+		std::string s = d.sig;
+		int exp = d.exp;
+		while (s.back() == '0') {
+			s.pop_back();
+			++exp;
+		}
+		int nd = s.length();
+
+		soft_extended x;
+		unsigned flags = 0;
+
+		if (nd - 1 + exp > 4932) {
+			// >= 1e4933.  overflow (or max) depending on rounding.
+			x = soft_extended::make(d.sgn, 20000, UINT64_C(1) << 63, 0, rd);
+			flags = OVERFLOW | INEXACT;
+		}
+		else if (nd + exp < -4951) {
+			// < 1e-4951.  0 (or min) depending on rounding.
+			x = soft_extended::make(d.sgn, -20000, UINT64_C(1) << 63, 0, rd);
+			flags = UNDERFLOW | INEXACT;
+		}
+		else if (nd <= 19 && exp >= -27 && exp <= 27) {
+			// exact integer and exact power of 10 -- one rounding.
+			uint64_t m = std::accumulate(s.begin(), s.end(), UINT64_C(0), [](uint64_t akk, char c){
+				return akk * 10 + c - '0';
+			});
+
+			x = soft_extended::make(d.sgn, 63, m, 0, rd);
+			if (exp > 0) x = mul(x, pow10(exp), rd);
+			if (exp < 0) x = div(x, pow10(-exp), rd);
+
+			// m and 10^exp are exact, so only the one operation can round.
+			if (exp > 0) {
+				uint64_t hi, lo;
+				fp::mul64(m, pow5(exp), hi, lo);
+				if (hi && (lo << fp::clz64(hi)) != 0) flags = INEXACT;
+			}
+			if (exp < 0 && m % pow5(-exp)) flags = INEXACT;
+		}
+		else {
+			// d * 10^exp == (d * 5^exp) * 2^exp.  a / b with a 128-bit quotient.
+			bigint a;
+			for (size_t i = 0; i < s.length(); i += 9) {
+				size_t len = std::min(s.length() - i, (size_t)9);
+				uint32_t chunk = std::stoul(s.substr(i, len));
+				uint32_t scale = 1;
+				for (size_t j = 0; j < len; ++j) scale *= 10;
+				a.mul(scale, chunk);
+			}
+
+			bigint b(1);
+			if (exp > 0) a.mul_pow5(exp);
+			if (exp < 0) b.mul_pow5(-exp);
+
+			// 2^126 < a * 2^shift / b < 2^128
+			int shift = 127 - ((int)a.bits() - (int)b.bits());
+			if (shift > 0) a.shl(shift);
+			if (shift < 0) b.shl(-shift);
+
+			bigint q;
+			bool sticky = divide(a, b, q);
+			q.w.resize(4);
+
+			uint64_t hi = ((uint64_t)q.w[3] << 32) | q.w[2];
+			uint64_t lo = ((uint64_t)q.w[1] << 32) | q.w[0];
+			x = soft_extended::make(d.sgn, 127 - shift + exp, hi, lo | sticky, rd);
+
+			// the bits below the top 64, more if it's denormal.
+			int c = fp::clz64(hi);
+			int e = 127 - shift + exp - c;
+			uint64_t nhi = c ? hi << 1 | lo >> 63 : hi;
+			uint64_t nlo = lo << c;
+			int below = e < fp::extended_traits::min_exp ? fp::extended_traits::min_exp - e : 0;
+			bool inexact = sticky || nlo || (below >= 64 || (below && nhi << (64 - below)));
+			if (inexact) flags = INEXACT | (below ? UNDERFLOW : 0);
+			if (e > fp::extended_traits::max_exp) flags = OVERFLOW | INEXACT;
+		}
+
+		// rounding up to infinity.
+		if ((x.sexp & fp::extended_traits::nan_exp) == fp::extended_traits::nan_exp) flags |= OVERFLOW | INEXACT;
+
+		fpi = (fp::info)x;
+		signal_exceptions(flags);
+	}
+
+
+	/*
+	 * comp <-> decimal on the integer and the digit string.  The results
+	 * are x2dec((long double)c, df) and comp(dec2x(d)), without the
+	 * intermediate rounding to 64 bits: dec2comp truncates the decimal
+	 * value itself.
+	 */
+	decimal comp2dec(const comp &c, const decform &df, rounding_direction rd) {
+
+		if (isnan(c)) {
+			fp::info fpi;
+			fpi.nan = true;
+			fpi.sig = NANCOMP;
+			return x2dec(fpi, df);
+		}
+
+		decimal d;
+		int64_t v = (int64_t)c;
+		if (!v) {
+			d.sig = "0";
+			return d;
+		}
+
+		d.sgn = v < 0;
+		uint64_t m = v < 0 ? -(uint64_t)v : v;
+		std::string s(detail::count_digits(m), '0');
+		detail::write_digits(&s[0] + s.length(), m);
+
+		int digits = std::min((int)df.digits, 32);
+		int exp = 0;
+
+		if (df.style == decform::FIXEDDECIMAL) {
+			if (digits >= 0) {
+				s.append(digits, '0');
+				exp = -digits;
+			}
+			else round_digits(s, exp, s.length() + digits, d.sgn, rd);
+
+			if (s.empty()) s = "0";
+			d.sig = std::move(s);
+			d.exp = exp;
+			return d;
+		}
+
+		int n = std::max(digits, 1);
+		round_digits(s, exp, n, d.sgn, rd);
+		if ((int)s.length() > n) {
+			// 999 -> 1000
+			s.pop_back();
+			++exp;
+		}
+		while ((int)s.length() < n) {
+			s.push_back('0');
+			--exp;
+		}
+
+		d.sig = std::move(s);
+		d.exp = exp;
+		return d;
+	}
+
+	comp dec2comp(const decimal &d, rounding_direction rd) {
+
+		const comp nan(comp::NaN);
+
+		// page 38 -- leading 0 is 0.
+		if (d.sig.empty() || d.sig[0] == '0') return comp(0);
+
+		// infinities, NaNs and invalid digit strings.
+		if (!std::all_of(d.sig.begin(), d.sig.end(), [](char c){ return std::isdigit(c); })) {
+			signal_exceptions(INVALID);
+			return nan;
+		}
+
+		int nd = d.sig.length();
+		while (nd > 1 && d.sig[nd - 1] == '0') --nd;
+		int exp = d.exp + (int)(d.sig.length() - nd);
+
+		// integer digits.  10^18 < 2^63 < 10^19.
+		int n = nd + exp;
+		if (n > 19) {
+			signal_exceptions(INVALID);
+			return nan;
+		}
+
+		uint64_t m = 0;
+		for (int i = 0; i < n; ++i)
+			m = m * 10 + (i < nd ? d.sig[i] - '0' : 0);
+
+		// digits past the point (the last is never 0).
+		if (n < nd) {
+			int round = n >= 0 ? d.sig[n] - '0' : 0;
+			bool sticky = n < 0 || nd > n + 1;
+			bool up = false;
+			switch (rd) {
+				case TONEAREST: up = round > 5 || (round == 5 && (sticky || (m & 1))); break;
+				case UPWARD: up = !d.sgn; break;
+				case DOWNWARD: up = d.sgn; break;
+				case TOWARDZERO: break;
+			}
+			m += up;
+			signal_exceptions(INEXACT);
+		}
+
+		if (m > (uint64_t)INT64_MAX) {
+			signal_exceptions(INVALID);
+			return nan;
+		}
+		return comp(d.sgn ? -(int64_t)m : (int64_t)m);
+	}
+
+
+	void truncate(decimal &d, int digits, rounding_direction rd) {
+		if (digits < 1) digits = 1;
+		if ((int)d.sig.length() <= digits) return;
+
+		// special case for N, I
+		if (d.sig.front() == 'I' || d.sig.front() == 'N') {
+			d.sig.resize(digits);
+			return;
+		}
+
+		int exp = d.exp;
+		round_digits(d.sig, exp, digits, d.sgn, rd);
+		d.exp = exp;
+
+		// remove trailing 0s (including 99 -> 100).
+		while (d.sig.length() > 1 && d.sig.back() == '0') {
+			d.sig.pop_back();
+			d.exp++;
+		}
+	}
+
+
+	fp::canonical canonicalize(const decimal &d) {
+
+		fp::canonical c;
+
+		if (d.sig.empty() || d.sig[0] == '0') return c;
+		if (d.sig[0] == 'I') return fp::detail::make_special(fp::canonical::infinite, d.sgn);
+		if (d.sig[0] == 'N' || !std::all_of(d.sig.begin(), d.sig.end(), [](char c){ return std::isdigit(c); }))
+			return fp::detail::make_special(fp::canonical::nan);
+
+		size_t nd = d.sig.find_last_not_of('0') + 1;
+		int exp = d.exp + (int)(d.sig.length() - nd);
+
+		// value = m * 5^exp * 2^exp
+		if (nd <= 19 && exp >= -27 && exp <= 27) {
+			uint64_t m = std::accumulate(d.sig.begin(), d.sig.begin() + nd, UINT64_C(0), [](uint64_t akk, char c){
+				return akk * 10 + c - '0';
+			});
+			uint64_t p = pow5(std::abs(exp));
+
+			if (exp >= 0) {
+				uint64_t hi, lo;
+				fp::mul64(m, p, hi, lo);
+				return fp::detail::make_finite(d.sgn, 127 + exp, hi, lo);
+			}
+			if (m % p == 0) return fp::detail::make_finite(d.sgn, 127 + exp, 0, m / p);
+
+			c.lo = m;
+			c.exp = exp;
+			c.kind = fp::canonical::nonbinary;
+			c.sign = d.sgn;
+			return c;
+		}
+
+		bigint a;
+		for (size_t i = 0; i < nd; i += 9) {
+			size_t len = std::min(nd - i, (size_t)9);
+			uint32_t chunk = std::stoul(d.sig.substr(i, len));
+			uint32_t scale = 1;
+			for (size_t j = 0; j < len; ++j) scale *= 10;
+			a.mul(scale, chunk);
+		}
+
+		uint64_t hi, lo;
+		int shift;
+
+		if (exp >= 0) {
+			bigint b(a);
+			b.mul_pow5(exp);
+			if (window128(b, hi, lo, shift))
+				return fp::detail::make_finite(d.sgn, 127 + exp + shift, hi, lo);
+		}
+		else {
+			bigint b(1), q;
+			b.mul_pow5(-exp);
+			if (!divide(a, b, q) && window128(q, hi, lo, shift))
+				return fp::detail::make_finite(d.sgn, 127 + exp + shift, hi, lo);
+		}
+
+		// decimal records hold at most SIGDIGLEN digits, which fit.
+		window128(a, hi, lo, shift);
+		c.hi = hi;
+		c.lo = lo;
+		c.exp = exp;
+		c.kind = fp::canonical::nonbinary;
+		c.sign = d.sgn;
+		return c;
+	}
+
+
+	/*
+	 * value = m * 2^p2 * 5^p5.  Bit counts bound log2 of each side, which
+	 * settles anything not within a factor of 2; the rest is exact.
+	 */
+	int fp::detail::compare_magnitude(const fp::canonical &a, const fp::canonical &b) {
+
+		struct term {
+			int p2 = 0;
+			int p5 = 0;
+			double lower;
+			double upper;
+		};
+
+		auto make = [](const fp::canonical &c) {
+			term t;
+			t.p2 = c.exp - 127;
+			if (c.kind == fp::canonical::nonbinary) t.p2 = t.p5 = c.exp;
+			int bits = c.hi ? 128 - fp::clz64(c.hi) : 64 - fp::clz64(c.lo);
+			double log2 = bits + t.p2 + t.p5 * 2.321928094887362;
+			t.lower = log2 - 1 - 1e-6;
+			t.upper = log2 + 1e-6;
+			return t;
+		};
+
+		term x = make(a);
+		term y = make(b);
+
+		if (x.upper < y.lower) return -1;
+		if (y.upper < x.lower) return 1;
+
+		auto value = [](const fp::canonical &c) {
+			bigint m(c.hi);
+			for (int shift = 32; shift >= 0; shift -= 32) {
+				m.mul(65536);
+				m.mul(65536, c.lo >> shift);
+			}
+			return m;
+		};
+
+		bigint mx = value(a);
+		bigint my = value(b);
+		int p2 = std::min(x.p2, y.p2);
+		int p5 = std::min(x.p5, y.p5);
+		mx.shl(x.p2 - p2);
+		my.shl(y.p2 - p2);
+		mx.mul_pow5(x.p5 - p5);
+		my.mul_pow5(y.p5 - p5);
+
+		if (mx.w.size() != my.w.size()) return mx.w.size() < my.w.size() ? -1 : 1;
+		for (size_t i = mx.w.size(); i--; ) {
+			if (mx.w[i] != my.w[i]) return mx.w[i] < my.w[i] ? -1 : 1;
+		}
+		return 0;
+	}
+
+}
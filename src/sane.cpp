@@ -33,59 +33,12 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
  
 #include <numeric>
 #include <algorithm>
 #include <stdexcept>
 
-#include "sane_config.h"
-
-#ifndef HAVE_ASPRINTF
-
-#include <cstdarg>
-
-namespace {
-
-	int vasprintf(char **out, const char *fmt, va_list ap) {
-		int size;
-		char *cp;
-		char buffer[256];
-
-		size = vsnprintf(buffer, sizeof(buffer), fmt, ap);
-		if (size < 0) return size;
-
-		if (size < sizeof(buffer)) {
-			cp = strdup(buffer);
-			*out = cp;
-			if (!cp) return -1;
-
-			return size;
-		}
-
-		cp = (char *)malloc(size + 1);
-		*out = cp;
-
-		if (!cp) return -1;
-
-		return vsnprintf(cp, size+1, fmt, ap);
-	}
-
-	int asprintf(char **out, const char *fmt, ...) {
-		int size;
-		va_list ap;
-		va_start(ap, fmt);
-
-		size = vasprintf(out, fmt, ap);
-		va_end(ap);
-		return size;
-	}
-
-}
-
-
-#endif
-
-
 namespace SANE {
 
 	namespace fp = floating_point;
@@ -98,20 +51,6 @@ namespace SANE {
 	using std::signbit;
 
 
-	namespace {
-		// Nxxxx -> int. 0 if empty.
-		unsigned nan_type(const std::string &s) {
-
-			return std::accumulate(s.begin() + 1, s.end(), 0, [](uint32_t akk, char c){
-				if (std::isdigit(c)) { akk = (akk << 4) + c - '0'; }
-				else if (std::isxdigit(c)) { akk = (akk << 4) + (c | 0x20) - 'a'; }
-				return akk;
-			});
-
-		}
-	}
-
-
 	template<>
 	comp make_nan<comp>(unsigned code) {
 		return comp(UINT64_C(0x8000000000000000));
@@ -119,52 +58,16 @@ namespace SANE {
 
 	template<>
 	decimal make_nan<decimal>(unsigned code) {
-		std::string s = "N";
-		code = code & 0xffff;
-		if (code) {
-
-			const char *hexstr = "0123456789abcdef";
-			// 4-byte hex
-			s.push_back(hexstr[(code >> 12) & 0x0f]);
-			s.push_back(hexstr[(code >> 8) & 0x0f]);
-			s.push_back(hexstr[(code >> 4) & 0x0f]);
-			s.push_back(hexstr[(code >> 0) & 0x0f]);
-
-		}
-		decimal d{ 0, 0, s};
-		return d;
-	}
-
-	template<>
-	float make_nan<float>(unsigned code) {
-		if (!code) code = NANZERO;
-
-		floating_point::info i;
-		i.nan = true;
-		i.sig = code;
-		return (float)i;
-	}
-
-	template<>
-	double make_nan<double>(unsigned code) {
-		if (!code) code = NANZERO;
-
-		floating_point::info i;
-		i.nan = true;
-		i.sig = code;
-		return (double)i;
-	}
-
-	template<>
-	long double make_nan<long double>(unsigned code) {
-		if (!code) code = NANZERO;
-
-		floating_point::info i;
-		i.nan = true;
-		i.sig = code;
-		return (long double)i;
+		fp::info fpi;
+		fpi.nan = true;
+		fpi.sig = code ? code : (unsigned)NANZERO;
+		return x2dec(fpi, decform());
 	}
 
+	// out of line copies for code compiled against older headers.
+	template float make_nan<float>(unsigned);
+	template double make_nan<double>(unsigned);
+	template long double make_nan<long double>(unsigned);
 
 
 
@@ -198,7 +101,10 @@ namespace SANE {
 			return;
 		}
 		if (sig[0] == 'N') {
-			unsigned type = nan_type(sig);
+			// the SANE code is the low byte of the payload.
+			fp::info fpi;
+			dec2x(d, fpi);
+			unsigned type = fpi.sig & 0xff;
 			std::string tmp;
 			tmp.reserve(3);
 			if (type > 0 && type < 1000) {
@@ -231,14 +137,12 @@ namespace SANE {
 			if (digits > 80) { s = "?"; return; }
 			while (digits > 1) { s.push_back('0'); --digits; }
 
-			s.push_back('e');
-			if (exp < 0) {
-				// to_string() will include the -
-				s.append(std::to_string(exp));
-			} else {
-				s.push_back('+');
-				s.append(std::to_string(exp));
-			}
+			char tmp[16];
+			tmp[0] = 'e';
+			tmp[1] = '+';
+			// format_integer() will include the -
+			char *end = detail::format_integer(tmp + 1 + (exp >= 0), tmp + sizeof(tmp), exp);
+			s.append(tmp, end);
 
 			// if > 80 in length, return '?'
 			if (s.length() > 80) s = "?";
@@ -306,288 +210,175 @@ namespace SANE {
 	}
 
 
-	long double dec2x(const decimal &d) {
-		// todo -- if sig is empty, NAN or 0?
-
-		if (d.sig.empty() || d.sig[0] == '0') {
-			return d.sgn ? -0.0 : 0.0;
-		}
-		if (d.sig[0] == 'I') {
-			return d.sgn? -INFINITY : INFINITY;
-		}
-		if (d.sig[0] == 'N') {
-			// todo -- NaN type?
-			long double tmp = make_nan<long double>(nan_type(d.sig));
-			return d.sgn ? -tmp : tmp;
-		}
-
-
-		std::string str = d.sig + "e" + std::to_string(d.exp);
-		const char *cstr = str.c_str();
-		char *end;
-		long double tmp = std::strtold(cstr, &end);
-		if (end-cstr != str.length()) {
-			tmp = make_nan<long double>(NANASCBIN);
-		}
-
-		if (d.sgn) tmp = -tmp;
-		return tmp;
+	long double dec2x(const decimal &d, rounding_direction rd) {
+		fp::info fpi;
+		dec2x(d, fpi, rd);
+		return (long double)fpi;
 	}
 
-	static bool all_zero(const std::string &s) {
-		return std::all_of(s.begin(), s.end(), [](char c){ return c == '0'; });
+	decimal x2dec(long double x, const decform &df, rounding_direction rd) {
+		return x2dec(fp::info(x), df, rd);
 	}
 
 
-	static void format_f(long double x, int precision, std::string &mm, std::string &nn)
-	{
-		char *buffer = nullptr;
-
-		mm.clear();
-		nn.clear();
+	int fpclassify(const decimal &d) {
+		if (d.sig.empty() || d.sig.front() == '0') return FP_ZERO;
+		if (d.sig.front() == 'N') return FP_NAN;
+		if (d.sig.front() == 'I') return FP_INFINITE;
+		return FP_NORMAL;
+	}
 
-		if (precision < 0) precision = 0;
-		int length = asprintf(&buffer, "%.*Lf", precision, x);
-		std::string tmp(buffer, length);
-		free(buffer);
+	inline int isfinite(const decimal &d) {
+		return d.sig.empty() || std::isdigit(d.sig.front());
+	}
 
-		auto dot = tmp.find('.');
-		if (dot == tmp.npos)
-		{
-			mm = std::move(tmp);
-		}
-		else
-		{
-			mm = tmp.substr(0, dot);
-			nn = tmp.substr(dot + 1);
-		}
+	inline int isnormal(const decimal &d) {
+		if (d.sig.empty() || d.sig.front() == '0') return false;
+		return std::isdigit(d.sig.front());
+	}
 
-		// skip mm if it's 0
-		if (mm.length() == 1 && mm.front() == '0') mm.clear();
+	std::string to_string(const comp &c) {
 
-		// skip nn if it's 0000...
-		if (std::all_of(nn.begin(), nn.end(), [](char c){ return c == '0'; }))
-			nn.clear();
+		char buffer[24];
+		return std::string(buffer, to_chars(buffer, buffer + sizeof(buffer), c));
 	}
 
+	char *to_chars(char *first, char *last, const comp &c, int scale, int digits, rounding_direction rd) {
 
-	static void format_e(long double x, int precision, std::string &mm, std::string &nn, int16_t &exp)
-	{
-		char *buffer = nullptr;
-
-		exp = 0;
-		mm.clear();
-		nn.clear();
+		if (isnan(c)) {
+			if (last - first < 8) return nullptr;
+			std::memcpy(first, "NAN(020)", 8);
+			return first + 8;
+		}
 
-		if (precision < 0) precision = 0;
-		// if (precision > 19) precision = 19;
+		int64_t v = (int64_t)c;
+		uint64_t m = v < 0 ? -(uint64_t)v : v;
+		bool inexact = false;
+
+		// drop scale - digits digits.
+		if (digits < scale) {
+			uint64_t p = detail::pow10(scale - digits);
+			uint64_t q = m / p;
+			uint64_t r = m % p;
+			inexact = r != 0;
+			if (r) {
+				switch (rd) {
+					case UPWARD: q += v >= 0; break;
+					case DOWNWARD: q += v < 0; break;
+					case TOWARDZERO: break;
+					default: q += r > p - r || (r == p - r && (q & 1)); break;
+				}
+			}
+			m = q;
+			scale = digits;
+		}
 
-		int length = asprintf(&buffer, "%.*Le", precision, x);
-		// output mm . nn e[+-]exp
-		// mm e[+-]exp
-		std::string tmp(buffer, length);
-		free(buffer);
+		char tmp[20];
+		int n = detail::count_digits(m);
+		detail::write_digits(tmp + n, m);
 
-		auto dot = tmp.find('.');
-		auto e = tmp.find('e');
+		// [-]mmm.fff000
+		int whole = std::max(n - scale, 1);
+		int size = (v < 0) + whole + (digits ? 1 + digits : 0);
+		if (last - first < size) return nullptr;
 
-		if (dot == tmp.npos)
-		{
-			mm = tmp.substr(0, e);
+		char *cp = first;
+		if (v < 0) *cp++ = '-';
+		if (n > scale) {
+			std::memcpy(cp, tmp, n - scale);
+			cp += n - scale;
 		}
-		else
-		{
-			mm = tmp.substr(0, dot);
-			nn = tmp.substr(dot + 1, e - dot - 1);
+		else *cp++ = '0';
+
+		if (digits) {
+			*cp++ = '.';
+			int lead = std::max(scale - n, 0);
+			std::memset(cp, '0', lead);
+			cp += lead;
+			int frac = std::min(n, scale);
+			std::memcpy(cp, tmp + n - frac, frac);
+			cp += frac;
+			std::memset(cp, '0', digits - scale);
+			cp += digits - scale;
 		}
-
-		char sign = tmp[e+1];
-		tmp = tmp.substr(e + 2);
-		exp = std::stoi(tmp);
-		if (sign == '-') exp = -exp;
+		if (inexact) signal_exceptions(INEXACT);
+		return cp;
 	}
 
+	const char *from_chars(const char *first, const char *last, comp &c, int scale, rounding_direction rd) {
 
+		const char *cp = first;
+		bool sign = false;
+		if (cp != last && (*cp == '-' || *cp == '+')) sign = *cp++ == '-';
 
-	decimal x2dec(long double x, const decform &df) {
-
-		/*
-		 * SANE pp 27 - 31
-		 *
-		 * Floating style (0):
-		 * [-| ]m[.nnn]e[+|-]dddd
-		 * digits is the number of significant digits
-		 *
-		 * Fixed style (1):
-		 * [-]mmm[.nnn]
-		 * digits is the number of digits to the right of the decimal point
-		 * (left if negative)
-		 */
-
-		decimal d;
-		int digits = df.digits;
-		// SANE requires at least 18 digits.
-		// IIgs sane allows 28 digits
-		// MacOS sane allows 20 digits.
-		// if (digits < 0) digits = 0;
-		if (digits > 32) digits = 32;
-
-		fp::info fpi(x);
-		//fprintf(stderr, "%02x %02x %d %016llx\n", fpi.sign, fpi.one, fpi.exp, fpi.sig);
-
-
-		d.sgn = signbit(x);
-
-		// handle infinity, nan as a special case.
-		switch (fpclassify(x))
-		{
-			case FP_ZERO:
-				d.sig = "0";
-				return d;
-
-			case FP_NAN: {
-				// TODO -- Macintosh returns N + 16-digit hex number.
-				// TODO -- Apple IIgs returns N + 6-digit hex number.
-				// NAN type encoded in the sig.
-					char buffer[20]; // 16 + 2 needed
-					// todo -- use 4 hex digits if possible...
-					snprintf(buffer, sizeof(buffer), "N%04x", (unsigned)fpi.sig & 0xffff);
-					d.sig = buffer;
-					return d;
+		// NAN(020) as to_chars writes it; any code (or none) is the NaN.
+		if (last - cp >= 3 && std::toupper((unsigned char)cp[0]) == 'N' && std::toupper((unsigned char)cp[1]) == 'A' && std::toupper((unsigned char)cp[2]) == 'N') {
+			cp += 3;
+			if (cp != last && *cp == '(') {
+				const char *p = cp + 1;
+				while (p != last && std::isdigit((unsigned char)*p)) ++p;
+				if (p != last && *p == ')') cp = p + 1;
 			}
-
-			case FP_INFINITE:
-				d.sig = "I";
-				return d;				
-
-			default:
-				break;
-
+			c = comp(comp::NaN);
+			return cp;
 		}
 
-		// normal and subnormal handled here....
-
-		// float decimal: df.digits refers to the total length
-		// fixed decimal: df.digits refers to the fractional part only.
-
-		x = abs(x);
-
-
-		if (df.style == decform::FIXEDDECIMAL) {
-
-			std::string mm;
-			std::string nn;
-
-			if (digits < 0) {
-				d.sig = "0";
-				d.exp = -digits;
-			}
-
-			format_f(x, digits, mm, nn);
+		// 19 digits always fit in 64 bits; more (after leading 0s) is out of range.
+		uint64_t m = 0;
+		int n = 0;
+		bool any = false;
+		unsigned d;
 
-			d.exp = -digits;
+		for (; cp != last && (d = *cp - '0') < 10; ++cp) {
+			m = m * 10 + d;
+			n += (n | m) != 0;
+			any = true;
+		}
 
-			if (mm.empty() && nn.empty())
-			{
-				// very large 0.
-				d.sig = "0";
-				return d;
+		int frac = 0, round = -1;
+		bool sticky = false;
+		if (cp != last && *cp == '.') {
+			++cp;
+			for (; cp != last && (d = *cp - '0') < 10 && frac < scale; ++cp, ++frac) {
+				m = m * 10 + d;
+				n += (n | m) != 0;
+				any = true;
 			}
-
-			if (mm.empty()) {
-				// don't include leading 0s.
-				auto iter = nn.begin();
-				auto end = nn.end();
-				while (iter != end && *iter == '0') ++iter;
-				d.sig.assign(iter, end);
-				return d;
+			// past the scale, only for rounding.
+			if (cp != last && (d = *cp - '0') < 10) {
+				round = d;
+				any = true;
+				while (++cp != last && (d = *cp - '0') < 10) sticky |= d != 0;
 			}
-
-			while(nn.length() < digits) nn.push_back('0');
-			d.sig = std::move(mm);
-			d.sig.append(nn);
-			return d;
-		} else {
-
-			// float
-
-			std::string mm;
-			std::string nn;
-			int16_t exp = 0;
-
-			int dm1 = digits - 1;
-			if (dm1 < 0) dm1 = 0;
-
-			format_e(x, dm1, mm, nn, exp);
-
-			d.sig = std::move(mm);
-			d.sig.append(nn);
-			d.exp = exp - nn.length();
-			return d;
 		}
 
-	}
-
-
-
-	void truncate(decimal &d, int digits) {
-		if (digits < 1) digits = 1;
-		if (d.sig.length() <= digits) return;
-
-		// special case for N, I
-		if (d.sig.front() == 'I' || d.sig.front() == 'N') {
-			d.sig.resize(digits);
-			return;
+		if (!any) {
+			c = comp(comp::NaN);
+			return nullptr;
 		}
 
-		bool ru = d.sig[digits] >= '5';
-		d.exp += (d.sig.length() - digits);
-		d.sig.resize(digits);
-
-		// round up...
-		// TODO -- should round towards even number
-		while (!d.sig.empty() && ru) {
-			auto &c = d.sig.back();
-			++c;
-			ru = (c > '9');
-			if (ru) {
-				d.exp++;
-				d.sig.pop_back();
+		// m wraps once n passes 19, but then it's the NaN anyway.
+		n += m ? scale - frac : 0;
+		m *= detail::pow10(scale - frac);
+
+		bool inexact = round > 0 || sticky;
+		if (inexact) {
+			switch (rd) {
+				case UPWARD: m += !sign; break;
+				case DOWNWARD: m += sign; break;
+				case TOWARDZERO: break;
+				default: m += round > 5 || (round == 5 && (sticky || (m & 1))); break;
 			}
 		}
 
-		// 99 -> (1) 00.  exp already bumped.
-		if (ru && d.sig.empty()) d.sig = "1";
-
-		// remove trailing 0s.
-		while (d.sig.length() > 1 && d.sig.back() == '0') {
-			d.sig.pop_back();
-			d.exp++;
+		if (n > 19 || m > (uint64_t)INT64_MAX) {
+			c = comp(comp::NaN);
+			signal_exceptions(INVALID);
+		} else {
+			c = comp(sign ? -(int64_t)m : (int64_t)m);
+			if (inexact) signal_exceptions(INEXACT);
 		}
-
-	}
-
-
-	int fpclassify(const decimal &d) {
-		if (d.sig.empty() || d.sig.front() == '0') return FP_ZERO;
-		if (d.sig.front() == 'N') return FP_NAN;
-		if (d.sig.front() == 'I') return FP_INFINITE;
-		return FP_NORMAL;
-	}
-
-	inline int isfinite(const decimal &d) {
-		return d.sig.empty() || std::isdigit(d.sig.front());
-	}
-
-	inline int isnormal(const decimal &d) {
-		if (d.sig.empty() || d.sig.front() == '0') return false;
-		return std::isdigit(d.sig.front());
-	}
-
-	std::string to_string(const comp &c) {
-
-		if (isnan(c)) return std::string("nan");
-		return std::to_string((int64_t)c);
+		return cp;
 	}
 
 
@@ -0,0 +1,956 @@
+
+/*
+ * micro benchmarks.  Not a test -- run by hand:
+ *
+ * sane_bench [filter]
+ */
+
+#include <sane/sane.h>
+#include <sane/info_batch.h>
+#include <sane/floating_point.h>
+#include <sane/soft_extended.h>
+#include <sane/comp.h>
+#include <sane/sort.h>
+#include <sane/hash.h>
+#include <sane/compare.h>
+#include <sane/endian_value.h>
+#include <sane/range.h>
+#include <sane/reduce.h>
+#include <sane/integer.h>
+#include <sane/value.h>
+#include <sane/environment.h>
+
+#include <algorithm>
+#include <cfenv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace SANE;
+namespace fp = SANE::floating_point;
+
+namespace {
+
+	const char *filter = nullptr;
+
+	// keep results alive.
+	volatile uint64_t sink;
+
+	template<class F>
+	void bench(const char *name, size_t count, F f) {
+
+		if (filter && !std::strstr(name, filter)) return;
+
+		typedef std::chrono::steady_clock clock;
+
+		f(); // warm up.
+
+		double best = 0;
+		for (int i = 0; i < 5; ++i) {
+			auto start = clock::now();
+			f();
+			auto end = clock::now();
+			double ns = std::chrono::duration<double, std::nano>(end - start).count() / count;
+			if (i == 0 || ns < best) best = ns;
+		}
+		std::printf("%-40s %8.2f ns/op\n", name, best);
+	}
+
+	std::vector<long double> random_extended(size_t count, int range) {
+		std::mt19937_64 rng(count);
+		std::vector<long double> v;
+
+		v.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			fp::info fpi;
+			fpi.sign = rng() & 0x01;
+			fpi.one = true;
+			fpi.exp = (int)(rng() % (2 * range)) - range;
+			fpi.sig = rng() | (UINT64_C(1) << 63);
+			v.push_back((long double)fpi);
+		}
+		return v;
+	}
+
+	template<class F>
+	void info_batch_bench(const char *name, F f) {
+
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 100);
+		std::vector<uint8_t> v(count * F::size), w(count * F::size);
+		for (size_t i = 0; i < count; ++i) fp::info(a[i]).write(f, v.data() + i * F::size);
+		fp::info_batch b(count);
+		std::string s;
+
+		s = std::string("info_batch read per value ") + name;
+		bench(s.c_str(), count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				fp::info fpi;
+				fpi.read(f, v.data() + i * F::size);
+				b.set(i, fpi);
+			}
+			sink = b.sig[0];
+		});
+		s = std::string("info_batch read ") + name;
+		bench(s.c_str(), count, [&]{
+			b.read(f, v.data(), count);
+			sink = b.sig[0];
+		});
+		s = std::string("info_batch write per value ") + name;
+		bench(s.c_str(), count, [&]{
+			for (size_t i = 0; i < count; ++i) b.get(i).write(f, w.data() + i * F::size);
+			sink = w[0];
+		});
+		s = std::string("info_batch write ") + name;
+		bench(s.c_str(), count, [&]{
+			b.write(f, w.data());
+			sink = w[0];
+		});
+	}
+
+	// measured against x87 on x86-64 (min of 60 runs): add/sub ~5x,
+	// mul ~3x, div ~6x, sqrt ~5x, rint ~1.2x, rem ~0.5x.
+	void soft_extended_bench() {
+
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 100);
+		// same seed, so shuffle; a[i] == b[i] would only time the x - x path.
+		auto b = a;
+		std::shuffle(b.begin(), b.end(), std::mt19937_64(29));
+		std::vector<soft_extended> sa, sb;
+		for (auto x : a) sa.emplace_back(x);
+		for (auto x : b) sb.emplace_back(x);
+
+		std::vector<long double> lr(count);
+		std::vector<soft_extended> sr(count);
+
+	#define BENCH_OP(name, lexpr, sexpr) \
+		bench("long double " name, count, [&]{ \
+			for (size_t i = 0; i < count; ++i) lr[i] = lexpr; \
+			sink = lr[count / 2] != 0; \
+		}); \
+		bench("soft_extended " name, count, [&]{ \
+			for (size_t i = 0; i < count; ++i) sr[i] = sexpr; \
+			sink = sr[count / 2].sig; \
+		});
+
+		BENCH_OP("add", a[i] + b[i], add(sa[i], sb[i]))
+		BENCH_OP("sub", a[i] - b[i], sub(sa[i], sb[i]))
+		BENCH_OP("mul", a[i] * b[i], mul(sa[i], sb[i]))
+		BENCH_OP("div", a[i] / b[i], div(sa[i], sb[i]))
+		BENCH_OP("sqrt", std::sqrt(std::fabs(a[i])), sqrt(abs(sa[i])))
+		BENCH_OP("rint", std::rint(a[i]), rint(sa[i]))
+		BENCH_OP("rem", std::remainder(a[i], b[i]), rem(sa[i], sb[i]))
+
+	#undef BENCH_OP
+	}
+
+
+	void narrowing_bench() {
+
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 140);
+		std::vector<fp::info> info;
+		for (auto x : a) info.emplace_back(x);
+		std::vector<uint32_t> f(count);
+		std::vector<uint64_t> d(count);
+
+		bench("long double -> float (host)", count, [&]{
+			for (size_t i = 0; i < count; ++i) f[i] = fp::bit_cast<uint32_t>((float)a[i]);
+			sink = f[count / 2];
+		});
+		bench("info -> float", count, [&]{
+			for (size_t i = 0; i < count; ++i) f[i] = info[i].pack_single();
+			sink = f[count / 2];
+		});
+		bench("info -> float (via long double)", count, [&]{
+			for (size_t i = 0; i < count; ++i) f[i] = fp::bit_cast<uint32_t>((float)(long double)info[i]);
+			sink = f[count / 2];
+		});
+		bench("info -> double", count, [&]{
+			for (size_t i = 0; i < count; ++i) d[i] = info[i].pack_double();
+			sink = d[count / 2];
+		});
+		bench("info -> double (via long double)", count, [&]{
+			for (size_t i = 0; i < count; ++i) d[i] = fp::bit_cast<uint64_t>((double)(long double)info[i]);
+			sink = d[count / 2];
+		});
+	}
+
+	// sort count raw values by decoding them to long double first.
+	template<class F>
+	void decode_sort(F f, uint8_t *data, size_t count) {
+		std::vector<std::pair<long double, size_t>> v(count);
+		for (size_t i = 0; i < count; ++i) {
+			fp::info fpi;
+			fpi.read(f, data + i * F::size);
+			v[i] = std::make_pair((long double)fpi, i);
+		}
+		std::stable_sort(v.begin(), v.end(), [](const std::pair<long double, size_t> &a, const std::pair<long double, size_t> &b){
+			return a.first < b.first;
+		});
+		std::vector<uint8_t> tmp(data, data + count * F::size);
+		for (size_t i = 0; i < count; ++i)
+			std::memcpy(data + i * F::size, tmp.data() + v[i].second * F::size, F::size);
+	}
+
+	template<class F>
+	void sort_bench(const char *name, F f) {
+
+		constexpr size_t count = 1 << 20;
+		auto a = random_extended(count, 1000);
+		std::vector<uint8_t> raw(count * F::size), tmp;
+		for (size_t i = 0; i < count; ++i) fp::info(a[i]).write(f, raw.data() + i * F::size);
+
+		std::string n = name;
+		bench((n + " decode + stable_sort").c_str(), count, [&]{
+			tmp = raw;
+			decode_sort(f, tmp.data(), count);
+			sink = tmp[0];
+		});
+		bench((n + " radix_sort (1 thread)").c_str(), count, [&]{
+			tmp = raw;
+			fp::radix_sort(f, tmp.data(), count, 1);
+			sink = tmp[0];
+		});
+		bench((n + " radix_sort").c_str(), count, [&]{
+			tmp = raw;
+			fp::radix_sort(f, tmp.data(), count);
+			sink = tmp[0];
+		});
+
+		tmp = raw;
+		fp::radix_sort(f, tmp.data(), count);
+		auto decode = [&](const uint8_t *cp){
+			fp::info fpi;
+			fpi.read(f, cp);
+			return (long double)fpi;
+		};
+		bench((n + " decode + binary search").c_str(), count, [&]{
+			size_t x = 0;
+			for (size_t i = 0; i < count; ++i) {
+				long double value = decode(raw.data() + i * F::size);
+				size_t first = 0, len = count;
+				while (len) {
+					size_t half = len / 2;
+					if (decode(tmp.data() + (first + half) * F::size) < value) {
+						first += half + 1;
+						len -= half + 1;
+					}
+					else len = half;
+				}
+				x += first;
+			}
+			sink = x;
+		});
+		bench((n + " lower_bound").c_str(), count, [&]{
+			size_t x = 0;
+			for (size_t i = 0; i < count; ++i)
+				x += fp::lower_bound(f, tmp.data(), count, raw.data() + i * F::size);
+			sink = x;
+		});
+	}
+
+	template<class F>
+	void classify_bench(const char *name, F f) {
+
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 140);
+		std::vector<uint8_t> raw(count * F::size);
+		for (size_t i = 0; i < count; ++i) {
+			fp::info fpi(a[i]);
+			if (i % 100 == 0) {
+				fpi.nan = true;
+				fpi.sig = i % 40;
+			}
+			fpi.write(f, raw.data() + i * F::size);
+		}
+
+		// every count, so none are optimized away.
+		auto total = [](const fp::class_counts &c){
+			return c.zero * 1 + c.subnormal * 3 + c.normal * 5 + c.infinite * 7 + c.nan * 11 + c.nan_code[1];
+		};
+
+		std::string n = name;
+		bench((n + " info + fpclassify").c_str(), count, [&]{
+			fp::class_counts c;
+			for (size_t i = 0; i < count; ++i) {
+				fp::info fpi;
+				fpi.read(f, raw.data() + i * F::size);
+				switch (fpclassify(fpi)) {
+					case FP_ZERO: ++c.zero; break;
+					case FP_SUBNORMAL: ++c.subnormal; break;
+					case FP_NORMAL: ++c.normal; break;
+					case FP_INFINITE: ++c.infinite; break;
+					case FP_NAN: ++c.nan; ++c.nan_code[fpi.sig & 0xff]; break;
+				}
+			}
+			sink = total(c);
+		});
+		bench((n + " classify").c_str(), count, [&]{
+			fp::class_counts c = fp::classify(f, raw.data(), count);
+			sink = total(c);
+		});
+		std::vector<uint8_t> codes(count);
+		bench((n + " nan_codes").c_str(), count, [&]{
+			sink = fp::nan_codes(f, raw.data(), codes.data(), count) + codes[count / 2];
+		});
+	}
+
+	void comp_classify_bench() {
+
+		constexpr size_t count = 1 << 16;
+		std::mt19937_64 rng(36);
+		std::vector<uint8_t> raw(count * 8);
+		for (size_t i = 0; i < count; ++i) {
+			uint64_t w = i % 100 == 0 ? comp::NaN : i % 7 == 0 ? 0 : rng();
+			big_endian<comp>::at(raw.data() + i * 8) = comp(w);
+		}
+
+		bench("comp (big endian) classify", count, [&]{
+			fp::class_counts c = fp::classify(fp::format_comp<endian::big>{}, raw.data(), count);
+			sink = c.zero + c.normal * 5 + c.nan * 11;
+		});
+	}
+
+	void hash_bench() {
+
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 60);
+		std::vector<uint8_t> raw(count * 10);
+		std::vector<decimal> d(count);
+		std::vector<uint64_t> h(count);
+		typedef fp::format<10, endian::big> F;
+
+		for (size_t i = 0; i < count; ++i) {
+			// short decimals, like the ones in records.
+			fp::info fpi(a[i]);
+			fpi.write(F{}, raw.data() + i * 10);
+			d[i] = x2dec(fpi, decform(decform::FLOATDECIMAL, 1 + i % 8));
+		}
+
+		bench("extended (big endian) info + hash", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				fp::info fpi;
+				fpi.read(F{}, raw.data() + i * 10);
+				h[i] = fp::hash(fp::canonicalize(fpi));
+			}
+			sink = h[count / 2];
+		});
+		bench("extended (big endian) hash", count, [&]{
+			fp::hash(F{}, raw.data(), h.data(), count);
+			sink = h[count / 2];
+		});
+
+		std::vector<uint8_t> raw8(count * 8);
+		typedef fp::format<8, endian::big> D;
+		for (size_t i = 0; i < count; ++i) fp::info(a[i]).write(D{}, raw8.data() + i * 8);
+		bench("double (big endian) hash per value", count, [&]{
+			for (size_t i = 0; i < count; ++i) h[i] = fp::hash(D{}, raw8.data() + i * 8);
+			sink = h[count / 2];
+		});
+		bench("double (big endian) hash", count, [&]{
+			fp::hash(D{}, raw8.data(), h.data(), count);
+			sink = h[count / 2];
+		});
+		bench("decimal dec2x + hash", count, [&]{
+			fp::info fpi;
+			for (size_t i = 0; i < count; ++i) {
+				dec2x(d[i], fpi);
+				h[i] = fp::hash(fp::canonicalize(fpi));
+			}
+			sink = h[count / 2];
+		});
+		bench("decimal hash", count, [&]{
+			for (size_t i = 0; i < count; ++i) h[i] = hash(d[i]);
+			sink = h[count / 2];
+		});
+	}
+
+	void compare_bench() {
+
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 60);
+		std::vector<uint8_t> x(count * 10), c(count * 8);
+		std::vector<decimal> d(count);
+		std::vector<relop> r(count);
+		typedef fp::format<10, endian::big> X;
+		typedef fp::format_comp<endian::big> C;
+
+		for (size_t i = 0; i < count; ++i) {
+			fp::info fpi(a[i]);
+			fpi.write(X{}, x.data() + i * 10);
+			d[i] = x2dec(fpi, decform(decform::FLOATDECIMAL, 1 + i % 8));
+			uint64_t w = (int64_t)(a[count - 1 - i] / 16);
+			std::memcpy(c.data() + i * 8, &w, 8);
+			fp::reverse_bytes<8>(c.data() + i * 8);
+		}
+
+		auto relation = [](long double a, long double b) {
+			return std::isunordered(a, b) ? UNORDERED : a < b ? LESSTHAN : a > b ? GREATERTHAN : EQUALTO;
+		};
+
+		bench("comp vs extended via long double", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				int64_t w;
+				std::memcpy(&w, c.data() + i * 8, 8);
+				fp::reverse_bytes<8>(&w);
+				fp::info q;
+				q.read(X{}, x.data() + i * 10);
+				r[i] = relation((long double)comp(w), (long double)q);
+			}
+			sink = r[count / 2];
+		});
+		bench("comp vs extended", count, [&]{
+			for (size_t i = 0; i < count; ++i) r[i] = fp::compare(C{}, c.data() + i * 8, X{}, x.data() + i * 10);
+			sink = r[count / 2];
+		});
+		bench("decimal vs extended via dec2x", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				fp::info p, q;
+				dec2x(d[i], p);
+				q.read(X{}, x.data() + (count - 1 - i) * 10);
+				r[i] = relation((long double)p, (long double)q);
+			}
+			sink = r[count / 2];
+		});
+		bench("decimal vs extended", count, [&]{
+			for (size_t i = 0; i < count; ++i) r[i] = fp::compare(d[i], X{}, x.data() + (count - 1 - i) * 10);
+			sink = r[count / 2];
+		});
+	}
+
+	// scale guest values in place.
+	void endian_value_bench() {
+
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 100);
+		std::vector<uint8_t> d(count * 8 + 1), x(count * 10 + 1);
+		for (size_t i = 0; i < count; ++i) {
+			fp::info(a[i]).write(fp::format<8, endian::big>{}, d.data() + 1 + i * 8);
+			fp::info(a[i]).write(fp::format<10, endian::big>{}, x.data() + 1 + i * 10);
+		}
+
+		bench("double (big endian) info read/write", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				uint8_t *cp = d.data() + 1 + i * 8;
+				fp::info fpi;
+				fpi.read(fp::format<8, endian::big>{}, cp);
+				fp::info((double)fpi * 1.5).write(fp::format<8, endian::big>{}, cp);
+			}
+			sink = d[count];
+		});
+		bench("double (big endian) big_endian<double>", count, [&]{
+			for (size_t i = 0; i < count; ++i) big_endian<double>::at(d.data() + 1 + i * 8) *= 1.5;
+			sink = d[count];
+		});
+		bench("extended (big endian) info read/write", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				uint8_t *cp = x.data() + 1 + i * 10;
+				fp::info fpi;
+				fpi.read(fp::format<10, endian::big>{}, cp);
+				fp::info((long double)fpi * 1.5L).write(fp::format<10, endian::big>{}, cp);
+			}
+			sink = x[count];
+		});
+		bench("extended (big endian) big_endian<long double>", count, [&]{
+			for (size_t i = 0; i < count; ++i) big_endian<long double>::at(x.data() + 1 + i * 10) *= 1.5L;
+			sink = x[count];
+		});
+	}
+
+	void comp_bench() {
+
+		// ledger-like amounts: mostly small, exact.
+		constexpr size_t count = 1 << 16;
+		std::mt19937_64 rng(41);
+		std::vector<comp> a(count, comp(0)), b(count, comp(0)), r(count, comp(0));
+		for (size_t i = 0; i < count; ++i) {
+			a[i] = comp((int64_t)(rng() % 100000000) - 50000000);
+			b[i] = comp((int64_t)(rng() % 1000) + 1);
+		}
+
+	#define COMP_BENCH(name, op) \
+		bench("comp " name " via long double", count, [&]{ \
+			for (size_t i = 0; i < count; ++i) r[i] = comp((long double)a[i] op (long double)b[i]); \
+			sink = (uint64_t)r[count - 1]; \
+		}); \
+		bench("comp " name, count, [&]{ \
+			for (size_t i = 0; i < count; ++i) r[i] = a[i] op b[i]; \
+			sink = (uint64_t)r[count - 1]; \
+		});
+
+		COMP_BENCH("+", +)
+		COMP_BENCH("*", *)
+		COMP_BENCH("/", /)
+	#undef COMP_BENCH
+
+		bench("comp rem via long double", count, [&]{
+			for (size_t i = 0; i < count; ++i) r[i] = comp(std::remainder((long double)a[i], (long double)b[i]));
+			sink = (uint64_t)r[count - 1];
+		});
+		bench("comp rem", count, [&]{
+			for (size_t i = 0; i < count; ++i) r[i] = rem(a[i], b[i]);
+			sink = (uint64_t)r[count - 1];
+		});
+	}
+
+	void comp_transcode_bench() {
+
+		typedef fp::format_comp<endian::big> C;
+		constexpr size_t count = 1 << 16;
+		std::mt19937_64 rng(42);
+		std::vector<uint8_t> c(count * 8), d(count * 8), x(count * 10);
+		for (size_t i = 0; i < count; ++i) big_endian<comp>::at(c.data() + i * 8) = comp((int64_t)(rng() >> 20) - (INT64_C(1) << 43));
+		fp::transcode(C{}, c.data(), fp::format<8, endian::native>{}, d.data(), count);
+		fp::transcode(C{}, c.data(), fp::format<10, endian::native>{}, x.data(), count);
+
+		bench("comp (big endian) -> double scalar", count, [&]{
+			double *dp = (double *)d.data();
+			for (size_t i = 0; i < count; ++i) dp[i] = (double)big_endian<comp>::at(c.data() + i * 8).load();
+			sink = d[8];
+		});
+		bench("comp (big endian) -> double transcode", count, [&]{
+			fp::transcode(C{}, c.data(), fp::format<8, endian::native>{}, d.data(), count);
+			sink = d[8];
+		});
+		bench("double -> comp (big endian) scalar", count, [&]{
+			const double *dp = (const double *)d.data();
+			for (size_t i = 0; i < count; ++i) big_endian<comp>::at(c.data() + i * 8) = comp(dp[i]);
+			sink = c[8];
+		});
+		bench("double -> comp (big endian) transcode", count, [&]{
+			fp::transcode(fp::format<8, endian::native>{}, d.data(), C{}, c.data(), count);
+			sink = c[8];
+		});
+		bench("comp (big endian) -> extended scalar", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				long double t = (long double)big_endian<comp>::at(c.data() + i * 8).load();
+				std::memcpy(x.data() + i * 10, &t, 10);
+			}
+			sink = x[8];
+		});
+		bench("comp (big endian) -> extended transcode", count, [&]{
+			fp::transcode(C{}, c.data(), fp::format<10, endian::native>{}, x.data(), count);
+			sink = x[8];
+		});
+		bench("extended -> comp (big endian) scalar", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				long double t;
+				std::memcpy(&t, x.data() + i * 10, 10);
+				big_endian<comp>::at(c.data() + i * 8) = comp(t);
+			}
+			sink = c[8];
+		});
+		bench("extended -> comp (big endian) transcode", count, [&]{
+			fp::transcode(fp::format<10, endian::native>{}, x.data(), C{}, c.data(), count);
+			sink = c[8];
+		});
+	}
+
+	void reduce_bench() {
+
+		typedef fp::format_comp<endian::big> C;
+		constexpr size_t count = 1 << 22;
+		std::mt19937_64 rng(43);
+		std::vector<uint8_t> c(count * 8);
+		for (size_t i = 0; i < count; ++i)
+			big_endian<comp>::at(c.data() + i * 8) = i % 1000 ? comp((int64_t)(rng() % 100000000) - 50000000) : comp(comp::NaN);
+
+		bench("comp (big endian) sum/min/max via comp", count, [&]{
+			comp sum(0), mn(INT64_MAX), mx(-INT64_MAX);
+			size_t n = 0;
+			for (size_t i = 0; i < count; ++i) {
+				comp x = big_endian<comp>::at(c.data() + i * 8);
+				if (isnan(x)) continue;
+				sum += x;
+				if (x < mn) mn = x;
+				if (x > mx) mx = x;
+				++n;
+			}
+			sink = (uint64_t)sum + (uint64_t)mn + (uint64_t)mx + n;
+		});
+		bench("comp (big endian) reduce, 1 thread", count, [&]{
+			fp::comp_reduction r = fp::reduce(C{}, c.data(), count, fp::skip_nans, 1);
+			sink = (uint64_t)r.sum + (uint64_t)r.min + (uint64_t)r.max + r.count;
+		});
+		bench("comp (big endian) reduce", count, [&]{
+			fp::comp_reduction r = fp::reduce(C{}, c.data(), count);
+			sink = (uint64_t)r.sum + (uint64_t)r.min + (uint64_t)r.max + r.count;
+		});
+	}
+
+	void to_chars_bench() {
+
+		typedef fp::format_comp<endian::big> C;
+		constexpr size_t count = 1 << 16;
+		std::mt19937_64 rng(44);
+		std::vector<uint8_t> c(count * 8);
+		for (size_t i = 0; i < count; ++i) big_endian<comp>::at(c.data() + i * 8) = comp((int64_t)(rng() >> (rng() % 64)));
+		std::vector<char> arena(count * 20);
+		std::vector<size_t> offsets(count + 1);
+
+		bench("comp (big endian) to_string", count, [&]{
+			size_t n = 0;
+			for (size_t i = 0; i < count; ++i) n += to_string(big_endian<comp>::at(c.data() + i * 8).load()).size();
+			sink = n;
+		});
+		bench("comp (big endian) std::to_string", count, [&]{
+			size_t n = 0;
+			for (size_t i = 0; i < count; ++i) n += std::to_string((int64_t)big_endian<comp>::at(c.data() + i * 8).load()).size();
+			sink = n;
+		});
+		bench("comp (big endian) to_chars", count, [&]{
+			char buffer[24];
+			size_t n = 0;
+			for (size_t i = 0; i < count; ++i) n += to_chars(buffer, buffer + sizeof(buffer), big_endian<comp>::at(c.data() + i * 8).load()) - buffer;
+			sink = n;
+		});
+		bench("comp (big endian) to_chars arena", count, [&]{
+			sink = fp::to_chars(C{}, c.data(), count, arena.data(), offsets.data());
+		});
+	}
+
+	void comp2dec_bench() {
+
+		constexpr size_t count = 1 << 12;
+		std::mt19937_64 rng(45);
+		std::vector<comp> c(count, comp(0)), r(count, comp(0));
+		std::vector<decimal> d(count);
+		decform df{decform::FIXEDDECIMAL, 0};
+		for (size_t i = 0; i < count; ++i) {
+			c[i] = comp((int64_t)(rng() >> (rng() % 64)));
+			d[i] = comp2dec(c[i], df);
+		}
+
+		bench("comp2dec via x2dec", count, [&]{
+			for (size_t i = 0; i < count; ++i) d[i] = x2dec(fp::info((long double)c[i]), df);
+			sink = d[0].sig.size();
+		});
+		bench("comp2dec", count, [&]{
+			for (size_t i = 0; i < count; ++i) d[i] = comp2dec(c[i], df);
+			sink = d[0].sig.size();
+		});
+		bench("dec2comp via dec2x", count, [&]{
+			for (size_t i = 0; i < count; ++i) r[i] = comp(dec2x(d[i]));
+			sink = (uint64_t)r[0];
+		});
+		bench("dec2comp", count, [&]{
+			for (size_t i = 0; i < count; ++i) r[i] = dec2comp(d[i]);
+			sink = (uint64_t)r[0];
+		});
+	}
+
+	void scaled_comp_bench() {
+
+		// cents, printed and parsed.
+		constexpr size_t count = 1 << 12;
+		std::mt19937_64 rng(46);
+		std::vector<uint8_t> v(count * 8), w(count * 8);
+		for (size_t i = 0; i < count; ++i)
+			little_endian<comp>::at(v.data() + i * 8) = comp((int64_t)(rng() >> (rng() % 64)) >> 1);
+		std::vector<char> arena(count * 40);
+		std::vector<size_t> offsets(count + 1);
+		std::vector<std::string> text(count);
+		decform df{decform::FIXEDDECIMAL, 2};
+
+		bench("scaled comp to text via dec2str", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				comp c = little_endian<comp>::at(v.data() + i * 8);
+				dec2str(df, x2dec(fp::info((long double)c / 100), df), text[i]);
+			}
+			sink = text[0].size();
+		});
+		bench("scaled comp to_chars", count, [&]{
+			sink = fp::to_chars(fp::format_comp<endian::little>{}, v.data(), count, 2, 2, arena.data(), offsets.data());
+		});
+		bench("scaled comp from text via str2dec", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				std::string s(arena.data() + offsets[i], arena.data() + offsets[i + 1]);
+				uint16_t index = 0, valid;
+				decimal d;
+				str2dec(s, index, d, valid);
+				little_endian<comp>::at(w.data() + i * 8) = comp(dec2x(d) * 100);
+			}
+			sink = w[0];
+		});
+		bench("scaled comp from_chars", count, [&]{
+			sink = fp::from_chars(fp::format_comp<endian::little>{}, arena.data(), offsets.data(), count, 2, w.data());
+		});
+	}
+
+	void integer_bench() {
+
+		// big endian LONGINTs, as an emulator would read and write them.
+		typedef fp::format_integer<4, endian::big> L;
+		constexpr size_t count = 1 << 16;
+		std::mt19937_64 rng(47);
+		std::vector<double> d(count);
+		std::vector<long double> a(count);
+		std::vector<uint8_t> l(count * 4), x(count * 10);
+		for (size_t i = 0; i < count; ++i) {
+			d[i] = std::ldexp((double)(int64_t)rng(), -(int)(rng() % 40) - 10);
+			a[i] = d[i];
+		}
+		for (size_t i = 0; i < count; ++i) fp::info(a[i]).write(fp::format<10, endian::native>{}, x.data() + i * 10);
+
+		bench("double -> longint cast", count, [&]{
+			for (size_t i = 0; i < count; ++i) fp::detail::store_word<endian::big>(l.data() + i * 4, (uint32_t)(int32_t)d[i]);
+			sink = l[3];
+		});
+		bench("double -> longint lrint + range", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				double r = std::nearbyint(d[i]);
+				int32_t v = std::fabs(r) < 2147483648.0 ? (int32_t)r : INT32_MIN;
+				fp::detail::store_word<endian::big>(l.data() + i * 4, (uint32_t)v);
+			}
+			sink = l[3];
+		});
+		bench("double -> longint transcode", count, [&]{
+			fp::transcode(fp::format<8, endian::native>{}, d.data(), L{}, l.data(), count);
+			sink = l[3];
+		});
+		bench("extended -> longint x2l", count, [&]{
+			for (size_t i = 0; i < count; ++i) fp::detail::store_word<endian::big>(l.data() + i * 4, (uint32_t)SANE::x2l(a[i]));
+			sink = l[3];
+		});
+		bench("extended -> longint transcode", count, [&]{
+			fp::transcode(fp::format<10, endian::native>{}, x.data(), L{}, l.data(), count);
+			sink = l[3];
+		});
+		bench("longint -> extended scalar", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				long double t = (int32_t)fp::detail::load_word<uint32_t, endian::big>(l.data() + i * 4);
+				std::memcpy(x.data() + i * 10, &t, 10);
+			}
+			sink = x[8];
+		});
+		bench("longint -> extended transcode", count, [&]{
+			fp::transcode(L{}, l.data(), fp::format<10, endian::native>{}, x.data(), count);
+			sink = x[8];
+		});
+	}
+
+	void environment_bench() {
+
+		// an emulator's FX2L: set the rounding direction, convert, read the flags back.
+		constexpr size_t count = 1 << 16;
+		std::mt19937_64 rng(49);
+		std::vector<long double> a(count);
+		std::vector<int32_t> l(count);
+		for (size_t i = 0; i < count; ++i) a[i] = std::ldexp((long double)(int64_t)rng(), -(int)(rng() % 40) - 10);
+
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+		bench("x2l with host fenv", count, [&]{
+			unsigned flags = 0;
+			for (size_t i = 0; i < count; ++i) {
+				std::fesetround(modes[i & 3]);
+				std::feclearexcept(FE_ALL_EXCEPT);
+				long double r = std::nearbyint(a[i]);
+				l[i] = std::fabs(r) < 2147483648.0L ? (int32_t)r : INT32_MIN;
+				flags |= std::fetestexcept(FE_INEXACT | FE_INVALID);
+			}
+			std::fesetround(FE_TONEAREST);
+			sink = l[0] + flags;
+		});
+
+		const SANE::rounding_direction directions[4] = { SANE::TONEAREST, SANE::UPWARD, SANE::DOWNWARD, SANE::TOWARDZERO };
+		bench("x2l with SANE environment", count, [&]{
+			unsigned flags = 0;
+			for (size_t i = 0; i < count; ++i) {
+				SANE::setround(directions[i & 3]);
+				SANE::setexception(SANE::INEXACT | SANE::INVALID, false);
+				l[i] = SANE::x2l(a[i]);
+				flags |= SANE::testexception(SANE::INEXACT | SANE::INVALID);
+			}
+			SANE::setenvironment(0);
+			sink = l[0] + flags;
+		});
+	}
+
+	void value_bench() {
+
+		// float, double, extended and comp in runs of 1-128.
+		constexpr size_t count = 1 << 14;
+		std::mt19937_64 rng(48);
+		auto a = random_extended(count, 60);
+		std::vector<SANE::sane_value> values;
+		SANE::sane_column column;
+		while (values.size() < count) {
+			unsigned type = rng() % 4;
+			size_t n = std::min<size_t>(1 + rng() % 128, count - values.size());
+			for (size_t i = 0; i < n; ++i) {
+				long double x = a[values.size()];
+				switch (type) {
+					case 0: values.emplace_back((float)x); break;
+					case 1: values.emplace_back((double)x); break;
+					case 2: values.emplace_back(x); break;
+					case 3: values.emplace_back(comp(x)); break;
+				}
+				column.push_back(values.back());
+			}
+		}
+		std::vector<double> d(count);
+		std::vector<SANE::relop> rel(count);
+		auto pivot = SANE::sane_value(1.5).canonical();
+
+		bench("sane_value -> double per value", count, [&]{
+			for (size_t i = 0; i < count; ++i) values[i].write(fp::format<8, endian::native>{}, &d[i]);
+			sink = (uint64_t)d[0];
+		});
+		bench("sane_column -> double per run", count, [&]{
+			column.convert(fp::format<8, endian::native>{}, d.data());
+			sink = (uint64_t)d[0];
+		});
+		bench("sane_value compare per value", count, [&]{
+			for (size_t i = 0; i < count; ++i) rel[i] = fp::compare(values[i].canonical(), pivot);
+			sink = rel[0];
+		});
+		bench("sane_column compare per run", count, [&]{
+			column.compare(pivot, rel.data());
+			sink = rel[0];
+		});
+		bench("sane_value classify per value", count, [&]{
+			size_t nan = 0;
+			for (size_t i = 0; i < count; ++i) nan += fpclassify(values[i]) == FP_NAN;
+			sink = nan;
+		});
+		bench("sane_column classify per run", count, [&]{
+			sink = column.classify().nan;
+		});
+	}
+
+	void range_bench() {
+
+		// extended in 16 byte records -> 68881 in 12 byte records.
+		constexpr size_t count = 1 << 16;
+		auto a = random_extended(count, 100);
+		std::vector<uint8_t> x(count * 16), y(count * 12);
+		for (size_t i = 0; i < count; ++i)
+			fp::info(a[i]).write(fp::format<10, endian::big>{}, x.data() + i * 16);
+
+		fp::const_format_range<fp::format<10, endian::big>, 16> src(x.data(), count);
+		fp::format_range<fp::format_68881<endian::big>> dst(y.data(), count);
+
+		bench("extended (16 byte stride) -> 68881 info read/write", count, [&]{
+			for (size_t i = 0; i < count; ++i) {
+				fp::info fpi;
+				fpi.read(fp::format<10, endian::big>{}, x.data() + i * 16);
+				fpi.write(fp::format_68881<endian::big>{}, y.data() + i * 12);
+			}
+			sink = y[count];
+		});
+		bench("extended (16 byte stride) -> 68881 transform", count, [&]{
+			transform(src, dst);
+			sink = y[count];
+		});
+		bench("extended (16 byte stride) classify", count, [&]{
+			fp::class_counts c = classify(src);
+			sink = c.normal + c.zero;
+		});
+	}
+
+	void decimal_bench() {
+
+		constexpr size_t count = 1 << 12;
+		auto a = random_extended(count, 200);
+		std::vector<decimal> d(count);
+		std::vector<std::string> str(count);
+		decform df{decform::FLOATDECIMAL, 19};
+
+		for (size_t i = 0; i < count; ++i) {
+			d[i] = x2dec(fp::info(a[i]), df);
+			str[i] = d[i].sig + "e" + std::to_string(d[i].exp);
+		}
+
+		bench("snprintf %.18Le", count, [&]{
+			char buffer[64];
+			for (size_t i = 0; i < count; ++i) std::snprintf(buffer, sizeof(buffer), "%.18Le", a[i]);
+			sink = buffer[0];
+		});
+		bench("x2dec info", count, [&]{
+			for (size_t i = 0; i < count; ++i) d[i] = x2dec(fp::info(a[i]), df);
+			sink = d[0].sig.size();
+		});
+
+		bench("strtold", count, [&]{
+			long double x = 0;
+			for (size_t i = 0; i < count; ++i) x += std::strtold(str[i].c_str(), nullptr);
+			sink = x != 0;
+		});
+		bench("dec2x info", count, [&]{
+			fp::info fpi;
+			uint64_t x = 0;
+			for (size_t i = 0; i < count; ++i) { dec2x(d[i], fpi); x += fpi.sig; }
+			sink = x;
+		});
+
+		// directed rounding: a host fenv switch around each call vs the direction as an argument.
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+		const SANE::rounding_direction directions[4] = { SANE::TONEAREST, SANE::UPWARD, SANE::DOWNWARD, SANE::TOWARDZERO };
+		bench("snprintf %.18Le, fesetround per call", count, [&]{
+			char buffer[64];
+			for (size_t i = 0; i < count; ++i) {
+				std::fesetround(modes[i & 3]);
+				std::snprintf(buffer, sizeof(buffer), "%.18Le", a[i]);
+			}
+			std::fesetround(FE_TONEAREST);
+			sink = buffer[0];
+		});
+		bench("x2dec info, direction per call", count, [&]{
+			for (size_t i = 0; i < count; ++i) d[i] = x2dec(fp::info(a[i]), df, directions[i & 3]);
+			sink = d[0].sig.size();
+		});
+		bench("strtold, fesetround per call", count, [&]{
+			long double x = 0;
+			for (size_t i = 0; i < count; ++i) {
+				std::fesetround(modes[i & 3]);
+				x += std::strtold(str[i].c_str(), nullptr);
+			}
+			std::fesetround(FE_TONEAREST);
+			sink = x != 0;
+		});
+		bench("dec2x info, direction per call", count, [&]{
+			fp::info fpi;
+			uint64_t x = 0;
+			for (size_t i = 0; i < count; ++i) { dec2x(d[i], fpi, directions[i & 3]); x += fpi.sig; }
+			sink = x;
+		});
+	}
+
+}
+
+int main(int argc, char **argv) {
+
+	if (argc > 1) filter = argv[1];
+
+	soft_extended_bench();
+	info_batch_bench("(float, big endian)", fp::format<4, endian::big>{});
+	info_batch_bench("(double, big endian)", fp::format<8, endian::big>{});
+	info_batch_bench("(extended, big endian)", fp::format<10, endian::big>{});
+	narrowing_bench();
+	sort_bench("double (big endian)", fp::format<8, endian::big>{});
+	sort_bench("extended (big endian)", fp::format<10, endian::big>{});
+	classify_bench("float (big endian)", fp::format<4, endian::big>{});
+	classify_bench("double (big endian)", fp::format<8, endian::big>{});
+	classify_bench("extended (big endian)", fp::format<10, endian::big>{});
+	comp_classify_bench();
+	hash_bench();
+	compare_bench();
+	endian_value_bench();
+	range_bench();
+	comp_bench();
+	comp_transcode_bench();
+	reduce_bench();
+	to_chars_bench();
+	comp2dec_bench();
+	scaled_comp_bench();
+	integer_bench();
+	environment_bench();
+	value_bench();
+	decimal_bench();
+	return 0;
+}
@@ -5,8 +5,26 @@
 #include <sane/sane.h>
 #include <sane/floating_point.h>
 #include <sane/comp.h>
-
+#include <sane/info_batch.h>
+#include <sane/soft_extended.h>
+#include <sane/sort.h>
+#include <sane/hash.h>
+#include <sane/compare.h>
+#include <sane/endian_value.h>
+#include <sane/range.h>
+#include <sane/reduce.h>
+#include <sane/integer.h>
+#include <sane/value.h>
+#include <sane/environment.h>
+
+#include <algorithm>
+#include <functional>
 #include <cmath>
+#include <cstring>
+#include <cfenv>
+#include <limits>
+#include <random>
+#include <vector>
 
 using std::abs;
 using std::fpclassify;
@@ -319,7 +337,7 @@ TEST_CASE( "Dec2Str(Fixed)", "[dec2str]") {
 
 /*
  * SANE 65816/68000 tests:
- * if no bytes processed, returns N0011 (NANASCBIN)
+ * if no bytes processed, returns N4011 (NANASCBIN)
  * NAN -> N4000 ; NAN(1) -> N4001
  *
  */
@@ -411,7 +429,7 @@ TEST_CASE( "Str2Dec", "[str2dec]" ) {
 		REQUIRE(index == 0);
 		REQUIRE(valid);
 
-		REQUIRE(d.sig == "N0011");
+		REQUIRE(d.sig == "N4011");
 		REQUIRE(d.sgn == 0);
 		REQUIRE(d.exp == 0);
 	}
@@ -617,7 +635,7 @@ TEST_CASE( "Str2Dec", "[str2dec]" ) {
 		REQUIRE(index == 0);
 		REQUIRE(valid == 1);
 
-		REQUIRE(d.sig == "N0011"); /* NANASCBIN */
+		REQUIRE(d.sig == "N4011"); /* NANASCBIN */
 		REQUIRE(d.sgn == 0);
 		REQUIRE(d.exp == 0);
 	}
@@ -628,7 +646,7 @@ TEST_CASE( "Str2Dec", "[str2dec]" ) {
 		REQUIRE(index == 0);
 		REQUIRE(valid == 1);
 
-		REQUIRE(d.sig == "N0011"); /* NANASCBIN */
+		REQUIRE(d.sig == "N4011"); /* NANASCBIN */
 		REQUIRE(d.sgn == 0);
 		REQUIRE(d.exp == 0);
 	}
@@ -639,7 +657,7 @@ TEST_CASE( "Str2Dec", "[str2dec]" ) {
 		REQUIRE(index == 0);
 		REQUIRE(valid == 1);
 
-		REQUIRE(d.sig == "N0011"); /* NANASCBIN */
+		REQUIRE(d.sig == "N4011"); /* NANASCBIN */
 		REQUIRE(d.sgn == 0);
 		REQUIRE(d.exp == 0);
 	}
@@ -661,7 +679,7 @@ TEST_CASE( "Str2Dec", "[str2dec]" ) {
 		REQUIRE(index == 0);
 		REQUIRE(valid == 0);
 
-		REQUIRE(d.sig == "N0011");  /* NANASCBIN */
+		REQUIRE(d.sig == "N4011");  /* NANASCBIN */
 		REQUIRE(d.sgn == 0);
 		REQUIRE(d.exp == 0);
 	}
@@ -672,7 +690,7 @@ TEST_CASE( "Str2Dec", "[str2dec]" ) {
 		REQUIRE(index == 0);
 		REQUIRE(valid == 1);
 
-		REQUIRE(d.sig == "N0011");
+		REQUIRE(d.sig == "N4011");
 		REQUIRE(d.sgn == 0);
 		REQUIRE(d.exp == 0);
 	}
@@ -683,7 +701,7 @@ TEST_CASE( "Str2Dec", "[str2dec]" ) {
 		REQUIRE(index == 0);
 		REQUIRE(valid == 1);
 
-		REQUIRE(d.sig == "N0011");
+		REQUIRE(d.sig == "N4011");
 		REQUIRE(d.sgn == 0);
 		REQUIRE(d.exp == 0);
 	}
@@ -827,6 +845,45 @@ TEST_CASE( "truncation" "[truncate]") {
 		CHECK(d.sig == "1");
 	}
 
+	SECTION( "ties to even" ) {
+		SANE::decimal d { 0, 0, "125" };
+		SANE::truncate(d, 2);
+		CHECK(d.exp == 1);
+		CHECK(d.sig == "12");
+
+		d = SANE::decimal { 0, 0, "135" };
+		SANE::truncate(d, 2);
+		CHECK(d.sig == "14");
+
+		d = SANE::decimal { 0, 0, "1251" };
+		SANE::truncate(d, 2);
+		CHECK(d.exp == 2);
+		CHECK(d.sig == "13");
+	}
+
+	SECTION( "directed" ) {
+		SANE::decimal d { 0, 0, "121" };
+		SANE::truncate(d, 2, SANE::UPWARD);
+		CHECK(d.sig == "13");
+
+		d = SANE::decimal { 1, 0, "121" };
+		SANE::truncate(d, 2, SANE::UPWARD);
+		CHECK(d.sig == "12");
+
+		d = SANE::decimal { 1, 0, "121" };
+		SANE::truncate(d, 2, SANE::DOWNWARD);
+		CHECK(d.sig == "13");
+
+		d = SANE::decimal { 0, 0, "199" };
+		SANE::truncate(d, 2, SANE::TOWARDZERO);
+		CHECK(d.sig == "19");
+
+		d = SANE::decimal { 0, 0, "991" };
+		SANE::truncate(d, 2, SANE::UPWARD);
+		CHECK(d.exp == 3);
+		CHECK(d.sig == "1");
+	}
+
 }
 
 TEST_CASE( "double/extended conversion", "[floating_point]") {
@@ -971,6 +1028,965 @@ TEST_CASE("comp", "[comp]") {
 		CHECK(SANE::abs(c) == SANE::comp(123));
 	}
 
+	SECTION("arithmetic") {
+		using SANE::comp;
+
+		const comp nan(comp::NaN);
+		const comp max(INT64_MAX);
+
+		CHECK(comp(2) + comp(3) == comp(5));
+		CHECK(comp(2) - comp(3) == comp(-1));
+		CHECK(comp(-4) * comp(3) == comp(-12));
+		CHECK(comp(12) / comp(-4) == comp(-3));
+		CHECK(comp(7) / comp(2) == comp(4)); // 3.5, ties to even
+		CHECK(comp(5) / comp(2) == comp(2));
+		CHECK(SANE::rem(comp(5), comp(3)) == comp(-1));
+		CHECK(SANE::rem(comp(3), comp(2)) == comp(-1));
+		CHECK(SANE::rem(comp(5), comp(2)) == comp(1));
+
+		CHECK(SANE::isnan(max + comp(1)));
+		CHECK(SANE::isnan(-max - comp(1))); // -2^63 is the NaN.
+		CHECK(SANE::isnan(max * comp(2)));
+		CHECK(SANE::isnan(comp(1) / comp(0)));
+		CHECK(SANE::isnan(comp(0) / comp(0)));
+		CHECK(SANE::isnan(SANE::rem(comp(1), comp(0))));
+		CHECK(SANE::isnan(nan + comp(1)));
+		CHECK(SANE::isnan(comp(1) * nan));
+		CHECK(SANE::isnan(-nan));
+		CHECK(-max + max == comp(0));
+
+		comp c(10);
+		c += comp(5);
+		c *= comp(3);
+		c -= comp(1);
+		c /= comp(4);
+		CHECK(c == comp(11));
+
+		// against the extended route.
+		auto ref = [](long double x) { return comp(std::nearbyint(x)); };
+
+		std::mt19937_64 rng(41);
+		for (int i = 0; i < 20000; ++i) {
+			int64_t x = rng() >> (rng() % 64);
+			int64_t y = rng() >> (rng() % 64);
+			if (rng() & 1) x = -x;
+			if (rng() & 1) y = -y;
+			if (x == INT64_MIN || y == INT64_MIN) continue;
+
+			comp a(x), b(y);
+			long double la = (long double)a, lb = (long double)b;
+
+			CHECK((uint64_t)(a + b) == (uint64_t)ref(la + lb));
+			CHECK((uint64_t)(a - b) == (uint64_t)ref(la - lb));
+			CHECK((uint64_t)(a * b) == (uint64_t)ref(la * lb));
+			if (y) {
+				CHECK((uint64_t)(a / b) == (uint64_t)ref(la / lb));
+				CHECK((uint64_t)SANE::rem(a, b) == (uint64_t)ref(std::remainder(la, lb)));
+			}
+		}
+
+		// inexact quotients in every (SANE environment) rounding direction.
+		const SANE::rounding_direction directions[4] = { SANE::TONEAREST, SANE::UPWARD, SANE::DOWNWARD, SANE::TOWARDZERO };
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+		for (int m = 0; m < 4; ++m) {
+			for (int i = 0; i < 2000; ++i) {
+				int64_t x = (int64_t)(rng() >> 1) >> (rng() % 63);
+				int64_t y = (int64_t)(rng() % 64) - 32;
+				if (rng() & 1) x = -x;
+				if (!y) continue;
+				std::fesetround(modes[m]);
+				comp expect = ref((long double)x / (long double)y);
+				std::fesetround(FE_TONEAREST);
+				SANE::setround(directions[m]);
+				CHECK((uint64_t)(comp(x) / comp(y)) == (uint64_t)expect);
+				SANE::setround(SANE::TONEAREST);
+			}
+		}
+	}
+
+}
+
+
+TEST_CASE("comp transcode", "[comp]") {
+
+	using SANE::comp;
+	using SANE::endian;
+	typedef fp::format_comp<endian::big> C;
+	typedef fp::format_comp<endian::little> CL;
+
+	std::vector<int64_t> ints = { 0, 1, -1, 2, 1000, -123456789, INT64_MAX, -INT64_MAX, (int64_t)comp::NaN,
+		INT64_C(0x0020000000000001), INT64_C(-0x0020000000000003), INT64_C(0x7ffffffffffffc00),
+		INT64_C(0x001fffffffffffff), INT64_C(-0x0020000000000001), INT64_C(0x40000001), INT64_C(0x0020000020000001) };
+	std::vector<long double> values = { 0.0L, -0.0L, 0.5L, -0.75L, 1.0L, -2.5L, 1.0e18L, -9.2e18L, 9.3e18L,
+		9223372036854775807.0L, -9223372036854775807.0L, 9223372036854775808.0L, -9223372036854775808.0L,
+		std::numeric_limits<long double>::infinity(), -std::numeric_limits<long double>::infinity(),
+		std::numeric_limits<long double>::quiet_NaN(), std::numeric_limits<long double>::denorm_min(), 1.0e-4000L };
+
+	std::mt19937_64 rng(42);
+	for (int i = 0; i < 1000; ++i) {
+		ints.push_back((int64_t)rng() >> (rng() % 64));
+		fp::info fpi;
+		fpi.sign = rng() & 1;
+		fpi.exp = (int)(rng() % 140) - 70;
+		fpi.sig = rng() | (UINT64_C(1) << 63);
+		values.push_back((long double)fpi);
+	}
+
+	auto same = [](long double a, long double b) {
+		return std::memcmp(&a, &b, 10) == 0;
+	};
+
+	SECTION("comp ->") {
+		size_t n = ints.size();
+		std::vector<uint8_t> src(n * 8), d(n * 8), f(n * 4), x(n * 12);
+		for (size_t i = 0; i < n; ++i) big_endian<comp>::at(src.data() + i * 8) = comp(ints[i]);
+
+		fp::transcode(C{}, src.data(), fp::format<8, endian::big>{}, d.data(), n);
+		fp::transcode(C{}, src.data(), fp::format<4, endian::little>{}, f.data(), n);
+		fp::transcode(C{}, src.data(), fp::format_68881<endian::big>{}, x.data(), n);
+
+		for (size_t i = 0; i < n; ++i) {
+			comp c(ints[i]);
+			double dd = big_endian<double>::at(d.data() + i * 8);
+			float ff = little_endian<float>::at(f.data() + i * 4);
+			long double xx = endian_value<long double, endian::big, fp::format_68881<endian::big>>::at(x.data() + i * 12);
+			double ed = (double)c;
+			float ef = (float)c;
+			CHECK(std::memcmp(&dd, &ed, 8) == 0);
+			CHECK(std::memcmp(&ff, &ef, 4) == 0);
+			CHECK(same(xx, (long double)c));
+		}
+	}
+
+	SECTION("-> comp") {
+		size_t n = values.size();
+		std::vector<uint8_t> d(n * 8), f(n * 4), x(n * 16), c1(n * 8), c2(n * 8), c3(n * 8);
+		for (size_t i = 0; i < n; ++i) {
+			little_endian<double>::at(d.data() + i * 8) = (double)values[i];
+			big_endian<float>::at(f.data() + i * 4) = (float)values[i];
+			fp::info(values[i]).write(fp::format<16, endian::little>{}, x.data() + i * 16);
+		}
+
+		fp::transcode(fp::format<8, endian::little>{}, d.data(), C{}, c1.data(), n);
+		fp::transcode(fp::format<4, endian::big>{}, f.data(), CL{}, c2.data(), n);
+		fp::transcode(fp::format<16, endian::little>{}, x.data(), C{}, c3.data(), n);
+
+		for (size_t i = 0; i < n; ++i) {
+			CHECK((uint64_t)big_endian<comp>::at(c1.data() + i * 8).load() == (uint64_t)comp((double)values[i]));
+			CHECK((uint64_t)little_endian<comp>::at(c2.data() + i * 8).load() == (uint64_t)comp((float)values[i]));
+			CHECK((uint64_t)big_endian<comp>::at(c3.data() + i * 8).load() == (uint64_t)comp(values[i]));
+		}
+
+		for (SANE::rounding_direction rd : { SANE::TONEAREST, SANE::UPWARD, SANE::DOWNWARD, SANE::TOWARDZERO }) {
+			fp::transcode(fp::format<8, endian::little>{}, d.data(), C{}, c1.data(), n, rd);
+			fp::transcode(fp::format<4, endian::big>{}, f.data(), CL{}, c2.data(), n, rd);
+			fp::transcode(fp::format<16, endian::little>{}, x.data(), C{}, c3.data(), n, rd);
+
+			for (size_t i = 0; i < n; ++i) {
+				CHECK((uint64_t)big_endian<comp>::at(c1.data() + i * 8).load() == (uint64_t)comp((double)values[i], rd));
+				CHECK((uint64_t)little_endian<comp>::at(c2.data() + i * 8).load() == (uint64_t)comp((float)values[i], rd));
+				CHECK((uint64_t)big_endian<comp>::at(c3.data() + i * 8).load() == (uint64_t)comp(values[i], rd));
+			}
+		}
+	}
+
+	SECTION("directions") {
+		const long double x[] = { 2.5L, -2.5L, 3.5L, 0.5L, -0.5L, 0.25L, -0.75L, 2.0L, 1e-4000L, -1e-4000L };
+		const int64_t nearest[] = { 2, -2, 4, 0, 0, 0, -1, 2, 0, 0 };
+		const int64_t up[] = { 3, -2, 4, 1, 0, 1, 0, 2, 1, 0 };
+		const int64_t down[] = { 2, -3, 3, 0, -1, 0, -1, 2, 0, -1 };
+		const int64_t zero[] = { 2, -2, 3, 0, 0, 0, 0, 2, 0, 0 };
+		for (int i = 0; i < 10; ++i) {
+			CHECK((int64_t)comp(x[i], SANE::TONEAREST) == nearest[i]);
+			CHECK((int64_t)comp(x[i], SANE::UPWARD) == up[i]);
+			CHECK((int64_t)comp(x[i], SANE::DOWNWARD) == down[i]);
+			CHECK((int64_t)comp(x[i], SANE::TOWARDZERO) == zero[i]);
+			if (i < 8) {
+				CHECK((int64_t)comp((double)x[i], SANE::UPWARD) == up[i]);
+				CHECK((int64_t)comp((float)x[i], SANE::DOWNWARD) == down[i]);
+			}
+		}
+		CHECK((int64_t)comp(2.5) == 2);
+		CHECK(SANE::isnan(comp(9223372036854775808.0, SANE::DOWNWARD)));
+		CHECK((int64_t)comp(-4611686018427387903.5L, SANE::TOWARDZERO) == -INT64_C(4611686018427387903));
+		CHECK((int64_t)comp(-4611686018427387903.5L, SANE::DOWNWARD) == -INT64_C(4611686018427387904));
+	}
+}
+
+
+TEST_CASE("comp reduce", "[comp]") {
+
+	using SANE::comp;
+	using SANE::endian;
+	typedef fp::format_comp<endian::big> C;
+
+	const size_t n = 300000;
+	std::vector<uint8_t> v(n * 8);
+	std::mt19937_64 rng(43);
+	for (size_t i = 0; i < n; ++i)
+		big_endian<comp>::at(v.data() + i * 8) = comp((int64_t)(rng() >> 24) - (INT64_C(1) << 39));
+
+	auto at = [&](size_t i) -> big_endian<comp> & { return big_endian<comp>::at(v.data() + i * 8); };
+
+	auto check = [&](const fp::comp_reduction &r, size_t count) {
+		int64_t sum = 0, mn = INT64_MAX, mx = INT64_MIN;
+		size_t nans = 0;
+		for (size_t i = 0; i < count; ++i) {
+			comp c = at(i);
+			if (isnan(c)) { ++nans; continue; }
+			sum += (int64_t)c;
+			mn = std::min(mn, (int64_t)c);
+			mx = std::max(mx, (int64_t)c);
+		}
+		CHECK(r.count == count - nans);
+		CHECK(r.nans == nans);
+		CHECK((int64_t)r.sum == sum);
+		CHECK((int64_t)r.min == mn);
+		CHECK((int64_t)r.max == mx);
+	};
+
+	SECTION("sum, min, max") {
+		for (unsigned threads : { 1u, 2u, 3u, 8u }) check(fp::reduce(C{}, v.data(), n, fp::skip_nans, threads), n);
+		for (size_t count : { 1000, 1003, 3 }) check(fp::reduce(C{}, v.data(), count), count);
+		CHECK(std::abs(fp::reduce(C{}, v.data(), 7).mean() - ((long double)fp::reduce(C{}, v.data(), 7).sum / 7)) < 1);
+	}
+
+	SECTION("NaNs") {
+		at(5) = comp(comp::NaN);
+		at(n - 1) = comp(comp::NaN);
+		check(fp::reduce(C{}, v.data(), n, fp::skip_nans, 4), n);
+
+		fp::comp_reduction r = fp::reduce(C{}, v.data(), n, fp::propagate_nans, 4);
+		CHECK(isnan(r.sum));
+		CHECK(isnan(r.min));
+		CHECK(isnan(r.max));
+		CHECK(std::isnan(r.mean()));
+		CHECK(r.nans == 2);
+		CHECK(!std::isnan(fp::reduce(C{}, v.data(), n, fp::skip_nans, 4).mean()));
+
+		fp::comp_reduction e = fp::reduce(C{}, v.data() + 5 * 8, 1);
+		CHECK(e.count == 0);
+		CHECK(isnan(e.min));
+		CHECK((int64_t)e.sum == 0);
+	}
+
+	SECTION("overflow") {
+		for (size_t i = 0; i < 1000; ++i) at(i) = comp(INT64_MAX - (int64_t)i);
+		for (unsigned threads : { 1u, 2u }) {
+			fp::comp_reduction r = fp::reduce(C{}, v.data(), 1000, fp::skip_nans, threads);
+			CHECK(isnan(r.sum));
+			// 1000 * (2^63 - 1) - 499500.
+			CHECK(r.total_hi == 499);
+			CHECK(r.total_lo == UINT64_C(0x8000000000000000) * 1000 - 1000 - 499500);
+			CHECK((int64_t)r.max == INT64_MAX);
+			CHECK(fp::info(r.mean()).sig == NANCOMP);
+		}
+
+		// back in range after overflowing along the way.
+		at(1000) = comp(-INT64_MAX);
+		at(1001) = comp(INT64_C(-5));
+		fp::comp_reduction r = fp::reduce(C{}, v.data() + 998 * 8, 4);
+		CHECK((int64_t)r.sum == INT64_MAX - 998 - 999 - 5);
+	}
+}
+
+
+TEST_CASE("comp to_chars", "[comp]") {
+
+	using SANE::comp;
+	using SANE::endian;
+
+	std::vector<int64_t> ints = { 0, 1, -1, 9, 10, 99, 100, -100, 12345, INT64_MAX, -INT64_MAX, (int64_t)comp::NaN };
+	for (uint64_t p = 1; p && p < UINT64_C(10000000000000000000); p *= 10) {
+		ints.push_back((int64_t)p - 1);
+		ints.push_back((int64_t)p);
+	}
+	std::mt19937_64 rng(44);
+	for (int i = 0; i < 1000; ++i) ints.push_back((int64_t)rng() >> (rng() % 64));
+
+	char buffer[32];
+	for (int64_t x : ints) {
+		comp c(x);
+		std::string expect = isnan(c) ? "nan" : std::to_string(x);
+		char *end = to_chars(buffer, buffer + sizeof(buffer), c);
+		REQUIRE(end);
+		CHECK(std::string(buffer, end) == expect);
+		CHECK(to_string(c) == expect);
+		CHECK(to_chars(buffer, buffer + expect.size() - 1, c) == nullptr);
+	}
+
+	// batch, into an arena.
+	std::vector<uint8_t> v(ints.size() * 8);
+	for (size_t i = 0; i < ints.size(); ++i) little_endian<comp>::at(v.data() + i * 8) = comp(ints[i]);
+	std::vector<char> arena(ints.size() * 20);
+	std::vector<size_t> offsets(ints.size() + 1);
+	size_t used = fp::to_chars(fp::format_comp<endian::little>{}, v.data(), ints.size(), arena.data(), offsets.data());
+	CHECK(used == offsets.back());
+	for (size_t i = 0; i < ints.size(); ++i)
+		CHECK(std::string(arena.data() + offsets[i], arena.data() + offsets[i + 1]) == to_string(comp(ints[i])));
+}
+
+
+TEST_CASE("comp2dec", "[comp]") {
+
+	using SANE::comp;
+
+	std::vector<int64_t> ints = { 0, 1, -1, 5, 49, 50, 51, 123, -600, 999, 12345678, INT64_MAX, -INT64_MAX, (int64_t)comp::NaN,
+		INT64_C(999999999999999999), INT64_C(4999999999999999999) };
+	std::mt19937_64 rng(45);
+	for (int i = 0; i < 300; ++i) ints.push_back((int64_t)rng() >> (rng() % 64));
+
+	auto same = [](const decimal &a, const decimal &b) {
+		return a.sgn == b.sgn && a.exp == b.exp && a.sig == b.sig;
+	};
+
+	SECTION("comp2dec") {
+		for (int64_t x : ints) {
+			comp c(x);
+			for (int style : { decform::FLOATDECIMAL, decform::FIXEDDECIMAL }) {
+				for (int digits : { -25, -5, -1, 0, 1, 3, 10, 19, 20, 32, 40 }) {
+					decform df(style, digits);
+					decimal expect = x2dec(fp::info((long double)c), df);
+					CHECK(same(comp2dec(c, df), expect));
+				}
+			}
+		}
+	}
+
+	SECTION("dec2comp") {
+		for (int64_t x : ints) {
+			decimal d = comp2dec(comp(x), decform(decform::FLOATDECIMAL, 19));
+			CHECK((uint64_t)dec2comp(d) == (uint64_t)comp(x));
+		}
+
+		CHECK((int64_t)dec2comp(decimal(0, -2, "12399")) == 124);
+		CHECK((int64_t)dec2comp(decimal(0, -2, "12399"), TOWARDZERO) == 123);
+		CHECK((int64_t)dec2comp(decimal(1, -2, "12399"), TOWARDZERO) == -123);
+		CHECK((int64_t)dec2comp(decimal(0, 3, "12")) == 12000);
+		CHECK((int64_t)dec2comp(decimal(0, -5, "12")) == 0);
+		CHECK((int64_t)dec2comp(decimal(0, 0, "0")) == 0);
+		CHECK((int64_t)dec2comp(decimal(0, 0, "9223372036854775807")) == INT64_MAX);
+		CHECK((int64_t)dec2comp(decimal(0, -20, "922337203685477580799999999999999999999"), TOWARDZERO) == INT64_MAX);
+		CHECK(isnan(dec2comp(decimal(0, -20, "922337203685477580799999999999999999999"))));
+		CHECK(isnan(dec2comp(decimal(0, 0, "9223372036854775808"))));
+		CHECK(isnan(dec2comp(decimal(1, 0, "9223372036854775808"))));
+		CHECK(isnan(dec2comp(decimal(0, 19, "1"))));
+		CHECK(isnan(dec2comp(decimal(0, 0, "I"))));
+		CHECK(isnan(dec2comp(decimal(0, 0, "N4011"))));
+		CHECK(isnan(dec2comp(decimal(0, 0, "12x"))));
+
+		// beyond 64 bits of precision, the extended route rounds first.
+		decimal d(0, -22, "29999999999999999999999");
+		CHECK((int64_t)dec2comp(d, TOWARDZERO) == 2);
+		CHECK((int64_t)comp(dec2x(d), TOWARDZERO) == 3);
+	}
+
+	SECTION("NaN") {
+		decimal d = comp2dec(comp(comp::NaN), decform());
+		CHECK(isnan(d));
+		CHECK(same(d, x2dec(fp::info(make_nan<long double>(NANCOMP)), decform())));
+	}
+}
+
+
+TEST_CASE("scaled comp", "[comp]") {
+
+	using SANE::comp;
+	using SANE::endian;
+
+	char buffer[40];
+	auto format = [&](int64_t x, int scale, int digits) {
+		char *end = to_chars(buffer, buffer + sizeof(buffer), comp(x), scale, digits);
+		return end ? std::string(buffer, end) : std::string("?");
+	};
+	auto parse = [](const std::string &s, int scale) {
+		comp c(0);
+		const char *end = from_chars(s.data(), s.data() + s.size(), c, scale);
+		return end == s.data() + s.size() ? (int64_t)c : INT64_C(-1);
+	};
+
+	SECTION("currency") {
+		CHECK(parse("1234.56", 2) == 123456);
+		CHECK(format(123456, 2, 2) == "1234.56");
+		CHECK(format(5, 2, 2) == "0.05");
+		CHECK(format(-5, 2, 2) == "-0.05");
+		CHECK(format(0, 2, 2) == "0.00");
+		CHECK(format(123456, 2, 0) == "1235");
+		CHECK(format(123450, 2, 0) == "1234");
+		CHECK(format(123550, 2, 0) == "1236");
+		CHECK(format(-123450, 2, 1) == "-1234.5");
+		CHECK(format(-4, 2, 0) == "-0");
+		CHECK(format(123456, 2, 4) == "1234.5600");
+		CHECK(format(123456, 0, 0) == "123456");
+		CHECK(format(INT64_MAX, 18, 18) == "9.223372036854775807");
+		CHECK(format(-INT64_MAX, 0, 18).size() == 39);
+		CHECK(format((int64_t)comp::NaN, 2, 2) == "NAN(020)");
+		CHECK(to_chars(buffer, buffer + 6, comp(123456), 2) == nullptr);
+
+		CHECK(parse("-1234.56", 2) == -123456);
+		CHECK(parse("+.05", 2) == 5);
+		CHECK(parse("12", 2) == 1200);
+		CHECK(parse("12.", 2) == 1200);
+		CHECK(parse("0.005", 2) == 0);
+		CHECK(parse("0.015", 2) == 2);
+		CHECK(parse("0.0150", 2) == 2);
+		CHECK(parse("0.0051", 2) == 1);
+		CHECK(parse("-0.025", 2) == -2);
+		CHECK(parse("000000000000000000000001.5", 0) == 2);
+		CHECK(parse("92233720368547758.07", 2) == INT64_MAX);
+
+		comp c(0);
+		std::string s = "92233720368547758.08";
+		CHECK(from_chars(s.data(), s.data() + s.size(), c, 2) == s.data() + s.size());
+		CHECK(isnan(c));
+		s = "123456789012345678901234";
+		CHECK(from_chars(s.data(), s.data() + s.size(), c, 0) == s.data() + s.size());
+		CHECK(isnan(c));
+		s = "1.5x";
+		CHECK(from_chars(s.data(), s.data() + s.size(), c, 2) == s.data() + 3);
+		CHECK((int64_t)c == 150);
+		for (std::string bad : { "", "-", ".", "x", "-.x" }) {
+			CHECK(from_chars(bad.data(), bad.data() + bad.size(), c, 2) == nullptr);
+			CHECK(isnan(c));
+		}
+		for (std::string nan : { "NAN(020)", "nan", "-NaN(1)" }) {
+			c = comp(1);
+			CHECK(from_chars(nan.data(), nan.data() + nan.size(), c, 2) == nan.data() + nan.size());
+			CHECK(isnan(c));
+		}
+		s = "NAN(02";
+		CHECK(from_chars(s.data(), s.data() + s.size(), c, 2) == s.data() + 3);
+		CHECK(isnan(c));
+	}
+
+	SECTION("directions") {
+		setround(UPWARD);
+		CHECK(parse("0.001", 2) == 1);
+		CHECK(parse("-0.019", 2) == -1);
+		CHECK(parse("0.010", 2) == 1);
+		setround(DOWNWARD);
+		CHECK(parse("0.019", 2) == 1);
+		CHECK(parse("-0.0100001", 2) == -2);
+		setround(TOWARDZERO);
+		CHECK(parse("0.019", 2) == 1);
+		CHECK(parse("-0.019", 2) == -1);
+		setround(TONEAREST);
+		CHECK(parse("0.019", 2) == 2);
+
+		// or as told.
+		auto directed = [&](int64_t x, rounding_direction rd) {
+			char *end = to_chars(buffer, buffer + sizeof(buffer), comp(x), 2, 0, rd);
+			return end ? std::string(buffer, end) : std::string("?");
+		};
+		CHECK(directed(123401, UPWARD) == "1235");
+		CHECK(directed(123400, UPWARD) == "1234");
+		CHECK(directed(-4, UPWARD) == "-0");
+		CHECK(directed(-123401, DOWNWARD) == "-1235");
+		CHECK(directed(123499, DOWNWARD) == "1234");
+		CHECK(directed(-123499, TOWARDZERO) == "-1234");
+		CHECK(directed(123450, TONEAREST) == "1234");
+
+		comp c(0);
+		std::string s = "-0.011";
+		CHECK(from_chars(s.data(), s.data() + s.size(), c, 2, DOWNWARD) == s.data() + s.size());
+		CHECK((int64_t)c == -2);
+		CHECK(from_chars(s.data(), s.data() + s.size(), c, 2, UPWARD) == s.data() + s.size());
+		CHECK((int64_t)c == -1);
+	}
+
+	SECTION("dec2str") {
+		std::vector<int64_t> ints = { 0, 1, -1, 5, 49, 50, 51, 150, 250, -250, 999, INT64_MAX, -INT64_MAX };
+		std::mt19937_64 rng(46);
+		for (int i = 0; i < 300; ++i) ints.push_back((int64_t)rng() >> (rng() % 64));
+
+		for (int64_t x : ints) {
+			for (int scale : { 0, 1, 2, 4, 9, 18 }) {
+				for (int digits : { 0, 1, 2, 3, 6 }) {
+					// round at digits, then move the point.
+					for (rounding_direction rd : { TONEAREST, UPWARD, DOWNWARD, TOWARDZERO }) {
+						decimal d = comp2dec(comp(x), decform(decform::FIXEDDECIMAL, digits - scale), rd);
+						d.exp -= scale;
+						std::string expect;
+						dec2str(decform(decform::FIXEDDECIMAL, digits), d, expect);
+						char *end = to_chars(buffer, buffer + sizeof(buffer), comp(x), scale, digits, rd);
+						CHECK(std::string(buffer, end ? end : buffer) == expect);
+					}
+				}
+				CHECK(parse(format(x, scale, scale), scale) == x);
+			}
+		}
+	}
+
+	SECTION("batch") {
+		std::vector<int64_t> ints = { 0, 5, -5, 123456, (int64_t)comp::NaN, INT64_MAX };
+		std::vector<uint8_t> v(ints.size() * 8), w(ints.size() * 8);
+		for (size_t i = 0; i < ints.size(); ++i) big_endian<comp>::at(v.data() + i * 8) = comp(ints[i]);
+
+		std::vector<char> arena(ints.size() * 40);
+		std::vector<size_t> offsets(ints.size() + 1);
+		size_t used = fp::to_chars(fp::format_comp<endian::big>{}, v.data(), ints.size(), 2, 2, arena.data(), offsets.data());
+		CHECK(used == offsets.back());
+		for (size_t i = 0; i < ints.size(); ++i)
+			CHECK(std::string(arena.data() + offsets[i], arena.data() + offsets[i + 1]) == format(ints[i], 2, 2));
+
+		CHECK(fp::from_chars(fp::format_comp<endian::big>{}, arena.data(), offsets.data(), ints.size(), 2, w.data()) == 0);
+		CHECK(v == w);
+
+		CHECK(fp::from_chars(fp::format_comp<endian::big>{}, arena.data(), offsets.data(), ints.size(), 1, w.data(), UPWARD) == 0);
+		CHECK((int64_t)big_endian<comp>::at(w.data() + 8).load() == 1);
+		CHECK((int64_t)big_endian<comp>::at(w.data() + 16).load() == 0);
+		CHECK((int64_t)big_endian<comp>::at(w.data() + 24).load() == 12346);
+		used = fp::to_chars(fp::format_comp<endian::big>{}, v.data(), ints.size(), 2, 0, arena.data(), offsets.data(), DOWNWARD);
+		CHECK(used == offsets.back());
+		CHECK(std::string(arena.data() + offsets[2], arena.data() + offsets[3]) == "-1");
+	}
+}
+
+
+TEST_CASE("integer conversions", "[integer]") {
+
+	using SANE::endian;
+	using SANE::x2i;
+	using SANE::x2l;
+	typedef fp::format_integer<2, endian::big> I;
+	typedef fp::format_integer<4, endian::little> L;
+
+	std::vector<long double> values = { 0.0L, -0.0L, 0.5L, -0.5L, 1.5L, 2.5L, -2.5L, 0.25L, -0.75L, 1.0e-4000L,
+		32767.0L, 32767.5L, 32768.0L, -32768.0L, -32768.5L, -32769.0L, -32767.5L,
+		2147483647.0L, 2147483647.5L, 2147483648.0L, -2147483648.0L, -2147483648.5L, -2147483649.0L,
+		1.0e18L, -9.3e18L, 1.0e300L,
+		std::numeric_limits<long double>::infinity(), -std::numeric_limits<long double>::infinity(),
+		std::numeric_limits<long double>::quiet_NaN(), std::numeric_limits<long double>::denorm_min() };
+
+	std::mt19937_64 rng(47);
+	for (int i = 0; i < 2000; ++i) {
+		fp::info fpi;
+		fpi.sign = rng() & 1;
+		fpi.exp = (int)(rng() % 40) - 4;
+		fpi.sig = (rng() | (UINT64_C(1) << 63)) & ~(rng() % 2 ? UINT64_C(0) : ~UINT64_C(0) >> 34);
+		values.push_back((long double)fpi);
+	}
+
+	const SANE::rounding_direction directions[4] = { SANE::TONEAREST, SANE::UPWARD, SANE::DOWNWARD, SANE::TOWARDZERO };
+	const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+
+	// the host's rint, then the SANE range rules.
+	auto expect = [&](long double x, int m, long double lo, long double hi) -> int64_t {
+		if (std::isnan(x) || std::isinf(x)) return (int64_t)lo;
+		std::fesetround(modes[m]);
+		volatile long double r = std::nearbyint(x);
+		std::fesetround(FE_TONEAREST);
+		if (r < lo || r > hi) return (int64_t)lo;
+		return (int64_t)r;
+	};
+
+	SECTION("x2i, x2l") {
+		for (long double x : values) {
+			for (int m = 0; m < 4; ++m) {
+				CHECK(x2i(x, directions[m]) == expect(x, m, -32768.0L, 32767.0L));
+				CHECK(x2l(x, directions[m]) == expect(x, m, -2147483648.0L, 2147483647.0L));
+			}
+		}
+		CHECK(x2i(2.5L) == 2);
+		CHECK(x2i(3.5L) == 4);
+		CHECK(x2i(-0.5L, SANE::DOWNWARD) == -1);
+		CHECK(x2i(-32768.0L) == INT16_MIN);
+		CHECK(x2i(32768.0L) == INT16_MIN);
+		CHECK(x2l(-2147483648.4L) == INT32_MIN);
+		CHECK(x2l(2147483647.4L) == INT32_MAX);
+		CHECK(x2l(2147483647.4L, SANE::UPWARD) == INT32_MIN);
+	}
+
+	SECTION("batch ->") {
+		size_t n = values.size();
+		std::vector<uint8_t> x(n * 12), d(n * 8), f(n * 4), i1(n * 2), i2(n * 2), l1(n * 4), l2(n * 4), l3(n * 4);
+		for (size_t i = 0; i < n; ++i) {
+			fp::info(values[i]).write(fp::format_68881<endian::big>{}, x.data() + i * 12);
+			big_endian<double>::at(d.data() + i * 8) = (double)values[i];
+			little_endian<float>::at(f.data() + i * 4) = (float)values[i];
+		}
+
+		for (int m = 0; m < 4; ++m) {
+			auto rd = directions[m];
+			fp::transcode(fp::format_68881<endian::big>{}, x.data(), I{}, i1.data(), n, rd);
+			fp::transcode(fp::format<8, endian::big>{}, d.data(), I{}, i2.data(), n, rd);
+			fp::transcode(fp::format_68881<endian::big>{}, x.data(), L{}, l1.data(), n, rd);
+			fp::transcode(fp::format<8, endian::big>{}, d.data(), L{}, l2.data(), n, rd);
+			fp::transcode(fp::format<4, endian::little>{}, f.data(), L{}, l3.data(), n, rd);
+
+			for (size_t i = 0; i < n; ++i) {
+				long double dd = (double)values[i];
+				long double ff = (float)values[i];
+				CHECK((int16_t)fp::detail::load_word<uint16_t, endian::big>(i1.data() + i * 2) == x2i(values[i], rd));
+				CHECK((int16_t)fp::detail::load_word<uint16_t, endian::big>(i2.data() + i * 2) == x2i(dd, rd));
+				CHECK((int32_t)fp::detail::load_word<uint32_t, endian::little>(l1.data() + i * 4) == x2l(values[i], rd));
+				CHECK((int32_t)fp::detail::load_word<uint32_t, endian::little>(l2.data() + i * 4) == x2l(dd, rd));
+				CHECK((int32_t)fp::detail::load_word<uint32_t, endian::little>(l3.data() + i * 4) == x2l(ff, rd));
+			}
+		}
+	}
+
+	SECTION("-> batch") {
+		std::vector<int32_t> ints = { 0, 1, -1, 255, -32768, 32767, INT32_MIN, INT32_MAX, 16777217, -16777219 };
+		for (int i = 0; i < 1000; ++i) ints.push_back((int32_t)rng() >> (rng() % 32));
+		size_t n = ints.size();
+
+		std::vector<uint8_t> i16(n * 2), i32(n * 4), x(n * 12), d(n * 8), f(n * 4);
+		for (size_t i = 0; i < n; ++i) {
+			fp::detail::store_word<endian::big>(i16.data() + i * 2, (uint16_t)ints[i]);
+			fp::detail::store_word<endian::little>(i32.data() + i * 4, (uint32_t)ints[i]);
+		}
+
+		fp::transcode(I{}, i16.data(), fp::format<10, endian::little>{}, x.data(), n);
+		fp::transcode(I{}, i16.data(), fp::format<8, endian::big>{}, d.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+			int16_t v = (int16_t)ints[i];
+			CHECK(little_endian<long double>::at(x.data() + i * 10) == (long double)v);
+			CHECK(big_endian<double>::at(d.data() + i * 8) == (double)v);
+		}
+
+		fp::transcode(L{}, i32.data(), fp::format_68881<endian::big>{}, x.data(), n);
+		fp::transcode(L{}, i32.data(), fp::format<4, endian::big>{}, f.data(), n);
+		for (size_t i = 0; i < n; ++i) {
+			long double xx = endian_value<long double, endian::big, fp::format_68881<endian::big>>::at(x.data() + i * 12);
+			CHECK(xx == (long double)ints[i]);
+			CHECK(x2l(xx) == ints[i]);
+			CHECK(big_endian<float>::at(f.data() + i * 4) == (float)ints[i]);
+		}
+
+		// LONGINT -> float rounds in the direction, as the host's conversion does.
+		for (int m = 0; m < 4; ++m) {
+			fp::transcode(L{}, i32.data(), fp::format<4, endian::little>{}, f.data(), n, directions[m]);
+			int errors = 0;
+			for (size_t i = 0; i < n; ++i) {
+				std::fesetround(modes[m]);
+				volatile int32_t v = ints[i];
+				volatile float expected = (float)v;
+				std::fesetround(FE_TONEAREST);
+				errors += little_endian<float>::at(f.data() + i * 4) != expected;
+			}
+			CHECK(errors == 0);
+		}
+	}
+}
+
+
+TEST_CASE("sane_value", "[value]") {
+
+	using SANE::comp;
+	using SANE::sane_value;
+	using SANE::sane_column;
+
+	CHECK(sizeof(sane_value) == 16);
+
+	// a mix of every type, in runs of random length.
+	std::mt19937_64 rng(48);
+	std::vector<sane_value> values;
+	while (values.size() < 3000) {
+		unsigned type = rng() % 5;
+		size_t n = 1 + rng() % 40;
+		for (size_t i = 0; i < n; ++i) {
+			fp::info fpi;
+			fpi.sign = rng() & 1;
+			fpi.exp = (int)(rng() % 200) - 100;
+			fpi.sig = rng() | (UINT64_C(1) << 63);
+			long double x = (long double)fpi;
+			switch (rng() % 16) {
+				case 0: x = 0; break;
+				case 1: x = std::numeric_limits<long double>::infinity(); break;
+				case 2: x = make_nan<long double>(rng() % 255 + 1); break;
+			}
+			switch (type) {
+				case 0: values.emplace_back((float)x); break;
+				case 1: values.emplace_back((double)x); break;
+				case 2: values.emplace_back(x); break;
+				case 3: values.emplace_back(comp(x)); break;
+				case 4: values.emplace_back(x2dec(fpi, decform(decform::FLOATDECIMAL, 1 + (int)(rng() % 25)))); break;
+			}
+		}
+	}
+
+	sane_column column;
+	for (const auto &v : values) column.push_back(v);
+	size_t n = values.size();
+
+	SECTION("values") {
+		sane_value a(decimal(0, -2, "125"));
+		sane_value b(a), c(1.25);
+		CHECK(b.type() == SANE::decimal_type);
+		CHECK(&b.dec() != &a.dec());
+		CHECK(SANE::compare(a, b) == SANE::EQUALTO);
+		CHECK(SANE::compare(a, c) == SANE::EQUALTO);
+		CHECK(SANE::compare(sane_value(comp(1)), c) == SANE::LESSTHAN);
+		CHECK(SANE::compare(sane_value(make_nan<double>(1)), c) == SANE::UNORDERED);
+		c = a;
+		a = sane_value(2.5f);
+		CHECK(c.type() == SANE::decimal_type);
+		CHECK(a.type() == SANE::single_type);
+		CHECK((long double)a.info() == 2.5L);
+		sane_value d(std::move(c));
+		CHECK(d.dec().sig == "125");
+		CHECK(to_string(sane_value(comp(-42)), decform(decform::FIXEDDECIMAL, 0)) == "-42");
+		CHECK(isnan(sane_value(comp(comp::NaN))));
+		CHECK(fpclassify(sane_value(0.0f)) == FP_ZERO);
+	}
+
+	SECTION("column") {
+		REQUIRE(column.size() == n);
+		CHECK(column.runs().size() < n / 10);
+		for (size_t i = 0; i < n; ++i) {
+			sane_value v = column[i];
+			CHECK(v.type() == values[i].type());
+			CHECK(v.canonical() == values[i].canonical());
+		}
+
+		std::vector<uint8_t> x(n * 10), d(n * 8), c(n * 8), e(16);
+		column.convert(fp::format<10, SANE::endian::big>{}, x.data());
+		column.convert(fp::format<8, SANE::endian::little>{}, d.data());
+		column.convert(fp::format_comp<SANE::endian::big>{}, c.data());
+		for (size_t i = 0; i < n; ++i) {
+			values[i].write(fp::format<10, SANE::endian::big>{}, e.data());
+			CHECK(std::memcmp(x.data() + i * 10, e.data(), 10) == 0);
+			values[i].write(fp::format<8, SANE::endian::little>{}, e.data());
+			CHECK(std::memcmp(d.data() + i * 8, e.data(), 8) == 0);
+			values[i].write(fp::format_comp<SANE::endian::big>{}, e.data());
+			CHECK(std::memcmp(c.data() + i * 8, e.data(), 8) == 0);
+		}
+
+		fp::class_counts counts = column.classify(), expect;
+		for (size_t i = 0; i < n; ++i) {
+			values[i].write(fp::format<10, SANE::endian::native>{}, e.data());
+			fp::classify(fp::format<10, SANE::endian::native>{}, e.data(), 1, expect);
+		}
+		CHECK(counts.zero == expect.zero);
+		CHECK(counts.normal == expect.normal);
+		CHECK(counts.subnormal == expect.subnormal);
+		CHECK(counts.infinite == expect.infinite);
+		CHECK(counts.nan == expect.nan);
+		CHECK(std::equal(counts.nan_code, counts.nan_code + 256, expect.nan_code));
+
+		sane_value pivot(decimal(1, -3, "12345"));
+		std::vector<SANE::relop> rel(n);
+		column.compare(pivot.canonical(), rel.data());
+		for (size_t i = 0; i < n; ++i) CHECK(rel[i] == SANE::compare(values[i], pivot));
+
+		decform df(decform::FLOATDECIMAL, 12);
+		std::vector<std::string> text(n);
+		column.format(df, text.data());
+		for (size_t i = 0; i < n; ++i) CHECK(text[i] == to_string(values[i], df));
+	}
+}
+
+
+namespace {
+	unsigned halted = 0;
+	void record_halt(unsigned exceptions, SANE::environment) { halted |= exceptions; }
+}
+
+TEST_CASE("environment", "[environment]") {
+
+	using namespace SANE;
+
+	setenvironment(0);
+
+	SECTION("word") {
+		setround(DOWNWARD);
+		CHECK(getenvironment() == 0x4000);
+		CHECK(getround() == DOWNWARD);
+		setprecision(DBLPRECISION);
+		CHECK(getenvironment() == 0x4020);
+		CHECK(getprecision() == DBLPRECISION);
+		sethalt(OVERFLOW, true);
+		CHECK(getenvironment() == 0x4024);
+		CHECK(testhalt(OVERFLOW | INVALID));
+		CHECK(!testhalt(INVALID));
+		setexception(INEXACT, true);
+		CHECK(getenvironment() == 0x5024);
+		CHECK(testexception(INEXACT));
+		CHECK(!testexception(INVALID | UNDERFLOW));
+		setexception(INEXACT, false);
+		sethalt(OVERFLOW, false);
+		CHECK(getenvironment() == 0x4020);
+	}
+
+	SECTION("procentry/procexit") {
+		setround(UPWARD);
+		setexception(INVALID, true);
+		environment e;
+		procentry(e);
+		CHECK(getenvironment() == 0);
+		setexception(INEXACT, true);
+		procexit(e);
+		CHECK(getround() == UPWARD);
+		CHECK(testexception(INVALID));
+		CHECK(testexception(INEXACT));
+	}
+
+	SECTION("halts") {
+		halted = 0;
+		sethaltvector(record_halt);
+		sethalt(DIVBYZERO, true);
+		comp c = comp(1) / comp(0);
+		CHECK(isnan(c));
+		CHECK(halted == DIVBYZERO);
+		CHECK(testexception(DIVBYZERO | INVALID));
+		sethalt(DIVBYZERO, false);
+		halted = 0;
+		setexception(INVALID, true);
+		CHECK(halted == 0);
+		sethaltvector(nullptr);
+	}
+
+	SECTION("comp") {
+		auto raised = [](std::function<void()> fn) {
+			setenvironment(0);
+			fn();
+			return (unsigned)getenvironment() >> 8;
+		};
+		CHECK(raised([]{ comp(6) / comp(2); }) == 0);
+		CHECK(raised([]{ comp(7) / comp(2); }) == INEXACT);
+		CHECK(raised([]{ comp(0) / comp(0); }) == INVALID);
+		CHECK(raised([]{ comp(INT64_MAX) + comp(1); }) == INVALID);
+		CHECK(raised([]{ comp(comp::NaN) * comp(1); }) == INVALID);
+		CHECK(raised([]{ rem(comp(1), comp(0)); }) == INVALID);
+		CHECK(raised([]{ comp(2.5); }) == INEXACT);
+		CHECK(raised([]{ comp(2.0); }) == 0);
+		CHECK(raised([]{ comp(1e30); }) == INVALID);
+		CHECK(raised([]{ comp c(0); from_chars("0.019", "0.019" + 5, c, 2); }) == INEXACT);
+		CHECK(raised([]{ comp c(0); from_chars("0.010", "0.010" + 5, c, 2); }) == 0);
+		CHECK(raised([]{ comp c(0); from_chars("92233720368547758.08", "92233720368547758.08" + 20, c, 2); }) == INVALID);
+		CHECK(raised([]{ char b[40]; to_chars(b, b + 40, comp(12345), 2, 1); }) == INEXACT);
+		CHECK(raised([]{ char b[40]; to_chars(b, b + 40, comp(12340), 2, 1); }) == 0);
+		CHECK(raised([]{ dec2comp(decimal(0, -1, "25")); }) == INEXACT);
+		CHECK(raised([]{ dec2comp(decimal(0, 0, "N4011")); }) == INVALID);
+		CHECK(raised([]{ x2dec(0.1L, decform(decform::FLOATDECIMAL, 5)); }) == INEXACT);
+		CHECK(raised([]{ x2dec(0.5L, decform(decform::FIXEDDECIMAL, 2)); }) == 0);
+		CHECK(raised([]{ comp2dec(comp(12345), decform(decform::FLOATDECIMAL, 3)); }) == INEXACT);
+		CHECK(raised([]{ decimal d(0, 0, "125"); truncate(d, 2); }) == INEXACT);
+		CHECK(raised([]{ dec2x(decimal(0, 0, "5")); }) == 0);
+		CHECK(raised([]{ dec2x(decimal(0, 27, "1")); }) == 0);
+		CHECK(raised([]{ dec2x(decimal(0, -1, "1")); }) == INEXACT);
+		CHECK(raised([]{ dec2x(decimal(0, -3, "125")); }) == 0);
+		CHECK(raised([]{ dec2x(decimal(0, 40, "1")); }) == INEXACT);
+		CHECK(raised([]{ dec2x(decimal(0, 0, "1180591620717411303424")); }) == 0); // 2^70
+		CHECK(raised([]{ dec2x(decimal(0, 4932, "2")); }) == (OVERFLOW | INEXACT));
+		CHECK(raised([]{ dec2x(decimal(0, 5000, "1")); }) == (OVERFLOW | INEXACT));
+		CHECK(raised([]{ dec2x(decimal(1, -4940, "1")); }) == (UNDERFLOW | INEXACT));
+		CHECK(raised([]{ dec2x(decimal(0, -5000, "1")); }) == (UNDERFLOW | INEXACT));
+		CHECK(raised([]{ float f; dec2x(decimal(0, 0, "16777217"), fp::format<4, endian::native>{}, &f); }) == INEXACT);
+		CHECK(raised([]{ x2i(2.5L); }) == INEXACT);
+		CHECK(raised([]{ x2i(40000.0L); }) == INVALID);
+		CHECK(raised([]{ x2l(40000.0L); }) == 0);
+
+		setenvironment(0);
+		setround(UPWARD);
+		CHECK(x2i(2.25L) == 3);
+		CHECK((int64_t)(comp(9) / comp(4)) == 3);
+
+		uint8_t v[24], w[12];
+		std::memcpy(v, "\x3f\xf8\0\0\0\0\0\0", 8);  // 1.5, big endian
+		std::memcpy(v + 8, "\x40\0\0\0\0\0\0\0", 8);  // 2.0
+		std::memcpy(v + 16, "\x7f\xf0\0\0\0\0\0\0", 8); // inf
+		CHECK(raised([&]{ fp::transcode(fp::format<8, endian::big>{}, v, fp::format_integer<4, endian::big>{}, w, 2); }) == INEXACT);
+		CHECK(raised([&]{ fp::transcode(fp::format<8, endian::big>{}, v + 8, fp::format_integer<2, endian::big>{}, w, 2); }) == INVALID);
+		CHECK(raised([&]{ fp::transcode(fp::format<8, endian::big>{}, v, fp::format_comp<endian::big>{}, w, 1); }) == INEXACT);
+		std::memcpy(w, "\x01\0\0\x01\x01\0\0\0", 8); // 16777217, 16777216 as big endian LONGINTs
+		CHECK(raised([&]{ fp::transcode(fp::format_integer<4, endian::big>{}, w, fp::format<4, endian::big>{}, v, 2); }) == INEXACT);
+		CHECK(raised([&]{ fp::transcode(fp::format_integer<4, endian::big>{}, w + 4, fp::format<8, endian::big>{}, v, 1); }) == 0);
+		CHECK(raised([&]{ fp::transcode(fp::format_integer<4, endian::big>{}, w + 4, fp::format<4, endian::big>{}, v, 1); }) == 0);
+
+		// whole batches, where the vector kernels (if any) collect them.
+		uint8_t u[80], z[64];
+		auto flags = [&](double x, int at) {
+			for (int i = 0; i < 8; ++i) big_endian<double>::at(u + i * 8) = i == at ? x : i * 4.0;
+			unsigned a = raised([&]{ fp::transcode(fp::format<8, endian::big>{}, u, fp::format_comp<endian::big>{}, z, 8); });
+			for (int i = 0; i < 8; ++i) fp::info(i == at ? x : i * 4.0).write(fp::format<10, endian::little>{}, u + i * 10);
+			return a | raised([&]{ fp::transcode(fp::format<10, endian::little>{}, u, fp::format_comp<endian::big>{}, z, 8); }) << 8;
+		};
+		CHECK(flags(0.0, 0) == 0);
+		CHECK(flags(2.5, 2) == (INEXACT | INEXACT << 8));
+		CHECK(flags(-0.25, 7) == (INEXACT | INEXACT << 8));
+		CHECK(flags(1e30, 5) == (INVALID | INVALID << 8));
+
+		auto integer_flags = [&](double x, int at) {
+			for (int i = 0; i < 8; ++i) fp::info(i == at ? x : i * 4.0).write(fp::format<10, endian::little>{}, u + i * 10);
+			unsigned a = raised([&]{ fp::transcode(fp::format<10, endian::little>{}, u, fp::format_integer<2, endian::big>{}, z, 8); });
+			for (int i = 0; i < 8; ++i) big_endian<double>::at(u + i * 8) = i == at ? x : i * 4.0;
+			return a | raised([&]{ fp::transcode(fp::format<8, endian::big>{}, u, fp::format_integer<2, endian::big>{}, z, 8); }) << 8;
+		};
+		CHECK(integer_flags(0.0, 0) == 0);
+		CHECK(integer_flags(2.5, 2) == (INEXACT | INEXACT << 8));
+		CHECK(integer_flags(40000.0, 5) == (INVALID | INVALID << 8));
+
+		auto longint_flags = [&](int32_t x, int at) {
+			for (int i = 0; i < 8; ++i) fp::detail::store_word<endian::big>(z + i * 4, (uint32_t)(i == at ? x : i * 4));
+			return raised([&]{ fp::transcode(fp::format_integer<4, endian::big>{}, z, fp::format<4, endian::big>{}, u, 8); });
+		};
+		CHECK(longint_flags(16777216, 3) == 0);
+		CHECK(longint_flags(-16777219, 6) == INEXACT);
+	}
+
+	SECTION("convert") {
+		// the flags against the host's.
+		const rounding_direction directions[4] = { TONEAREST, UPWARD, DOWNWARD, TOWARDZERO };
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+		std::mt19937_64 rng(49);
+		for (int i = 0; i < 20000; ++i) {
+			fp::info fpi;
+			fpi.sign = rng() & 1;
+			fpi.exp = (int)(rng() % 2300) - 1150;
+			fpi.sig = (rng() | (UINT64_C(1) << 63)) & ~(rng() % 2 ? UINT64_C(0) : ~UINT64_C(0) >> 30);
+			long double x = (long double)fpi;
+			int m = rng() % 4;
+
+			float f;
+			double d;
+			std::feclearexcept(FE_ALL_EXCEPT);
+			std::fesetround(modes[m]);
+			volatile float hf = (float)x;
+			int fex = std::fetestexcept(FE_INEXACT | FE_OVERFLOW | FE_UNDERFLOW);
+			std::feclearexcept(FE_ALL_EXCEPT);
+			volatile double hd = (double)x;
+			int dex = std::fetestexcept(FE_INEXACT | FE_OVERFLOW | FE_UNDERFLOW);
+			std::fesetround(FE_TONEAREST);
+
+			auto flags = [](int ex) {
+				return (ex & FE_INEXACT ? INEXACT : 0) | (ex & FE_OVERFLOW ? OVERFLOW : 0) | (ex & FE_UNDERFLOW ? UNDERFLOW : 0);
+			};
+
+			setenvironment(0);
+			setround(directions[m]);
+			convert(fpi, fp::format<4, endian::native>{}, &f);
+			CHECK(std::memcmp(&f, (const void *)&hf, 4) == 0);
+			// tininess is detected before rounding; skip results that rounded up to the smallest normal.
+			if (std::fabs(f) != std::numeric_limits<float>::min())
+				CHECK((getenvironment() >> 8 & 0x1f) == (unsigned)flags(fex));
+
+			setenvironment(0);
+			setround(directions[m]);
+			convert(fpi, fp::format<8, endian::native>{}, &d);
+			CHECK(std::memcmp(&d, (const void *)&hd, 8) == 0);
+			if (std::fabs(d) != std::numeric_limits<double>::min())
+				CHECK((getenvironment() >> 8 & 0x1f) == (unsigned)flags(dex));
+		}
+
+		// a signaling NaN comes out quiet, with its payload.
+		fp::info snan;
+		snan.nan = true;
+		snan.signaling = true;
+		snan.sig = NANASCBIN;
+		uint64_t w;
+		setenvironment(0);
+		convert(snan, fp::format<8, endian::native>{}, &w);
+		CHECK(w == UINT64_C(0x7ff8000000000011));
+		CHECK((getenvironment() >> 8 & 0x1f) == INVALID);
+		setenvironment(0);
+		dec2x(decimal(0, 0, "N0011"), fp::format<8, endian::native>{}, &w);
+		CHECK(w == UINT64_C(0x7ff8000000000011));
+		CHECK((getenvironment() >> 8 & 0x1f) == INVALID);
+	}
+
+	setenvironment(0);
 }
 
 
@@ -1000,12 +2016,184 @@ TEST_CASE("make_nan", "[nan]") {
 
 	SECTION("make_nan<decimal>") {
 		SANE::decimal d = make_nan<SANE::decimal>(0xff);
-		CHECK(d.sig == "N00ff");
+		CHECK(d.sig == "N40ff");
 	}
 
 }
 
 
+TEST_CASE("nan payloads", "[nan]") {
+
+	using SANE::endian;
+
+	const uint64_t payloads[] = { 1, NANFINAN, 0xff, 0x3fff, 0x4000, UINT64_C(0x123456789abc) };
+
+	auto round_trip = [&](auto f, uint64_t mask) {
+		for (uint64_t p : payloads) {
+			for (bool s : { false, true }) {
+				fp::info a, b;
+				uint8_t buffer[16];
+				a.nan = true;
+				a.sig = p;
+				a.signaling = s;
+				a.write(f, buffer);
+				b.read(f, buffer);
+				CHECK(b.nan);
+				CHECK(b.signaling == s);
+				CHECK(b.sig == (p & mask));
+			}
+		}
+	};
+
+	SECTION("formats") {
+		round_trip(fp::format<4, endian::little>{}, (1 << 22) - 1);
+		round_trip(fp::format<4, endian::big>{}, (1 << 22) - 1);
+		round_trip(fp::format<8, endian::big>{}, (UINT64_C(1) << 51) - 1);
+		round_trip(fp::format<10, endian::big>{}, (UINT64_C(1) << 62) - 1);
+		round_trip(fp::format<12, endian::native>{}, (UINT64_C(1) << 62) - 1);
+		round_trip(fp::format_68881<endian::big>{}, (UINT64_C(1) << 62) - 1);
+		round_trip(fp::format_quad<endian::big>{}, (UINT64_C(1) << 62) - 1);
+		round_trip(fp::format_double_double<endian::big>{}, (UINT64_C(1) << 51) - 1);
+	}
+
+	SECTION("narrowing") {
+		fp::info a;
+		a.nan = true;
+		a.signaling = true;
+		a.sig = UINT64_C(1) << 40;
+
+		// the payload doesn't fit -- still signaling.
+		fp::info b(fp::bit_cast<float>(a.pack_single()));
+		CHECK(b.signaling);
+		CHECK(b.sig == NANZERO);
+
+		// the default quiet NaN is unchanged.
+		b = fp::info(fp::bit_cast<float>(UINT32_C(0x7fc00000)));
+		CHECK(b.pack_single() == UINT32_C(0x7fc00000));
+
+		a.signaling = false;
+		a.sig = (UINT64_C(1) << 40) | NANFINAN;
+		CHECK((fp::info(fp::bit_cast<float>(a.pack_single())).sig & 0xff) == NANFINAN);
+		CHECK((fp::info(fp::bit_cast<double>(a.pack_double())).sig & 0xff) == NANFINAN);
+	}
+
+	SECTION("decimal") {
+		SANE::decform df{ SANE::decform::FLOATDECIMAL, 19 };
+		for (uint64_t p : payloads) {
+			for (bool s : { false, true }) {
+				fp::info a, b;
+				a.nan = true;
+				a.sig = p;
+				a.signaling = s;
+				SANE::dec2x(SANE::x2dec(a, df), b);
+				CHECK(b.nan);
+				CHECK(b.signaling == s);
+				CHECK(b.sig == p);
+			}
+		}
+
+		fp::info fpi;
+		SANE::dec2x(SANE::decimal{ 0, 0, "N4024" }, fpi);
+		CHECK(fpi.sig == 36);
+		CHECK(!fpi.signaling);
+		SANE::dec2x(SANE::decimal{ 0, 0, "N00ff" }, fpi);
+		CHECK(fpi.sig == 0xff);
+		CHECK(fpi.signaling);
+		// what str2dec gives for bad input: quiet NANASCBIN.
+		SANE::dec2x(SANE::decimal{ 0, 0, "N4011" }, fpi);
+		CHECK(fpi.sig == NANASCBIN);
+		CHECK(!fpi.signaling);
+		SANE::dec2x(SANE::decimal{ 0, 0, "N004011" }, fpi);
+		CHECK(fpi.sig == NANASCBIN);
+		CHECK(!fpi.signaling);
+		SANE::dec2x(SANE::decimal{ 0, 0, "N0000000000004011" }, fpi);
+		CHECK(fpi.sig == 0x4011);
+		CHECK(fpi.signaling);
+		SANE::dec2x(SANE::decimal{ 0, 0, "N12345" }, fpi);
+		CHECK(fpi.sig == 0x12345);
+		CHECK(fpi.signaling);
+		SANE::dec2x(SANE::decimal{ 0, 0, "N400000012345" }, fpi);
+		CHECK(fpi.sig == UINT64_C(0x400000012345));
+		CHECK(fpi.signaling);
+		SANE::dec2x(SANE::decimal{ 0, 0, "N40000000000000011" }, fpi);
+		CHECK(fpi.sig == NANZERO);
+		CHECK(!fpi.signaling);
+		SANE::dec2x(SANE::decimal{ 0, 0, "N" }, fpi);
+		CHECK(fpi.sig == NANZERO);
+		CHECK(!fpi.signaling);
+
+		CHECK(SANE::x2dec(fpi, df).sig == "N4015");
+		fpi.sig = UINT64_C(0x12345);
+		CHECK(SANE::x2dec(fpi, df).sig == "N4000000000012345");
+
+		std::string s;
+		SANE::dec2str(df, SANE::decimal{ 0, 0, "N4024" }, s);
+		CHECK(s == " NAN(036)");
+	}
+
+	SECTION("comp") {
+		SANE::comp c = make_nan<SANE::comp>(NANFINAN);
+		CHECK(fp::info((double)c).sig == NANCOMP);
+		CHECK(SANE::isnan(SANE::comp(make_nan<double>(NANFINAN))));
+	}
+
+	SECTION("nan_codes") {
+		std::vector<fp::info> v;
+		for (int i = 0; i < 300; ++i) {
+			fp::info fpi((long double)i - 150);
+			if (i % 3 == 0) {
+				fpi.nan = true;
+				fpi.sig = i;
+				fpi.signaling = i & 0x01;
+			}
+			if (i % 7 == 0) fpi.inf = !fpi.nan;
+			v.push_back(fpi);
+		}
+
+		auto check = [&](auto f) {
+			std::vector<uint8_t> buffer(v.size() * decltype(f)::size);
+			std::vector<uint8_t> codes(v.size());
+			size_t count = 0;
+			for (size_t i = 0; i < v.size(); ++i) v[i].write(f, buffer.data() + i * decltype(f)::size);
+
+			CHECK(fp::nan_codes(f, buffer.data(), codes.data(), v.size()) == 100);
+			for (size_t i = 0; i < v.size(); ++i) {
+				fp::info fpi;
+				fpi.read(f, buffer.data() + i * decltype(f)::size);
+				CHECK(codes[i] == (fpi.nan ? fpi.sig & 0xff : 0));
+				count += fpi.nan;
+			}
+			CHECK(count == 100);
+
+			// odd offset and count, for the tails of the vector loops.
+			CHECK(fp::nan_codes(f, buffer.data() + decltype(f)::size, codes.data(), v.size() - 2) == 99);
+			for (size_t i = 1; i + 1 < v.size(); ++i) {
+				fp::info fpi;
+				fpi.read(f, buffer.data() + i * decltype(f)::size);
+				CHECK(codes[i - 1] == (fpi.nan ? fpi.sig & 0xff : 0));
+			}
+		};
+
+		check(fp::format<4, endian::native>{});
+		check(fp::format<4, endian::big>{});
+		check(fp::format<8, endian::little>{});
+		check(fp::format<8, endian::big>{});
+		check(fp::format<10, endian::big>{});
+		check(fp::format<12, endian::little>{});
+		check(fp::format<16, endian::native>{});
+		check(fp::format_68881<endian::big>{});
+		check(fp::format_quad<endian::big>{});
+		check(fp::format_double_double<endian::little>{});
+
+		// double-double with a NaN low half.
+		double dd[2] = { 1.0, make_nan<double>(NANFINAN) };
+		uint8_t code = 0;
+		CHECK(fp::nan_codes(fp::format_double_double<endian::native>{}, dd, &code, 1) == 1);
+		CHECK(code == NANFINAN);
+	}
+}
+
+
 TEST_CASE("x2dec", "[x2dec]") {
 	// page 33.
 
@@ -1291,3 +2479,1491 @@ TEST_CASE("x2dec_float_6", "[x2dec]") {
 	}
 }
 
+
+TEST_CASE("x2dec/dec2x info", "[x2dec][dec2x]") {
+
+	SANE::decform df{SANE::decform::FLOATDECIMAL, 20};
+
+	SECTION("2^64 - 1") {
+		fp::info fpi;
+		fpi.one = true;
+		fpi.exp = 63;
+		fpi.sig = ~UINT64_C(0);
+
+		SANE::decimal d = SANE::x2dec(fpi, df);
+		CHECK(d.sgn == 0);
+		CHECK(d.exp == 0);
+		CHECK(d.sig == "18446744073709551615");
+
+		fp::info tmp;
+		SANE::dec2x(d, tmp);
+		CHECK(tmp.exp == 63);
+		CHECK(tmp.sig == ~UINT64_C(0));
+	}
+
+	SECTION("extended denormal") {
+		SANE::decimal d{0, -4970, "36451995318824746025"};
+		uint8_t buffer[10];
+		SANE::dec2x(d, fp::format<10, endian::big>{}, buffer);
+		for (int i = 0; i < 9; ++i) CHECK(buffer[i] == 0);
+		CHECK(buffer[9] == 1);
+
+		d = SANE::x2dec(fp::format<10, endian::big>{}, buffer, df);
+		CHECK(d.exp == -4970);
+		CHECK(d.sig == "36451995318824746025");
+	}
+
+	SECTION("fixed, negative digits") {
+		SANE::decform f2{SANE::decform::FIXEDDECIMAL, -2};
+		SANE::decimal d = SANE::x2dec(fp::info(1250.0), f2);
+		CHECK(d.exp == 2);
+		CHECK(d.sig == "12");
+	}
+
+	SECTION("round trip") {
+		// 21 significant digits are enough to recover any extended.
+		SANE::decform f21{SANE::decform::FLOATDECIMAL, 21};
+		std::mt19937_64 rng(21);
+		for (int i = 0; i < 2000; ++i) {
+			uint16_t sexp = rng() % 0x7fff;
+			uint64_t sig = rng() | (sexp ? UINT64_C(1) << 63 : 0);
+			fp::info fpi, tmp;
+			fpi.unpack_extended(sexp, sig);
+
+			SANE::dec2x(SANE::x2dec(fpi, f21), tmp);
+			uint16_t e;
+			uint64_t s;
+			tmp.pack_extended(e, s);
+			CHECK(e == sexp);
+			CHECK(s == sig);
+		}
+	}
+
+#ifdef SANE_X87_BIT_CAST
+	SECTION("strtold") {
+		std::mt19937_64 rng(19);
+		for (int i = 0; i < 2000; ++i) {
+			SANE::decimal d;
+			d.exp = (int)(rng() % 9000) - 4500;
+			d.sig = std::to_string(rng() | 1);
+			d.sig += std::to_string(rng() % 1000);
+
+			std::string str = d.sig + "e" + std::to_string(d.exp);
+			long double x = std::strtold(str.c_str(), nullptr);
+			CHECK((long double)dec2x(d) == x);
+		}
+	}
+#endif
+
+}
+
+
+TEST_CASE("directed decimal conversions", "[x2dec][dec2x]") {
+
+	using SANE::rounding_direction;
+	const rounding_direction directions[4] = { SANE::TONEAREST, SANE::UPWARD, SANE::DOWNWARD, SANE::TOWARDZERO };
+
+	SECTION("x2dec brackets") {
+		SANE::decform df{SANE::decform::FLOATDECIMAL, 17};
+		std::mt19937_64 rng(50);
+		for (int i = 0; i < 2000; ++i) {
+			uint16_t sexp = (1 + rng() % 0x7ffe) | (rng() & 0x8000);
+			uint64_t sig = rng() | UINT64_C(1) << 63;
+			uint8_t x[10];
+			std::memcpy(x, &sig, 8);
+			std::memcpy(x + 8, &sexp, 2);
+			fp::info fpi;
+			fpi.read(fp::format<10, endian::little>{}, x);
+
+			SANE::decimal d[4];
+			for (int m = 0; m < 4; ++m) d[m] = SANE::x2dec(fpi, df, directions[m]);
+			const SANE::decimal &up = d[1], &down = d[2];
+
+			CHECK(fp::compare(fp::format<10, endian::little>{}, x, up) != SANE::GREATERTHAN);
+			CHECK(fp::compare(fp::format<10, endian::little>{}, x, down) != SANE::LESSTHAN);
+			CHECK(SANE::compare(d[0], up) != SANE::GREATERTHAN);
+			CHECK(SANE::compare(d[0], down) != SANE::LESSTHAN);
+			CHECK(SANE::compare(d[3], fpi.sign ? up : down) == SANE::EQUALTO);
+			// one unit in the last digit apart.
+			if (up.exp == down.exp) {
+				uint64_t a = std::stoull(up.sig), b = std::stoull(down.sig);
+				CHECK((fpi.sign ? b - a : a - b) == 1);
+			}
+		}
+	}
+
+	SECTION("comp") {
+		SANE::decform df{SANE::decform::FLOATDECIMAL, 2};
+		CHECK(SANE::comp2dec(comp(125), df).sig == "12");
+		CHECK(SANE::comp2dec(comp(125), df, SANE::UPWARD).sig == "13");
+		CHECK(SANE::comp2dec(comp(-125), df, SANE::UPWARD).sig == "12");
+		CHECK(SANE::comp2dec(comp(-121), df, SANE::DOWNWARD).sig == "13");
+
+		SANE::decimal d{0, -1, "25"};
+		CHECK((int64_t)SANE::dec2comp(d) == 2);
+		CHECK((int64_t)SANE::dec2comp(d, SANE::TONEAREST) == 2);
+		CHECK((int64_t)SANE::dec2comp(d, SANE::UPWARD) == 3);
+		CHECK((int64_t)SANE::dec2comp(SANE::decimal{0, -1, "35"}, SANE::TONEAREST) == 4);
+		CHECK((int64_t)SANE::dec2comp(SANE::decimal{1, -1, "25"}, SANE::DOWNWARD) == -3);
+		CHECK((int64_t)SANE::dec2comp(SANE::decimal{0, -3, "3"}, SANE::UPWARD) == 1);
+		CHECK((int64_t)SANE::dec2comp(SANE::decimal{0, -3, "3"}, SANE::TONEAREST) == 0);
+		CHECK((int64_t)SANE::dec2comp(SANE::decimal{0, -1, "5"}, SANE::TONEAREST) == 0);
+		CHECK((int64_t)SANE::dec2comp(SANE::decimal{0, -1, "51"}, SANE::TONEAREST) == 5);
+		CHECK(isnan(SANE::dec2comp(SANE::decimal{0, -1, "92233720368547758075"}, SANE::UPWARD)));
+	}
+
+#ifdef SANE_X87_BIT_CAST
+	SECTION("dec2x against strtold/strtod") {
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+		std::mt19937_64 rng(50);
+		for (int i = 0; i < 2000; ++i) {
+			SANE::decimal d;
+			d.sgn = rng() & 1;
+			d.exp = (int)(rng() % 9000) - 4500;
+			if (i & 1) d.exp = (int)(rng() % 40) - 20;
+			d.sig = std::to_string(rng() % 1000000000000000 + 1);
+			if (i & 2) d.sig += std::to_string(rng() | 1);
+			std::string str = (d.sgn ? "-" : "") + d.sig + "e" + std::to_string(d.exp);
+
+			int m = rng() % 4;
+			std::fesetround(modes[m]);
+			long double x = std::strtold(str.c_str(), nullptr);
+			double y = std::strtod(str.c_str(), nullptr);
+			std::fesetround(FE_TONEAREST);
+
+			CHECK(SANE::dec2x(d, directions[m]) == x);
+			// directed rounding through extended is still one rounding.
+			if (m) {
+				double dd;
+				SANE::dec2x(d, fp::format<8, endian::native>{}, &dd, directions[m]);
+				CHECK(dd == y);
+			}
+		}
+	}
+#endif
+
+}
+
+
+TEST_CASE("68881 extended", "[floating_point]") {
+
+	// 68881 1.0 (big endian)
+	const uint8_t one_68k[12] = {
+		0x3f,0xff,0x00,0x00,0x80,0x00,0x00,0x00,0x00,0x00,0x00,0x00
+	};
+	// -2.5
+	const uint8_t m25_68k[12] = {
+		0xc0,0x00,0x00,0x00,0xa0,0x00,0x00,0x00,0x00,0x00,0x00,0x00
+	};
+
+	SECTION("read") {
+		fp::info fpi;
+		fpi.read(fp::format_68881<endian::big>{}, one_68k);
+		CHECK((long double)fpi == LONG_DOUBLE_C(1.0));
+
+		CHECK(fp::read_extended(fp::format_68881<endian::big>{}, m25_68k) == LONG_DOUBLE_C(-2.5));
+	}
+
+	SECTION("write") {
+		uint8_t buffer[12];
+
+		fp::info fpi(-2.5);
+		std::memset(buffer, 0xff, sizeof(buffer));
+		fpi.write(fp::format_68881<endian::big>{}, buffer);
+		CHECK(std::memcmp(buffer, m25_68k, 12) == 0);
+
+		std::memset(buffer, 0xff, sizeof(buffer));
+		fp::write_extended(LONG_DOUBLE_C(1.0), fp::format_68881<endian::big>{}, buffer);
+		CHECK(std::memcmp(buffer, one_68k, 12) == 0);
+	}
+
+	SECTION("infinity") {
+		// explicit 1 bit not required.
+		const uint8_t inf_68k[12] = {
+			0x7f,0xff,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
+		};
+		long double ld = fp::read_extended(fp::format_68881<endian::big>{}, inf_68k);
+		CHECK(isinf(ld));
+		CHECK(!signbit(ld));
+	}
+
+	SECTION("transcode") {
+		uint8_t src[3 * 12];
+		uint8_t sane[3 * 10];
+		uint8_t dst[3 * 12];
+		const uint8_t one_sane[10] = {
+			0x3f,0xff,0x80,0x00,0x00,0x00,0x00,0x00,0x00,0x00
+		};
+
+		std::memcpy(src + 0, one_68k, 12);
+		std::memcpy(src + 12, m25_68k, 12);
+		std::memcpy(src + 24, one_68k, 12);
+
+		fp::transcode(fp::format_68881<endian::big>{}, src, fp::format<10, endian::big>{}, sane, 3);
+		CHECK(std::memcmp(sane, one_sane, 10) == 0);
+		CHECK(std::memcmp(sane + 20, one_sane, 10) == 0);
+		CHECK(fp::read_extended(fp::format<10, endian::big>{}, sane + 10) == LONG_DOUBLE_C(-2.5));
+
+		fp::transcode(fp::format<10, endian::big>{}, sane, fp::format_68881<endian::big>{}, dst, 3);
+		CHECK(std::memcmp(src, dst, sizeof(src)) == 0);
+	}
+}
+
+
+TEST_CASE("binary128", "[floating_point]") {
+
+	SECTION("info") {
+		// 1.5, big endian.
+		const uint8_t one_half[16] = { 0x3f, 0xff, 0x80 };
+		uint8_t buffer[16];
+
+		fp::info fpi;
+		fpi.read(fp::format_quad<endian::big>{}, one_half);
+		CHECK(fpi.exp == 0);
+		CHECK(fpi.sig == UINT64_C(0xc000000000000000));
+
+		fpi.write(fp::format_quad<endian::big>{}, buffer);
+		CHECK(std::memcmp(buffer, one_half, 16) == 0);
+
+		fpi = fp::info();
+		fpi.nan = true;
+		fpi.sig = NANSQRT;
+		fpi.write(fp::format_quad<endian::little>{}, buffer);
+		fpi = fp::info();
+		fpi.read(fp::format_quad<endian::little>{}, buffer);
+		CHECK(fpi.nan);
+		CHECK(fpi.sig == NANSQRT);
+	}
+
+#if defined(SANE_HAVE_FLOAT128) && LDBL_MANT_DIG == 64
+	SECTION("host") {
+		std::mt19937_64 rng(128);
+		const size_t count = 4096;
+		std::vector<long double> x(count);
+		std::vector<__float128> q(count);
+		std::vector<uint64_t> bits(count * 2);
+
+		for (size_t i = 0; i < count; ++i) {
+			uint16_t sexp = rng();
+			uint64_t sig = rng();
+			if (i & 1) sexp = (sexp & 0x8000) | (rng() % 130); // denormals, tiny
+			// no unnormals or pseudo-denormals.
+			if (sexp & 0x7fff) sig |= UINT64_C(1) << 63;
+			else sig &= ~(UINT64_C(1) << 63);
+			if ((sexp & 0x7fff) == 0x7fff && i & 2) sig = UINT64_C(1) << 63;
+			fp::x87_image tmp{};
+			tmp.sexp = sexp;
+			tmp.sig = sig;
+			std::memcpy(&x[i], &tmp, 10);
+		}
+
+		fp::transcode(fp::format<sizeof(long double), endian::native>{}, x.data(), fp::format_quad<endian::native>{}, q.data(), count);
+		int errors = 0;
+		for (size_t i = 0; i < count; ++i) {
+			__float128 tmp = x[i];
+			if (std::isnan(x[i])) errors += !(q[i] != q[i]);
+			else errors += std::memcmp(&tmp, &q[i], 16) != 0;
+		}
+		CHECK(errors == 0);
+
+		for (auto &b : bits) b = rng();
+		for (size_t i = 0; i < count; i += 2) bits[i * 2 + 1] &= UINT64_C(0x8001ffffffffffff); // denormals, tiny
+		std::memcpy(q.data(), bits.data(), count * 16);
+
+		fp::transcode(fp::format_quad<endian::native>{}, q.data(), fp::format<sizeof(long double), endian::native>{}, x.data(), count);
+		errors = 0;
+		for (size_t i = 0; i < count; ++i) {
+			long double tmp = (long double)q[i];
+			if (q[i] != q[i]) errors += !std::isnan(x[i]);
+			else errors += std::memcmp(&tmp, &x[i], 10) != 0;
+
+			fp::info fpi(q[i]);
+			errors += q[i] == q[i] && fp::info(tmp).sig != fpi.sig;
+		}
+		CHECK(errors == 0);
+	}
+#endif
+}
+
+
+TEST_CASE("double-double", "[floating_point]") {
+
+	SECTION("info") {
+		// 1 + 2^-60, big endian.
+		const uint8_t one_tiny[16] = { 0x3f, 0xf0, 0, 0, 0, 0, 0, 0, 0x3c, 0x30 };
+		uint8_t buffer[16];
+
+		fp::info fpi;
+		fpi.read(fp::format_double_double<endian::big>{}, one_tiny);
+		CHECK(fpi.exp == 0);
+		CHECK(fpi.sig == UINT64_C(0x8000000000000008));
+
+		fpi.write(fp::format_double_double<endian::big>{}, buffer);
+		CHECK(std::memcmp(buffer, one_tiny, 16) == 0);
+	}
+
+#if LDBL_MANT_DIG == 64
+	SECTION("split/join") {
+		std::mt19937_64 rng(106);
+		const size_t count = 1000;
+		std::vector<long double> x(count), y(count);
+		std::vector<double> hi(count), lo(count);
+
+		for (size_t i = 0; i < count; ++i) {
+			fp::info fpi;
+			fpi.sign = rng() & 0x01;
+			fpi.one = true;
+			fpi.exp = (int)(rng() % 2200) - 1100;
+			fpi.sig = rng() | (UINT64_C(1) << 63);
+			if (i % 10 == 0) fpi.sig = 0;
+			// the edges of the common range.
+			if (i % 10 == 5) fpi.exp = (int)(i / 10 % 8) + (i % 20 == 5 ? -963 : 1019);
+			x[i] = (long double)fpi;
+		}
+
+		fp::split_double_double(fp::format<sizeof(long double), endian::native>{}, x.data(), hi.data(), lo.data(), count);
+		int errors = 0;
+		for (size_t i = 0; i < count; ++i) {
+			uint64_t h, l;
+			fp::info(x[i]).pack_double_double(h, l);
+			errors += std::memcmp(&h, &hi[i], 8) != 0 || std::memcmp(&l, &lo[i], 8) != 0;
+		}
+		CHECK(errors == 0);
+
+		errors = 0;
+		for (size_t i = 0; i < count; ++i) {
+			// both halves normal.
+			if (std::fabs(x[i]) < 1e-290L || std::fabs(x[i]) > 1e308L) continue;
+			double h = (double)x[i];
+			double l = (double)(x[i] - h);
+			errors += std::memcmp(&h, &hi[i], 8) != 0 || std::memcmp(&l, &lo[i], 8) != 0;
+		}
+		CHECK(errors == 0);
+
+		fp::join_double_double(hi.data(), lo.data(), fp::format<sizeof(long double), endian::native>{}, y.data(), count);
+		errors = 0;
+		for (size_t i = 0; i < count; ++i) {
+			fp::info fpi;
+			fpi.unpack_double_double(fp::bit_cast<uint64_t>(hi[i]), fp::bit_cast<uint64_t>(lo[i]));
+			long double tmp = (long double)fpi;
+			errors += std::memcmp(&tmp, &y[i], 10) != 0;
+			if (std::fabs(x[i]) < 1e-290L || std::fabs(x[i]) > 1e308L) continue;
+			errors += std::memcmp(&x[i], &y[i], 10) != 0;
+		}
+		CHECK(errors == 0);
+
+		// big endian images (and odd counts) go the same way.
+		std::vector<uint8_t> big(count * 10), big2(count * 10);
+		std::vector<double> hi2(count), lo2(count);
+		fp::transcode(fp::format<sizeof(long double), endian::native>{}, x.data(), fp::format<10, endian::big>{}, big.data(), count);
+		fp::split_double_double(fp::format<10, endian::big>{}, big.data(), hi2.data(), lo2.data(), count - 3);
+		CHECK(std::memcmp(hi.data(), hi2.data(), (count - 3) * 8) == 0);
+		CHECK(std::memcmp(lo.data(), lo2.data(), (count - 3) * 8) == 0);
+		fp::join_double_double(hi.data(), lo.data(), fp::format<10, endian::big>{}, big2.data(), count - 3);
+		fp::transcode(fp::format<sizeof(long double), endian::native>{}, y.data(), fp::format<10, endian::big>{}, big.data(), count);
+		CHECK(std::memcmp(big.data(), big2.data(), (count - 3) * 10) == 0);
+
+		// arbitrary pairs are rounded to nearest.
+		for (size_t i = 0; i < count; ++i) {
+			hi[i] = std::ldexp((double)(rng() >> 11), (int)(rng() % 200) - 100);
+			lo[i] = std::ldexp((double)(int64_t)rng(), (int)(rng() % 200) - 200);
+		}
+		fp::join_double_double(hi.data(), lo.data(), fp::format<sizeof(long double), endian::native>{}, y.data(), count);
+		errors = 0;
+		for (size_t i = 0; i < count; ++i) {
+			long double tmp = (long double)hi[i] + (long double)lo[i];
+			errors += std::memcmp(&tmp, &y[i], 10) != 0;
+		}
+		CHECK(errors == 0);
+	}
+#endif
+}
+
+
+TEST_CASE("info_batch", "[floating_point]") {
+
+	const double data[] = { 0.0, -1.0, 2.5, HUGE_VAL, -HUGE_VAL, NAN, 4.9e-324, 1e300 };
+	constexpr size_t count = sizeof(data) / sizeof(data[0]);
+
+	fp::info_batch b;
+	b.read(fp::format<8, endian::native>{}, data, count);
+	REQUIRE(b.size() == count);
+
+	SECTION("round trip") {
+		double out[count];
+		b.write(fp::format<8, endian::native>{}, out);
+		for (size_t i = 0; i < count; ++i) {
+			if (std::isnan(data[i])) CHECK(std::isnan(out[i]));
+			else CHECK(out[i] == data[i]);
+		}
+	}
+
+	SECTION("get") {
+		CHECK((double)b.get(2) == 2.5);
+		CHECK(b.get(1).sign);
+	}
+
+	SECTION("fpclassify") {
+		int out[count];
+		SANE::fpclassify(b, out);
+		CHECK(out[0] == FP_ZERO);
+		CHECK(out[1] == FP_NORMAL);
+		CHECK(out[3] == FP_INFINITE);
+		CHECK(out[5] == FP_NAN);
+		CHECK(out[6] == FP_SUBNORMAL);
+	}
+
+	SECTION("flags") {
+		CHECK(SANE::isnan(b)[0] == 0x20);
+		CHECK(SANE::isinf(b)[0] == 0x18);
+		CHECK(SANE::signbit(b)[0] == 0x12);
+		CHECK(SANE::isfinite(b)[0] == 0xc7);
+		CHECK(SANE::signbit(SANE::abs(b))[0] == 0);
+	}
+
+	SECTION("fields match info") {
+		// random bits (lots of specials and denormals) in three formats.
+		std::mt19937_64 rng(27);
+		auto check = [&](auto f) {
+			constexpr size_t size = decltype(f)::size;
+			constexpr size_t n = 300;
+			std::vector<uint8_t> in(n * size), out(n * size);
+			for (size_t i = 0; i < in.size(); ++i) in[i] = rng();
+			for (size_t i = 0; i < 128; ++i) {
+				// two blocks of normals.
+				in[i * size] = (in[i * size] & 0x80) | 0x40;
+				if (size >= 10) in[i * size + (size == 10 ? 2 : 4)] |= 0x80;
+			}
+			for (size_t i = 128; i < n; i += 3) {
+				// exponent byte(s) all 0 or all 1.
+				in[i * size] = -(rng() & 1);
+				in[i * size + 1] = (in[i * size + 1] & 0x0f) | (in[i * size] & 0xf0);
+			}
+			fp::info_batch bb;
+			bb.read(f, in.data(), n);
+			for (size_t i = 0; i < n; ++i) {
+				fp::info fpi;
+				fpi.read(f, in.data() + i * size);
+				fp::info x = bb.get(i);
+				CHECK(x.sign == fpi.sign);
+				CHECK(x.one == fpi.one);
+				CHECK(x.nan == fpi.nan);
+				CHECK(x.inf == fpi.inf);
+				CHECK(x.signaling == fpi.signaling);
+				CHECK(x.exp == fpi.exp);
+				CHECK(x.sig == fpi.sig);
+			}
+			bb.write(f, out.data());
+			for (size_t i = 0; i < n; ++i) {
+				uint8_t expect[size];
+				bb.get(i).write(f, expect);
+				CHECK(std::memcmp(out.data() + i * size, expect, size) == 0);
+			}
+		};
+		check(fp::format<4, endian::big>{});
+		check(fp::format<8, endian::little>{});
+		check(fp::format<10, endian::big>{});
+		check(fp::format_68881<endian::big>{});
+	}
+}
+
+
+#ifdef SANE_HAVE_BIT_CAST
+// compile time evaluation.
+static_assert(SANE::isnan(fp::info(make_nan<double>(NANSQRT))), "constexpr make_nan<double>");
+static_assert(fp::info(make_nan<float>(NANDIV)).sig == NANDIV, "constexpr make_nan<float>");
+static_assert((float)fp::info(2.5) == 2.5f, "constexpr double -> float");
+static_assert(SANE::fpclassify(fp::info(-0.0f)) == FP_ZERO, "constexpr fpclassify");
+#ifdef SANE_X87_BIT_CAST
+static_assert(fp::info(make_nan<long double>(NANLOG)).sig == NANLOG, "constexpr make_nan<long double>");
+static_assert((long double)fp::info(1.5) == 1.5L, "constexpr double -> long double");
+#endif
+#endif
+
+TEST_CASE("info pack/unpack", "[floating_point]") {
+
+	fp::info fpi;
+
+	fpi.unpack_single(UINT32_C(0x3fc00000));
+	CHECK((double)fpi == 1.5);
+	CHECK(fpi.pack_single() == UINT32_C(0x3fc00000));
+
+	fpi.unpack_double(UINT64_C(0xc004000000000000));
+	CHECK((float)fpi == -2.5f);
+	CHECK(fpi.pack_double() == UINT64_C(0xc004000000000000));
+
+	// reused info must not keep stale flags.
+	fpi.unpack_single(UINT32_C(0x7f800000));
+	CHECK(fpi.inf);
+	fpi.unpack_extended(0x3fff, UINT64_C(0x8000000000000000));
+	CHECK(!fpi.inf);
+	CHECK((long double)fpi == 1.0L);
+}
+
+
+TEST_CASE("info rounding", "[floating_point]") {
+
+	fp::info fpi;
+
+	SECTION("nearest even") {
+		// 1 + 2^-24 (half way) -> 1, 1 + 3 * 2^-24 -> 1 + 2^-22
+		fpi.unpack_extended(0x3fff, UINT64_C(0x8000008000000000));
+		CHECK(fpi.pack_single() == UINT32_C(0x3f800000));
+		fpi.unpack_extended(0x3fff, UINT64_C(0x8000018000000000));
+		CHECK(fpi.pack_single() == UINT32_C(0x3f800002));
+		CHECK(fpi.pack_single(TOWARDZERO) == UINT32_C(0x3f800001));
+
+		// carry into the exponent.
+		fpi.unpack_extended(0x3fff, ~UINT64_C(0));
+		CHECK(fpi.pack_double() == UINT64_C(0x4000000000000000));
+		CHECK(fpi.pack_double(DOWNWARD) == UINT64_C(0x3fffffffffffffff));
+	}
+
+	SECTION("overflow") {
+		fpi.unpack_extended(0x7ffe, ~UINT64_C(0));
+		CHECK(fpi.pack_single() == UINT32_C(0x7f800000));
+		CHECK(fpi.pack_single(TOWARDZERO) == UINT32_C(0x7f7fffff));
+		fpi.sign = true;
+		CHECK(fpi.pack_double(UPWARD) == UINT64_C(0xffefffffffffffff));
+		CHECK(fpi.pack_double(DOWNWARD) == UINT64_C(0xfff0000000000000));
+	}
+
+	SECTION("gradual underflow") {
+		// 2^-149 is the smallest single denormal.
+		fpi.unpack_extended(0x3fff - 149, UINT64_C(0x8000000000000000));
+		CHECK(fpi.pack_single() == 1);
+		// 2^-150 ties to even (0), 1.5 * 2^-150 rounds up.
+		fpi.unpack_extended(0x3fff - 150, UINT64_C(0x8000000000000000));
+		CHECK(fpi.pack_single() == 0);
+		CHECK(fpi.pack_single(UPWARD) == 1);
+		fpi.unpack_extended(0x3fff - 150, UINT64_C(0xc000000000000000));
+		CHECK(fpi.pack_single() == 1);
+
+		// extended denormals.
+		uint16_t sexp;
+		uint64_t sig;
+		fpi.unpack_extended(0x0001, UINT64_C(0x8000000000000001));
+		fpi.exp -= 2;
+		fpi.pack_extended(sexp, sig);
+		CHECK(sexp == 0);
+		CHECK(sig == UINT64_C(0x2000000000000000));
+		fpi.pack_extended(sexp, sig, UPWARD);
+		CHECK(sig == UINT64_C(0x2000000000000001));
+
+		// denormal -> double -> extended round trip.
+		fpi.unpack_double(UINT64_C(0x000000000000dead));
+		CHECK(fpi.pack_double() == UINT64_C(0x000000000000dead));
+		CHECK((double)fp::info((long double)fpi) == fp::bit_cast<double>(UINT64_C(0x000000000000dead)));
+	}
+
+#if LDBL_MANT_DIG == 64
+	SECTION("host") {
+		// compare narrowing against the host in all rounding directions.
+		std::mt19937_64 rng(33);
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+		int errors = 0;
+
+		for (int i = 0; i < 20000; ++i) {
+			fp::info fpi;
+			fpi.sign = rng() & 0x01;
+			fpi.one = true;
+			fpi.exp = (int)(rng() % 2300) - 1150;
+			if (i & 1) fpi.exp = (int)(rng() % 340) - 170;
+			fpi.sig = rng() | (UINT64_C(1) << 63);
+			if (i & 2) fpi.sig &= ~UINT64_C(0) << (rng() % 64);
+			volatile long double x = (long double)fpi;
+
+			for (int m = 0; m < 4; ++m) {
+				std::fesetround(modes[m]);
+				volatile float f = x;
+				volatile double d = x;
+				std::fesetround(FE_TONEAREST);
+
+				errors += fpi.pack_single((rounding_direction)m) != fp::bit_cast<uint32_t>((float)f);
+				errors += fpi.pack_double((rounding_direction)m) != fp::bit_cast<uint64_t>((double)d);
+			}
+		}
+		CHECK(errors == 0);
+	}
+#endif
+
+	SECTION("float32 sample") {
+		int errors = 0;
+		for (uint64_t i = 0; i <= UINT32_MAX; i += 4099) {
+			fpi.unpack_single(i);
+			if (fpi.nan) continue;
+			errors += fpi.pack_single() != i;
+		}
+		CHECK(errors == 0);
+	}
+}
+
+
+// slow -- run with sane_test "[exhaustive]"
+TEST_CASE("float32 exhaustive", "[.][exhaustive]") {
+
+	fp::info fpi;
+	int errors = 0;
+
+	for (uint64_t i = 0; i <= UINT32_MAX; ++i) {
+
+		fpi.unpack_single(i);
+		if (fpi.nan) {
+			errors += !std::isnan((float)fpi);
+			continue;
+		}
+
+		// exact round trip, through extended too.
+		errors += fpi.pack_single() != i;
+		uint16_t sexp;
+		uint64_t sig;
+		fpi.pack_extended(sexp, sig);
+		fpi.unpack_extended(sexp, sig);
+		errors += fpi.pack_single() != i;
+
+		// half way to the next float (exact in double).
+		if (i > 0x7f7ffffe) continue;
+		uint32_t even = i & 0x01 ? i + 1 : i;
+		double mid = ((double)fp::bit_cast<float>((uint32_t)i) + (double)fp::bit_cast<float>((uint32_t)i + 1)) / 2;
+		uint64_t bits = fp::bit_cast<uint64_t>(mid);
+
+		fpi.unpack_double(bits);
+		errors += fpi.pack_single() != even;
+		errors += fpi.pack_single(UPWARD) != i + 1;
+		errors += fpi.pack_single(DOWNWARD) != i;
+		errors += fpi.pack_single(TOWARDZERO) != i;
+		fpi.sign = true;
+		errors += fpi.pack_single() != (even | 0x80000000);
+		errors += fpi.pack_single(UPWARD) != (i | 0x80000000);
+		errors += fpi.pack_single(DOWNWARD) != ((i + 1) | 0x80000000);
+
+		fpi.unpack_double(bits + 1);
+		errors += fpi.pack_single() != i + 1;
+		fpi.unpack_double(bits - 1);
+		errors += fpi.pack_single() != i;
+	}
+	CHECK(errors == 0);
+}
+
+
+TEST_CASE("soft_extended", "[soft_extended]") {
+
+	typedef SANE::soft_extended sx;
+
+	SECTION("basic") {
+		CHECK((long double)(sx(1.5L) + sx(2.25L)) == 3.75L);
+		CHECK((long double)(sx(1.5L) - sx(2.25L)) == -0.75L);
+		CHECK((long double)(sx(1.5L) * sx(-4.0L)) == -6.0L);
+		CHECK((long double)(sx(1.0L) / sx(4.0L)) == 0.25L);
+		CHECK((long double)SANE::sqrt(sx(2.25L)) == 1.5L);
+		CHECK((long double)SANE::rem(sx(7.0L), sx(2.0L)) == -1.0L);
+		CHECK((long double)SANE::rint(sx(2.5L)) == 2.0L);
+		CHECK((long double)SANE::rint(sx(2.5L), UPWARD) == 3.0L);
+		CHECK((long double)SANE::rint(sx(-2.5L), TOWARDZERO) == -2.0L);
+		CHECK(sx(1.0L) < sx(2.0L));
+		CHECK(sx(-0.0L) == sx(0.0L));
+	}
+
+	SECTION("NaN codes") {
+		sx inf(HUGE_VALL);
+		CHECK(fp::info(sx(inf - inf)).sig == NANADD);
+		CHECK(fp::info(sx(0.0L) / sx(0.0L)).sig == NANDIV);
+		CHECK(fp::info(sx(0.0L) * inf).sig == NANMUL);
+		CHECK(fp::info(SANE::sqrt(sx(-1.0L))).sig == NANSQRT);
+		CHECK(fp::info(SANE::rem(sx(1.0L), sx(0.0L))).sig == NANREM);
+		CHECK(fp::info(sx(make_nan<long double>(NANLOG)) + sx(1.0L)).sig == NANLOG);
+		CHECK(!(sx(NAN) == sx(NAN)));
+	}
+
+	SECTION("directed overflow") {
+		sx big(LDBL_MAX);
+		CHECK(SANE::isinf(mul(big, big, TONEAREST)));
+		CHECK(!SANE::isinf(mul(big, big, TOWARDZERO)));
+		CHECK(!SANE::isinf(mul(big, big, DOWNWARD)));
+		CHECK(SANE::isinf(mul(big, -big, DOWNWARD)));
+	}
+
+#if LDBL_MANT_DIG == 64
+	SECTION("x87") {
+		// compare against the host in all rounding directions.
+		std::mt19937_64 rng(0x5a4e);
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+
+		auto random_value = [&rng](int range) {
+			fp::info fpi;
+			fpi.sign = rng() & 1;
+			fpi.one = true;
+			fpi.exp = (int)(rng() % (2 * range)) - range;
+			fpi.sig = rng() | (UINT64_C(1) << 63);
+			if ((rng() & 7) == 0) fpi.sig &= ~UINT64_C(0) << (rng() % 64); // short significands.
+			return (long double)fpi;
+		};
+
+		auto same = [](const sx &a, long double b) {
+			sx tmp(b);
+			if (std::isnan(b)) return (bool)SANE::isnan(a);
+			return a.sexp == tmp.sexp && a.sig == tmp.sig;
+		};
+
+		int errors = 0;
+		for (int i = 0; i < 20000; ++i) {
+			int range = i < 10000 ? 64 : 16500;
+			volatile long double x = random_value(range);
+			volatile long double y = random_value(i & 1 ? 2 : range);
+			sx a(x), b(y);
+
+			for (int m = 0; m < 4; ++m) {
+				rounding_direction rd = (rounding_direction)m;
+				std::fesetround(modes[m]);
+				volatile long double r_add = x + y;
+				volatile long double r_sub = x - y;
+				volatile long double r_mul = x * y;
+				volatile long double r_div = x / y;
+				volatile long double r_sqrt = std::sqrt(std::fabs(x));
+				volatile long double r_rint = std::rint(x / (1 << 20));
+				std::fesetround(FE_TONEAREST);
+
+				errors += !same(add(a, b, rd), r_add);
+				errors += !same(sub(a, b, rd), r_sub);
+				errors += !same(mul(a, b, rd), r_mul);
+				errors += !same(div(a, b, rd), r_div);
+				errors += !same(SANE::sqrt(SANE::abs(a), rd), r_sqrt);
+				errors += !same(SANE::rint(div(a, sx(1.0L * (1 << 20)), rd), rd), r_rint);
+			}
+			errors += !same(SANE::rem(a, b), std::remainder((long double)x, (long double)y));
+		}
+		CHECK(errors == 0);
+	}
+
+	SECTION("sqrt near squares") {
+		// exact squares and their neighbours, where sqrt rounding is closest to a tie.
+		std::mt19937_64 rng(0x5152);
+		const int modes[4] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+
+		int errors = 0;
+		for (int i = 0; i < 20000; ++i) {
+			fp::info fpi;
+			fpi.one = true;
+			fpi.exp = (int)(rng() % 64) - 32;
+			fpi.sig = (rng() | (UINT64_C(1) << 63)) & (~UINT64_C(0) << 32);
+			long double q = (long double)fpi;
+			long double x = q * q;
+			for (int k = (int)(rng() % 4); k; --k)
+				x = std::nextafter(x, i & 1 ? HUGE_VALL : 0.0L);
+
+			for (int m = 0; m < 4; ++m) {
+				std::fesetround(modes[m]);
+				volatile long double r = std::sqrt(x);
+				std::fesetround(FE_TONEAREST);
+
+				sx tmp(r);
+				sx s = SANE::sqrt(sx(x), (rounding_direction)m);
+				errors += !(s.sexp == tmp.sexp && s.sig == tmp.sig);
+			}
+		}
+		CHECK(errors == 0);
+	}
+#endif
+}
+
+
+TEST_CASE("sort keys", "[sort]") {
+
+	using SANE::endian;
+
+	std::mt19937_64 rng(35);
+	std::vector<long double> v = {
+		0.0L, -0.0L, INFINITY, -INFINITY, NAN, -NAN,
+		make_nan<long double>(NANSQRT), make_nan<long double>(NANFINAN),
+		LDBL_MIN, -LDBL_MIN, LDBL_MAX, -LDBL_MAX, DBL_MAX, FLT_MAX, 1.0L, -1.0L,
+		std::numeric_limits<long double>::denorm_min(),
+		-std::numeric_limits<long double>::denorm_min(),
+		std::numeric_limits<double>::denorm_min(),
+		std::numeric_limits<float>::denorm_min(),
+	};
+	for (int i = 0; i < 2000; ++i) {
+		fp::info fpi;
+		fpi.sign = rng() & 0x01;
+		fpi.one = true;
+		fpi.exp = (int)(rng() % 33000) - 16500;
+		fpi.sig = rng() | (UINT64_C(1) << 63);
+		if (i % 4 == 0) fpi.exp = (int)(rng() % 20) - 10;
+		if (i % 8 == 0) fpi.sig &= ~UINT64_C(0xffffffffff);
+		v.push_back((long double)fpi);
+	}
+
+	auto check = [&](auto f) {
+		typedef decltype(f) F;
+		size_t n = v.size();
+		std::vector<uint8_t> buffer(n * F::size);
+		std::vector<long double> x(n);
+		std::vector<fp::sort_key_t<F>> keys(n);
+
+		for (size_t i = 0; i < n; ++i) {
+			fp::info fpi(v[i]);
+			fpi.write(f, buffer.data() + i * F::size);
+			fpi.read(f, buffer.data() + i * F::size);
+			x[i] = (long double)fpi;
+		}
+		fp::sort_keys(f, buffer.data(), keys.data(), n);
+
+		for (size_t i = 0; i < n; ++i) {
+			CHECK(fp::sort_key(f, buffer.data() + i * F::size) == keys[i]);
+			for (int m = 0; m < 4; ++m) {
+				size_t j = rng() % n;
+				if (std::isnan(x[i]) || std::isnan(x[j])) {
+					CHECK((keys[i] < keys[j]) == (!std::isnan(x[i]) && std::isnan(x[j])));
+					continue;
+				}
+				if (x[i] < x[j]) CHECK(keys[i] < keys[j]);
+				if (keys[i] < keys[j]) CHECK(x[i] <= x[j]);
+			}
+		}
+	};
+
+	SECTION("formats") {
+		check(fp::format<4, endian::big>{});
+		check(fp::format<4, endian::little>{});
+		check(fp::format<8, endian::big>{});
+		check(fp::format<8, endian::little>{});
+		check(fp::format<10, endian::big>{});
+		check(fp::format<12, endian::little>{});
+		check(fp::format<16, endian::native>{});
+		check(fp::format_68881<endian::big>{});
+	}
+
+	SECTION("extended encodings") {
+		auto key = [](uint16_t sexp, uint64_t sig) {
+			uint8_t buffer[10];
+			std::memcpy(buffer, &sexp, 2);
+			std::memcpy(buffer + 2, &sig, 8);
+			fp::reverse_bytes<2>(buffer);
+			fp::reverse_bytes<8>(buffer + 2);
+			return fp::sort_key(fp::format<10, endian::big>{}, buffer);
+		};
+		// pseudo-denormal == smallest normal exponent.
+		CHECK(key(0x0000, UINT64_C(0xc000000000000000)) == key(0x0001, UINT64_C(0xc000000000000000)));
+		CHECK(key(0x8000, UINT64_C(0xc000000000000000)) == key(0x8001, UINT64_C(0xc000000000000000)));
+		CHECK(key(0x0000, UINT64_C(0x7fffffffffffffff)) < key(0x0001, UINT64_C(0x8000000000000000)));
+		// unnormals.
+		CHECK(key(0x4005, UINT64_C(0x4000000000000000)) == key(0x4004, UINT64_C(0x8000000000000000)));
+		CHECK(key(0x0001, UINT64_C(0x4000000000000000)) == key(0x0000, UINT64_C(0x4000000000000000)));
+		CHECK(key(0x4005, 0) == key(0x0000, 0));
+		// 68881 infinity without the explicit bit.
+		CHECK(key(0x7fff, 0) == key(0x7fff, UINT64_C(0x8000000000000000)));
+	}
+
+	SECTION("comp") {
+		std::vector<int64_t> c = { 0, 1, -1, INT64_MAX, -INT64_MAX, INT64_MIN };
+		for (int i = 0; i < 1000; ++i) c.push_back(rng() >> (rng() % 64));
+
+		std::vector<uint8_t> buffer(c.size() * 8);
+		for (size_t i = 0; i < c.size(); ++i) {
+			std::memcpy(buffer.data() + i * 8, &c[i], 8);
+			fp::reverse_bytes<8>(buffer.data() + i * 8);
+		}
+
+		for (size_t i = 0; i < c.size(); ++i) {
+			for (size_t j = 0; j < c.size(); j += 7) {
+				bool less = c[j] == INT64_MIN ? c[i] != INT64_MIN : c[i] != INT64_MIN && c[i] < c[j];
+				auto a = fp::sort_key(fp::format_comp<endian::big>{}, buffer.data() + i * 8);
+				auto b = fp::sort_key(fp::format_comp<endian::big>{}, buffer.data() + j * 8);
+				CHECK((a < b) == less);
+			}
+		}
+	}
+
+	SECTION("radix_sort") {
+		typedef fp::format<8, endian::big> F;
+		size_t n = 200000;
+		std::vector<uint8_t> a(n * 8);
+
+		for (size_t i = 0; i < n; ++i) {
+			fp::info fpi(v[rng() % v.size()]);
+			// NaNs all have the same key; the payload shows stability.
+			if (fpi.nan) fpi.sig = i;
+			fpi.write(F{}, a.data() + i * 8);
+		}
+		std::vector<uint8_t> b(a);
+		std::vector<uint8_t> c(a);
+
+		fp::radix_sort(F{}, a.data(), n, 1);
+		fp::radix_sort(F{}, b.data(), n, 4);
+		CHECK(a == b);
+
+		std::vector<uint64_t> keys(n);
+		fp::sort_keys(F{}, c.data(), keys.data(), n);
+		std::sort(keys.begin(), keys.end());
+
+		uint64_t prev_nan = 0;
+		for (size_t i = 0; i < n; ++i) {
+			fp::info fpi;
+			fpi.read(F{}, a.data() + i * 8);
+			CHECK(fp::sort_key(F{}, a.data() + i * 8) == keys[i]);
+			if (fpi.nan) {
+				CHECK(fpi.sig >= prev_nan);
+				prev_nan = fpi.sig;
+			}
+		}
+
+		for (int m = 0; m < 1000; ++m) {
+			uint8_t probe[8];
+			fp::info(v[rng() % v.size()]).write(F{}, probe);
+			auto k = fp::sort_key(F{}, probe);
+			CHECK(fp::lower_bound(F{}, a.data(), n, probe) == (size_t)(std::lower_bound(keys.begin(), keys.end(), k) - keys.begin()));
+		}
+		CHECK(fp::lower_bound(F{}, a.data(), 0, a.data()) == 0);
+
+		// every key the same.
+		std::vector<double> same(1000, 2.5);
+		fp::radix_sort(fp::format<8, endian::native>{}, same.data(), same.size(), 2);
+		CHECK(same == std::vector<double>(1000, 2.5));
+
+		// 10-byte records.
+		typedef fp::format<10, endian::big> X;
+		std::vector<uint8_t> x(5000 * 10);
+		for (size_t i = 0; i < 5000; ++i) fp::info(v[i % v.size()]).write(X{}, x.data() + i * 10);
+		fp::radix_sort(X{}, x.data(), 5000);
+		for (size_t i = 1; i < 5000; ++i)
+			CHECK(!(fp::sort_key(X{}, x.data() + i * 10) < fp::sort_key(X{}, x.data() + i * 10 - 10)));
+	}
+}
+
+TEST_CASE("classify", "[floating_point]") {
+
+	using SANE::endian;
+
+	std::mt19937_64 rng(36);
+
+	// random bit images, mostly with an interesting exponent.
+	auto check = [&](auto f, unsigned exp_bits) {
+		typedef decltype(f) F;
+		size_t n = 5003;
+		std::vector<uint8_t> buffer(n * F::size);
+
+		for (size_t i = 0; i < n; ++i) {
+			uint8_t *cp = buffer.data() + i * F::size;
+			for (size_t j = 0; j < F::size; ++j) cp[j] = rng();
+
+			fp::info fpi;
+			fpi.read(f, cp);
+			switch (rng() % 4) {
+				case 0: fpi.exp = 0; fpi.sig = 0; fpi.nan = fpi.inf = false; break;
+				case 1: fpi.nan = true; fpi.signaling = rng() & 1; fpi.sig = rng() % (1 << exp_bits); break;
+				case 2: fpi.inf = true; fpi.nan = false; break;
+				default: continue;
+			}
+			fpi.write(f, cp);
+		}
+
+		fp::class_counts expected;
+		for (size_t i = 0; i < n; ++i) {
+			fp::info fpi;
+			fpi.read(f, buffer.data() + i * F::size);
+			switch (fpclassify(fpi)) {
+				case FP_ZERO: ++expected.zero; break;
+				case FP_SUBNORMAL: ++expected.subnormal; break;
+				case FP_NORMAL: ++expected.normal; break;
+				case FP_INFINITE: ++expected.infinite; break;
+				case FP_NAN: ++expected.nan; ++expected.nan_code[fpi.sig & 0xff]; break;
+			}
+		}
+
+		fp::class_counts c = fp::classify(f, buffer.data(), n);
+		CHECK(c.zero == expected.zero);
+		CHECK(c.subnormal == expected.subnormal);
+		CHECK(c.normal == expected.normal);
+		CHECK(c.infinite == expected.infinite);
+		CHECK(c.nan == expected.nan);
+		CHECK(std::equal(c.nan_code, c.nan_code + 256, expected.nan_code));
+
+		c += c;
+		CHECK(c.nan == 2 * expected.nan);
+	};
+
+	SECTION("formats") {
+		check(fp::format<4, endian::big>{}, 8);
+		check(fp::format<4, endian::little>{}, 8);
+		check(fp::format<8, endian::big>{}, 8);
+		check(fp::format<8, endian::little>{}, 8);
+		check(fp::format<10, endian::big>{}, 8);
+		check(fp::format<12, endian::little>{}, 8);
+		check(fp::format<16, endian::native>{}, 8);
+		check(fp::format_68881<endian::big>{}, 8);
+	}
+
+	SECTION("extended encodings") {
+		typedef fp::format<10, endian::native> F;
+		// pseudo-denormal, unnormal, 68881 infinity, pseudo-NaN.
+		std::vector<std::pair<uint16_t, uint64_t>> v = {
+			{ 0x0000, UINT64_C(0xc000000000000000) },
+			{ 0x4005, UINT64_C(0x4000000000000000) },
+			{ 0x4005, 0 },
+			{ 0x7fff, 0 },
+			{ 0xffff, NANSQRT },
+		};
+		// through the vector kernels (if any) and the tail.
+		for (size_t i = 0; i < 10; ++i) v.push_back(v[i]);
+		std::vector<uint8_t> buffer(v.size() * 10);
+		for (size_t i = 0; i < v.size(); ++i) {
+			std::memcpy(buffer.data() + i * 10 + fp::extended_layout<F>::sexp, &v[i].first, 2);
+			std::memcpy(buffer.data() + i * 10 + fp::extended_layout<F>::sig, &v[i].second, 8);
+		}
+
+		fp::class_counts c = fp::classify(F{}, buffer.data(), v.size());
+		CHECK(c.normal == 3);
+		CHECK(c.subnormal == 3);
+		CHECK(c.zero == 3);
+		CHECK(c.infinite == 3);
+		CHECK(c.nan == 3);
+		CHECK(c.nan_code[NANSQRT] == 3);
+
+		std::vector<uint8_t> codes(v.size());
+		CHECK(fp::nan_codes(F{}, buffer.data(), codes.data(), v.size()) == 3);
+		for (size_t i = 0; i < v.size(); ++i) CHECK(codes[i] == (i % 5 == 4 ? NANSQRT : 0));
+	}
+
+	SECTION("comp") {
+		std::vector<int64_t> v = { 0, 1, -1, INT64_MAX, INT64_MIN, INT64_MIN, 0 };
+		for (int i = 0; i < 14; ++i) v.push_back(v[i]);
+		fp::class_counts c = fp::classify(fp::format_comp<endian::little>{}, v.data(), v.size());
+		CHECK(c.zero == 6);
+		CHECK(c.normal == 9);
+		CHECK(c.nan == 6);
+		CHECK(c.nan_code[NANCOMP] == 6);
+
+		for (auto &x : v) fp::reverse_bytes<8>(&x);
+		c = fp::classify(fp::format_comp<endian::big>{}, v.data(), v.size());
+		CHECK(c.zero == 6);
+		CHECK(c.normal == 9);
+		CHECK(c.nan == 6);
+		CHECK(c.nan_code[NANCOMP] == 6);
+	}
+}
+
+TEST_CASE("canonical hash", "[hash]") {
+
+	using SANE::endian;
+
+	std::mt19937_64 rng(37);
+
+	auto canon = [](auto f, const fp::info &fpi) {
+		uint8_t buffer[16];
+		fpi.write(f, buffer);
+		return fp::canonicalize(f, buffer);
+	};
+
+	SECTION("formats") {
+		std::vector<long double> v = {
+			0.0L, -0.0L, INFINITY, -INFINITY, 1.0L, -1.5L, FLT_MAX, -FLT_MIN,
+			std::numeric_limits<float>::denorm_min(),
+		};
+		for (int i = 0; i < 2000; ++i) v.push_back((float)std::ldexp((long double)(int64_t)rng(), (int)(rng() % 300) - 200));
+
+		for (auto x : v) {
+			// every value here is a float, so every format holds it exactly.
+			fp::info fpi(x);
+			fp::canonical c = fp::canonicalize(fpi);
+			CHECK(canon(fp::format<4, endian::big>{}, fpi) == c);
+			CHECK(canon(fp::format<4, endian::little>{}, fpi) == c);
+			CHECK(canon(fp::format<8, endian::big>{}, fpi) == c);
+			CHECK(canon(fp::format<10, endian::big>{}, fpi) == c);
+			CHECK(canon(fp::format<12, endian::little>{}, fpi) == c);
+			CHECK(canon(fp::format_68881<endian::big>{}, fpi) == c);
+			CHECK(canon(fp::format_quad<endian::big>{}, fpi) == c);
+		}
+
+		CHECK(canon(fp::format<8, endian::big>{}, fp::info(0.0L)) == canon(fp::format<4, endian::little>{}, fp::info(-0.0L)));
+		CHECK(canon(fp::format<8, endian::big>{}, fp::info((long double)INFINITY)) != canon(fp::format<8, endian::big>{}, fp::info(-(long double)INFINITY)));
+
+		double nan = NAN;
+		CHECK(fp::hash(fp::format<8, endian::native>{}, &nan) == fp::hash(fp::canonicalize(fp::info(make_nan<long double>(NANSQRT)))));
+		CHECK(!fp::equal(fp::format<8, endian::native>{}, &nan, fp::format<8, endian::native>{}, &nan));
+
+		double one = 1.0;
+		float f1 = 1.0f;
+		CHECK(fp::equal(fp::format<8, endian::native>{}, &one, fp::format<4, endian::native>{}, &f1));
+		CHECK(fp::hash(fp::format<8, endian::native>{}, &one) == fp::hash(fp::format<4, endian::native>{}, &f1));
+	}
+
+	SECTION("extended encodings") {
+		typedef fp::format<10, endian::native> F;
+		auto key = [](uint16_t sexp, uint64_t sig) {
+			uint8_t buffer[10];
+			std::memcpy(buffer + fp::extended_layout<F>::sexp, &sexp, 2);
+			std::memcpy(buffer + fp::extended_layout<F>::sig, &sig, 8);
+			return fp::canonicalize(F{}, buffer);
+		};
+		CHECK(key(0x0000, UINT64_C(0xc000000000000000)) == key(0x0001, UINT64_C(0xc000000000000000)));
+		CHECK(key(0x4005, UINT64_C(0x4000000000000000)) == key(0x4004, UINT64_C(0x8000000000000000)));
+		CHECK(key(0x4005, 0) == key(0x8000, 0));
+		CHECK(key(0x7fff, 0) == key(0x7fff, UINT64_C(0x8000000000000000)));
+	}
+
+	SECTION("comp") {
+		for (int i = 0; i < 1000; ++i) {
+			int64_t x = (int64_t)rng() >> (rng() % 64);
+			if (x == INT64_MIN) continue;
+			uint64_t w = x;
+			fp::reverse_bytes<8>(&w);
+			CHECK(fp::canonicalize(fp::format_comp<endian::big>{}, &w) == canon(fp::format<10, endian::big>{}, fp::info((long double)x)));
+		}
+		uint64_t nan = comp::NaN;
+		CHECK(fp::canonicalize(fp::format_comp<endian::native>{}, &nan).kind == fp::canonical::nan);
+	}
+
+	SECTION("decimal") {
+		CHECK(canonicalize(decimal(0, -1, "15")) == fp::canonicalize(fp::info(1.5L)));
+		CHECK(canonicalize(decimal(1, -19, "15000000000000000000")) == fp::canonicalize(fp::info(-1.5L)));
+		CHECK(canonicalize(decimal(0, 0, "18446744073709551616")) == fp::canonicalize(fp::info(std::ldexp(1.0L, 64))));
+		CHECK(canonicalize(decimal(1, 0, "0")) == canonicalize(decimal(0, 5, "0123")));
+		CHECK(canonicalize(decimal(1, 0, "I")) == fp::canonicalize(fp::info(-(long double)INFINITY)));
+		CHECK(canonicalize(decimal(0, 0, "N4001")).kind == fp::canonical::nan);
+		CHECK(canonicalize(decimal(0, 0, "1x")).kind == fp::canonical::nan);
+
+		// 0.1 isn't binary.
+		fp::canonical tenth = canonicalize(decimal(0, -1, "1"));
+		CHECK(tenth.kind == fp::canonical::nonbinary);
+		CHECK(tenth == canonicalize(decimal(0, -2, "10")));
+		CHECK(tenth != canonicalize(decimal(0, -1, "2")));
+		CHECK(tenth != fp::canonicalize(fp::info(0.1L)));
+
+		// the slow path agrees with the fast one.
+		CHECK(canonicalize(decimal(0, 40, "1")) == canonicalize(decimal(0, 9, "10000000000000000000000000000000")));
+		CHECK(canonicalize(decimal(0, 40, "1")).kind == fp::canonical::finite);
+		CHECK(canonicalize(decimal(0, -30, "5")) == canonicalize(decimal(0, -31, "50")));
+		CHECK(canonicalize(decimal(0, -30, "5")).kind == fp::canonical::nonbinary);
+		CHECK(canonicalize(decimal(0, -40, "9094947017729282379150390625")) == fp::canonicalize(fp::info(std::ldexp(1.0L, -40))));
+
+		for (int i = 0; i < 1000; ++i) {
+			long double x = std::ldexp((long double)(int64_t)(rng() >> 40), -(int)(rng() % 20));
+			decimal d = x2dec(fp::info(x), decform(decform::FLOATDECIMAL, 32));
+			CHECK(canonicalize(d) == fp::canonicalize(fp::info(x)));
+			CHECK(hash(d) == fp::hash(fp::canonicalize(fp::info(x))));
+		}
+	}
+
+	SECTION("batch") {
+		typedef fp::format<8, endian::big> F;
+		std::vector<uint8_t> buffer(1000 * 8);
+		for (size_t i = 0; i < 1000; ++i) fp::info(std::ldexp((long double)(int64_t)rng(), -63)).write(F{}, buffer.data() + i * 8);
+
+		std::vector<uint64_t> h(1000);
+		fp::hash(F{}, buffer.data(), h.data(), 1000);
+		for (size_t i = 0; i < 1000; ++i) CHECK(h[i] == fp::hash(F{}, buffer.data() + i * 8));
+
+		// random bit images (specials included) in every format, and an odd count.
+		auto check = [&](auto f, auto special) {
+			typedef decltype(f) G;
+			size_t n = 1001;
+			std::vector<uint8_t> raw(n * G::size);
+			for (auto &b : raw) b = rng();
+			for (size_t i = 0; i < n; i += 7) special(i, raw.data() + i * G::size);
+
+			std::vector<uint64_t> out(n);
+			fp::hash(f, raw.data(), out.data(), n);
+			size_t bad = 0;
+			for (size_t i = 0; i < n; ++i) bad += out[i] != fp::hash(fp::canonicalize(f, raw.data() + i * G::size));
+			CHECK(bad == 0);
+		};
+		auto binary = [&](auto f) {
+			check(f, [f](size_t i, uint8_t *cp) {
+				fp::info fpi;
+				fpi.read(f, cp);
+				switch (i % 4) {
+					case 0: fpi.sig = 0; break;
+					case 1: fpi.nan = true; fpi.sig = i & 0xff; break;
+					case 2: fpi.inf = true; fpi.nan = false; break;
+					default: fpi.exp = -16400; break;
+				}
+				fpi.write(f, cp);
+			});
+		};
+		binary(fp::format<4, endian::little>{});
+		binary(fp::format<8, endian::big>{});
+		binary(fp::format<10, endian::big>{});
+		binary(fp::format<12, endian::little>{});
+		binary(fp::format_68881<endian::big>{});
+		binary(fp::format_quad<endian::big>{});
+		check(fp::format_comp<endian::big>{}, [](size_t i, uint8_t *cp) {
+			std::memset(cp, 0, 8);
+			if (i & 1) cp[0] = 0x80;
+		});
+	}
+}
+
+TEST_CASE("mixed compare", "[hash]") {
+
+	using SANE::endian;
+
+	std::mt19937_64 rng(38);
+
+	auto relation = [](long double a, long double b) {
+		if (std::isnan(a) || std::isnan(b)) return UNORDERED;
+		if (a < b) return LESSTHAN;
+		if (a > b) return GREATERTHAN;
+		return EQUALTO;
+	};
+
+	std::vector<long double> v = {
+		0.0L, -0.0L, INFINITY, -INFINITY, NAN, 1.0L, -1.0L, 0.1L, 0.1, 0.1f,
+		LDBL_MIN, DBL_MIN, FLT_MIN, LDBL_MAX, DBL_MAX, FLT_MAX,
+	};
+	for (int i = 0; i < 500; ++i) {
+		fp::info fpi;
+		fpi.sign = rng() & 0x01;
+		fpi.one = true;
+		fpi.exp = (int)(rng() % 200) - 100;
+		fpi.sig = rng() | (UINT64_C(1) << 63);
+		long double x = (long double)fpi;
+		v.push_back(x);
+		v.push_back((double)x);
+		v.push_back((float)x);
+		v.push_back(std::rint(x));
+	}
+
+	SECTION("binary") {
+		typedef fp::format<8, endian::big> D;
+		typedef fp::format<10, endian::little> X;
+		typedef fp::format_comp<endian::big> C;
+
+		for (int i = 0; i < 5000; ++i) {
+			long double a = v[rng() % v.size()];
+			long double b = v[rng() % v.size()];
+			uint8_t x[10], d[8], c[8];
+			fp::info(a).write(X{}, x);
+			fp::info((double)b).write(D{}, d);
+			CHECK(fp::compare(X{}, x, D{}, d) == relation(a, (double)b));
+			CHECK(fp::compare(D{}, d, X{}, x) == relation((double)b, a));
+
+			if (std::fabs(b) < std::ldexp(1.0L, 62)) {
+				uint64_t w = (int64_t)std::rint(b);
+				std::memcpy(c, &w, 8);
+				fp::reverse_bytes<8>(c);
+				CHECK(fp::compare(C{}, c, X{}, x) == relation(std::rint(b), a));
+			}
+		}
+	}
+
+	SECTION("decimal") {
+		// 0.1 in any binary format is above 0.1.
+		decimal tenth(0, -1, "1");
+		float f = 0.1f;
+		double d = 0.1;
+		long double x = 0.1L;
+		CHECK(fp::compare(tenth, fp::format<4, endian::native>{}, &f) == LESSTHAN);
+		CHECK(fp::compare(fp::format<8, endian::native>{}, &d, tenth) == GREATERTHAN);
+		CHECK(fp::compare(fp::format<sizeof(long double), endian::native>{}, &x, tenth) == GREATERTHAN);
+		CHECK(fp::compare(fp::format<8, endian::native>{}, &d, decimal(0, -55, "1000000000000000055511151231257827021181583404541015625")) == EQUALTO);
+
+		CHECK(compare(tenth, decimal(0, -2, "10")) == EQUALTO);
+		CHECK(compare(decimal(0, -1, "2"), decimal(0, -2, "19")) == GREATERTHAN);
+		CHECK(compare(decimal(1, -1, "2"), decimal(1, -2, "19")) == LESSTHAN);
+		CHECK(compare(decimal(0, 0, "N4001"), tenth) == UNORDERED);
+		CHECK(compare(decimal(0, 0, "0"), decimal(1, 3, "0")) == EQUALTO);
+		CHECK(compare(decimal(1, 0, "I"), decimal(1, 4000, "9")) == LESSTHAN);
+		CHECK(compare(decimal(0, -4000, "3"), decimal(0, -4022, "29999999999999999999999")) == GREATERTHAN);
+
+		// rounding a decimal to extended can't change which side of x it is on.
+		for (int i = 0; i < 2000; ++i) {
+			long double x = v[rng() % v.size()];
+			decimal dd = x2dec(fp::info(x), decform(decform::FLOATDECIMAL, 1 + rng() % 20));
+			fp::info fpi;
+			dec2x(dd, fpi);
+			relop r = relation((long double)fpi, x);
+			if (r == EQUALTO) continue;
+			uint8_t buffer[10];
+			fp::info(x).write(fp::format<10, endian::big>{}, buffer);
+			CHECK(fp::compare(dd, fp::format<10, endian::big>{}, buffer) == r);
+		}
+	}
+
+	SECTION("batch") {
+		typedef fp::format<4, endian::big> F;
+		std::vector<uint8_t> buffer(v.size() * 4);
+		for (size_t i = 0; i < v.size(); ++i) fp::info((float)v[i]).write(F{}, buffer.data() + i * 4);
+
+		std::vector<relop> r(v.size());
+		fp::canonical value = canonicalize(decimal(0, -3, "1"));
+		fp::compare(F{}, buffer.data(), value, r.data(), v.size());
+		for (size_t i = 0; i < v.size(); ++i) {
+			if (std::isnan(v[i])) CHECK(r[i] == UNORDERED);
+			else CHECK(r[i] == ((float)v[i] > 0.001L ? GREATERTHAN : LESSTHAN));
+		}
+	}
+}
+
+TEST_CASE("endian_value", "[floating_point]") {
+
+	using SANE::endian;
+
+	static_assert(sizeof(big_endian<float>) == 4 && alignof(big_endian<float>) == 1, "big_endian<float>");
+	static_assert(sizeof(big_endian<double>) == 8 && alignof(big_endian<double>) == 1, "big_endian<double>");
+	static_assert(sizeof(big_endian<long double>) == 10, "big_endian<long double>");
+	static_assert(sizeof(little_endian<soft_extended>) == 10, "little_endian<soft_extended>");
+	static_assert(sizeof(big_endian<comp>) == 8, "big_endian<comp>");
+
+	// unaligned on purpose.
+	uint8_t ram[32] = {};
+	uint8_t *cp = ram + 1;
+
+	SECTION("double") {
+		auto &x = big_endian<double>::at(cp);
+		x = 1.5;
+		CHECK(cp[0] == 0x3f);
+		CHECK(cp[1] == 0xf8);
+		CHECK(x == 1.5);
+		x += 1;
+		CHECK(x * 2 == 5.0);
+		CHECK(cp[0] == 0x40);
+
+		auto &y = little_endian<double>::at(cp);
+		y = 1.5;
+		CHECK(cp[7] == 0x3f);
+		CHECK(cp[6] == 0xf8);
+		CHECK((double)y == 1.5);
+	}
+
+	SECTION("float") {
+		auto &x = big_endian<float>::at(cp);
+		x = -2.0f;
+		CHECK(cp[0] == 0xc0);
+		CHECK(x / 4 == -0.5f);
+		x *= 3;
+		CHECK(x == -6.0f);
+	}
+
+	SECTION("extended") {
+		const uint8_t one[10] = { 0x3f, 0xff, 0x80, 0, 0, 0, 0, 0, 0, 0 };
+
+		big_endian<long double>::at(cp) = 1.0L;
+		CHECK(std::memcmp(cp, one, 10) == 0);
+		CHECK(big_endian<long double>::at(cp) == 1.0L);
+
+		auto &s = big_endian<soft_extended>::at(cp + 10);
+		s = soft_extended(1.0L);
+		CHECK(std::memcmp(cp + 10, one, 10) == 0);
+		soft_extended t = s;
+		CHECK(t.sexp == 0x3fff);
+		CHECK(t.sig == UINT64_C(0x8000000000000000));
+
+		// 68881: the padding word is after the exponent.
+		const uint8_t m68k[12] = { 0x3f, 0xff, 0, 0, 0x80, 0, 0, 0, 0, 0, 0, 0 };
+		typedef endian_value<long double, endian::big, fp::format_68881<endian::big>> X;
+		std::memset(ram, 0xff, sizeof(ram));
+		X::at(cp) = 1.0L;
+		CHECK(std::memcmp(cp, m68k, 12) == 0);
+		CHECK((long double)X::at(cp) == 1.0L);
+	}
+
+	SECTION("comp") {
+		auto &c = big_endian<comp>::at(cp);
+		c = comp(INT64_C(-2));
+		CHECK(cp[0] == 0xff);
+		CHECK(cp[7] == 0xfe);
+		CHECK((int64_t)c.load() == -2);
+
+		c = comp(comp::NaN);
+		CHECK(isnan(c.load()));
+		CHECK(cp[0] == 0x80);
+	}
+}
+
+TEST_CASE("format_range", "[floating_point]") {
+
+	using SANE::endian;
+	typedef fp::format<10, endian::big> xbig;
+	typedef fp::format<16, endian::little> x16;
+
+	const long double values[] = {
+		1.0L, -2.5L, 0.0L, 3.0e100L, -1.0e-4000L,
+		std::numeric_limits<long double>::infinity(),
+		std::numeric_limits<long double>::denorm_min(),
+		1.0L / 3.0L, 7.0L, -0.0L,
+	};
+	constexpr size_t n = sizeof(values) / sizeof(values[0]);
+
+	// 10 byte extended in 14 byte records.
+	std::vector<uint8_t> records(n * 14, 0xee);
+	fp::format_range<xbig, 14> r(records.data(), n);
+
+	for (size_t i = 0; i < n; ++i) r[i] = values[i];
+	CHECK(records[10] == 0xee);
+	CHECK(records[13] == 0xee);
+
+	SECTION("iterators") {
+		CHECK(std::distance(r.begin(), r.end()) == (ptrdiff_t)n);
+		auto it = r.begin() + 3;
+		CHECK(*it == values[3]);
+		CHECK(it[1] == values[4]);
+		CHECK(it - r.begin() == 3);
+		CHECK(r.end() - 1 > it);
+
+		long double sum = 0;
+		for (long double x : r.subrange(0, 2)) sum += x;
+		CHECK(sum == -1.5L);
+
+		fp::const_format_range<xbig, 14> cr = r;
+		CHECK(cr[7] == values[7]);
+
+		r[5] = 0.0L; // no infinity for sort.
+		std::sort(r.begin(), r.end(), [](long double a, long double b){ return a < b; });
+		CHECK(std::is_sorted(r.begin(), r.end(), [](long double a, long double b){ return a < b; }));
+		CHECK(r[0] == -2.5L);
+		CHECK(r[n - 1] == 3.0e100L);
+		for (size_t i = 0; i < n; ++i) CHECK(records[i * 14 + 10] == 0xee);
+	}
+
+	SECTION("transform") {
+		uint8_t nan[10];
+		fp::info fpi;
+		fpi.nan = true;
+		fpi.sig = UINT64_C(0x4015000000000000);
+		fpi.write(xbig{}, nan);
+		std::memcpy(records.data() + 9 * 14, nan, 10);
+
+		std::vector<uint8_t> a(n * 20), b(n * 16), c(n * 12), d(n * 8);
+		fp::format_range<x16, 20> ra(a.data(), n);
+		fp::format_range<x16> rb(b.data(), n);
+		fp::format_range<fp::format_68881<endian::big>> rc(c.data(), n);
+		fp::format_range<fp::format<8, endian::big>> rd(d.data(), n);
+
+		transform(r, ra);
+		transform(ra, rb);
+		transform(rb, rc);
+		transform(r, rd);
+
+		for (size_t i = 0; i < n; ++i) {
+			uint8_t expect[16];
+			fp::info x;
+			x.read(xbig{}, records.data() + i * 14);
+			x.write(x16{}, expect);
+			CHECK(std::memcmp(b.data() + i * 16, expect, 16) == 0);
+			CHECK(std::memcmp(a.data() + i * 20, expect, 16) == 0);
+
+			x.write(fp::format_68881<endian::big>{}, expect);
+			CHECK(std::memcmp(c.data() + i * 12, expect, 12) == 0);
+
+			x.write(fp::format<8, endian::big>{}, expect);
+			CHECK(std::memcmp(d.data() + i * 8, expect, 8) == 0);
+		}
+	}
+
+	SECTION("batch kernels") {
+		std::vector<uint8_t> packed(n * 10);
+		for (size_t i = 0; i < n; ++i)
+			std::memcpy(packed.data() + i * 10, records.data() + i * 14, 10);
+
+		fp::class_counts a = classify(r);
+		fp::class_counts b = fp::classify(xbig{}, packed.data(), n);
+		CHECK(a.normal == b.normal);
+		CHECK(a.subnormal == b.subnormal);
+		CHECK(a.zero == b.zero);
+		CHECK(a.infinite == 1);
+
+		uint64_t ha[n], hb[n];
+		hash(r, ha);
+		fp::hash(xbig{}, packed.data(), hb, n);
+		CHECK(std::equal(ha, ha + n, hb));
+	}
+}
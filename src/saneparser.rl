@@ -193,10 +193,10 @@ void str2dec(const std::string &s, uint16_t &index, decimal &d, uint16_t &vp)
 		int exp = 0;
 		std::string siga, sigb;
 
-		/* grr... empty string is a valid N0011 */
+		/* grr... empty string is a valid N4011 */
 		if (index >= s.size()) {
 			vp = 1;
-			d.sig = "N0011";
+			d.sig = "N4011";
 			d.exp = 0;
 			d.sgn = 0;
 			return;
@@ -230,7 +230,8 @@ void str2dec(const std::string &s, uint16_t &index, decimal &d, uint16_t &vp)
 		else if (nan)
 		{
 			d.sig = "N";
-			nantype |= 0x4000;
+			// quiet NaN.  see nan_type() in decimal.cpp.
+			nantype = (nantype & 0x3fff) | 0x4000;
 			const char *hexstr = "0123456789abcdef";
 			// 4-byte hex
 			d.sig.push_back(hexstr[(nantype >> 12) & 0x0f]);
@@ -248,7 +249,7 @@ void str2dec(const std::string &s, uint16_t &index, decimal &d, uint16_t &vp)
 		vp = cs != fpstr_error;
 		auto processed = checkpoint - s.begin();
 		if (processed == 0) {
-			d.sig = "N0011";
+			d.sig = "N4011";
 			d.sgn = 0;
 			d.exp = 0;
 		} else index = processed;
@@ -0,0 +1,596 @@
+
+#include <sane/soft_extended.h>
+#include <sane/sane.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace SANE {
+
+	namespace {
+
+		using namespace floating_point::extended_traits;
+		using floating_point::clz64;
+		using floating_point::mul64;
+
+		/*
+		 * 128-bit helpers.  __int128 where the compiler has it, otherwise
+		 * plain 64-bit arithmetic.
+		 */
+
+		// (hi:lo) / d, requires hi < d.
+		inline uint64_t div128(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &r) {
+		#ifdef __SIZEOF_INT128__
+			unsigned __int128 n = ((unsigned __int128)hi << 64) | lo;
+			r = n % d;
+			return n / d;
+		#else
+			uint64_t q = 0;
+			for (int i = 0; i < 64; ++i) {
+				bool carry = hi >> 63;
+				hi = (hi << 1) | (lo >> 63);
+				lo <<= 1;
+				q <<= 1;
+				if (carry || hi >= d) {
+					hi -= d;
+					q |= 1;
+				}
+			}
+			r = hi;
+			return q;
+		#endif
+		}
+
+		// shift (hi:lo) right, OR-ing any lost bits into the low bit.
+		inline void shift_right_jam(uint64_t &hi, uint64_t &lo, unsigned n) {
+			if (n == 0) return;
+			if (n < 64) {
+				bool lost = (lo << (64 - n)) != 0;
+				lo = (lo >> n) | (hi << (64 - n)) | lost;
+				hi >>= n;
+			} else if (n < 128) {
+				bool lost = lo != 0 || (n > 64 && (hi << (128 - n)) != 0);
+				lo = (hi >> (n - 64)) | lost;
+				hi = 0;
+			} else {
+				lo = (hi | lo) != 0;
+				hi = 0;
+			}
+		}
+
+		inline void shift_left(uint64_t &hi, uint64_t &lo, unsigned n) {
+			if (n == 0) return;
+			if (n < 64) {
+				hi = (hi << n) | (lo >> (64 - n));
+				lo <<= n;
+			} else {
+				hi = lo << (n - 64);
+				lo = 0;
+			}
+		}
+
+
+		enum { cls_zero, cls_finite, cls_inf, cls_nan };
+
+		inline int classify(const soft_extended &x) {
+			if ((x.sexp & nan_exp) == nan_exp) return (x.sig << 1) ? cls_nan : cls_inf;
+			if (x.sig == 0) return cls_zero;
+			return cls_finite;
+		}
+
+		// value = sig * 2^(exp - 63), sig normalized.
+		struct unpacked {
+			bool sign;
+			int exp;
+			uint64_t sig;
+		};
+
+		inline unpacked unpack(const soft_extended &x) {
+			unpacked u;
+			int e = x.sexp & nan_exp;
+
+			u.sign = x.sexp >> 15;
+			u.exp = e ? e - (int)bias : min_exp;
+			u.sig = x.sig;
+
+			// denormals and unnormals.
+			int shift = clz64(u.sig);
+			u.sig <<= shift;
+			u.exp -= shift;
+			return u;
+		}
+
+		inline soft_extended zero(bool sign) {
+			return soft_extended(sign ? sign_bit : 0, 0);
+		}
+
+		inline soft_extended infinity(bool sign) {
+			return soft_extended((sign ? sign_bit : 0) | nan_exp, one_bit);
+		}
+
+		inline soft_extended with_sign(const soft_extended &x, bool sign) {
+			return soft_extended((x.sexp & nan_exp) | (sign ? sign_bit : 0), x.sig);
+		}
+
+		soft_extended make_nan(unsigned code) {
+			floating_point::info fpi;
+			soft_extended tmp;
+
+			fpi.nan = true;
+			fpi.sig = code;
+			fpi.pack_extended(tmp.sexp, tmp.sig);
+			return tmp;
+		}
+
+		inline soft_extended quiet(const soft_extended &x) {
+			return soft_extended(x.sexp, x.sig | one_bit | quiet_nan);
+		}
+
+		// at least one operand is a NaN.  Return the one with the larger code.
+		soft_extended propagate(const soft_extended &a, const soft_extended &b) {
+			bool an = classify(a) == cls_nan;
+			bool bn = classify(b) == cls_nan;
+
+			if (an && bn) {
+				uint64_t ac = a.sig & ((UINT64_C(1) << 62) - 1);
+				uint64_t bc = b.sig & ((UINT64_C(1) << 62) - 1);
+				return quiet(ac >= bc ? a : b);
+			}
+			return quiet(an ? a : b);
+		}
+
+		/*
+		 * 1 if (sig:lo) rounds up.  The direction is turned into masks
+		 * (as integer_rounding does) so there's no branch on it or on the
+		 * round bits, which are random.
+		 */
+		inline uint64_t round_increment(bool sign, uint64_t sig, uint64_t lo, rounding_direction rd) {
+			uint64_t nearest = rd == TONEAREST;
+			uint64_t away = sign ? rd == DOWNWARD : rd == UPWARD;
+			return (nearest & (lo >> 63) & (((lo << 1) != 0) | sig)) | (away & (lo != 0));
+		}
+
+		soft_extended overflow(bool sign, rounding_direction rd) {
+			bool inf = rd == TONEAREST || (rd == UPWARD && !sign) || (rd == DOWNWARD && sign);
+			if (inf) return infinity(sign);
+			return soft_extended((sign ? sign_bit : 0) | (nan_exp - 1), ~UINT64_C(0));
+		}
+
+		/*
+		 * round (sig:lo) to 64 bits and pack.  sig must be normalized (or
+		 * both 0).  Handles gradual underflow and overflow.
+		 */
+		soft_extended round_pack_slow(bool sign, int exp, uint64_t sig, uint64_t lo, rounding_direction rd) {
+
+			if (sig == 0 && lo == 0) return zero(sign);
+
+			if (exp < min_exp) {
+				shift_right_jam(sig, lo, min_exp - exp);
+				exp = min_exp;
+			}
+
+			uint64_t inc = round_increment(sign, sig, lo, rd);
+			sig += inc;
+			if (sig < inc) {
+				// carry out.
+				sig = one_bit;
+				++exp;
+			}
+
+			if (exp > max_exp) return overflow(sign, rd);
+
+			uint16_t e = sig >> 63 ? exp + bias : 0;
+			return soft_extended(e | (sign ? sign_bit : 0), sig);
+		}
+
+		// the usual case, normal and below max_exp (so a carry out can't overflow), inline.
+		inline soft_extended round_pack(bool sign, int exp, uint64_t sig, uint64_t lo, rounding_direction rd) {
+
+			if ((unsigned)(exp - min_exp) >= (unsigned)(max_exp - min_exp) || !(sig >> 63))
+				return round_pack_slow(sign, exp, sig, lo, rd);
+
+			uint64_t inc = round_increment(sign, sig, lo, rd);
+			sig += inc;
+			// a carry out leaves 0.
+			uint64_t carry = sig < inc;
+			sig |= one_bit & (0 - carry);
+			return soft_extended((uint16_t)(exp + (int)carry + bias) | (uint16_t)(sign ? sign_bit : 0), sig);
+		}
+
+
+		/*
+		 * finite, non-zero operands.  The signs and the alignment shift
+		 * are random, so the order, the shift, the sum and the difference
+		 * are all done with selects; only a cancellation of all 64 high
+		 * bits (rare) branches.
+		 */
+		soft_extended add_finite(unpacked x, unpacked y, rounding_direction rd) {
+
+			// |x| >= |y|.  (The masks are spelled out; gcc makes branches of ?:.)
+			uint64_t swap = (x.exp < y.exp) | ((x.exp == y.exp) & (x.sig < y.sig));
+			uint64_t m = 0 - swap;
+			int im = (int)m;
+			uint64_t xs = x.sig ^ ((x.sig ^ y.sig) & m);
+			uint64_t ys = y.sig ^ ((x.sig ^ y.sig) & m);
+			int xe = x.exp ^ ((x.exp ^ y.exp) & im);
+			unsigned d = (unsigned)(((x.exp - y.exp) ^ im) - im);
+			bool sign = x.sign ^ ((x.sign ^ y.sign) & swap);
+
+			// ys >> d as (hi:lo), the lost bits jammed into the low bit.
+			d = d < 128 ? d : 128;
+			uint64_t hi = (ys >> (d & 63)) & (0 - (uint64_t)(d < 64));
+			uint64_t lo = (ys << ((64 - d) & 63)) & (0 - (uint64_t)(d - 1 < 63));
+			lo |= (ys >> ((d - 64) & 63)) & (0 - (uint64_t)(d - 64 < 64));
+			lo |= (uint64_t)((ys << ((128 - d) & 63)) != 0) & (uint64_t)(d - 65 < 63);
+			lo |= (uint64_t)(d == 128);
+
+			// the sum, renormalized if it carried out.
+			uint64_t shi = xs + hi;
+			uint64_t carry = shi < xs;
+			uint64_t slo = (lo >> carry) | (lo & carry) | ((shi << 63) & (0 - carry));
+			shi = (shi >> carry) | (one_bit & (0 - carry));
+
+			// the difference, which is >= 0.
+			uint64_t dlo = 0 - lo;
+			uint64_t dhi = xs - hi - (lo != 0);
+
+			uint64_t same = 0 - (uint64_t)(x.sign == y.sign);
+			uint64_t rhi = (shi & same) | (dhi & ~same);
+			uint64_t rlo = (slo & same) | (dlo & ~same);
+			int exp = xe + (int)(carry & same);
+
+			if (rhi == 0) {
+				if (rlo == 0) return zero(rd == DOWNWARD);
+				rhi = rlo;
+				rlo = 0;
+				exp -= 64;
+			}
+			int shift = clz64(rhi);
+			rhi = (rhi << shift) | ((rlo >> 1) >> (63 - shift));
+			rlo <<= shift;
+			return round_pack(sign, exp - shift, rhi, rlo, rd);
+		}
+
+		soft_extended add_sub(const soft_extended &a, const soft_extended &b, bool negate, rounding_direction rd) {
+
+			int ca = classify(a);
+			int cb = classify(b);
+
+			bool sa = a.sexp >> 15;
+			bool sb = (b.sexp >> 15) ^ negate;
+
+			if (ca == cls_finite && cb == cls_finite) {
+				unpacked x = unpack(a);
+				unpacked y = unpack(b);
+				y.sign = sb;
+				return add_finite(x, y, rd);
+			}
+
+			if (ca == cls_nan || cb == cls_nan) return propagate(a, b);
+
+			if (ca == cls_inf) {
+				if (cb == cls_inf && sa != sb) return make_nan(NANADD);
+				return a;
+			}
+			if (cb == cls_inf) return with_sign(b, sb);
+
+			if (ca == cls_zero && cb == cls_zero) {
+				if (sa == sb) return zero(sa);
+				return zero(rd == DOWNWARD);
+			}
+
+			// one of them is zero.
+			unpacked x = unpack(ca == cls_zero ? b : a);
+			if (ca == cls_zero) x.sign = sb;
+			return round_pack(x.sign, x.exp, x.sig, 0, rd);
+		}
+
+		// 128-bit integer square root.  r = floor(sqrt(hi:lo)), hi >= 2^62.
+		uint64_t isqrt(uint64_t hi, uint64_t lo, uint64_t &rem_hi, uint64_t &rem_lo) {
+
+			/*
+			 * sqrt(hi) in double is good to 2^12 of r; start 6144 below
+			 * so M - r^2 is positive and < 2^79.  One integer newton step,
+			 * r += (M - r^2) * (2^125 / r) >> 126, with the reciprocal
+			 * computed from the same double off the critical path.  The
+			 * step is biased low so r is the answer or one too small and
+			 * a single fixup finishes it.  No branches -- the inputs are
+			 * random, so any branch here would mispredict.
+			 */
+
+			double s = std::sqrt((double)(int64_t)(hi >> 1));
+
+			// 2^93 / (sqrt(2) * s) = 2^125 / r
+			uint64_t inv = (uint64_t)(int64_t)(9903520314283042199192993792.0 * 0.70710678118654752440 / s);
+
+			// sqrt(2) * 2^31 * s, clamped below 2^63 for the conversion.
+			uint64_t r = ((uint64_t)(int64_t)std::min(s * 3037000499.97605, 9223372036854774784.0) << 1) - 6144;
+
+			uint64_t phi, plo;
+			mul64(r, r, phi, plo);
+			uint64_t elo = lo - plo;
+			uint64_t ehi = hi - phi - (lo < plo);
+
+			uint64_t qhi, qlo;
+			mul64((ehi << 49) | (elo >> 15), inv, qhi, qlo);
+			r += (qhi - (UINT64_C(1) << 19)) >> 47;
+
+			// rem = M - r^2
+			mul64(r, r, phi, plo);
+			uint64_t rlo = lo - plo;
+			uint64_t rhi = hi - phi - (lo < plo);
+
+			// one too small (rem >= 2r + 1): rem -= 2r + 1, ++r.
+			uint64_t tlo = (r << 1) | 1;
+			uint64_t thi = r >> 63;
+			uint64_t small = (rhi > thi) | ((rhi == thi) & (rlo >= tlo));
+			tlo &= -small;
+			thi &= -small;
+			rhi -= thi + (rlo < tlo);
+			rlo -= tlo;
+			r += small;
+
+			rem_hi = rhi;
+			rem_lo = rlo;
+			return r;
+		}
+	}
+
+
+	soft_extended::soft_extended(const floating_point::info &fpi) {
+
+		if (fpi.nan) {
+			floating_point::info tmp(fpi);
+			tmp.pack_extended(sexp, sig);
+			return;
+		}
+		if (fpi.inf) {
+			*this = infinity(fpi.sign);
+			return;
+		}
+		if (fpi.sig == 0) {
+			*this = zero(fpi.sign);
+			return;
+		}
+
+		int shift = clz64(fpi.sig);
+		*this = round_pack(fpi.sign, fpi.exp - shift, fpi.sig << shift, 0, TONEAREST);
+	}
+
+
+	soft_extended soft_extended::make(bool sign, int exp, uint64_t sig, uint64_t extra, rounding_direction rd) {
+		if (!sig) {
+			sig = extra;
+			extra = 0;
+			exp -= 64;
+		}
+		if (sig && !(sig >> 63)) {
+			int shift = clz64(sig);
+			shift_left(sig, extra, shift);
+			exp -= shift;
+		}
+		return round_pack(sign, exp, sig, extra, rd);
+	}
+
+
+	soft_extended add(const soft_extended &a, const soft_extended &b, rounding_direction rd) {
+		return add_sub(a, b, false, rd);
+	}
+
+	soft_extended sub(const soft_extended &a, const soft_extended &b, rounding_direction rd) {
+		return add_sub(a, b, true, rd);
+	}
+
+	soft_extended mul(const soft_extended &a, const soft_extended &b, rounding_direction rd) {
+
+		int ca = classify(a);
+		int cb = classify(b);
+
+		if (ca == cls_nan || cb == cls_nan) return propagate(a, b);
+
+		bool sign = (a.sexp ^ b.sexp) >> 15;
+
+		if (ca == cls_inf || cb == cls_inf) {
+			if (ca == cls_zero || cb == cls_zero) return make_nan(NANMUL);
+			return infinity(sign);
+		}
+		if (ca == cls_zero || cb == cls_zero) return zero(sign);
+
+		unpacked x = unpack(a);
+		unpacked y = unpack(b);
+
+		uint64_t hi, lo;
+		int exp = x.exp + y.exp + 1;
+
+		mul64(x.sig, y.sig, hi, lo);
+
+		// product is in [1, 4), normalize without a branch.
+		uint64_t n = ~hi >> 63;
+		hi = (hi << n) | ((lo >> 63) & n);
+		lo <<= n;
+		exp -= n;
+		return round_pack(sign, exp, hi, lo, rd);
+	}
+
+	soft_extended div(const soft_extended &a, const soft_extended &b, rounding_direction rd) {
+
+		int ca = classify(a);
+		int cb = classify(b);
+
+		if (ca == cls_nan || cb == cls_nan) return propagate(a, b);
+
+		bool sign = (a.sexp ^ b.sexp) >> 15;
+
+		if (ca == cls_inf) {
+			if (cb == cls_inf) return make_nan(NANDIV);
+			return infinity(sign);
+		}
+		if (cb == cls_inf) return zero(sign);
+
+		if (cb == cls_zero) {
+			if (ca == cls_zero) return make_nan(NANDIV);
+			return infinity(sign);
+		}
+		if (ca == cls_zero) return zero(sign);
+
+		unpacked x = unpack(a);
+		unpacked y = unpack(b);
+
+		// quotient is in (1/2, 2), scale the dividend so it's in [1, 2).
+		uint64_t ge = x.sig >= y.sig;
+		uint64_t nhi = x.sig >> ge;
+		uint64_t nlo = (x.sig << 63) & (0 - ge);
+		int exp = x.exp - y.exp - 1 + (int)ge;
+
+		uint64_t r;
+		uint64_t q = div128(nhi, nlo, y.sig, r);
+
+		// remainder vs half the divisor gives the round and sticky bits.
+		uint64_t half = y.sig - r;
+		uint64_t lo = ((uint64_t)(r >= half) << 63) | (r != half && r != 0);
+
+		return round_pack(sign, exp, q, lo, rd);
+	}
+
+	soft_extended rem(const soft_extended &a, const soft_extended &b) {
+
+		int ca = classify(a);
+		int cb = classify(b);
+
+		if (ca == cls_nan || cb == cls_nan) return propagate(a, b);
+		if (ca == cls_inf || cb == cls_zero) return make_nan(NANREM);
+		if (cb == cls_inf || ca == cls_zero) return a;
+
+		unpacked x = unpack(a);
+		unpacked y = unpack(b);
+
+		int d = x.exp - y.exp;
+		bool sign = x.sign;
+		uint64_t r;
+		int exp;
+
+		if (d < -1) return a;
+
+		if (d == -1) {
+			// |a| < |b|.  n is 1 if |a| > |b| / 2, otherwise 0 (ties to even).
+			if (x.sig <= y.sig) return a;
+			r = (y.sig << 1) - x.sig;
+			exp = x.exp;
+			sign = !sign;
+		} else {
+			uint64_t q = 0;
+
+			r = x.sig;
+			if (r >= y.sig) { r -= y.sig; q = 1; }
+
+			while (d > 0) {
+				int k = d > 63 ? 63 : d;
+				q = div128(r >> (64 - k), r << k, y.sig, r);
+				d -= k;
+			}
+
+			// round the quotient to nearest, ties to even.
+			uint64_t half = y.sig - r;
+			if (r > half || (r == half && (q & 0x01))) {
+				r = half;
+				sign = !sign;
+			}
+			exp = y.exp;
+		}
+
+		if (r == 0) return zero(x.sign);
+
+		int shift = clz64(r);
+		return round_pack(sign, exp - shift, r << shift, 0, TONEAREST);
+	}
+
+	soft_extended sqrt(const soft_extended &a, rounding_direction rd) {
+
+		int ca = classify(a);
+
+		if (ca == cls_nan) return quiet(a);
+		if (ca == cls_zero) return a;
+		if (a.sexp >> 15) return make_nan(NANSQRT);
+		if (ca == cls_inf) return a;
+
+		unpacked x = unpack(a);
+
+		// shift so the exponent is even (without a branch on it).
+		uint64_t even = ~x.exp & 0x01;
+		uint64_t hi = x.sig >> even;
+		uint64_t lo = (x.sig << 63) & (0 - even);
+		int s = 64 - (int)even;
+
+		uint64_t rem_hi, rem_lo;
+		uint64_t r = isqrt(hi, lo, rem_hi, rem_lo);
+
+		// sqrt can't be exactly halfway so remainder > r means > 1/2 ulp.
+		uint64_t above = (rem_hi != 0) | (rem_lo > r);
+		uint64_t extra = (above << 63) | ((rem_hi | rem_lo) != 0);
+
+		return round_pack(false, 63 + (x.exp - 63 - s) / 2, r, extra, rd);
+	}
+
+	soft_extended rint(const soft_extended &a, rounding_direction rd) {
+
+		int ca = classify(a);
+
+		if (ca == cls_nan) return quiet(a);
+		if (ca != cls_finite) return a;
+
+		unpacked x = unpack(a);
+
+		if (x.exp >= 63) return a;
+
+		uint64_t ip;
+		uint64_t lo;
+
+		if (x.exp >= -1) {
+			unsigned shift = 63 - x.exp;
+			ip = shift == 64 ? 0 : x.sig >> shift;
+			lo = x.sig << (64 - shift);
+			if (shift == 64) lo = x.sig;
+		} else {
+			// < 1/2
+			ip = 0;
+			lo = 0x01;
+		}
+
+		ip += round_increment(x.sign, ip, lo, rd);
+		if (ip == 0) return zero(x.sign);
+
+		int shift = clz64(ip);
+		return round_pack(x.sign, 63 - shift, ip << shift, 0, rd);
+	}
+
+	int compare(const soft_extended &a, const soft_extended &b) {
+
+		int ca = classify(a);
+		int cb = classify(b);
+
+		if (ca == cls_nan || cb == cls_nan) return 2;
+		if (ca == cls_zero && cb == cls_zero) return 0;
+
+		bool sa = a.sexp >> 15;
+		bool sb = b.sexp >> 15;
+
+		if (ca == cls_zero) return sb ? 1 : -1;
+		if (cb == cls_zero) return sa ? -1 : 1;
+		if (sa != sb) return sa ? -1 : 1;
+
+		int m = 0;
+		if (ca == cls_inf || cb == cls_inf) {
+			m = (ca == cls_inf) - (cb == cls_inf);
+		} else {
+			unpacked x = unpack(a);
+			unpacked y = unpack(b);
+
+			if (x.exp != y.exp) m = x.exp < y.exp ? -1 : 1;
+			else if (x.sig != y.sig) m = x.sig < y.sig ? -1 : 1;
+		}
+		return sa ? -m : m;
+	}
+
+}